@@ -1217,6 +1217,10 @@ void MT_ProcessSerialCommand( byte *msg )
       case SPI_CMD_ZDO_MGMT_PERMIT_JOIN_REQ:
       case SPI_CMD_ZDO_SERVERDISC_REQ:
       case SPI_CMD_ZDO_NETWORK_START_REQ:
+      case SPI_CMD_ZDO_INVENTORY_REQ:
+      case SPI_CMD_ZDO_TOPOLOGY_REQ:
+      case SPI_CMD_ZDO_ADMIT_STATS_REQ:
+      case SPI_CMD_ZDO_RESUME_STATS_REQ:
         MT_ZdoCommandProcessing( cmd , len , pData );
         break;
 #endif
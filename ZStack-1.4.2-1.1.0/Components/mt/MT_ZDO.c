@@ -547,6 +547,56 @@ void MT_ZdoCommandProcessing( uint16 cmd_id , byte len , byte *pData )
       ret = ZDApp_StartUpFromApp( ZDAPP_STARTUP_AUTO );
       break;
     
+#endif
+
+#if defined ( ZDO_INVENTORY )
+    case SPI_CMD_ZDO_INVENTORY_REQ:
+      // Non-zero starts a new pass, zero stops the current one.
+      if ( *pData )
+      {
+        ZDInventoryStart();
+      }
+      else
+      {
+        ZDInventoryStop();
+      }
+      ret = ZSUCCESS;
+      break;
+#endif
+
+#if defined ( ZDO_TOPOLOGY )
+    case SPI_CMD_ZDO_TOPOLOGY_REQ:
+      // Non-zero starts crawling from scratch, zero stops.
+      if ( *pData )
+      {
+        ZDTopologyStart();
+      }
+      else
+      {
+        ZDTopologyStop();
+      }
+      ret = ZSUCCESS;
+      break;
+#endif
+
+#if defined ( ZDSECMGR_ADMIT )
+    case SPI_CMD_ZDO_ADMIT_STATS_REQ:
+      // Report the join storm metrics, non-zero also resets them.
+      zdo_MTCB_AdmitStatsCB( ZDSecMgrAdmitStatsGet() );
+      if ( *pData )
+      {
+        ZDSecMgrAdmitStatsReset();
+      }
+      ret = ZSUCCESS;
+      break;
+#endif
+
+#if defined ( ZDO_FAST_RESUME )
+    case SPI_CMD_ZDO_RESUME_STATS_REQ:
+      // Report the fast resume latency of the last start.
+      zdo_MTCB_ResumeStatsCB( ZDApp_ResumeStatsGet() );
+      ret = ZSUCCESS;
+      break;
 #endif
     
     default:
@@ -1457,6 +1507,177 @@ void zdo_MTCB_ServerDiscRspCB( uint16 srcAddr, byte status,
 }
 #endif
 
+#if defined ( ZDO_INVENTORY )
+/*********************************************************************
+ * @fn     zdo_MTCB_InventoryRspCB()
+ *
+ * @brief  Called to send MT callback response for a device finished by
+ *         the Network Inventory, or for the end of the inventory pass.
+ *
+ * @param  status - ZSuccess, or ZFailure if the device did not respond.
+ * @param  pDev - Inventory entry, NULL for the end of the pass.
+ *
+ * @return  none
+ */
+void zdo_MTCB_InventoryRspCB( byte status, invDevice_t *pDev )
+{
+  byte buf[1 + 2 + Z_EXTADDR_LEN + 3 + (INV_EP_MAX * 7)];
+  byte *pBuf = buf;
+  byte x;
+
+  *pBuf++ = status;
+
+  if ( pDev == NULL )
+  {
+    *pBuf++ = HI_UINT16( INVALID_NODE_ADDR );
+    *pBuf++ = LO_UINT16( INVALID_NODE_ADDR );
+    osal_memset( pBuf, 0, Z_EXTADDR_LEN + 3 );
+    pBuf += Z_EXTADDR_LEN + 3;
+  }
+  else
+  {
+    *pBuf++ = HI_UINT16( pDev->nwkAddr );
+    *pBuf++ = LO_UINT16( pDev->nwkAddr );
+    pBuf = zdo_MT_CopyRevExtAddr( pBuf, pDev->extAddr );
+    *pBuf++ = pDev->logicalType;
+    *pBuf++ = pDev->capabilities;
+    *pBuf++ = pDev->epCnt;
+
+    for ( x = 0; x < pDev->epCnt; x++ )
+    {
+      invEndPoint_t *pEP = &pDev->epList[x];
+
+      *pBuf++ = pEP->endPoint;
+      *pBuf++ = HI_UINT16( pEP->profileID );
+      *pBuf++ = LO_UINT16( pEP->profileID );
+      *pBuf++ = HI_UINT16( pEP->deviceID );
+      *pBuf++ = LO_UINT16( pEP->deviceID );
+      *pBuf++ = pEP->numInClusters;
+      *pBuf++ = pEP->numOutClusters;
+    }
+  }
+
+  MT_BuildAndSendZToolCB( SPI_CB_ZDO_INVENTORY_RSP, (byte)(pBuf - buf), buf );
+}
+#endif
+
+#if defined ( ZDO_TOPOLOGY )
+/*********************************************************************
+ * @fn     zdo_MTCB_TopologyRspCB()
+ *
+ * @brief  Called to send MT callback response for a link added to,
+ *         removed from or changed in the Topology Crawler graph.
+ *
+ * @param  change - TOPO_LINK_ADDED, TOPO_LINK_REMOVED or TOPO_LINK_CHANGED.
+ * @param  pLink - The link.
+ *
+ * @return  none
+ */
+void zdo_MTCB_TopologyRspCB( byte change, topoLink_t *pLink )
+{
+  byte buf[7];
+
+  buf[0] = change;
+  buf[1] = HI_UINT16( pLink->srcAddr );
+  buf[2] = LO_UINT16( pLink->srcAddr );
+  buf[3] = HI_UINT16( pLink->dstAddr );
+  buf[4] = LO_UINT16( pLink->dstAddr );
+  buf[5] = pLink->lqi;
+  buf[6] = pLink->flags & TOPO_LINK_ROUTE;
+
+  MT_BuildAndSendZToolCB( SPI_CB_ZDO_TOPOLOGY_RSP, 7, buf );
+}
+#endif
+
+#if defined ( ZDSECMGR_ADMIT )
+/*********************************************************************
+ * @fn     zdo_MTCB_AdmitStatsCB()
+ *
+ * @brief  Called to send MT callback response with the join storm
+ *         metrics of the join admission queue.
+ *
+ * @param  pStats - The metrics.
+ *
+ * @return  none
+ */
+void zdo_MTCB_AdmitStatsCB( ZDSecMgrAdmitStats_t *pStats )
+{
+  byte buf[21];
+  byte *pBuf = buf;
+  uint32 mean = 0;
+
+  if ( pStats->timed )
+  {
+    mean = pStats->waitSum / pStats->timed;
+  }
+
+  *pBuf++ = HI_UINT16( pStats->joins );
+  *pBuf++ = LO_UINT16( pStats->joins );
+  *pBuf++ = HI_UINT16( pStats->admitted );
+  *pBuf++ = LO_UINT16( pStats->admitted );
+  *pBuf++ = HI_UINT16( pStats->known );
+  *pBuf++ = LO_UINT16( pStats->known );
+  *pBuf++ = HI_UINT16( pStats->overflow );
+  *pBuf++ = LO_UINT16( pStats->overflow );
+  *pBuf++ = pStats->peak;
+
+  *pBuf++ = BREAK_UINT32( mean, 3 );
+  *pBuf++ = BREAK_UINT32( mean, 2 );
+  *pBuf++ = BREAK_UINT32( mean, 1 );
+  *pBuf++ = BREAK_UINT32( mean, 0 );
+  *pBuf++ = BREAK_UINT32( pStats->waitMax, 3 );
+  *pBuf++ = BREAK_UINT32( pStats->waitMax, 2 );
+  *pBuf++ = BREAK_UINT32( pStats->waitMax, 1 );
+  *pBuf++ = BREAK_UINT32( pStats->waitMax, 0 );
+  *pBuf++ = BREAK_UINT32( pStats->span, 3 );
+  *pBuf++ = BREAK_UINT32( pStats->span, 2 );
+  *pBuf++ = BREAK_UINT32( pStats->span, 1 );
+  *pBuf++ = BREAK_UINT32( pStats->span, 0 );
+
+  MT_BuildAndSendZToolCB( SPI_CB_ZDO_ADMIT_STATS_RSP, 21, buf );
+}
+#endif
+
+#if defined ( ZDO_FAST_RESUME )
+/*********************************************************************
+ * @fn     zdo_MTCB_ResumeStatsCB()
+ *
+ * @brief  Called to send MT callback response with the fast resume
+ *         latency.
+ *
+ * @param  pStats - The latency record.
+ *
+ * @return  none
+ */
+void zdo_MTCB_ResumeStatsCB( ZDApp_ResumeStats_t *pStats )
+{
+  byte buf[18];
+  byte *pBuf = buf;
+
+  *pBuf++ = pStats->state;
+  *pBuf++ = pStats->tries;
+
+  *pBuf++ = BREAK_UINT32( pStats->init, 3 );
+  *pBuf++ = BREAK_UINT32( pStats->init, 2 );
+  *pBuf++ = BREAK_UINT32( pStats->init, 1 );
+  *pBuf++ = BREAK_UINT32( pStats->init, 0 );
+  *pBuf++ = BREAK_UINT32( pStats->online, 3 );
+  *pBuf++ = BREAK_UINT32( pStats->online, 2 );
+  *pBuf++ = BREAK_UINT32( pStats->online, 1 );
+  *pBuf++ = BREAK_UINT32( pStats->online, 0 );
+  *pBuf++ = BREAK_UINT32( pStats->firstTx, 3 );
+  *pBuf++ = BREAK_UINT32( pStats->firstTx, 2 );
+  *pBuf++ = BREAK_UINT32( pStats->firstTx, 1 );
+  *pBuf++ = BREAK_UINT32( pStats->firstTx, 0 );
+  *pBuf++ = BREAK_UINT32( pStats->done, 3 );
+  *pBuf++ = BREAK_UINT32( pStats->done, 2 );
+  *pBuf++ = BREAK_UINT32( pStats->done, 1 );
+  *pBuf++ = BREAK_UINT32( pStats->done, 0 );
+
+  MT_BuildAndSendZToolCB( SPI_CB_ZDO_RESUME_STATS_RSP, 18, buf );
+}
+#endif
+
 /*********************************************************************
 *********************************************************************/
 
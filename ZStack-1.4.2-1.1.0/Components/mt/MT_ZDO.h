@@ -27,6 +27,9 @@
 #include "ZDProfile.h"
 #include "ZDObject.h"
 #include "ZDApp.h"
+#include "ZDInventory.h"
+#include "ZDTopology.h"
+#include "ZDSecMgr.h"
 
 #if !defined( WIN32 )
   #include "OnBoard.h"
@@ -66,6 +69,10 @@
 #define SPI_CMD_ZDO_MGMT_PERMIT_JOIN_REQ      0x0A16
 #define SPI_CMD_ZDO_SERVERDISC_REQ            0X0A17
 #define SPI_CMD_ZDO_NETWORK_START_REQ         0X0A18
+#define SPI_CMD_ZDO_INVENTORY_REQ             0x0A19
+#define SPI_CMD_ZDO_TOPOLOGY_REQ              0x0A1A
+#define SPI_CMD_ZDO_ADMIT_STATS_REQ           0x0A1B
+#define SPI_CMD_ZDO_RESUME_STATS_REQ          0x0A1C
 
 #define SPI_ZDO_CB_TYPE                       0x0A80
 
@@ -92,6 +99,10 @@
 #define SPI_CB_ZDO_MGMT_LEAVE_RSP             0x0A91
 #define SPI_CB_ZDO_MGMT_PERMIT_JOIN_RSP       0x0A92
 #define SPI_CB_ZDO_SERVERDISC_RSP             0x0A93
+#define SPI_CB_ZDO_INVENTORY_RSP              0x0A94
+#define SPI_CB_ZDO_TOPOLOGY_RSP               0x0A95
+#define SPI_CB_ZDO_ADMIT_STATS_RSP            0x0A96
+#define SPI_CB_ZDO_RESUME_STATS_RSP           0x0A97
 
 #define SPI_RESP_LEN_ZDO_DEFAULT              0x01
 
@@ -115,6 +126,10 @@
 #define CB_ID_ZDO_MGMT_LEAVE_RSP             0x00020000
 #define CB_ID_ZDO_MGMT_PERMIT_JOIN_RSP       0x00040000
 #define CB_ID_ZDO_SERVERDISC_RSP             0x00080000
+#define CB_ID_ZDO_INVENTORY_RSP              0x00100000
+#define CB_ID_ZDO_TOPOLOGY_RSP               0x00200000
+#define CB_ID_ZDO_ADMIT_STATS_RSP            0x00400000
+#define CB_ID_ZDO_RESUME_STATS_RSP           0x00800000
 
 /*********************************************************************
  * TYPEDEFS
@@ -401,5 +416,78 @@ void zdo_MTCB_ServerDiscRspCB( uint16 srcAddr, byte status,
                                uint16 serverMask, byte SecurityUse );
 #endif
 
+/*
+ *  Network Inventory device record, or end of pass if NwkAddr is 0xFFFF.
+ *
+ *  @MT SPI_CB_ZDO_INVENTORY_RSP
+ *  (byte Status,
+ *   uint16 NwkAddr,
+ *   byte IEEEAddr[8],
+ *   byte LogicalType,
+ *   byte Capabilities,
+ *   byte EPCount,
+ *   EPCount * ( byte EndPoint,
+ *               uint16 ProfileID,
+ *               uint16 DeviceID,
+ *               byte NumInClusters,
+ *               byte NumOutClusters ))
+ *
+ */
+#if defined ( ZDO_INVENTORY )
+extern void zdo_MTCB_InventoryRspCB( byte status, invDevice_t *pDev );
+#endif
+
+/*
+ *  Topology Crawler link change.
+ *
+ *  @MT SPI_CB_ZDO_TOPOLOGY_RSP
+ *  (byte Change,
+ *   uint16 SrcAddr,
+ *   uint16 NbrAddr,
+ *   byte LQI,
+ *   byte Route)
+ *
+ */
+#if defined ( ZDO_TOPOLOGY )
+extern void zdo_MTCB_TopologyRspCB( byte change, topoLink_t *pLink );
+#endif
+
+/*
+ *  Join storm metrics, sent when the join admission queue drains and
+ *  on request. Times are in milliseconds.
+ *
+ *  @MT SPI_CB_ZDO_ADMIT_STATS_RSP
+ *  (uint16 Joins,
+ *   uint16 Admitted,
+ *   uint16 Known,
+ *   uint16 Overflow,
+ *   byte Peak,
+ *   uint32 WaitMean,
+ *   uint32 WaitMax,
+ *   uint32 Span)
+ *
+ */
+#if defined ( ZDSECMGR_ADMIT )
+extern void zdo_MTCB_AdmitStatsCB( ZDSecMgrAdmitStats_t *pStats );
+#endif
+
+/*
+ *  Fast resume latency, sent when the resume check ends and on
+ *  request. Times are osal_GetSystemClock() milliseconds since boot,
+ *  0 if not reached.
+ *
+ *  @MT SPI_CB_ZDO_RESUME_STATS_RSP
+ *  (byte State,
+ *   byte Tries,
+ *   uint32 Init,
+ *   uint32 Online,
+ *   uint32 FirstTx,
+ *   uint32 Done)
+ *
+ */
+#if defined ( ZDO_FAST_RESUME )
+extern void zdo_MTCB_ResumeStatsCB( ZDApp_ResumeStats_t *pStats );
+#endif
+
 /*********************************************************************
 *********************************************************************/
@@ -80,6 +80,11 @@ osal_msg_q_t osal_qHead;
  * LOCAL VARIABLES
  */
 
+// Called before a message buffer tagged with the hook's index is freed, so
+// that the owner of any memory referenced from the message (e.g. a shared
+// AF payload) can release it.
+static osalMsgFreeCB_t osal_msgFreeCB[OSAL_MSG_FREE_CB_MAX];
+
 /*********************************************************************
  * LOCAL FUNCTION PROTOTYPES
  */
@@ -399,6 +404,7 @@ byte * osal_msg_allocate( uint16 len )
     hdr->next = NULL;
     hdr->len = len;
     hdr->dest_id = TASK_NO_TASK;
+    hdr->free_id = OSAL_MSG_FREE_NONE;
 
 #if defined( OSAL_TOTAL_MEM )
     osal_msg_cnt++;
@@ -432,6 +438,11 @@ byte osal_msg_deallocate( byte *msg_ptr )
   if ( OSAL_MSG_ID( msg_ptr ) != TASK_NO_TASK )
     return ( MSG_BUFFER_NOT_AVAIL );
 
+  if ( OSAL_MSG_FREE_ID( msg_ptr ) < OSAL_MSG_FREE_CB_MAX )
+  {
+    osal_msgFreeCB[OSAL_MSG_FREE_ID( msg_ptr )]( msg_ptr, OSAL_MSG_LEN( msg_ptr ) );
+  }
+
   x = (byte *)((byte *)msg_ptr - sizeof( osal_msg_hdr_t ));
 
   osal_mem_free( (void *)x );
@@ -444,6 +455,37 @@ byte osal_msg_deallocate( byte *msg_ptr )
   return ( ZSUCCESS );
 }
 
+/*********************************************************************
+ * @fn      osal_msg_register_free_cb
+ *
+ * @brief
+ *
+ *    Register a function for osal_msg_deallocate() to call just before
+ *    a message buffer is returned to the heap. It is only called for the
+ *    messages whose OSAL_MSG_FREE_ID() the owner set to the returned ID,
+ *    so other messages are freed at no extra cost. Registering the same
+ *    function again returns the same ID.
+ *
+ * @param   osalMsgFreeCB_t pfnFreeCB - hook
+ *
+ * @return  hook ID, OSAL_MSG_FREE_NONE if OSAL_MSG_FREE_CB_MAX are in use
+ */
+byte osal_msg_register_free_cb( osalMsgFreeCB_t pfnFreeCB )
+{
+  byte id;
+
+  for ( id = 0; id < OSAL_MSG_FREE_CB_MAX; id++ )
+  {
+    if ( (osal_msgFreeCB[id] == NULL) || (osal_msgFreeCB[id] == pfnFreeCB) )
+    {
+      osal_msgFreeCB[id] = pfnFreeCB;
+      return ( id );  // EMBEDDED RETURN
+    }
+  }
+
+  return ( OSAL_MSG_FREE_NONE );
+}
+
 #if defined( OSAL_TOTAL_MEM )
 /*********************************************************************
  * @fn      osal_num_msgs
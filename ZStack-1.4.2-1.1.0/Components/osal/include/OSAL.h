@@ -42,6 +42,10 @@ extern "C"
 
 #define OSAL_MSG_NEXT(msg_ptr)      ((osal_msg_hdr_t *) (msg_ptr) - 1)->next
 
+// Hook called when the message is freed, an ID from
+// osal_msg_register_free_cb() or OSAL_MSG_FREE_NONE
+#define OSAL_MSG_FREE_ID(msg_ptr)   ((osal_msg_hdr_t *) (msg_ptr) - 1)->free_id
+
 #define OSAL_MSG_Q_INIT(q_ptr)      *(q_ptr) = NULL
 
 #define OSAL_MSG_Q_EMPTY(q_ptr)     (*(q_ptr) == NULL)
@@ -55,6 +59,13 @@ extern "C"
 /*** Interrupts ***/
 #define INTS_ALL    0xFF
 
+/*** Message deallocation hooks ***/
+#define OSAL_MSG_FREE_NONE    0xFF
+
+#if !defined( OSAL_MSG_FREE_CB_MAX )
+  #define OSAL_MSG_FREE_CB_MAX  2
+#endif
+
 
 /*********************************************************************
  * TYPEDEFS
@@ -64,6 +75,7 @@ typedef struct
   void   *next;
   uint16 len;
   byte   dest_id;
+  byte   free_id;
 } osal_msg_hdr_t;
 
 typedef struct
@@ -74,6 +86,10 @@ typedef struct
 
 typedef void * osal_msg_q_t;
 
+// Hook invoked by osal_msg_deallocate() just before a message tagged with
+// its ID (OSAL_MSG_FREE_ID) is freed.
+typedef void (*osalMsgFreeCB_t)( byte *msg_ptr, uint16 len );
+
 /*********************************************************************
  * GLOBAL VARIABLES
  */
@@ -94,6 +110,11 @@ typedef void * osal_msg_q_t;
    */
   extern byte osal_msg_deallocate( byte *msg_ptr );
 
+  /*
+   * Register a Task Message Deallocation hook
+   */
+  extern byte osal_msg_register_free_cb( osalMsgFreeCB_t pfnFreeCB );
+
   /*
    * Task Messages Count
    */
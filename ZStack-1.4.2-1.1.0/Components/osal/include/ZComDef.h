@@ -143,6 +143,8 @@ extern "C"
 #define ZCD_NV_SECURITY_LEVEL             0x0061
 #define ZCD_NV_PRECFGKEY                  0x0062
 #define ZCD_NV_PRECFGKEYS_ENABLE          0x0063
+#define ZCD_NV_SECMGR_ENTRIES             0x0064
+#define ZCD_NV_SECMGR_ENTRIES_END         0x007F
 
 // ZDO NV Item IDs
 #define ZCD_NV_USERDESC                   0x0081
@@ -155,6 +157,7 @@ extern "C"
 
 // ZCL NV item IDs
 #define ZCD_NV_SCENE_TABLE                0x0091
+#define ZCD_NV_REPORT_CFG_TABLE           0x0092
 
 // Non-standard NV item IDs
 #define ZCD_NV_SAPI_ENDPOINT              0x00A1
@@ -300,6 +303,7 @@ typedef struct
 #define AF_INCOMING_MSG_CMD       0x1A    // Incoming MSG type message
 #define AF_INCOMING_KVP_CMD       0x1B    // Incoming KVP type message
 #define AF_INCOMING_GRP_KVP_CMD   0x1C    // Incoming Group KVP type message
+#define AF_TX_READY_CMD           0x1D    // AF transmit queue has room again
 
 #define KEY_CHANGE                0xC0    // Key Events
 
@@ -315,6 +319,8 @@ typedef struct
 #define ZDO_BIND_RESP             0xD9    // ZDO received a Bind_rsp message
 #define ZDO_UNBIND_RESP           0xDA    // ZDO received an Unbind_rsp message
 #define ZDO_MATCH_DESC_RSP_SENT   0xDB    // ZDO match descriptor response was sent
+#define ZDO_ADDR_RESOLVE_RSP      0xDC    // ZDO address resolution completed
+#define ZDO_SHARED_RSP            0xDD    // ZDO notification shared by its subscribers
 
 // OSAL System Message IDs/Events Reserved for applications (user applications)
 // 0xE0  0xFF
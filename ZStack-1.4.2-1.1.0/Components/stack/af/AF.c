@@ -28,7 +28,9 @@
 #include "nwk_util.h"
 #include "aps_groups.h"
 #include "ZDProfile.h"
+#include "ZDApp.h"
 #include "aps_frag.h"
+#include "nwk_bufs.h"
 
 #if ( AF_FLOAT_SUPPORT )
   #include "math.h"
@@ -42,6 +44,11 @@
  * MACROS
  */
 
+// Cluster ID n of a list in a received frame, cIdLen bytes per ID.
+#define AF_CLUSTER_AT( pList, n, cIdLen ) \
+  BUILD_UINT16( (pList)[(n) * (cIdLen)], \
+                ((cIdLen) == 2) ? (pList)[(n) * (cIdLen) + 1] : 0 )
+
 /*********************************************************************
  * @fn      afSend
  *
@@ -95,12 +102,82 @@ typedef struct
 } afMultiHdr_t;
 #endif
 
+// Group delivery index entry, kept sorted by group ID.
+typedef struct
+{
+  uint16 groupID;
+  uint16 epMask;    // Bit n set for the endpoint in afEpSlots[n]
+} afGroupIdx_t;
+
+// Match_Desc_req index entry, kept sorted by cluster ID.
+typedef struct
+{
+  uint16 clusterID;
+  uint16 inMask;    // Bit n set if afEpSlots[n] has the cluster as input
+  uint16 outMask;   // Bit n set if afEpSlots[n] has the cluster as output
+} afClusterIdx_t;
+
+#if ( AF_AGGREGATE_SUPPORT )
+// Aggregate being filled
+typedef struct
+{
+  afAddrType_t dstAddr;
+  endPointDesc_t *srcEP;
+  uint8 options;
+  uint8 radius;
+  uint8 count;
+  uint8 len;
+  uint8 handle;   // Transaction ID of the aggregate frame itself
+  uint8 transID[AF_AGGREGATE_MAX_MSGS];
+  uint8 *buf;     // NULL if nothing is pending
+} afAggregate_t;
+
+// Aggregate sent and waiting for its data confirm
+typedef struct
+{
+  uint8 endPoint;
+  uint8 handle;   // Transaction ID the aggregate frame was sent with
+  uint8 count;    // 0 if the entry is free
+  uint8 transID[AF_AGGREGATE_MAX_MSGS];
+} afAggregateSent_t;
+#endif
+
+#if ( AF_TX_QUEUE_SUPPORT )
+// Queued AF_DataRequest(), the data follows the structure.
+typedef struct afTxQueueItem_s
+{
+  struct afTxQueueItem_s *next;
+  afAddrType_t dstAddr;
+  endPointDesc_t *srcEP;
+  uint16 cID;
+  uint16 len;
+  uint8 transID;
+  uint8 options;
+  uint8 radius;
+  uint8 priority;
+} afTxQueueItem_t;
+#endif
+
+#if ( AF_SHARED_INCOMING )
+// ASDU copy shared by all endpoint messages built from one incoming frame.
+// The payload immediately follows this header.
+typedef struct
+{
+  uint8 refCnt;
+} afSharedASDU_t;
+
+#endif
+
 /*********************************************************************
  * GLOBAL VARIABLES
  */
 
 epList_t *epList;
 
+#if ( AF_AGGREGATE_SUPPORT )
+afAggregateStats_t afAggregateStats;
+#endif
+
 /*********************************************************************
  * EXTERNAL VARIABLES
  */
@@ -113,6 +190,51 @@ epList_t *epList;
  * LOCAL VARIABLES
  */
 
+#if ( AF_SHARED_INCOMING )
+// OSAL free hook ID of the messages referencing a shared ASDU, whose
+// pointer follows their afIncomingMSGPacket_t.
+static byte afSharedFreeId;
+#endif
+
+// Endpoint dispatch table: afEpIndex[endpoint] holds (slot + 1) into
+// afEpSlots[], or 0 if the endpoint isn't in the table.
+static byte afEpIndex[AF_EP_INDEX_MAX + 1];
+static epList_t *afEpSlots[AF_MAX_ENDPOINTS];
+static byte afEpSlotCnt;
+
+// Set when an endpoint had to be registered outside of the table.
+static byte afEpOverflow;
+
+// Group ID to endpoint bitmap index, rebuilt from the APS group table
+// whenever afGroupIdxValid is FALSE. The APS group table is also changed
+// by callers of aps_AddGroup()/aps_RemoveGroup() and the NV restore, so
+// its size is checked against afGroupIdxApsCnt before each use.
+static afGroupIdx_t afGroupIdx[APS_MAX_GROUPS];
+static byte afGroupIdxCnt;
+static byte afGroupIdxValid;
+static byte afGroupIdxApsCnt;
+
+// Cluster ID to endpoint bitmaps, used for Match_Desc_req while
+// afClusterIdxValid is TRUE.
+static afClusterIdx_t afClusterIdx[AF_CLUSTER_IDX_MAX];
+static byte afClusterIdxCnt;
+static byte afClusterIdxValid;
+
+#if ( AF_AGGREGATE_SUPPORT )
+static afAggregate_t afAggPend;
+static afAggregateSent_t afAggSent[AF_AGGREGATE_SENT_MAX];
+
+// Peers that unpack aggregates, INVALID_NODE_ADDR if the entry is free
+static uint16 afAggPeers[AF_AGGREGATE_PEER_MAX];
+#endif
+
+#if ( AF_TX_QUEUE_SUPPORT )
+static afTxQueueItem_t *afTxQueue;  // Sorted by priority, FIFO within one
+static uint8 afTxQueueCnt;
+static uint8 afTxQueueBusy;         // Draining, don't re-enter
+static uint8 afTxQueuePaced;        // Hold bulk traffic until the timer
+#endif
+
 /*********************************************************************
  * LOCAL FUNCTIONS
  */
@@ -124,7 +246,13 @@ static void afBuildKVPIncoming( aps_FrameFormat_t *aff, endPointDesc_t *epDesc,
 
 static void afBuildMSGIncoming( aps_FrameFormat_t *aff, endPointDesc_t *epDesc,
                 zAddrType_t *SrcAddress, uint8 LinkQuality, byte SecurityUse,
-                uint32 timestamp );
+                uint32 timestamp, void **ppShared );
+
+#if ( AF_SHARED_INCOMING )
+static afSharedASDU_t *afSharedAlloc( byte *asdu, uint16 len );
+static void afSharedRelease( afSharedASDU_t *shared );
+static void afSharedMsgFreeCB( byte *msg_ptr, uint16 len );
+#endif
 
 #if ( AF_KVP_SUPPORT )
 static afMultiHdr_t *multiInit( afAddrType_t *dstAddr,
@@ -145,7 +273,43 @@ static afStatus_t afDataRequest( afAddrType_t *dstAddr, endPointDesc_t *srcEP,
 
 static epList_t *afFindEndPointDescList( byte EndPoint );
 
-static pDescCB afGetDescCB( endPointDesc_t *epDesc );
+static void afEpIndexAdd( epList_t *ep );
+
+static uint16 afGetProfileID( epList_t *pList );
+
+static byte afGroupIdxBuild( void );
+static void afGroupIdxSync( void );
+static afGroupIdx_t *afGroupIdxFind( uint16 groupID, byte *pPos );
+static void afGroupIdxSet( uint8 endpoint, uint16 groupID, byte member );
+static epList_t *afGroupNextEp( uint16 groupID, uint16 *pMask, uint8 *pLastEP );
+
+static void afClusterIdxBuild( void );
+static void afClusterIdxAdd( epList_t *ep );
+static afClusterIdx_t *afClusterIdxFind( uint16 clusterID, byte *pPos );
+static void afClusterIdxSet( uint16 clusterID, uint16 bit, byte output );
+static byte afClusterListHas( byte cnt, byte *pList, byte cIdLen,
+                              byte descCnt, cId_t *pDescList );
+
+#if ( AF_AGGREGATE_SUPPORT )
+static uint8 afAggregateAdd( afAddrType_t *dstAddr, endPointDesc_t *srcEP,
+                             uint16 cID, uint16 len, uint8 *buf, uint8 *transID,
+                             uint8 options, uint8 radius );
+static void afAggregateFlush( void );
+static afAggregateSent_t *afAggregateSentFind( uint8 endPoint, uint8 handle );
+static uint8 afAggregatePeerFind( uint16 nwkAddr );
+static uint8 afAggregateConfirm( uint8 endPoint, uint8 transID, ZStatus_t status );
+static void afIncomingAggregate( aps_FrameFormat_t *aff, zAddrType_t *SrcAddress,
+                     uint8 LinkQuality, byte SecurityUse, uint32 timestamp );
+#endif
+
+#if ( AF_TX_QUEUE_SUPPORT )
+static afStatus_t afTxQueueAdd( afAddrType_t *dstAddr, endPointDesc_t *srcEP,
+                                uint16 cID, uint16 len, uint8 *buf, uint8 *transID,
+                                uint8 options, uint8 radius );
+static void afTxQueueDrain( void );
+static uint8 afTxQueueRetry( afStatus_t stat );
+static void afTxQueueTimer( uint16 timeout );
+#endif
 
 /*********************************************************************
  * NETWORK LAYER CALLBACKS
@@ -168,6 +332,44 @@ void afInit( void )
 {
   // Start with no endpoint defined
   epList = NULL;
+
+  osal_memset( afEpIndex, 0, sizeof( afEpIndex ) );
+  afEpSlotCnt = 0;
+  afEpOverflow = FALSE;
+
+  afGroupIdxCnt = 0;
+  afGroupIdxValid = FALSE;
+
+  afClusterIdxCnt = 0;
+  afClusterIdxValid = TRUE;
+
+#if ( AF_AGGREGATE_SUPPORT )
+  if ( afAggPend.buf )
+  {
+    osal_mem_free( afAggPend.buf );
+  }
+  osal_memset( &afAggPend, 0, sizeof( afAggPend ) );
+  osal_memset( afAggSent, 0, sizeof( afAggSent ) );
+  osal_memset( afAggPeers, 0xFF, sizeof( afAggPeers ) );
+#endif
+
+#if ( AF_TX_QUEUE_SUPPORT )
+  while ( afTxQueue )
+  {
+    afTxQueueItem_t *item = afTxQueue;
+    afTxQueue = item->next;
+    osal_mem_free( item );
+  }
+  afTxQueueCnt = 0;
+  afTxQueueBusy = FALSE;
+  afTxQueuePaced = FALSE;
+#endif
+
+#if ( AF_SHARED_INCOMING )
+  // Drop the shared payload reference as each incoming message is freed.
+  // Without a hook ID every message gets its own copy.
+  afSharedFreeId = osal_msg_register_free_cb( afSharedMsgFreeCB );
+#endif
 }
 
 /*********************************************************************
@@ -203,6 +405,11 @@ epList_t *afRegisterExtended( endPointDesc_t *epDesc, pDescCB descFn )
     ep->flags |= ((epDesc->endPoint == ZDO_EP) ? 0 : eEP_UsesKVP);
 #endif
     ep->pfnDescCB = descFn;
+    ep->profileID = 0xFFFF;  // Invalid Profile ID
+#if ( AF_TX_QUEUE_SUPPORT )
+    ep->txPriority = (epDesc->endPoint == ZDO_EP) ? AF_TX_PRIORITY_HIGH
+                                                  : AF_TX_PRIORITY_NORMAL;
+#endif
     ep->nextDesc = NULL;
 
     // Does a list exist?
@@ -218,11 +425,117 @@ epList_t *afRegisterExtended( endPointDesc_t *epDesc, pDescCB descFn )
       // Add new entry to end of list
       epSearch->nextDesc = ep;
     }
+
+    afEpIndexAdd( ep );
+
+    // Ask the callback now, so that dispatch doesn't have to.
+    (void)afGetProfileID( ep );
+
+    // Likewise index the clusters now for Match_Desc_req.
+    afClusterIdxAdd( ep );
   }
 
   return ep;
 }
 
+/*********************************************************************
+ * @fn      afEpIndexAdd
+ *
+ * @brief   Add a new registration to the endpoint dispatch table.
+ *
+ * @param   ep - pointer to the new endpoint list entry
+ *
+ * @return  none
+ */
+static void afEpIndexAdd( epList_t *ep )
+{
+  byte endPoint = ep->epDesc->endPoint;
+
+  if ( (endPoint <= AF_EP_INDEX_MAX) && (afEpSlotCnt < AF_MAX_ENDPOINTS) )
+  {
+    // The first registration of an endpoint is the one that is used.
+    if ( afEpIndex[endPoint] == 0 )
+    {
+      afEpSlots[afEpSlotCnt++] = ep;
+      afEpIndex[endPoint] = afEpSlotCnt;
+    }
+  }
+  else
+  {
+    afEpOverflow = TRUE;
+  }
+
+  // The endpoint may already be a member of groups.
+  afGroupIdxValid = FALSE;
+}
+
+/*********************************************************************
+ * @fn      afGetProfileID
+ *
+ * @brief   Get the profile ID of an endpoint. The descriptor callback
+ *          is only called if its cached answer isn't valid.
+ *
+ * @param   pList - pointer to the endpoint list entry
+ *
+ * @return  profile ID, 0xFFFF if not available
+ */
+static uint16 afGetProfileID( epList_t *pList )
+{
+  if ( pList->pfnDescCB )
+  {
+    if ( !(pList->flags & eEP_ProfileCached) )
+    {
+      uint16 *pID = (uint16 *)(pList->pfnDescCB(
+                           AF_DESCRIPTOR_PROFILE_ID, pList->epDesc->endPoint ));
+      if ( pID )
+      {
+        pList->profileID = *pID;
+        pList->flags |= eEP_ProfileCached;
+        osal_mem_free( pID );
+      }
+    }
+
+    return pList->profileID;
+  }
+  else if ( pList->epDesc->simpleDesc )
+  {
+    return pList->epDesc->simpleDesc->AppProfId;
+  }
+
+  return 0xFFFF;  // Invalid Profile ID
+}
+
+/*********************************************************************
+ * @fn      afInvalidateDescCache
+ *
+ * @brief   Drop the cached values taken from an endpoint's descriptor
+ *          (callback), e.g. after the application changed its profile.
+ *          The descriptor is consulted again on the next use.
+ *
+ * @param   EndPoint - Application Endpoint to look for
+ *
+ * @return  TRUE if success, FALSE if endpoint not found
+ */
+uint8 afInvalidateDescCache( byte EndPoint )
+{
+  epList_t *epSearch;
+
+  // Look for the endpoint
+  epSearch = afFindEndPointDescList( EndPoint );
+
+  if ( epSearch )
+  {
+    epSearch->flags &= ~eEP_ProfileCached;
+    epSearch->profileID = 0xFFFF;
+
+    // The clusters may have changed along with the profile.
+    afClusterIdxBuild();
+    return ( TRUE );
+  }
+  else
+    return ( FALSE );
+}
+
 /*********************************************************************
  * @fn      afRegister
  *
@@ -261,7 +574,7 @@ afStatus_t afRegisterFlags( endPointDesc_t *epDesc, eEP_Flags flags )
 
   if ( ep != NULL )
   {
-    ep->flags = flags;
+    ep->flags = (eEP_Flags)(flags | (ep->flags & eEP_ProfileCached));
     return afStatus_SUCCESS;
   }
   else
@@ -288,6 +601,17 @@ void afDataConfirm( uint8 endPoint, uint8 transID, ZStatus_t status )
   endPointDesc_t *epDesc;
   afDataConfirm_t *msgPtr;
 
+#if ( AF_TX_QUEUE_SUPPORT )
+  // A NWK data buffer was just freed.
+  afTxQueueDrain();
+#endif
+
+#if ( AF_AGGREGATE_SUPPORT )
+  // An aggregate is confirmed once for each message packed into it.
+  if ( afAggregateConfirm( endPoint, transID, status ) )
+    return;
+#endif
+
   // Find the endpoint description
   epDesc = afFindEndPointDesc( endPoint );
   if ( epDesc == NULL )
@@ -339,23 +663,45 @@ void afIncomingData( aps_FrameFormat_t *aff, zAddrType_t *SrcAddress,
                      uint8 LinkQuality, byte SecurityUse, uint32 timestamp )
 {
   endPointDesc_t *epDesc = NULL;
-  uint16 epProfileID = 0xFFFF;  // Invalid Profile ID
   epList_t *pList;
-  uint8 grpEp;
+  uint8 grpEp = APS_GROUPS_FIND_FIRST;
+  uint16 grpMask = 0;
+  void *shared = NULL;
+  void **ppShared = NULL;
+
+#if ( AF_AGGREGATE_SUPPORT )
+  if ( (aff->ClusterID == AF_AGGREGATE_CLUSTER_ID)
+      && (NLME_GetProtocolVersion() != ZB_PROT_V1_0)
+      && (SrcAddress->addrMode == Addr16Bit)
+      && (afAggregatePeerFind( SrcAddress->addr.shortAddr ) < AF_AGGREGATE_PEER_MAX) )
+  {
+    // Deliver each of the packed messages on its own
+    afIncomingAggregate( aff, SrcAddress, LinkQuality, SecurityUse, timestamp );
+    return;
+  }
+#endif
 
   if ( (NLME_GetProtocolVersion() != ZB_PROT_V1_0)
       && ((aff->FrmCtrl & APS_DELIVERYMODE_MASK) == APS_FC_DM_GROUP) )
   {
+    // Find all endpoints for this group
+    if ( (afGroupIdxValid && (aps_CountAllGroups() == afGroupIdxApsCnt))
+        || afGroupIdxBuild() )
+    {
+      afGroupIdx_t *pIdx = afGroupIdxFind( aff->GroupID, NULL );
+      if ( pIdx == NULL )
+        return;   // No endpoint found
+
+      grpMask = pIdx->epMask;
+    }
+
     // Find the first endpoint for this group
-    grpEp = aps_FindGroupForEndpoint( aff->GroupID, APS_GROUPS_FIND_FIRST );
-    if ( grpEp == APS_GROUPS_EP_NOT_FOUND )
+    pList = afGroupNextEp( aff->GroupID, &grpMask, &grpEp );
+    if ( pList == NULL )
       return;   // No endpoint found
 
-    epDesc = afFindEndPointDesc( grpEp );
-    if ( epDesc == NULL )
-      return;   // Endpoint descriptor not found
-
-    pList = afFindEndPointDescList( epDesc->endPoint );
+    epDesc = pList->epDesc;
+    ppShared = &shared;
   }
   else if ( aff->DstEndPoint == AF_BROADCAST_ENDPOINT )
   {
@@ -364,30 +710,16 @@ void afIncomingData( aps_FrameFormat_t *aff, zAddrType_t *SrcAddress,
     {
       epDesc = pList->epDesc;
     }
+    ppShared = &shared;
   }
-  else if ( (epDesc = afFindEndPointDesc( aff->DstEndPoint )) )
+  else if ( (pList = afFindEndPointDescList( aff->DstEndPoint )) )
   {
-    pList = afFindEndPointDescList( epDesc->endPoint );
+    epDesc = pList->epDesc;
   }
 
   while ( epDesc )
   {
-    if ( pList->pfnDescCB )
-    {
-      uint16 *pID = (uint16 *)(pList->pfnDescCB(
-                                 AF_DESCRIPTOR_PROFILE_ID, epDesc->endPoint ));
-      if ( pID )
-      {
-        epProfileID = *pID;
-        osal_mem_free( pID );
-      }
-    }
-    else if ( epDesc->simpleDesc )
-    {
-      epProfileID = epDesc->simpleDesc->AppProfId;
-    }
-
-    if ( (aff->ProfileID == epProfileID) ||
+    if ( (aff->ProfileID == afGetProfileID( pList )) ||
          ((epDesc->endPoint == ZDO_EP) && (aff->ProfileID == ZDO_PROFILE_ID)) )
     {
 #if ( AF_KVP_SUPPORT )
@@ -399,7 +731,8 @@ void afIncomingData( aps_FrameFormat_t *aff, zAddrType_t *SrcAddress,
       else
 #endif
       {
-        afBuildMSGIncoming( aff, epDesc, SrcAddress, LinkQuality, SecurityUse, timestamp );
+        afBuildMSGIncoming( aff, epDesc, SrcAddress, LinkQuality, SecurityUse,
+                            timestamp, ppShared );
       }
     }
 
@@ -407,15 +740,11 @@ void afIncomingData( aps_FrameFormat_t *aff, zAddrType_t *SrcAddress,
       && ((aff->FrmCtrl & APS_DELIVERYMODE_MASK) == APS_FC_DM_GROUP) )
     {
       // Find the next endpoint for this group
-      grpEp = aps_FindGroupForEndpoint( aff->GroupID, grpEp );
-      if ( grpEp == APS_GROUPS_EP_NOT_FOUND )
-        return;   // No endpoint found
+      pList = afGroupNextEp( aff->GroupID, &grpMask, &grpEp );
+      if ( pList == NULL )
+        break;  // No endpoint found
 
-      epDesc = afFindEndPointDesc( grpEp );
-      if ( epDesc == NULL )
-        return;   // Endpoint descriptor not found
-
-      pList = afFindEndPointDescList( epDesc->endPoint );
+      epDesc = pList->epDesc;
     }
     else if ( aff->DstEndPoint == AF_BROADCAST_ENDPOINT )
     {
@@ -428,6 +757,16 @@ void afIncomingData( aps_FrameFormat_t *aff, zAddrType_t *SrcAddress,
     else
       epDesc = NULL;
   }
+
+#if ( AF_SHARED_INCOMING )
+  // Drop the builder's reference, the delivered messages hold the rest.
+  if ( shared )
+  {
+    afSharedRelease( (afSharedASDU_t *)shared );
+  }
+#else
+  (void)shared;
+#endif
 }
 
 #if ( AF_KVP_SUPPORT )
@@ -554,24 +893,53 @@ static void afBuildKVPIncoming( aps_FrameFormat_t *aff, endPointDesc_t *epDesc,
  *
  * @brief       Build the message for the app
  *
- * @param
+ * @param       ppShared - NULL to copy the ASDU into the message, otherwise
+ *                         the shared ASDU of this frame (built on first use)
+ *                         that the message will reference.
  *
  * @return      pointer to next in data buffer
  */
 static void afBuildMSGIncoming( aps_FrameFormat_t *aff, endPointDesc_t *epDesc,
                  zAddrType_t *SrcAddress, uint8 LinkQuality, byte SecurityUse,
-                 uint32 timestamp )
+                 uint32 timestamp, void **ppShared )
 {
   afIncomingMSGPacket_t *MSGpkt;
 #if ( AF_V1_SUPPORT )
   const byte proVer = NLME_GetProtocolVersion();
-  const byte len = sizeof( afIncomingMSGPacket_t ) +
+  const byte dataLen =
               ((proVer == ZB_PROT_V1_0) ? aff->asdu[2] : aff->asduLength);
   byte *asdu = aff->asdu + ((proVer == ZB_PROT_V1_0) ? 1 : 0);
 #else
-  const byte len = sizeof( afIncomingMSGPacket_t ) + aff->asduLength;
+  const byte dataLen = aff->asduLength;
   byte *asdu = aff->asdu;
 #endif
+  byte len = sizeof( afIncomingMSGPacket_t ) + dataLen;
+#if ( AF_SHARED_INCOMING )
+  afSharedASDU_t *shared = NULL;
+
+  if ( (ppShared != NULL) && (dataLen != 0) &&
+       (afSharedFreeId != OSAL_MSG_FREE_NONE) )
+  {
+    if ( *ppShared == NULL )
+    {
+  #if ( AF_V1_SUPPORT )
+      *ppShared = afSharedAlloc( asdu + ((proVer == ZB_PROT_V1_0) ? 2 : 0),
+                                 dataLen );
+  #else
+      *ppShared = afSharedAlloc( asdu, dataLen );
+  #endif
+    }
+
+    // Without a shared copy, fall back to a private copy of the data.
+    if ( (shared = (afSharedASDU_t *)*ppShared) )
+    {
+      len = sizeof( afIncomingMSGPacket_t ) + sizeof( afSharedASDU_t * );
+    }
+  }
+#else
+  (void)ppShared;
+#endif
+
   MSGpkt = (afIncomingMSGPacket_t *)osal_msg_allocate( len );
 
   if ( MSGpkt == NULL )
@@ -605,8 +973,22 @@ static void afBuildMSGIncoming( aps_FrameFormat_t *aff, endPointDesc_t *epDesc,
 
   if ( MSGpkt->cmd.DataLength )
   {
-    MSGpkt->cmd.Data = (byte *)(MSGpkt + 1);
-    osal_memcpy( MSGpkt->cmd.Data, asdu, MSGpkt->cmd.DataLength );
+#if ( AF_SHARED_INCOMING )
+    if ( shared )
+    {
+      // Reference the shared copy, released when this message is freed.
+      MSGpkt->cmd.Data = (byte *)(shared + 1);
+      shared->refCnt++;
+
+      *((afSharedASDU_t **)(MSGpkt + 1)) = shared;
+      OSAL_MSG_FREE_ID( MSGpkt ) = afSharedFreeId;
+    }
+    else
+#endif
+    {
+      MSGpkt->cmd.Data = (byte *)(MSGpkt + 1);
+      osal_memcpy( MSGpkt->cmd.Data, asdu, MSGpkt->cmd.DataLength );
+    }
   }
   else
   {
@@ -629,543 +1011,1802 @@ static void afBuildMSGIncoming( aps_FrameFormat_t *aff, endPointDesc_t *epDesc,
   }
 }
 
-#if ( AF_KVP_SUPPORT )
+#if ( AF_SHARED_INCOMING )
 /*********************************************************************
- * @fn      multiInit
+ * @fn          afSharedAlloc
  *
- * @brief   Initialize a multi header.
+ * @brief       Allocate a shared copy of an incoming ASDU. The caller
+ *              owns the first reference.
  *
- * @param   none
+ * @param       asdu - pointer to the data to copy
+ * @param       len - number of bytes to copy
  *
- * @return  Pointer to the new memory allocated for the afMultiHdr_t structure.
+ * @return      pointer to the shared ASDU, NULL if out of memory
  */
-static afMultiHdr_t *multiInit( afAddrType_t *dstAddr,
-                     byte srcEndPoint, uint16 clusterID, byte FrameType,
-                     byte txOptions, bool DiscoverRoute, byte RadiusCounter )
+static afSharedASDU_t *afSharedAlloc( byte *asdu, uint16 len )
 {
-  afMultiHdr_t *hdr = (afMultiHdr_t *)osal_mem_alloc( sizeof( afMultiHdr_t ) );
+  afSharedASDU_t *shared;
 
-  if ( hdr == NULL )
+  shared = (afSharedASDU_t *)osal_mem_alloc(
+                              (short)(sizeof( afSharedASDU_t ) + len) );
+  if ( shared )
   {
-    return NULL;
+    shared->refCnt = 1;
+    osal_memcpy( (byte *)(shared + 1), asdu, len );
   }
 
-  hdr->clusterID = clusterID;
-  hdr->transCount = 0;
-  hdr->options = txOptions & AF_ACK_REQUEST;
-  hdr->options |= (DiscoverRoute) ? AF_DISCV_ROUTE : 0;
-  hdr->srcEP = srcEndPoint;
-  hdr->dstAddr.endPoint = dstAddr->endPoint;
-  hdr->dstAddr.addrMode = dstAddr->addrMode;
-  hdr->dstAddr.addr.shortAddr = dstAddr->addr.shortAddr;
-  hdr->msgLen = 0;
-  hdr->msg = NULL;
-
-  return hdr;
+  return shared;
 }
 
 /*********************************************************************
- * @fn      multiAppend
+ * @fn          afSharedRelease
  *
- * @brief   Concatenate a new KVP message too a mulit-KVP message.
+ * @brief       Drop one reference to a shared ASDU, freeing it with
+ *              the last reference.
  *
- * @param   none
+ * @param       shared - pointer to the shared ASDU
  *
- * @return  TRUE for success, FALSE otherwise.
+ * @return      none
  */
-static bool multiAppend( afMultiHdr_t *hdr, byte bufLen, byte *buf,
-       byte CommandType, byte AttribDataType, uint16 AttribId, byte ErrorCode )
+static void afSharedRelease( afSharedASDU_t *shared )
 {
-  byte len = (byte)hdr->msgLen;
-  byte *msg = osal_mem_alloc( (short)(AF_HDR_KVP_MAX_LEN + bufLen + len) );
-
-  if ( msg == NULL )
+  if ( --shared->refCnt == 0 )
   {
-    return FALSE;
+    osal_mem_free( shared );
   }
+}
 
-  if ( hdr->msg == NULL )  // Need to make space for FrameType/Count & SeqNum.
-  {
-    len += 5;
-    hdr->msg = msg;
-    msg += 2;
-  }
-  else                     // Need to copy existing buffer over.
+/*********************************************************************
+ * @fn          afSharedMsgFreeCB
+ *
+ * @brief       OSAL message deallocation hook, only called for the
+ *              messages afBuildMSGIncoming() tagged with afSharedFreeId.
+ *              Releases the shared ASDU the message references.
+ *
+ * @param       msg_ptr - message about to be freed
+ * @param       len - length of the message
+ *
+ * @return      none
+ */
+static void afSharedMsgFreeCB( byte *msg_ptr, uint16 len )
+{
+  afIncomingMSGPacket_t *MSGpkt = (afIncomingMSGPacket_t *)msg_ptr;
+
+  (void)len;
+
+  MSGpkt->cmd.Data = NULL;
+  afSharedRelease( *((afSharedASDU_t **)(MSGpkt + 1)) );
+}
+#endif
+
+#if ( AF_AGGREGATE_SUPPORT )
+/*********************************************************************
+ * @fn          afIncomingAggregate
+ *
+ * @brief       Split an aggregate frame and deliver each packed message
+ *              as if it had been received in a frame of its own.
+ *
+ * @param       aff  - pointer to APS frame format of the aggregate
+ * @param       SrcAddress  - Source address
+ * @param       LinkQuality - incoming message's link quality
+ * @param       SecurityUse - Security enable/disable
+ *
+ * @return      none
+ */
+static void afIncomingAggregate( aps_FrameFormat_t *aff, zAddrType_t *SrcAddress,
+                     uint8 LinkQuality, byte SecurityUse, uint32 timestamp )
+{
+  aps_FrameFormat_t sub;
+  byte *pBuf = aff->asdu;
+  byte *pEnd = aff->asdu + aff->asduLength;
+  byte count;
+
+  if ( aff->asduLength < AF_AGGREGATE_HDR_LEN )
   {
-    len += 3;
-    osal_memcpy( msg, hdr->msg, hdr->msgLen );
-    osal_mem_free( hdr->msg );
-    hdr->msg = msg;
-    msg += hdr->msgLen;
+    return;
   }
 
-  *msg++ = BUILD_UINT8( AttribDataType, CommandType );
-  *msg++ = LO_UINT16( AttribId);
-  *msg++ = HI_UINT16( AttribId );
+  osal_memcpy( &sub, aff, sizeof( aps_FrameFormat_t ) );
+  count = *pBuf++;
 
-  if ((CommandType == CMDTYPE_GET_RESP) ||
-      (CommandType == CMDTYPE_SET_RESP) ||
-      (CommandType == CMDTYPE_EVENT_RESP) )
+  while ( count-- && ((pBuf + AF_AGGREGATE_SUB_HDR_LEN) <= pEnd) )
   {
-    *msg++ = ErrorCode;
-    len++;
+    sub.ClusterID = BUILD_UINT16( pBuf[0], pBuf[1] );
+    sub.asduLength = pBuf[2];
+    sub.asdu = pBuf + AF_AGGREGATE_SUB_HDR_LEN;
+
+    pBuf = sub.asdu + sub.asduLength;
+    if ( pBuf > pEnd )
+    {
+      break;  // Malformed, drop the rest
+    }
+
+    if ( sub.ClusterID != AF_AGGREGATE_CLUSTER_ID )
+    {
+      afIncomingData( &sub, SrcAddress, LinkQuality, SecurityUse, timestamp );
+    }
   }
+}
 
-  if ( (CommandType == CMDTYPE_GET_ACK) ||
+/*********************************************************************
+ * @fn      afAggregateAdd
+ *
+ * @brief   Pack a message into the pending aggregate, flushing the
+ *          aggregate first if the message can't join it.
+ *
+ * @param   see AF_DataRequest()
+ *
+ * @return  TRUE if the message was taken, FALSE if it must be sent
+ *          on its own
+ */
+static uint8 afAggregateAdd( afAddrType_t *dstAddr, endPointDesc_t *srcEP,
+                             uint16 cID, uint16 len, uint8 *buf, uint8 *transID,
+                             uint8 options, uint8 radius )
+{
+  afDataReqMTU_t mtu;
+  uint8 maxLen;
+  uint8 *pBuf;
+
+  options &= ~AF_AGGREGATE;
+
+  // Only small unicast messages to a peer that unpacks aggregates are
+  // worth holding back.
+  if ( (len > AF_AGGREGATE_MAX_LEN) || (cID == AF_AGGREGATE_CLUSTER_ID)
+      || (NLME_GetProtocolVersion() == ZB_PROT_V1_0)
+      || (dstAddr->addrMode != afAddr16Bit)
+      || (afAggregatePeerFind( dstAddr->addr.shortAddr ) >= AF_AGGREGATE_PEER_MAX) )
+  {
+    return ( FALSE );
+  }
+
+  mtu.kvp = FALSE;
+  mtu.aps.secure = (options & AF_EN_SECURITY) ? TRUE : FALSE;
+  maxLen = afDataReqMTU( &mtu );
+
+  // Can't join the pending aggregate: send that one first.
+  if ( afAggPend.buf && ((afAggPend.srcEP != srcEP)
+      || (afAggPend.dstAddr.addr.shortAddr != dstAddr->addr.shortAddr)
+      || (afAggPend.dstAddr.endPoint != dstAddr->endPoint)
+      || (afAggPend.options != options) || (afAggPend.radius != radius)
+      || ((afAggPend.len + AF_AGGREGATE_SUB_HDR_LEN + len) > maxLen)) )
+  {
+    afAggregateFlush();
+  }
+
+  if ( afAggPend.buf == NULL )
+  {
+    // Without a free entry the confirm of one more aggregate would be lost.
+    if ( ((AF_AGGREGATE_HDR_LEN + AF_AGGREGATE_SUB_HDR_LEN + len) > maxLen)
+        || (afAggregateSentFind( AF_BROADCAST_ENDPOINT, 0 ) == NULL) )
+    {
+      return ( FALSE );
+    }
+
+    afAggPend.buf = osal_mem_alloc( maxLen );
+    if ( afAggPend.buf == NULL )
+    {
+      return ( FALSE );
+    }
+
+    afAggPend.dstAddr.addrMode = dstAddr->addrMode;
+    afAggPend.dstAddr.addr.shortAddr = dstAddr->addr.shortAddr;
+    afAggPend.dstAddr.endPoint = dstAddr->endPoint;
+    afAggPend.srcEP = srcEP;
+    afAggPend.options = options;
+    afAggPend.radius = radius;
+    afAggPend.count = 0;
+    afAggPend.len = AF_AGGREGATE_HDR_LEN;
+
+    osal_start_timerEx( ZDAppTaskID, ZDO_AF_TIMER, AF_AGGREGATE_WINDOW );
+  }
+
+  pBuf = afAggPend.buf + afAggPend.len;
+  *pBuf++ = LO_UINT16( cID );
+  *pBuf++ = HI_UINT16( cID );
+  *pBuf++ = (uint8)len;
+  osal_memcpy( pBuf, buf, len );
+
+  afAggPend.len += AF_AGGREGATE_SUB_HDR_LEN + (uint8)len;
+  afAggPend.transID[afAggPend.count++] = (*transID)++;
+
+  if ( afAggPend.count == 2 )
+  {
+    // Only now is a packed frame certain. It takes a transaction ID of
+    // its own, so its confirm can't be taken for that of a packed
+    // message. A lone message goes out unpacked and takes none.
+    do
+    {
+      afAggPend.handle = (*transID)++;
+    } while ( afAggregateSentFind( srcEP->endPoint, afAggPend.handle ) );
+  }
+
+  if ( (afAggPend.count >= AF_AGGREGATE_MAX_MSGS)
+      || ((afAggPend.len + AF_AGGREGATE_SUB_HDR_LEN) >= maxLen) )
+  {
+    afAggregateFlush();
+  }
+
+  return ( TRUE );
+}
+
+/*********************************************************************
+ * @fn      afAggregateFlush
+ *
+ * @brief   Send the pending aggregate. A lone message is sent as it
+ *          was given, without the aggregate header.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void afAggregateFlush( void )
+{
+  afAggregate_t agg;
+  afAggregateSent_t *pSent;
+  afStatus_t stat;
+  uint8 transID;
+  uint8 i;
+
+  if ( afAggPend.buf == NULL )
+  {
+    return;
+  }
+
+  // Take the aggregate out first, AF_DataRequest() may add a new one.
+  osal_memcpy( &agg, &afAggPend, sizeof( afAggregate_t ) );
+  afAggPend.buf = NULL;
+
+  if ( agg.count == 1 )
+  {
+    transID = agg.transID[0];
+
+    stat = AF_DataRequest( &agg.dstAddr, agg.srcEP,
+                           BUILD_UINT16( agg.buf[1], agg.buf[2] ),
+                           agg.buf[3], agg.buf + AF_AGGREGATE_HDR_LEN
+                                              + AF_AGGREGATE_SUB_HDR_LEN,
+                           &transID, agg.options, agg.radius );
+  }
+  else
+  {
+    // Note the packed messages before sending, the confirm may be
+    // generated before AF_DataRequest() returns. afAggregateAdd() only
+    // starts an aggregate while an entry is free.
+    pSent = afAggregateSentFind( AF_BROADCAST_ENDPOINT, 0 );
+    transID = agg.handle;
+
+    if ( pSent == NULL )
+    {
+      stat = afStatus_MEM_FAIL;
+    }
+    else
+    {
+      pSent->endPoint = agg.srcEP->endPoint;
+      pSent->handle = agg.handle;
+      pSent->count = agg.count;
+      osal_memcpy( pSent->transID, agg.transID, agg.count );
+
+      agg.buf[0] = agg.count;
+      stat = AF_DataRequest( &agg.dstAddr, agg.srcEP, AF_AGGREGATE_CLUSTER_ID,
+                             agg.len, agg.buf, &transID, agg.options, agg.radius );
+    }
+
+    if ( stat == afStatus_SUCCESS )
+    {
+      afAggregateStats.framesSent++;
+      afAggregateStats.msgsPacked += agg.count;
+      afAggregateStats.bytesPacked +=
+        agg.len - AF_AGGREGATE_HDR_LEN - (agg.count * AF_AGGREGATE_SUB_HDR_LEN);
+    }
+    else if ( pSent )
+    {
+      pSent->count = 0;
+    }
+  }
+
+  osal_mem_free( agg.buf );
+
+  // The application was already told the messages were accepted.
+  if ( stat != afStatus_SUCCESS )
+  {
+    for ( i = 0; i < agg.count; i++ )
+    {
+      afDataConfirm( agg.srcEP->endPoint, agg.transID[i], stat );
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      afAggregateConfirm
+ *
+ * @brief   Turn the data confirm of an aggregate into one data confirm
+ *          for each message packed into it.
+ *
+ * @param   endPoint - confirm end point
+ * @param   transID - transaction ID from APSDE_DATA_REQUEST
+ * @param   status - status of APSDE_DATA_REQUEST
+ *
+ * @return  TRUE if the confirm was for an aggregate
+ */
+static uint8 afAggregateConfirm( uint8 endPoint, uint8 transID, ZStatus_t status )
+{
+  afAggregateSent_t *pSent = afAggregateSentFind( endPoint, transID );
+  afAggregateSent_t sent;
+  uint8 i;
+
+  if ( pSent == NULL )
+  {
+    return ( FALSE );
+  }
+
+  osal_memcpy( &sent, pSent, sizeof( afAggregateSent_t ) );
+  pSent->count = 0;
+
+  for ( i = 0; i < sent.count; i++ )
+  {
+    afDataConfirm( endPoint, sent.transID[i], status );
+  }
+
+  return ( TRUE );
+}
+
+/*********************************************************************
+ * @fn      afAggregateSentFind
+ *
+ * @brief   Find the sent aggregate waiting for the confirm of an APS
+ *          handle (source endpoint and transaction ID).
+ *
+ * @param   endPoint - source endpoint, AF_BROADCAST_ENDPOINT to find
+ *                     a free entry
+ * @param   handle - transaction ID of the aggregate frame
+ *
+ * @return  pointer to the entry, NULL if not found
+ */
+static afAggregateSent_t *afAggregateSentFind( uint8 endPoint, uint8 handle )
+{
+  uint8 i;
+
+  for ( i = 0; i < AF_AGGREGATE_SENT_MAX; i++ )
+  {
+    if ( endPoint == AF_BROADCAST_ENDPOINT )
+    {
+      if ( afAggSent[i].count == 0 )
+        return ( &afAggSent[i] );
+    }
+    else if ( afAggSent[i].count && (afAggSent[i].endPoint == endPoint)
+             && (afAggSent[i].handle == handle) )
+    {
+      return ( &afAggSent[i] );
+    }
+  }
+
+  return ( NULL );
+}
+
+/*********************************************************************
+ * @fn      afAggregatePeerFind
+ *
+ * @brief   Find a peer in the aggregate peer table.
+ *
+ * @param   nwkAddr - peer, INVALID_NODE_ADDR to find a free entry
+ *
+ * @return  index of the peer, AF_AGGREGATE_PEER_MAX if not found
+ */
+static uint8 afAggregatePeerFind( uint16 nwkAddr )
+{
+  uint8 i;
+
+  for ( i = 0; i < AF_AGGREGATE_PEER_MAX; i++ )
+  {
+    if ( afAggPeers[i] == nwkAddr )
+      break;
+  }
+
+  return ( i );
+}
+
+/*********************************************************************
+ * @fn      afAggregatePeer
+ *
+ * @brief   Add or remove a peer that aggregates are exchanged with.
+ *          Messages to other devices are never packed, and aggregate
+ *          frames from other devices are delivered as they came, on
+ *          AF_AGGREGATE_CLUSTER_ID. Both devices must list each other,
+ *          as agreed by the applications.
+ *
+ * @param   nwkAddr - short address of the peer
+ * @param   enable - TRUE to add the peer, FALSE to remove it
+ *
+ * @return  afStatus_SUCCESS, afStatus_MEM_FAIL if the table is full,
+ *          afStatus_INVALID_PARAMETER for a broadcast or own address
+ */
+afStatus_t afAggregatePeer( uint16 nwkAddr, uint8 enable )
+{
+  uint8 i;
+
+  if ( (nwkAddr == INVALID_NODE_ADDR) || (nwkAddr == NLME_GetShortAddr())
+      || (NLME_IsAddressBroadcast( nwkAddr ) != ADDR_NOT_BCAST) )
+  {
+    return ( afStatus_INVALID_PARAMETER );
+  }
+
+  i = afAggregatePeerFind( nwkAddr );
+
+  if ( enable )
+  {
+    if ( i == AF_AGGREGATE_PEER_MAX )
+    {
+      i = afAggregatePeerFind( INVALID_NODE_ADDR );
+      if ( i == AF_AGGREGATE_PEER_MAX )
+      {
+        return ( afStatus_MEM_FAIL );
+      }
+      afAggPeers[i] = nwkAddr;
+    }
+  }
+  else if ( i < AF_AGGREGATE_PEER_MAX )
+  {
+    afAggPeers[i] = INVALID_NODE_ADDR;
+  }
+
+  return ( afStatus_SUCCESS );
+}
+#endif
+
+/*********************************************************************
+ * @fn          afTimerEvent
+ *
+ * @brief       Process the AF timer, run from the ZDApp task.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void afTimerEvent( void )
+{
+#if ( AF_AGGREGATE_SUPPORT )
+  // The aggregation window is over.
+  afAggregateFlush();
+#endif
+}
+
+/*********************************************************************
+ * @fn          afTxQueueEvent
+ *
+ * @brief       Process the transmit queue timer, run from the ZDApp task.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void afTxQueueEvent( void )
+{
+#if ( AF_TX_QUEUE_SUPPORT )
+  afTxQueuePaced = FALSE;
+  afTxQueueDrain();
+#endif
+}
+
+#if ( AF_TX_QUEUE_SUPPORT )
+/*********************************************************************
+ * @fn      afSetTxPriority
+ *
+ * @brief   Set the priority of the messages an endpoint sends through
+ *          the transmit queue.
+ *
+ * @param   EndPoint - endpoint to change
+ * @param   priority - AF_TX_PRIORITY_LOW, _NORMAL or _HIGH
+ *
+ * @return  afStatus_SUCCESS, afStatus_INVALID_PARAMETER if the endpoint
+ *          isn't registered
+ */
+afStatus_t afSetTxPriority( byte EndPoint, uint8 priority )
+{
+  epList_t *epSearch = afFindEndPointDescList( EndPoint );
+
+  if ( (epSearch == NULL) || (priority > AF_TX_PRIORITY_HIGH) )
+  {
+    return ( afStatus_INVALID_PARAMETER );
+  }
+
+  epSearch->txPriority = priority;
+  return ( afStatus_SUCCESS );
+}
+
+/*********************************************************************
+ * @fn      afTxQueueAdd
+ *
+ * @brief   Send a message now if nothing more urgent is waiting and the
+ *          NWK layer has room for it, queue it otherwise.
+ *
+ * @param   see AF_DataRequest()
+ *
+ * @return  afStatus_SUCCESS if sent or queued, afStatus_MEM_FAIL if the
+ *          queue is full (AF_TX_READY_CMD follows when it has room),
+ *          otherwise the AF_DataRequest() failure.
+ */
+static afStatus_t afTxQueueAdd( afAddrType_t *dstAddr, endPointDesc_t *srcEP,
+                                uint16 cID, uint16 len, uint8 *buf, uint8 *transID,
+                                uint8 options, uint8 radius )
+{
+  epList_t *pList;
+  afTxQueueItem_t *item;
+  afTxQueueItem_t **ppPrev;
+  afStatus_t stat;
+  uint8 priority = AF_TX_PRIORITY_NORMAL;
+
+  options &= ~AF_TX_QUEUE;
+
+  pList = afFindEndPointDescList( srcEP->endPoint );
+  if ( pList )
+  {
+    priority = pList->txPriority;
+  }
+
+  // Send right away unless the message would overtake an equal or
+  // higher priority one, or bulk traffic is being paced.
+  if ( ((afTxQueue == NULL) || (priority > afTxQueue->priority))
+      && !((priority == AF_TX_PRIORITY_LOW) && afTxQueuePaced)
+      && !nwk_MacDataBuffersFull() )
+  {
+    stat = AF_DataRequest( dstAddr, srcEP, cID, len, buf, transID, options, radius );
+    if ( !afTxQueueRetry( stat ) )
+    {
+      if ( (stat == afStatus_SUCCESS) && (priority == AF_TX_PRIORITY_LOW) )
+      {
+        afTxQueuePaced = TRUE;
+        afTxQueueTimer( AF_TX_QUEUE_PACING );
+      }
+      return ( stat );
+    }
+  }
+
+  item = NULL;
+  if ( afTxQueueCnt < AF_TX_QUEUE_DEPTH )
+  {
+    item = osal_mem_alloc( sizeof( afTxQueueItem_t ) + len );
+  }
+
+  if ( item == NULL )
+  {
+    if ( pList )
+    {
+      pList->flags |= eEP_TxWaiting;
+    }
+    return ( afStatus_MEM_FAIL );
+  }
+
+  osal_memcpy( &item->dstAddr, dstAddr, sizeof( afAddrType_t ) );
+  item->srcEP = srcEP;
+  item->cID = cID;
+  item->len = len;
+  item->transID = (*transID)++;
+  item->options = options;
+  item->radius = radius;
+  item->priority = priority;
+  osal_memcpy( (uint8 *)(item + 1), buf, len );
+
+  // Behind everything of the same or a higher priority
+  ppPrev = &afTxQueue;
+  while ( *ppPrev && ((*ppPrev)->priority >= priority) )
+  {
+    ppPrev = &((*ppPrev)->next);
+  }
+  item->next = *ppPrev;
+  *ppPrev = item;
+  afTxQueueCnt++;
+
+  // In case no data confirm comes to drain the queue
+  afTxQueueTimer( AF_TX_QUEUE_PACING );
+
+  return ( afStatus_SUCCESS );
+}
+
+/*********************************************************************
+ * @fn      afTxQueueDrain
+ *
+ * @brief   Send queued messages while the NWK layer has room for them,
+ *          then tell the endpoints that found the queue full that it
+ *          has room again.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void afTxQueueDrain( void )
+{
+  afTxQueueItem_t *item;
+  afTxReady_t *msgPtr;
+  epList_t *pList;
+  afStatus_t stat;
+  uint8 transID;
+
+  // AF_DataRequest() may confirm a message to this device right away.
+  if ( afTxQueueBusy )
+  {
+    return;
+  }
+  afTxQueueBusy = TRUE;
+
+  while ( (item = afTxQueue) != NULL )
+  {
+    if ( nwk_MacDataBuffersFull()
+        || ((item->priority == AF_TX_PRIORITY_LOW) && afTxQueuePaced) )
+    {
+      break;
+    }
+
+    transID = item->transID;
+    stat = AF_DataRequest( &item->dstAddr, item->srcEP, item->cID, item->len,
+                           (uint8 *)(item + 1), &transID, item->options, item->radius );
+    if ( afTxQueueRetry( stat ) )
+    {
+      break;
+    }
+
+    afTxQueue = item->next;
+    afTxQueueCnt--;
+
+    // The application was told the message was accepted.
+    if ( stat != afStatus_SUCCESS )
+    {
+      afDataConfirm( item->srcEP->endPoint, item->transID, stat );
+    }
+    else if ( item->priority == AF_TX_PRIORITY_LOW )
+    {
+      afTxQueuePaced = TRUE;
+    }
+
+    osal_mem_free( item );
+  }
+
+  if ( afTxQueue || afTxQueuePaced )
+  {
+    afTxQueueTimer( AF_TX_QUEUE_PACING );
+  }
+
+  if ( afTxQueueCnt < AF_TX_QUEUE_DEPTH )
+  {
+    for ( pList = epList; pList != NULL; pList = pList->nextDesc )
+    {
+      if ( pList->flags & eEP_TxWaiting )
+      {
+        msgPtr = (afTxReady_t *)osal_msg_allocate( sizeof( afTxReady_t ) );
+        if ( msgPtr == NULL )
+        {
+          break;  // Try again on the next drain
+        }
+
+        pList->flags &= ~eEP_TxWaiting;
+        msgPtr->hdr.event = AF_TX_READY_CMD;
+        msgPtr->hdr.status = ZSuccess;
+        msgPtr->endpoint = pList->epDesc->endPoint;
+        osal_msg_send( *(pList->epDesc->task_id), (byte *)msgPtr );
+      }
+    }
+  }
+
+  afTxQueueBusy = FALSE;
+}
+
+/*********************************************************************
+ * @fn      afTxQueueRetry
+ *
+ * @brief   Tell whether a send failed only for lack of buffers.
+ *
+ * @param   stat - AF_DataRequest() status
+ *
+ * @return  TRUE if the message should be sent again later
+ */
+static uint8 afTxQueueRetry( afStatus_t stat )
+{
+  return ( (stat == afStatus_MEM_FAIL) || (stat == ZMemError)
+          || (stat == ZBufferFull) || (stat == ZMacTransactionOverFlow) );
+}
+
+/*********************************************************************
+ * @fn      afTxQueueTimer
+ *
+ * @brief   Start the transmit queue timer unless it is already running.
+ *
+ * @param   timeout - milliseconds
+ *
+ * @return  none
+ */
+static void afTxQueueTimer( uint16 timeout )
+{
+  if ( osal_get_timeoutEx( ZDAppTaskID, ZDO_AF_TXQ_TIMER ) == 0 )
+  {
+    osal_start_timerEx( ZDAppTaskID, ZDO_AF_TXQ_TIMER, timeout );
+  }
+}
+#endif
+
+#if ( AF_KVP_SUPPORT )
+/*********************************************************************
+ * @fn      multiInit
+ *
+ * @brief   Initialize a multi header.
+ *
+ * @param   none
+ *
+ * @return  Pointer to the new memory allocated for the afMultiHdr_t structure.
+ */
+static afMultiHdr_t *multiInit( afAddrType_t *dstAddr,
+                     byte srcEndPoint, uint16 clusterID, byte FrameType,
+                     byte txOptions, bool DiscoverRoute, byte RadiusCounter )
+{
+  afMultiHdr_t *hdr = (afMultiHdr_t *)osal_mem_alloc( sizeof( afMultiHdr_t ) );
+
+  if ( hdr == NULL )
+  {
+    return NULL;
+  }
+
+  hdr->clusterID = clusterID;
+  hdr->transCount = 0;
+  hdr->options = txOptions & AF_ACK_REQUEST;
+  hdr->options |= (DiscoverRoute) ? AF_DISCV_ROUTE : 0;
+  hdr->srcEP = srcEndPoint;
+  hdr->dstAddr.endPoint = dstAddr->endPoint;
+  hdr->dstAddr.addrMode = dstAddr->addrMode;
+  hdr->dstAddr.addr.shortAddr = dstAddr->addr.shortAddr;
+  hdr->msgLen = 0;
+  hdr->msg = NULL;
+
+  return hdr;
+}
+
+/*********************************************************************
+ * @fn      multiAppend
+ *
+ * @brief   Concatenate a new KVP message too a mulit-KVP message.
+ *
+ * @param   none
+ *
+ * @return  TRUE for success, FALSE otherwise.
+ */
+static bool multiAppend( afMultiHdr_t *hdr, byte bufLen, byte *buf,
+       byte CommandType, byte AttribDataType, uint16 AttribId, byte ErrorCode )
+{
+  byte len = (byte)hdr->msgLen;
+  byte *msg = osal_mem_alloc( (short)(AF_HDR_KVP_MAX_LEN + bufLen + len) );
+
+  if ( msg == NULL )
+  {
+    return FALSE;
+  }
+
+  if ( hdr->msg == NULL )  // Need to make space for FrameType/Count & SeqNum.
+  {
+    len += 5;
+    hdr->msg = msg;
+    msg += 2;
+  }
+  else                     // Need to copy existing buffer over.
+  {
+    len += 3;
+    osal_memcpy( msg, hdr->msg, hdr->msgLen );
+    osal_mem_free( hdr->msg );
+    hdr->msg = msg;
+    msg += hdr->msgLen;
+  }
+
+  *msg++ = BUILD_UINT8( AttribDataType, CommandType );
+  *msg++ = LO_UINT16( AttribId);
+  *msg++ = HI_UINT16( AttribId );
+
+  if ((CommandType == CMDTYPE_GET_RESP) ||
+      (CommandType == CMDTYPE_SET_RESP) ||
+      (CommandType == CMDTYPE_EVENT_RESP) )
+  {
+    *msg++ = ErrorCode;
+    len++;
+  }
+
+  if ( (CommandType == CMDTYPE_GET_ACK) ||
        (CommandType == CMDTYPE_SET_RESP) ||
        (CommandType == CMDTYPE_EVENT_RESP ) )
   {
-    bufLen = 0;
+    bufLen = 0;
+  }
+  else if ((AttribDataType == DATATYPE_CHAR_STR) ||
+           (AttribDataType == DATATYPE_OCTET_STR))
+  {
+    *msg++ = bufLen;
+    len++;
+  }
+
+  if ( buf && bufLen )
+  {
+    osal_memcpy( msg, buf, bufLen );
+    len += bufLen;
+  }
+
+  hdr->msgLen = len;
+  hdr->transCount++;
+
+  return TRUE;
+}
+
+/*********************************************************************
+ * @fn      multiSend
+ *
+ * @brief   Send whatever has been buffered to send multi.
+ *
+ * @param   none
+ *
+ * @return  afStatus_t
+ */
+static afStatus_t multiSend( afMultiHdr_t *hdr, byte *seqNum, byte radius )
+{
+  afStatus_t stat;
+
+  if ( hdr == NULL )
+  {
+    return afStatus_MEM_FAIL;
+  }
+
+  hdr->msg[0] = BUILD_UINT8( FRAMETYPE_KVP, hdr->transCount );
+  hdr->msg[1] = *seqNum;
+
+  stat = afSend( &hdr->dstAddr, hdr->srcEP, hdr->clusterID,
+                  hdr->msgLen, hdr->msg, seqNum, hdr->options, radius );
+
+  osal_mem_free( hdr->msg );
+  osal_mem_free( hdr );
+
+  return stat;
+}
+
+/*********************************************************************
+ * @fn      afAddOrSendMessage
+ *
+ * @brief   Fills in the cmd format structure and sends the out-going message.
+ *
+ * input parameters
+ *
+ * @param  *dstAddr         - Full ZB destination address: Nwk Addr + End Point.
+ * @param   srcEndPoint     - Origination (i.e. respond to or ack to) End Point.
+ * @param   clusterID       - A valid cluster ID as specified by the Profile
+ *          (e.g. see CLUSTERID_... defs in HomeControlLighting.h).
+ * @param   AddOrSend       - A valid afAddOrSend_t type.
+ * @param   FrameType       - A valid frame type (see prev def of FRAMETYPE_...)
+ * @param  *TransSeqNumber  - A pointer to a byte which can be modified and
+ *          which will be used as the transaction sequence number of the msg.
+ * @param   CommandType     -
+ *          KVP Frame Type  : A valid command type (see prev def of CMDTYPE_...)
+ *          MSG Frame Type  : Set to 0.
+ * @param   AttribDataType  -
+ *          KVP Frame Type  : A valid data type (see prev def of DATATYPE_...)
+ *          MSG Frame Type  : Set to 0.
+ * @param   AttribId        -
+ *          KVP Frame Type  : A valid Attribute ID as specified by the Profile.
+ *            (e.g. see OnOffSRC_OnOff in HomeControlLighting.h).
+ *          MSG Frame Type  : Set to 0.
+ * @param   ErrorCode       -
+ *          KVP Frame Type  : A valid error code (see prev def of ERRORCODE_...)
+ *          Note: Set to 0 unless the CommandType is one of the CMDTYPE_..._ACK.
+ *          MSG Frame Type  : Set to 0.
+ * @param   DataLength      - Number of bytes of data pointed to by next param.
+ *          KVP Frame Type  : This must match value expected for the
+ *          AttributeDataType specified above or the send will fail.
+ *          MSG Frame Type  : No restriction or checks.
+ * @param  *Data            - A pointer to the data bytes to send.
+ * @param   txOptions       - A valid bit mask (see prev def of APS_TX_OPTIONS_)
+ * @param   DiscoverRoute   - Normally set to FALSE. Perhaps set to TRUE after
+ *          receiving an AF_DATA_CONFIRM_CMD with status other than ZSuccess.
+ * @param   RadiusCounter   - Normally set to AF_DEFAULT_RADIUS.
+ *
+ * output parameters
+ *
+ * @param  *TransSeqNumber  - Incremented by one if the return value is success.
+ *
+ * @return  afStatus_t      - See previous definition of afStatus_... types.
+ */
+afStatus_t afAddOrSendMessage(
+    afAddrType_t *dstAddr, byte srcEndPoint, cId_t clusterID,
+    afAddOrSend_t AddOrSend, byte FrameType, byte *TransSeqNumber,
+    byte CommandType, byte AttribDataType, uint16 AttribId, byte ErrorCode,
+    byte DataLength, byte *Data,
+    byte txOptions, byte DiscoverRoute, byte RadiusCounter )
+{
+  static afMultiHdr_t *hdr;
+  afStatus_t stat = afStatus_FAILED;
+
+  if ( FrameType == FRAMETYPE_MSG )
+  {
+    if ( AddOrSend != SEND_MESSAGE )
+    {
+      return afStatus_INVALID_PARAMETER;
+    }
+
+    return afFillAndSendMessage( dstAddr, srcEndPoint, clusterID,
+      1, FrameType, TransSeqNumber, NULL, NULL, NULL, NULL,
+      DataLength, Data, txOptions, DiscoverRoute, RadiusCounter );
+  }
+
+  if ( FrameType != FRAMETYPE_KVP )
+  {
+    return afStatus_INVALID_PARAMETER;
+  }
+
+  // Cannot mix Cluster ID's in aggregation packet.
+  if ( (hdr != NULL) && (hdr->clusterID != clusterID) )
+  {
+    multiSend( hdr, TransSeqNumber, RadiusCounter );
+    hdr = NULL;
+  }
+
+  if ( hdr == NULL )
+  {
+    hdr = multiInit( dstAddr, srcEndPoint, clusterID, FrameType,
+                     txOptions, DiscoverRoute, RadiusCounter );
+    if ( hdr == NULL )
+    {
+      return afStatus_MEM_FAIL;
+    }
+  }
+
+  if ( FALSE == multiAppend( hdr, (byte)DataLength, Data,
+                           CommandType, AttribDataType, AttribId, ErrorCode ) )
+  {
+    if ( hdr->msg != NULL )
+    {
+      multiSend( hdr, TransSeqNumber, RadiusCounter );
+    }
+    else
+    {
+      osal_mem_free( hdr );
+    }
+    hdr = NULL;
+    return afStatus_MEM_FAIL;
+  }
+
+  // Only supporting up to 16 concatenated messages.
+  if ( (AddOrSend == SEND_MESSAGE) || (hdr->transCount >= 16) )
+  {
+    stat = multiSend( hdr, TransSeqNumber, RadiusCounter );
+    hdr = NULL;
+  }
+  else
+  {
+    stat = afStatus_SUCCESS;
+    (*TransSeqNumber)++;
+  }
+
+  return stat;
+}
+#endif
+
+#if ( AF_V1_SUPPORT || AF_KVP_SUPPORT )
+/*********************************************************************
+ * @fn      afFillAndSendMessage
+ *
+ * @brief   Fills in the cmd format structure and sends the out-going message.
+ *
+ * input parameters
+ *
+ * @param  *dstAddr         - Full ZB destination address: Nwk Addr + End Point.
+ * @param   srcEndPoint     - Origination (i.e. respond to or ack to) End Point.
+ * @param   clusterID       - A valid cluster ID as specified by the Profile.
+ * @param   TransCount      - Set to 1.
+ * @param   FrameType       - A valid frame type (see prev def of FRAMETYPE_...)
+ * @param  *TransSeqNumber  - A pointer to a byte which can be modified and
+ *          which will be used as the transaction sequence number of the msg.
+ * @param   CommandType     -
+ *          KVP Frame Type  : A valid command type (see prev def of CMDTYPE_...)
+ *          MSG Frame Type  : Set to 0.
+ * @param   AttribDataType  -
+ *          KVP Frame Type  : A valid data type (see prev def of DATATYPE_...)
+ *          MSG Frame Type  : Set to 0.
+ * @param   AttribId        -
+ *          KVP Frame Type  : A valid Attribute ID as specified by the Profile.
+ *            (e.g. see OnOffSRC_OnOff in HomeControlLighting.h).
+ *          MSG Frame Type  : Set to 0.
+ * @param   ErrorCode       -
+ *          KVP Frame Type  : A valid error code (see prev def of ERRORCODE_...)
+ *          Note: Set to 0 unless the CommandType is one of the CMDTYPE_..._ACK.
+ *          MSG Frame Type  : Set to 0.
+ * @param   DataLength      - Number of bytes of data pointed to by next param.
+ *          KVP Frame Type  : This must match value expected for the
+ *          AttributeDataType specified above or the send will fail.
+ *          MSG Frame Type  : No restriction or checks.
+ * @param  *Data            - A pointer to the data bytes to send.
+ * @param   txOptions       - A valid bit mask (see prev def of APS_TX_OPTIONS_)
+ * @param   DiscoverRoute   - Normally set to FALSE. Perhaps set to TRUE after
+ *          receiving an AF_DATA_CONFIRM_CMD with status other than ZSuccess.
+ * @param   RadiusCounter   - Normally set to AF_DEFAULT_RADIUS.
+ *
+ * output parameters
+ *
+ * @param  *TransSeqNumber  - Incremented by one if the return value is success.
+ *
+ * @return  afStatus_t      - See previous definition of afStatus_... types.
+ */
+afStatus_t afFillAndSendMessage (
+  afAddrType_t *dstAddr, byte srcEndPoint, cId_t clusterID,
+  byte TransCount, byte FrameType, byte *TransSeqNumber,
+  byte CommandType, byte AttribDataType, uint16 AttribId, byte ErrorCode,
+  byte DataLength, byte *Data,
+  byte txOptions, byte DiscoverRoute, byte RadiusCounter )
+{
+  const byte proVer = NLME_GetProtocolVersion();
+  afStatus_t stat = afStatus_FAILED;
+  byte *buf = Data;
+
+#if ( AF_KVP_SUPPORT )
+  if ( FrameType == FRAMETYPE_KVP )
+  {
+    return afAddOrSendMessage( dstAddr, srcEndPoint, clusterID,
+      SEND_MESSAGE, FrameType, TransSeqNumber,
+      CommandType, AttribDataType, AttribId, ErrorCode,
+      DataLength, Data, txOptions, DiscoverRoute, RadiusCounter );
   }
-  else if ((AttribDataType == DATATYPE_CHAR_STR) ||
-           (AttribDataType == DATATYPE_OCTET_STR))
+#endif
+
+  if ( FrameType != FRAMETYPE_MSG )
   {
-    *msg++ = bufLen;
-    len++;
+    return afStatus_INVALID_PARAMETER;
+  }
+
+  if ( TransCount != 1 )
+  {
+    return afStatus_INVALID_PARAMETER;
+  }
+
+  if ( proVer == ZB_PROT_V1_0 )
+  {
+    buf = osal_mem_alloc( (short)(DataLength+3) );
+    if ( buf == NULL )
+    {
+      return afStatus_MEM_FAIL;
+    }
+
+    buf[0] = BUILD_UINT8( FRAMETYPE_MSG, 1 );
+    buf[1] = *TransSeqNumber;
+    buf[2] = (byte)DataLength;
+
+    // Copy the data portion of the packet.
+    if ( Data && DataLength )
+    {
+      osal_memcpy( buf+3, Data, DataLength );
+      DataLength += 3;
+    }
+    else
+    {
+      DataLength = 3;
+    }
+  }
+
+  stat = afSend( dstAddr, srcEndPoint, clusterID,
+                 DataLength, buf, TransSeqNumber, txOptions, RadiusCounter );
+
+  if ( proVer == ZB_PROT_V1_0 )
+  {
+    osal_mem_free( buf );
+  }
+
+  return stat;
+}
+#endif
+
+/*********************************************************************
+ * @fn      AF_DataRequest
+ *
+ * @brief   Common functionality for invoking APSDE_DataReq() for both
+ *          KVP-Send/SendMulti and MSG-Send.
+ *
+ * input parameters
+ *
+ * @param  *dstAddr - Full ZB destination address: Nwk Addr + End Point.
+ * @param  *srcEP - Origination (i.e. respond to or ack to) End Point Descr.
+ * @param   cID - A valid cluster ID as specified by the Profile.
+ * @param   len - Number of bytes of data pointed to by next param.
+ * @param  *buf - A pointer to the data bytes to send.
+ * @param  *transID - A pointer to a byte which can be modified and which will
+ *                    be used as the transaction sequence number of the msg.
+ * @param   options - Valid bit mask of Tx options.
+ * @param   radius - Normally set to AF_DEFAULT_RADIUS.
+ *
+ * output parameters
+ *
+ * @param  *transID - Incremented by one if the return value is success.
+ *
+ * @return  afStatus_t - See previous definition of afStatus_... types.
+ */
+#if ( AF_V1_SUPPORT )
+static afStatus_t afDataRequest( afAddrType_t *dstAddr, endPointDesc_t *srcEP,
+                           uint16 cID, uint16 len, uint8 *buf, uint8 *transID,
+                           uint8 options, uint8 radius )
+#else
+afStatus_t AF_DataRequest( afAddrType_t *dstAddr, endPointDesc_t *srcEP,
+                           uint16 cID, uint16 len, uint8 *buf, uint8 *transID,
+                           uint8 options, uint8 radius )
+#endif
+{
+  epList_t *pList;
+  ZStatus_t stat;
+  APSDE_DataReq_t req;
+  afDataReqMTU_t mtu;
+
+
+  if ( srcEP == NULL )
+  {
+    return afStatus_INVALID_PARAMETER;
+  }
+
+#if ( AF_AGGREGATE_SUPPORT )
+  if ( options & AF_AGGREGATE )
+  {
+    if ( afAggregateAdd( dstAddr, srcEP, cID, len, buf, transID, options, radius ) )
+    {
+      return afStatus_SUCCESS;
+    }
+  }
+#endif
+
+#if ( AF_TX_QUEUE_SUPPORT )
+  if ( options & AF_TX_QUEUE )
+  {
+    return afTxQueueAdd( dstAddr, srcEP, cID, len, buf, transID, options, radius );
+  }
+#endif
+
+  // Enforce consistent values on the destination address / address mode.
+  if ( dstAddr->addrMode == afAddrNotPresent )
+  {
+    dstAddr->endPoint = ZDO_EP;
+    req.dstAddr.addr.shortAddr = afGetReflector( srcEP->endPoint );
+  }
+  else // Handle types: afAddr16Bit
+  {    //               afAddrBroadcast
+       //               afAddrGroup
+    req.dstAddr.addr.shortAddr = dstAddr->addr.shortAddr;
+
+    if ( ( dstAddr->addrMode == afAddr16Bit     ) ||
+         ( dstAddr->addrMode == afAddrBroadcast )    )
+    {
+      // Check for valid broadcast values
+      if( ADDR_NOT_BCAST != NLME_IsAddressBroadcast( dstAddr->addr.shortAddr )  )
+      {
+        // Force mode to broadcast
+        dstAddr->addrMode = afAddrBroadcast;
+      }
+      else
+      {
+        // Address is not a valid broadcast type
+        if ( dstAddr->addrMode == afAddrBroadcast )
+        {
+          return afStatus_INVALID_PARAMETER;
+        }
+      }
+    }
+    else if ( dstAddr->addrMode != afAddrGroup )
+    {
+      return afStatus_INVALID_PARAMETER;
+    }
+  }
+  req.dstAddr.addrMode = dstAddr->addrMode;
+  req.profileID = ZDO_PROFILE_ID;
+
+  pList = afFindEndPointDescList( srcEP->endPoint );
+  if ( (pList != NULL) && (pList->epDesc == srcEP) && pList->pfnDescCB )
+  {
+    if ( afGetProfileID( pList ) != 0xFFFF )
+    {
+      req.profileID = pList->profileID;
+    }
+  }
+  else if ( srcEP->simpleDesc )
+  {
+    req.profileID = srcEP->simpleDesc->AppProfId;
+  }
+
+  req.txOptions = 0;
+
+  if ( ( options & AF_ACK_REQUEST              ) &&
+       ( req.dstAddr.addrMode != AddrBroadcast ) &&
+       ( req.dstAddr.addrMode != AddrGroup     )    )
+  {
+    req.txOptions |=  APS_TX_OPTIONS_ACK;
+  }
+
+  if ( options & AF_SKIP_ROUTING )
+  {
+    req.txOptions |=  APS_TX_OPTIONS_SKIP_ROUTING;
+  }
+
+  if ( options & AF_EN_SECURITY )
+  {
+    req.txOptions |= APS_TX_OPTIONS_SECURITY_ENABLE;
+    mtu.aps.secure = TRUE;
+  }
+  else
+  {
+    mtu.aps.secure = FALSE;
+  }
+
+  mtu.kvp = FALSE;
+
+  req.transID       = *transID;
+  req.srcEP         = srcEP->endPoint;
+  req.dstEP         = dstAddr->endPoint;
+  req.clusterID     = cID;
+  req.asduLen       = len;
+  req.asdu          = buf;
+  req.discoverRoute = (uint8)((options & AF_DISCV_ROUTE) ? 1 : 0);
+  req.radiusCounter = radius;
+
+  if (len > afDataReqMTU( &mtu ) )
+  {
+    if (apsfSendFragmented)
+    {
+      req.txOptions |= AF_FRAGMENTED | APS_TX_OPTIONS_ACK;
+      stat = (*apsfSendFragmented)( &req );
+    }
+    else
+    {
+      stat = afStatus_INVALID_PARAMETER;
+    }
+  } 
+  else
+  {
+    stat = APSDE_DataReq( &req );
+  }
+
+  /*
+   * If this is an EndPoint-to-EndPoint message on the same device, it will not
+   * get added to the NWK databufs. So it will not go OTA and it will not get
+   * a MACCB_DATA_CONFIRM_CMD callback. Thus it is necessary to generate the
+   * AF_DATA_CONFIRM_CMD here. Note that APSDE_DataConfirm() only generates one
+   * message with the first in line TransSeqNumber, even on a multi message.
+   */
+  if ( (req.dstAddr.addrMode == Addr16Bit) &&
+       (req.dstAddr.addr.shortAddr == NLME_GetShortAddr()) )
+  {
+    afDataConfirm( srcEP->endPoint, *transID, stat );
   }
 
-  if ( buf && bufLen )
+  if ( stat == afStatus_SUCCESS )
   {
-    osal_memcpy( msg, buf, bufLen );
-    len += bufLen;
+    (*transID)++;
   }
 
-  hdr->msgLen = len;
-  hdr->transCount++;
-
-  return TRUE;
+  return (afStatus_t)stat;
 }
 
 /*********************************************************************
- * @fn      multiSend
+ * @fn      afAddGroup
  *
- * @brief   Send whatever has been buffered to send multi.
+ * @brief   Add a group for an endpoint and add the endpoint to the
+ *          group delivery index.
  *
- * @param   none
+ * @param   endpoint - endpoint joining the group
+ * @param   group - group ID and name
  *
- * @return  afStatus_t
+ * @return  status of aps_AddGroup()
  */
-static afStatus_t multiSend( afMultiHdr_t *hdr, byte *seqNum, byte radius )
+ZStatus_t afAddGroup( uint8 endpoint, aps_Group_t *group )
 {
-  afStatus_t stat;
+  ZStatus_t stat = aps_AddGroup( endpoint, group );
 
-  if ( hdr == NULL )
+  if ( stat == ZSuccess )
   {
-    return afStatus_MEM_FAIL;
+    afGroupIdxSet( endpoint, group->ID, TRUE );
+    afGroupIdxSync();
   }
 
-  hdr->msg[0] = BUILD_UINT8( FRAMETYPE_KVP, hdr->transCount );
-  hdr->msg[1] = *seqNum;
-
-  stat = afSend( &hdr->dstAddr, hdr->srcEP, hdr->clusterID,
-                  hdr->msgLen, hdr->msg, seqNum, hdr->options, radius );
-
-  osal_mem_free( hdr->msg );
-  osal_mem_free( hdr );
-
-  return stat;
+  return ( stat );
 }
 
 /*********************************************************************
- * @fn      afAddOrSendMessage
+ * @fn      afRemoveGroup
  *
- * @brief   Fills in the cmd format structure and sends the out-going message.
+ * @brief   Remove a group from an endpoint and remove the endpoint from
+ *          the group delivery index.
  *
- * input parameters
+ * @param   endpoint - endpoint leaving the group
+ * @param   groupID - group ID
  *
- * @param  *dstAddr         - Full ZB destination address: Nwk Addr + End Point.
- * @param   srcEndPoint     - Origination (i.e. respond to or ack to) End Point.
- * @param   clusterID       - A valid cluster ID as specified by the Profile
- *          (e.g. see CLUSTERID_... defs in HomeControlLighting.h).
- * @param   AddOrSend       - A valid afAddOrSend_t type.
- * @param   FrameType       - A valid frame type (see prev def of FRAMETYPE_...)
- * @param  *TransSeqNumber  - A pointer to a byte which can be modified and
- *          which will be used as the transaction sequence number of the msg.
- * @param   CommandType     -
- *          KVP Frame Type  : A valid command type (see prev def of CMDTYPE_...)
- *          MSG Frame Type  : Set to 0.
- * @param   AttribDataType  -
- *          KVP Frame Type  : A valid data type (see prev def of DATATYPE_...)
- *          MSG Frame Type  : Set to 0.
- * @param   AttribId        -
- *          KVP Frame Type  : A valid Attribute ID as specified by the Profile.
- *            (e.g. see OnOffSRC_OnOff in HomeControlLighting.h).
- *          MSG Frame Type  : Set to 0.
- * @param   ErrorCode       -
- *          KVP Frame Type  : A valid error code (see prev def of ERRORCODE_...)
- *          Note: Set to 0 unless the CommandType is one of the CMDTYPE_..._ACK.
- *          MSG Frame Type  : Set to 0.
- * @param   DataLength      - Number of bytes of data pointed to by next param.
- *          KVP Frame Type  : This must match value expected for the
- *          AttributeDataType specified above or the send will fail.
- *          MSG Frame Type  : No restriction or checks.
- * @param  *Data            - A pointer to the data bytes to send.
- * @param   txOptions       - A valid bit mask (see prev def of APS_TX_OPTIONS_)
- * @param   DiscoverRoute   - Normally set to FALSE. Perhaps set to TRUE after
- *          receiving an AF_DATA_CONFIRM_CMD with status other than ZSuccess.
- * @param   RadiusCounter   - Normally set to AF_DEFAULT_RADIUS.
+ * @return  TRUE if removed, FALSE if not found
+ */
+uint8 afRemoveGroup( uint8 endpoint, uint16 groupID )
+{
+  if ( aps_RemoveGroup( endpoint, groupID ) )
+  {
+    afGroupIdxSet( endpoint, groupID, FALSE );
+    afGroupIdxSync();
+    return ( TRUE );
+  }
+  else
+    return ( FALSE );
+}
+
+/*********************************************************************
+ * @fn      afRemoveAllGroups
  *
- * output parameters
+ * @brief   Remove all groups of an endpoint and remove the endpoint
+ *          from the group delivery index.
  *
- * @param  *TransSeqNumber  - Incremented by one if the return value is success.
+ * @param   endpoint - endpoint leaving its groups
  *
- * @return  afStatus_t      - See previous definition of afStatus_... types.
+ * @return  none
  */
-afStatus_t afAddOrSendMessage(
-    afAddrType_t *dstAddr, byte srcEndPoint, cId_t clusterID,
-    afAddOrSend_t AddOrSend, byte FrameType, byte *TransSeqNumber,
-    byte CommandType, byte AttribDataType, uint16 AttribId, byte ErrorCode,
-    byte DataLength, byte *Data,
-    byte txOptions, byte DiscoverRoute, byte RadiusCounter )
+void afRemoveAllGroups( uint8 endpoint )
 {
-  static afMultiHdr_t *hdr;
-  afStatus_t stat = afStatus_FAILED;
+  byte slot;
+  byte i, j;
 
-  if ( FrameType == FRAMETYPE_MSG )
+  aps_RemoveAllGroup( endpoint );
+
+  if ( !afGroupIdxValid )
   {
-    if ( AddOrSend != SEND_MESSAGE )
+    return;
+  }
+
+  if ( (endpoint > AF_EP_INDEX_MAX) || (afEpIndex[endpoint] == 0) )
+  {
+    afGroupIdxValid = FALSE;
+    return;
+  }
+
+  slot = afEpIndex[endpoint] - 1;
+
+  // Clear the endpoint's bit and drop the groups left without endpoints.
+  for ( i = 0, j = 0; i < afGroupIdxCnt; i++ )
+  {
+    afGroupIdx[i].epMask &= ~((uint16)1 << slot);
+    if ( afGroupIdx[i].epMask )
     {
-      return afStatus_INVALID_PARAMETER;
+      afGroupIdx[j++] = afGroupIdx[i];
     }
-
-    return afFillAndSendMessage( dstAddr, srcEndPoint, clusterID,
-      1, FrameType, TransSeqNumber, NULL, NULL, NULL, NULL,
-      DataLength, Data, txOptions, DiscoverRoute, RadiusCounter );
   }
+  afGroupIdxCnt = j;
 
-  if ( FrameType != FRAMETYPE_KVP )
+  afGroupIdxSync();
+}
+
+/*********************************************************************
+ * @fn      afGroupIdxBuild
+ *
+ * @brief   Rebuild the group delivery index from the APS group table.
+ *
+ * @param   none
+ *
+ * @return  TRUE if the index can be used, FALSE to search the APS
+ *          group table instead
+ */
+static byte afGroupIdxBuild( void )
+{
+  uint16 *grpList;
+  byte slot;
+  byte cnt;
+
+  afGroupIdxCnt = 0;
+
+  // Groups of endpoints outside of the dispatch table can't be indexed.
+  if ( afEpOverflow )
   {
-    return afStatus_INVALID_PARAMETER;
+    return ( FALSE );
   }
 
-  // Cannot mix Cluster ID's in aggregation packet.
-  if ( (hdr != NULL) && (hdr->clusterID != clusterID) )
+  grpList = osal_mem_alloc( (short)(sizeof( uint16 ) * APS_MAX_GROUPS) );
+  if ( grpList == NULL )
   {
-    multiSend( hdr, TransSeqNumber, RadiusCounter );
-    hdr = NULL;
+    return ( FALSE );
   }
 
-  if ( hdr == NULL )
+  afGroupIdxValid = TRUE;
+
+  for ( slot = 0; slot < afEpSlotCnt; slot++ )
   {
-    hdr = multiInit( dstAddr, srcEndPoint, clusterID, FrameType,
-                     txOptions, DiscoverRoute, RadiusCounter );
-    if ( hdr == NULL )
+    cnt = aps_FindAllGroupsForEndpoint( afEpSlots[slot]->epDesc->endPoint,
+                                        grpList );
+    while ( cnt-- )
     {
-      return afStatus_MEM_FAIL;
+      afGroupIdxSet( afEpSlots[slot]->epDesc->endPoint, grpList[cnt], TRUE );
     }
   }
 
-  if ( FALSE == multiAppend( hdr, (byte)DataLength, Data,
-                           CommandType, AttribDataType, AttribId, ErrorCode ) )
+  osal_mem_free( grpList );
+
+  afGroupIdxSync();
+
+  return ( afGroupIdxValid );
+}
+
+/*********************************************************************
+ * @fn      afGroupIdxSync
+ *
+ * @brief   Record the size of the APS group table the group delivery
+ *          index matches. A later size change means the table was
+ *          changed behind AF's back and the index must be rebuilt.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void afGroupIdxSync( void )
+{
+  if ( afGroupIdxValid )
   {
-    if ( hdr->msg != NULL )
+    afGroupIdxApsCnt = aps_CountAllGroups();
+  }
+}
+
+/*********************************************************************
+ * @fn      afGroupIdxFind
+ *
+ * @brief   Binary search of the group delivery index.
+ *
+ * @param   groupID - group ID to look for
+ * @param   pPos - if not NULL, set to the position of the entry, or to
+ *                 where it would be inserted if not found
+ *
+ * @return  pointer to the index entry, NULL if not found
+ */
+static afGroupIdx_t *afGroupIdxFind( uint16 groupID, byte *pPos )
+{
+  byte lo = 0;
+  byte hi = afGroupIdxCnt;
+  byte mid;
+
+  while ( lo < hi )
+  {
+    mid = (byte)((lo + hi) >> 1);
+
+    if ( afGroupIdx[mid].groupID < groupID )
     {
-      multiSend( hdr, TransSeqNumber, RadiusCounter );
+      lo = mid + 1;
     }
     else
     {
-      osal_mem_free( hdr );
+      hi = mid;
     }
-    hdr = NULL;
-    return afStatus_MEM_FAIL;
   }
 
-  // Only supporting up to 16 concatenated messages.
-  if ( (AddOrSend == SEND_MESSAGE) || (hdr->transCount >= 16) )
+  if ( pPos )
   {
-    stat = multiSend( hdr, TransSeqNumber, RadiusCounter );
-    hdr = NULL;
+    *pPos = lo;
   }
-  else
+
+  if ( (lo < afGroupIdxCnt) && (afGroupIdx[lo].groupID == groupID) )
   {
-    stat = afStatus_SUCCESS;
-    (*TransSeqNumber)++;
+    return ( &afGroupIdx[lo] );
   }
 
-  return stat;
+  return ( NULL );
 }
-#endif
 
-#if ( AF_V1_SUPPORT || AF_KVP_SUPPORT )
 /*********************************************************************
- * @fn      afFillAndSendMessage
- *
- * @brief   Fills in the cmd format structure and sends the out-going message.
- *
- * input parameters
- *
- * @param  *dstAddr         - Full ZB destination address: Nwk Addr + End Point.
- * @param   srcEndPoint     - Origination (i.e. respond to or ack to) End Point.
- * @param   clusterID       - A valid cluster ID as specified by the Profile.
- * @param   TransCount      - Set to 1.
- * @param   FrameType       - A valid frame type (see prev def of FRAMETYPE_...)
- * @param  *TransSeqNumber  - A pointer to a byte which can be modified and
- *          which will be used as the transaction sequence number of the msg.
- * @param   CommandType     -
- *          KVP Frame Type  : A valid command type (see prev def of CMDTYPE_...)
- *          MSG Frame Type  : Set to 0.
- * @param   AttribDataType  -
- *          KVP Frame Type  : A valid data type (see prev def of DATATYPE_...)
- *          MSG Frame Type  : Set to 0.
- * @param   AttribId        -
- *          KVP Frame Type  : A valid Attribute ID as specified by the Profile.
- *            (e.g. see OnOffSRC_OnOff in HomeControlLighting.h).
- *          MSG Frame Type  : Set to 0.
- * @param   ErrorCode       -
- *          KVP Frame Type  : A valid error code (see prev def of ERRORCODE_...)
- *          Note: Set to 0 unless the CommandType is one of the CMDTYPE_..._ACK.
- *          MSG Frame Type  : Set to 0.
- * @param   DataLength      - Number of bytes of data pointed to by next param.
- *          KVP Frame Type  : This must match value expected for the
- *          AttributeDataType specified above or the send will fail.
- *          MSG Frame Type  : No restriction or checks.
- * @param  *Data            - A pointer to the data bytes to send.
- * @param   txOptions       - A valid bit mask (see prev def of APS_TX_OPTIONS_)
- * @param   DiscoverRoute   - Normally set to FALSE. Perhaps set to TRUE after
- *          receiving an AF_DATA_CONFIRM_CMD with status other than ZSuccess.
- * @param   RadiusCounter   - Normally set to AF_DEFAULT_RADIUS.
+ * @fn      afGroupIdxSet
  *
- * output parameters
+ * @brief   Set or clear an endpoint's membership of a group in the
+ *          group delivery index.
  *
- * @param  *TransSeqNumber  - Incremented by one if the return value is success.
+ * @param   endpoint - endpoint
+ * @param   groupID - group ID
+ * @param   member - TRUE to set, FALSE to clear
  *
- * @return  afStatus_t      - See previous definition of afStatus_... types.
+ * @return  none
  */
-afStatus_t afFillAndSendMessage (
-  afAddrType_t *dstAddr, byte srcEndPoint, cId_t clusterID,
-  byte TransCount, byte FrameType, byte *TransSeqNumber,
-  byte CommandType, byte AttribDataType, uint16 AttribId, byte ErrorCode,
-  byte DataLength, byte *Data,
-  byte txOptions, byte DiscoverRoute, byte RadiusCounter )
+static void afGroupIdxSet( uint8 endpoint, uint16 groupID, byte member )
 {
-  const byte proVer = NLME_GetProtocolVersion();
-  afStatus_t stat = afStatus_FAILED;
-  byte *buf = Data;
+  afGroupIdx_t *pIdx;
+  uint16 bit;
+  byte pos;
+  byte i;
 
-#if ( AF_KVP_SUPPORT )
-  if ( FrameType == FRAMETYPE_KVP )
+  if ( !afGroupIdxValid )
   {
-    return afAddOrSendMessage( dstAddr, srcEndPoint, clusterID,
-      SEND_MESSAGE, FrameType, TransSeqNumber,
-      CommandType, AttribDataType, AttribId, ErrorCode,
-      DataLength, Data, txOptions, DiscoverRoute, RadiusCounter );
+    return;   // Picked up by the next rebuild
   }
-#endif
 
-  if ( FrameType != FRAMETYPE_MSG )
+  if ( (endpoint > AF_EP_INDEX_MAX) || (afEpIndex[endpoint] == 0) )
   {
-    return afStatus_INVALID_PARAMETER;
+    // Not a registered endpoint, fall back to the APS group table.
+    afGroupIdxValid = FALSE;
+    return;
   }
 
-  if ( TransCount != 1 )
+  bit = (uint16)1 << (afEpIndex[endpoint] - 1);
+  pIdx = afGroupIdxFind( groupID, &pos );
+
+  if ( member )
   {
-    return afStatus_INVALID_PARAMETER;
+    if ( pIdx == NULL )
+    {
+      if ( afGroupIdxCnt >= APS_MAX_GROUPS )
+      {
+        afGroupIdxValid = FALSE;
+        return;
+      }
+
+      // Open a slot to keep the index sorted.
+      for ( i = afGroupIdxCnt; i > pos; i-- )
+      {
+        afGroupIdx[i] = afGroupIdx[i-1];
+      }
+      afGroupIdxCnt++;
+
+      pIdx = &afGroupIdx[pos];
+      pIdx->groupID = groupID;
+      pIdx->epMask = 0;
+    }
+
+    pIdx->epMask |= bit;
+  }
+  else if ( pIdx != NULL )
+  {
+    pIdx->epMask &= ~bit;
+
+    if ( pIdx->epMask == 0 )
+    {
+      afGroupIdxCnt--;
+      for ( i = pos; i < afGroupIdxCnt; i++ )
+      {
+        afGroupIdx[i] = afGroupIdx[i+1];
+      }
+    }
   }
+}
+
+/*********************************************************************
+ * @fn      afGroupNextEp
+ *
+ * @brief   Get the next endpoint to receive a group frame.
+ *
+ * @param   groupID - group ID of the frame
+ * @param   pMask - remaining endpoint bitmap, when the index is used
+ * @param   pLastEP - last endpoint found, when searching the APS group
+ *                    table (start with APS_GROUPS_FIND_FIRST)
+ *
+ * @return  next endpoint list entry, NULL if no more endpoints
+ */
+static epList_t *afGroupNextEp( uint16 groupID, uint16 *pMask, uint8 *pLastEP )
+{
+  byte slot;
 
-  if ( proVer == ZB_PROT_V1_0 )
+  if ( afGroupIdxValid )
   {
-    buf = osal_mem_alloc( (short)(DataLength+3) );
-    if ( buf == NULL )
+    for ( slot = 0; *pMask; slot++ )
     {
-      return afStatus_MEM_FAIL;
+      if ( *pMask & ((uint16)1 << slot) )
+      {
+        *pMask &= ~((uint16)1 << slot);
+        return ( afEpSlots[slot] );
+      }
     }
 
-    buf[0] = BUILD_UINT8( FRAMETYPE_MSG, 1 );
-    buf[1] = *TransSeqNumber;
-    buf[2] = (byte)DataLength;
-
-    // Copy the data portion of the packet.
-    if ( Data && DataLength )
-    {
-      osal_memcpy( buf+3, Data, DataLength );
-      DataLength += 3;
-    }
-    else
-    {
-      DataLength = 3;
-    }
+    return ( (epList_t *)NULL );
   }
 
-  stat = afSend( dstAddr, srcEndPoint, clusterID,
-                 DataLength, buf, TransSeqNumber, txOptions, RadiusCounter );
-
-  if ( proVer == ZB_PROT_V1_0 )
+  *pLastEP = aps_FindGroupForEndpoint( groupID, *pLastEP );
+  if ( *pLastEP == APS_GROUPS_EP_NOT_FOUND )
   {
-    osal_mem_free( buf );
+    return ( (epList_t *)NULL );
   }
 
-  return stat;
+  return ( afFindEndPointDescList( *pLastEP ) );
 }
-#endif
 
 /*********************************************************************
- * @fn      AF_DataRequest
+ * @fn      afClusterIdxBuild
  *
- * @brief   Common functionality for invoking APSDE_DataReq() for both
- *          KVP-Send/SendMulti and MSG-Send.
+ * @brief   Rebuild the Match_Desc_req cluster index from the endpoint
+ *          dispatch table.
  *
- * input parameters
+ * @param   none
  *
- * @param  *dstAddr - Full ZB destination address: Nwk Addr + End Point.
- * @param  *srcEP - Origination (i.e. respond to or ack to) End Point Descr.
- * @param   cID - A valid cluster ID as specified by the Profile.
- * @param   len - Number of bytes of data pointed to by next param.
- * @param  *buf - A pointer to the data bytes to send.
- * @param  *transID - A pointer to a byte which can be modified and which will
- *                    be used as the transaction sequence number of the msg.
- * @param   options - Valid bit mask of Tx options.
- * @param   radius - Normally set to AF_DEFAULT_RADIUS.
+ * @return  none
+ */
+static void afClusterIdxBuild( void )
+{
+  byte slot;
+
+  afClusterIdxCnt = 0;
+  afClusterIdxValid = !afEpOverflow;
+
+  for ( slot = 0; slot < afEpSlotCnt; slot++ )
+  {
+    afClusterIdxAdd( afEpSlots[slot] );
+  }
+}
+
+/*********************************************************************
+ * @fn      afClusterIdxAdd
  *
- * output parameters
+ * @brief   Add the clusters of a registered endpoint to the cluster index.
  *
- * @param  *transID - Incremented by one if the return value is success.
+ * @param   ep - pointer to the endpoint list entry
  *
- * @return  afStatus_t - See previous definition of afStatus_... types.
+ * @return  none
  */
-#if ( AF_V1_SUPPORT )
-static afStatus_t afDataRequest( afAddrType_t *dstAddr, endPointDesc_t *srcEP,
-                           uint16 cID, uint16 len, uint8 *buf, uint8 *transID,
-                           uint8 options, uint8 radius )
-#else
-afStatus_t AF_DataRequest( afAddrType_t *dstAddr, endPointDesc_t *srcEP,
-                           uint16 cID, uint16 len, uint8 *buf, uint8 *transID,
-                           uint8 options, uint8 radius )
-#endif
+static void afClusterIdxAdd( epList_t *ep )
 {
-  pDescCB pfnDescCB;
-  ZStatus_t stat;
-  APSDE_DataReq_t req;
-  afDataReqMTU_t mtu;
+  SimpleDescriptionFormat_t *sDesc;
+  byte endPoint = ep->epDesc->endPoint;
+  uint16 bit;
+  byte i;
 
+  if ( !afClusterIdxValid || (endPoint == ZDO_EP) )
+  {
+    return;
+  }
 
-  if ( srcEP == NULL )
+  if ( (endPoint > AF_EP_INDEX_MAX) || (afEpIndex[endPoint] == 0) )
   {
-    return afStatus_INVALID_PARAMETER;
+    // Outside of the dispatch table, every endpoint has to be searched.
+    afClusterIdxValid = FALSE;
+    return;
   }
 
-  // Enforce consistent values on the destination address / address mode.
-  if ( dstAddr->addrMode == afAddrNotPresent )
+  if ( afEpSlots[afEpIndex[endPoint] - 1] != ep )
   {
-    dstAddr->endPoint = ZDO_EP;
-    req.dstAddr.addr.shortAddr = afGetReflector( srcEP->endPoint );
+    return;   // Hidden by an earlier registration of the endpoint
   }
-  else // Handle types: afAddr16Bit
-  {    //               afAddrBroadcast
-       //               afAddrGroup
-    req.dstAddr.addr.shortAddr = dstAddr->addr.shortAddr;
 
-    if ( ( dstAddr->addrMode == afAddr16Bit     ) ||
-         ( dstAddr->addrMode == afAddrBroadcast )    )
-    {
-      // Check for valid broadcast values
-      if( ADDR_NOT_BCAST != NLME_IsAddressBroadcast( dstAddr->addr.shortAddr )  )
-      {
-        // Force mode to broadcast
-        dstAddr->addrMode = afAddrBroadcast;
-      }
-      else
-      {
-        // Address is not a valid broadcast type
-        if ( dstAddr->addrMode == afAddrBroadcast )
-        {
-          return afStatus_INVALID_PARAMETER;
-        }
-      }
-    }
-    else if ( dstAddr->addrMode != afAddrGroup )
-    {
-      return afStatus_INVALID_PARAMETER;
-    }
+  bit = (uint16)1 << (afEpIndex[endPoint] - 1);
+
+  if ( ep->pfnDescCB )
+  {
+    sDesc = (SimpleDescriptionFormat_t *)ep->pfnDescCB( AF_DESCRIPTOR_SIMPLE,
+                                                        endPoint );
+  }
+  else
+  {
+    sDesc = ep->epDesc->simpleDesc;
   }
-  req.dstAddr.addrMode = dstAddr->addrMode;
-  req.profileID = ZDO_PROFILE_ID;
 
-  if ( (pfnDescCB = afGetDescCB( srcEP )) )
+  if ( sDesc == NULL )
   {
-    uint16 *pID = (uint16 *)(pfnDescCB(
-                                 AF_DESCRIPTOR_PROFILE_ID, srcEP->endPoint ));
-    if ( pID )
-    {
-      req.profileID = *pID;
-      osal_mem_free( pID );
-    }
+    return;
   }
-  else if ( srcEP->simpleDesc )
+
+  for ( i = 0; i < sDesc->AppNumInClusters; i++ )
   {
-    req.profileID = srcEP->simpleDesc->AppProfId;
+    afClusterIdxSet( sDesc->pAppInClusterList[i], bit, FALSE );
   }
 
-  req.txOptions = 0;
+  for ( i = 0; i < sDesc->AppNumOutClusters; i++ )
+  {
+    afClusterIdxSet( sDesc->pAppOutClusterList[i], bit, TRUE );
+  }
 
-  if ( ( options & AF_ACK_REQUEST              ) &&
-       ( req.dstAddr.addrMode != AddrBroadcast ) &&
-       ( req.dstAddr.addrMode != AddrGroup     )    )
+  if ( ep->pfnDescCB )
   {
-    req.txOptions |=  APS_TX_OPTIONS_ACK;
+    osal_mem_free( sDesc );
   }
+}
 
-  if ( options & AF_SKIP_ROUTING )
+/*********************************************************************
+ * @fn      afClusterIdxFind
+ *
+ * @brief   Binary search of the cluster index.
+ *
+ * @param   clusterID - cluster ID to look for
+ * @param   pPos - if not NULL, set to the position of the entry, or to
+ *                 where it would be inserted if not found
+ *
+ * @return  pointer to the index entry, NULL if not found
+ */
+static afClusterIdx_t *afClusterIdxFind( uint16 clusterID, byte *pPos )
+{
+  byte lo = 0;
+  byte hi = afClusterIdxCnt;
+  byte mid;
+
+  while ( lo < hi )
   {
-    req.txOptions |=  APS_TX_OPTIONS_SKIP_ROUTING;
+    mid = (byte)((lo + hi) >> 1);
+
+    if ( afClusterIdx[mid].clusterID < clusterID )
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
   }
 
-  if ( options & AF_EN_SECURITY )
+  if ( pPos )
   {
-    req.txOptions |= APS_TX_OPTIONS_SECURITY_ENABLE;
-    mtu.aps.secure = TRUE;
+    *pPos = lo;
   }
-  else
+
+  if ( (lo < afClusterIdxCnt) && (afClusterIdx[lo].clusterID == clusterID) )
   {
-    mtu.aps.secure = FALSE;
+    return ( &afClusterIdx[lo] );
   }
 
-  mtu.kvp = FALSE;
+  return ( NULL );
+}
 
-  req.transID       = *transID;
-  req.srcEP         = srcEP->endPoint;
-  req.dstEP         = dstAddr->endPoint;
-  req.clusterID     = cID;
-  req.asduLen       = len;
-  req.asdu          = buf;
-  req.discoverRoute = (uint8)((options & AF_DISCV_ROUTE) ? 1 : 0);
-  req.radiusCounter = radius;
+/*********************************************************************
+ * @fn      afClusterIdxSet
+ *
+ * @brief   Mark an endpoint slot as having a cluster.
+ *
+ * @param   clusterID - cluster ID
+ * @param   bit - endpoint slot bit
+ * @param   output - TRUE for an output cluster, FALSE for an input cluster
+ *
+ * @return  none
+ */
+static void afClusterIdxSet( uint16 clusterID, uint16 bit, byte output )
+{
+  afClusterIdx_t *pIdx;
+  byte pos;
+  byte i;
 
-  if (len > afDataReqMTU( &mtu ) )
+  pIdx = afClusterIdxFind( clusterID, &pos );
+
+  if ( pIdx == NULL )
   {
-    if (apsfSendFragmented)
+    if ( afClusterIdxCnt >= AF_CLUSTER_IDX_MAX )
     {
-      req.txOptions |= AF_FRAGMENTED | APS_TX_OPTIONS_ACK;
-      stat = (*apsfSendFragmented)( &req );
+      afClusterIdxValid = FALSE;
+      return;
     }
-    else
+
+    // Open a slot to keep the index sorted.
+    for ( i = afClusterIdxCnt; i > pos; i-- )
     {
-      stat = afStatus_INVALID_PARAMETER;
+      afClusterIdx[i] = afClusterIdx[i-1];
     }
-  } 
-  else
-  {
-    stat = APSDE_DataReq( &req );
+    afClusterIdxCnt++;
+
+    pIdx = &afClusterIdx[pos];
+    pIdx->clusterID = clusterID;
+    pIdx->inMask = 0;
+    pIdx->outMask = 0;
   }
 
-  /*
-   * If this is an EndPoint-to-EndPoint message on the same device, it will not
-   * get added to the NWK databufs. So it will not go OTA and it will not get
-   * a MACCB_DATA_CONFIRM_CMD callback. Thus it is necessary to generate the
-   * AF_DATA_CONFIRM_CMD here. Note that APSDE_DataConfirm() only generates one
-   * message with the first in line TransSeqNumber, even on a multi message.
-   */
-  if ( (req.dstAddr.addrMode == Addr16Bit) &&
-       (req.dstAddr.addr.shortAddr == NLME_GetShortAddr()) )
+  if ( output )
   {
-    afDataConfirm( srcEP->endPoint, *transID, stat );
+    pIdx->outMask |= bit;
+  }
+  else
+  {
+    pIdx->inMask |= bit;
   }
+}
 
-  if ( stat == afStatus_SUCCESS )
+/*********************************************************************
+ * @fn      afClusterListHas
+ *
+ * @brief   Check a descriptor's cluster list against a list taken from
+ *          a received frame.
+ *
+ * @param   cnt - number of cluster IDs in pList
+ * @param   pList - cluster IDs as received
+ * @param   cIdLen - bytes per received cluster ID
+ * @param   descCnt - number of cluster IDs in pDescList
+ * @param   pDescList - descriptor's cluster list
+ *
+ * @return  TRUE if any cluster ID is in both lists
+ */
+static byte afClusterListHas( byte cnt, byte *pList, byte cIdLen,
+                              byte descCnt, cId_t *pDescList )
+{
+  uint16 clusterID;
+  byte x, y;
+
+  for ( x = 0; x < cnt; x++ )
   {
-    (*transID)++;
+    clusterID = AF_CLUSTER_AT( pList, x, cIdLen );
+
+    for ( y = 0; y < descCnt; y++ )
+    {
+      if ( pDescList[y] == clusterID )
+      {
+        return ( TRUE );
+      }
+    }
   }
 
-  return (afStatus_t)stat;
+  return ( FALSE );
 }
 
 /*********************************************************************
@@ -1182,6 +2823,18 @@ static epList_t *afFindEndPointDescList( byte EndPoint )
 {
   epList_t *epSearch;
 
+  // Direct lookup through the dispatch table
+  if ( (EndPoint <= AF_EP_INDEX_MAX) && afEpIndex[EndPoint] )
+  {
+    return ( afEpSlots[afEpIndex[EndPoint] - 1] );
+  }
+
+  // Only registrations that didn't fit the table need a search.
+  if ( !afEpOverflow )
+  {
+    return ( (epList_t *)NULL );
+  }
+
   // Start at the beginning
   epSearch = epList;
 
@@ -1258,34 +2911,117 @@ byte afFindSimpleDesc( SimpleDescriptionFormat_t **ppDesc, byte EP )
 }
 
 /*********************************************************************
- * @fn      afGetDescCB
+ * @fn      afMatchEndPoints
  *
- * @brief   Get the Descriptor callback function.
+ * @brief   Find the endpoints that answer a Match_Desc_req: those that
+ *          allow matching, have the profile and share an input or output
+ *          cluster with the request (or any, if the request has none).
  *
- * @param   epDesc - pointer to the endpoint descriptor
+ * @param   profileID - profile ID of the request
+ * @param   numIn - number of input cluster IDs
+ * @param   inList - input cluster IDs as received
+ * @param   numOut - number of output cluster IDs
+ * @param   outList - output cluster IDs as received
+ * @param   cIdLen - bytes per received cluster ID
+ * @param   pEPs - filled with the matching endpoints
  *
- * @return  function pointer or NULL
+ * @return  count of matching endpoints
  */
-static pDescCB afGetDescCB( endPointDesc_t *epDesc )
+byte afMatchEndPoints( uint16 profileID, byte numIn, byte *inList,
+                       byte numOut, byte *outList, byte cIdLen, byte *pEPs )
 {
+  SimpleDescriptionFormat_t *sDesc;
+  afClusterIdx_t *pIdx;
   epList_t *epSearch;
+  uint16 mask = 0;
+  byte cnt = 0;
+  byte slot;
+  byte i;
 
-  // Start at the beginning
-  epSearch = epList;
+  if ( afClusterIdxValid )
+  {
+    if ( (numIn == 0) && (numOut == 0) )
+    {
+      for ( slot = 0; slot < afEpSlotCnt; slot++ )
+      {
+        mask |= (uint16)1 << slot;
+      }
+    }
 
-  // Look through the list until the end
-  while ( epSearch )
+    for ( i = 0; i < numIn; i++ )
+    {
+      if ( (pIdx = afClusterIdxFind( AF_CLUSTER_AT( inList, i, cIdLen ), NULL )) )
+      {
+        mask |= pIdx->inMask;
+      }
+    }
+
+    for ( i = 0; i < numOut; i++ )
+    {
+      if ( (pIdx = afClusterIdxFind( AF_CLUSTER_AT( outList, i, cIdLen ), NULL )) )
+      {
+        mask |= pIdx->outMask;
+      }
+    }
+
+    for ( slot = 0; mask; slot++ )
+    {
+      if ( mask & ((uint16)1 << slot) )
+      {
+        mask &= ~((uint16)1 << slot);
+        epSearch = afEpSlots[slot];
+
+        if ( (epSearch->epDesc->endPoint != ZDO_EP) &&
+             (epSearch->flags & eEP_AllowMatch) &&
+             (afGetProfileID( epSearch ) == profileID) )
+        {
+          pEPs[cnt++] = epSearch->epDesc->endPoint;
+        }
+      }
+    }
+
+    return ( cnt );
+  }
+
+  // Compare the simple descriptor of every endpoint.
+  for ( epSearch = epList; epSearch; epSearch = epSearch->nextDesc )
   {
-    // Is there a match?
-    if ( epSearch->epDesc == epDesc )
+    // Don't search endpoint 0 and check if response is allowed
+    if ( (epSearch->epDesc->endPoint == ZDO_EP) ||
+         !(epSearch->flags & eEP_AllowMatch) )
+    {
+      continue;
+    }
+
+    if ( epSearch->pfnDescCB )
     {
-      return ( epSearch->pfnDescCB );
+      sDesc = (SimpleDescriptionFormat_t *)epSearch->pfnDescCB(
+                               AF_DESCRIPTOR_SIMPLE, epSearch->epDesc->endPoint );
     }
     else
-      epSearch = epSearch->nextDesc;  // Next entry
+    {
+      sDesc = epSearch->epDesc->simpleDesc;
+    }
+
+    if ( sDesc && (sDesc->AppProfId == profileID) )
+    {
+      if ( ((numIn == 0) && (numOut == 0))
+           || afClusterListHas( numIn, inList, cIdLen,
+                                sDesc->AppNumInClusters, sDesc->pAppInClusterList )
+           || afClusterListHas( numOut, outList, cIdLen,
+                                sDesc->AppNumOutClusters, sDesc->pAppOutClusterList ) )
+      {
+        pEPs[cnt++] = sDesc->EndPoint;
+      }
+    }
+
+    if ( epSearch->pfnDescCB && sDesc )
+    {
+      osal_mem_free( sDesc );
+    }
   }
 
-  return ( (pDescCB)NULL );
+  return ( cnt );
 }
 
 /*********************************************************************
@@ -30,6 +30,7 @@ extern "C"
 #include "ZComDef.h"
 #include "nwk.h"
 #include "APSMEDE.h"
+#include "aps_groups.h"
 
 /*********************************************************************
  * CONSTANTS
@@ -48,9 +49,103 @@ extern "C"
   #define AF_FLOAT_SUPPORT  FALSE
 #endif
 
+// When a frame fans out to several endpoints (broadcast endpoint or group),
+// deliver one header per endpoint that all reference a single copy of the
+// ASDU. The shared cmd.Data must be treated as read-only by the application,
+// and the message must be freed with osal_msg_deallocate() as it is.
+#if !defined ( AF_SHARED_INCOMING )
+  #define AF_SHARED_INCOMING  TRUE
+#endif
+
+// Endpoints 0 - AF_EP_INDEX_MAX are dispatched through a direct index into
+// a table of up to AF_MAX_ENDPOINTS registrations. Endpoints registered
+// beyond that are still found, by walking epList.
+#if !defined ( AF_MAX_ENDPOINTS )
+  #define AF_MAX_ENDPOINTS  16
+#endif
+#define AF_EP_INDEX_MAX                    240
+
+// Group delivery resolves all endpoints of a group with one lookup in an
+// index of group ID to endpoint slot bitmap, kept by afAddGroup(),
+// afRemoveGroup() and afRemoveAllGroups().
+#if ( AF_MAX_ENDPOINTS > 16 )
+  #error "AF_MAX_ENDPOINTS must fit the 16 bit group endpoint bitmap"
+#endif
+
+// Match_Desc_req is answered from an index of cluster ID to the same endpoint
+// slot bitmaps, filled as endpoints register. Registrations that don't fit
+// (AF_MAX_ENDPOINTS or AF_CLUSTER_IDX_MAX distinct clusters) fall back to
+// comparing every endpoint's simple descriptor.
+#if !defined ( AF_CLUSTER_IDX_MAX )
+  #define AF_CLUSTER_IDX_MAX  32
+#endif
+
+// Small MSG frames sent with the AF_AGGREGATE option to the same unicast
+// destination within AF_AGGREGATE_WINDOW milliseconds are packed into one
+// APS frame on cluster AF_AGGREGATE_CLUSTER_ID and split back into
+// separate AF_INCOMING_MSG_CMD messages by the receiving AF. Both ends
+// must be built with AF_AGGREGATE_SUPPORT and list each other with
+// afAggregatePeer().
+#if !defined ( AF_AGGREGATE_SUPPORT )
+  #define AF_AGGREGATE_SUPPORT  FALSE
+#endif
+
+#if !defined ( AF_AGGREGATE_WINDOW )
+  #define AF_AGGREGATE_WINDOW        50
+#endif
+
+#if !defined ( AF_AGGREGATE_MAX_MSGS )
+  #define AF_AGGREGATE_MAX_MSGS      8
+#endif
+
+#if !defined ( AF_AGGREGATE_MAX_LEN )
+  #define AF_AGGREGATE_MAX_LEN       20    // Largest message held back
+#endif
+
+#if !defined ( AF_AGGREGATE_CLUSTER_ID )
+  #define AF_AGGREGATE_CLUSTER_ID    0xFFF0
+#endif
+
+#if !defined ( AF_AGGREGATE_PEER_MAX )
+  #define AF_AGGREGATE_PEER_MAX      4
+#endif
+
+// Aggregates waiting for their data confirm. No new aggregate is started
+// while all are waiting, the messages are sent on their own instead.
+#if !defined ( AF_AGGREGATE_SENT_MAX )
+  #define AF_AGGREGATE_SENT_MAX      4
+#endif
+
+// Aggregate frame: count (1 byte), then per message the cluster ID
+// (2 bytes, LSB first), the data length (1 byte) and the data.
+#define AF_AGGREGATE_HDR_LEN               1
+#define AF_AGGREGATE_SUB_HDR_LEN           3
+
+// Messages sent with the AF_TX_QUEUE option are held in AF while the NWK
+// data buffers are full and sent, highest endpoint priority first, as
+// data confirms free the buffers. AF_TX_PRIORITY_LOW (bulk) endpoints
+// are paced to one message every AF_TX_QUEUE_PACING milliseconds.
+#if !defined ( AF_TX_QUEUE_SUPPORT )
+  #define AF_TX_QUEUE_SUPPORT   FALSE
+#endif
+
+#if !defined ( AF_TX_QUEUE_DEPTH )
+  #define AF_TX_QUEUE_DEPTH          8
+#endif
+
+#if !defined ( AF_TX_QUEUE_PACING )
+  #define AF_TX_QUEUE_PACING         20    // Also the retry period
+#endif
+
+#define AF_TX_PRIORITY_LOW                 0
+#define AF_TX_PRIORITY_NORMAL              1
+#define AF_TX_PRIORITY_HIGH                2     // Default for ZDO_EP
+
 #define AF_BROADCAST_ENDPOINT              0xFF
 
 #define AF_FRAGMENTED                      0x01
+#define AF_TX_QUEUE                        0x04  // Queue if NWK is busy
+#define AF_AGGREGATE                       0x08  // May be packed, see above
 #define AF_ACK_REQUEST                     0x10
 #define AF_DISCV_ROUTE                     0x20
 #define AF_EN_SECURITY                     0x40
@@ -326,6 +421,14 @@ typedef struct
   byte transID;
 } afDataConfirm_t;
 
+// AF_TX_READY_CMD: the transmit queue refused a message from this
+// endpoint before and now has room again.
+typedef struct
+{
+  osal_event_hdr_t hdr;
+  byte endpoint;
+} afTxReady_t;
+
 // Endpoint Table - this table is the device description
 // or application registration.
 // There will be one entry in this table for every
@@ -354,6 +457,10 @@ typedef enum
   eEP_AllowMatch = 1,
 #if ( AF_KVP_SUPPORT )
   eEP_UsesKVP =    2,
+#endif
+  eEP_ProfileCached = 4,    // profileID holds the pfnDescCB profile ID
+#if ( AF_TX_QUEUE_SUPPORT )
+  eEP_TxWaiting = 8,        // Send AF_TX_READY_CMD when the queue has room
 #endif
   eEP_NotUsed
 } eEP_Flags;
@@ -364,6 +471,10 @@ typedef struct
   uint16 reflectorAddr;
   eEP_Flags flags;
   pDescCB  pfnDescCB;     // Don't use if this function pointer is NULL.
+  uint16 profileID;       // pfnDescCB answer, valid with eEP_ProfileCached.
+#if ( AF_TX_QUEUE_SUPPORT )
+  uint8 txPriority;       // AF_TX_PRIORITY_xxx
+#endif
   void *nextDesc;
 } epList_t;
 
@@ -389,6 +500,18 @@ typedef struct
   APSDE_DataReqMTU_t aps;
 } afDataReqMTU_t;
 
+#if ( AF_AGGREGATE_SUPPORT )
+// Counters to measure the effect of aggregation: every message packed
+// into an aggregate saves the MAC/NWK/APS headers, the CSMA backoffs and
+// the MAC ACK of one frame.
+typedef struct
+{
+  uint16 msgsPacked;      // AF_DataRequest() messages sent in aggregates
+  uint16 framesSent;      // Aggregate frames sent
+  uint16 bytesPacked;     // Data bytes sent in aggregates
+} afAggregateStats_t;
+#endif
+
 
 /*********************************************************************
  * Special AF Data Types
@@ -416,6 +539,10 @@ typedef struct
 
 extern epList_t *epList;
 
+#if ( AF_AGGREGATE_SUPPORT )
+extern afAggregateStats_t afAggregateStats;
+#endif
+
 /*********************************************************************
  * FUNCTIONS
  */
@@ -447,6 +574,32 @@ extern epList_t *epList;
   extern afStatus_t afRegisterFlags( endPointDesc_t *epDesc, eEP_Flags flags );
 #endif
 
+ /*
+  * afTimerEvent - ZDApp will call this function when the AF timer
+  *                (ZDO_AF_TIMER) expires.
+  */
+  extern void afTimerEvent( void );
+
+ /*
+  * afTxQueueEvent - ZDApp will call this function when the transmit
+  *                  queue timer (ZDO_AF_TXQ_TIMER) expires.
+  */
+  extern void afTxQueueEvent( void );
+
+#if ( AF_AGGREGATE_SUPPORT )
+ /*
+  * afAggregatePeer - Add or remove a peer that aggregates are exchanged with.
+  */
+  extern afStatus_t afAggregatePeer( uint16 nwkAddr, uint8 enable );
+#endif
+
+#if ( AF_TX_QUEUE_SUPPORT )
+ /*
+  * afSetTxPriority - Set the transmit queue priority of an endpoint.
+  */
+  extern afStatus_t afSetTxPriority( byte EndPoint, uint8 priority );
+#endif
+
  /*
   * afDataConfirm - APS will call this function after a data message
   *                 has been sent.
@@ -515,6 +668,44 @@ extern epList_t *epList;
   */
   extern byte afFindSimpleDesc( SimpleDescriptionFormat_t **ppDesc, byte EP );
 
+ /*
+  *	afMatchEndPoints - Find the endpoints that answer a Match_Desc_req.
+  *          The cluster lists are taken as they are in the message, with
+  *          cIdLen (1 or 2) bytes per cluster ID.
+  *          Returns the count of endpoints put in pEPs.
+  */
+  extern byte afMatchEndPoints( uint16 profileID, byte numIn, byte *inList,
+                       byte numOut, byte *outList, byte cIdLen, byte *pEPs );
+
+ /*
+  *	afInvalidateDescCache - Drop the AF's cached copy of the values
+  *          returned by an endpoint's descriptor callback, so that the
+  *          callback is consulted again on the next use.
+  *          FALSE if endpoint not found.
+  */
+  extern uint8 afInvalidateDescCache( byte EndPoint );
+
+ /*
+  *	afAddGroup - Add a group for an endpoint (aps_AddGroup) and update
+  *          the AF group delivery index. A direct aps_AddGroup() or
+  *          aps_RemoveGroup() call is noticed from the size of the APS
+  *          group table and costs a rebuild of the index.
+  */
+  extern ZStatus_t afAddGroup( uint8 endpoint, aps_Group_t *group );
+
+ /*
+  *	afRemoveGroup - Remove a group from an endpoint (aps_RemoveGroup) and
+  *          update the AF group delivery index.
+  *          TRUE if removed, FALSE if not found.
+  */
+  extern uint8 afRemoveGroup( uint8 endpoint, uint16 groupID );
+
+ /*
+  *	afRemoveAllGroups - Remove all groups of an endpoint
+  *          (aps_RemoveAllGroup) and update the AF group delivery index.
+  */
+  extern void afRemoveAllGroups( uint8 endpoint );
+
  /*
   *	afGetReflector - Find the reflector for the endpoint.
   *         0xFFFF return if not found
@@ -21,6 +21,7 @@
  */
 #include "ZComDef.h"
 #include "OSAL.h"
+#include "OSAL_Nv.h"
 #include "AF.h"
 #include "ZDConfig.h"
 
@@ -45,6 +46,8 @@
 #define zclProcessCmd( a, b, c )      zclCmdTable[(a)].pfnProcessInProfile( (b), (c) )
 
 /*** Table Indexing ***/
+#define CONVERT_KEY( list, x, logical )  ( (logical) ? (list)[(x)].logicalCluster : \
+                                                      (list)[(x)].actualCluster )
 #define NEXT_READ_RSP( ptr, len )     (zclReadRspStatus_t *)( (uint8 *)(ptr) + \
                                            sizeof (zclReadRspStatus_t) + (len) )
 #define NEXT_WRITE( ptr, len )        (zclWriteRec_t *)( (uint8 *)(ptr) + \
@@ -56,8 +59,12 @@
 #define NEXT_REPORT_RSP( ptr, len )   (zclReportCfgRspRec_t *) ( (uint8 *)(ptr) + \
                                            sizeof (zclReportCfgRspRec_t) + (len) )
 
-// There is no attribute in the Mandatory Reportable Attribute list for now
-#define zcl_MandatoryReportableAttribute( a ) ( a == NULL )
+// Record at position x of an attribute list, in index order if it has one
+#define zclAttrRecAt( pItem, x )  ( (pItem)->index ? &((pItem)->attrs[(pItem)->index[x]]) \
+                                                   : &((pItem)->attrs[x]) )
+
+// Any readable attribute may be reported
+#define zcl_MandatoryReportableAttribute( a ) ( zcl_AccessCtrlRead( (a)->attr.accessControl ) )
 
 /*********************************************************************
  * CONSTANTS
@@ -68,6 +75,32 @@
 
 #define ZCL_MIN_REPORTING_INTERVAL    5
 
+// Frame Control, Transaction Sequence Number and Command ID
+#define ZCL_HDR_MIN_LEN               3
+
+// Maximum Reporting Interval that removes a reporting configuration
+#define ZCL_REPORT_STOP               0xFFFF
+
+// ZCL task events
+#define ZCL_REPORT_EVT                0x0001
+#define ZCL_TRANSITION_EVT            0x0002
+#define ZCL_DISCOVER_EVT              0x0004
+
+#define ZCL_TRANSITION_TICK           100     // In ms, a tenth of a second
+#define ZCL_TRANSITION_TICKS_PER_SEC  ( 1000 / ZCL_TRANSITION_TICK )
+#define ZCL_TRANSITION_SHIFT          16      // Fraction bits of the values
+
+#define ZCL_DISCOVER_TIMEOUT          5000    // In ms, before a discovery is dropped
+#define ZCL_DISCOVER_REC_LEN          3       // Attribute ID and Data Type
+
+#define ZCL_REPORT_VALUE_LEN          8       // Longest value compared
+#define ZCL_REPORT_MAX_TIMEOUT        60000   // Longest timer, in ms
+
+// Reporting configuration flags
+#define ZCL_REPORT_VALUE_VALID        0x01    // lastValue holds the last report
+#define ZCL_REPORT_PENDING            0x02    // Reportable change since then
+#define ZCL_REPORT_DUE                0x04    // Report in this pass
+
 /*********************************************************************
  * TYPEDEFS
  */
@@ -86,17 +119,94 @@ typedef struct zclProfileClusterConvertRec
   uint16                             profileID;
   uint16                             numClusters;
   GENERIC zclConvertClusterRec_t     *list;
+  zclLibPlugin_t                     **plugins;  // plugin of each list entry, NULL
+                                                 // if the table isn't indexed
+  uint8                              *byActual;  // list sorted by actual cluster ID
+  uint8                              *byLogical; // list sorted by logical cluster ID
 } zclProfileClusterConvertRec_t;
 
 // Attribute record list item
 typedef struct zclAttrRecsList
 {
-  struct zclAttrRecsList *next;
-  uint8                  endpoint;      // Used to link it into the endpoint descriptor
-  uint8                  numAttributes; // Number of the following records
-  zclAttrRec_t           *attrs;        // attribute records
+  struct zclAttrRecsList     *next;
+  uint8                      endpoint;      // Used to link it into the endpoint descriptor
+  uint8                      numAttributes; // Number of the following records
+  uint8                      sorted;        // TRUE if zclAttrRecAt() is in cluster
+                                            // and attribute ID order
+  const zclAttrRec_t GENERIC *attrs;        // attribute records, may be in CONST
+  uint8                      *index;        // attrs sorted by cluster and attribute
+                                            // ID, NULL if attrs are listed in order
+                                            // (or it couldn't be allocated)
+#ifdef ZCL_DISCOVER
+  uint8                      discPos;       // Next record of the discovery cursor
+#endif // ZCL_DISCOVER
 } zclAttrRecsList;
 
+#ifdef ZCL_DISCOVER
+// Discovery cursor over an endpoint's attribute lists
+typedef struct
+{
+  uint8  endpoint;
+  uint16 clusterID;           // Real cluster ID
+  uint16 nextAttr;            // Lowest attribute ID not returned yet
+  uint8  done;                // TRUE once the highest ID has been returned
+} zclDiscCursor_t;
+
+// Discovery of all the attributes of a remote cluster
+typedef struct
+{
+  uint8           srcEP;      // 0 if the entry is not used
+  uint8           seqNum;     // Of the Discover Attributes command sent
+  uint8           maxAttrIDs;
+  uint16          clusterID;  // Real cluster ID
+  afAddrType_t    dstAddr;
+  uint32          sent;       // osal_GetSystemClock() when it was sent
+  zclDiscoverCB_t pfnCB;
+} zclDiscoverAll_t;
+#endif // ZCL_DISCOVER
+
+#ifdef ZCL_REPORT
+// Attribute reporting configuration, as saved in NV
+typedef struct
+{
+  uint8  endpoint;            // 0 if the entry is not used
+  uint8  dstEP;               // Where reports are sent: the device that
+  uint16 dstAddr;             // configured reporting
+  uint16 clusterID;           // Real cluster ID
+  uint16 attrID;
+  uint16 minReportInt;        // In seconds
+  uint16 maxReportInt;        // In seconds, 0 for no periodic reports
+  uint8  reportableChange[ZCL_REPORT_VALUE_LEN]; // As received, analog only
+} zclReportCfgNV_t;
+
+// Attribute reporting configuration item
+typedef struct
+{
+  zclReportCfgNV_t           cfg;
+  const zclAttrRec_t GENERIC *pAttr;      // NULL until the attribute is looked up
+  uint32                     lastReport; // osal_GetSystemClock() at the last report
+  uint8                      lastValue[ZCL_REPORT_VALUE_LEN]; // Serialized value reported
+  uint8                      flags;
+} zclReportCfg_t;
+#endif // ZCL_REPORT
+
+#ifdef ZCL_TRANSITION
+// Transition in progress on one attribute
+typedef struct
+{
+  uint8                      endpoint;    // 0 if the entry is not used
+  uint8                      options;     // ZCL_TRANSITION_WRAP, ZCL_TRANSITION_DOWN...
+  const zclAttrRec_t GENERIC *pAttr;      // Attribute that moves (uint8 value)
+  const zclAttrRec_t GENERIC *pRemaining; // Remaining Time attribute, NULL if none
+  int32                      value;       // Current value, fixed point
+  int32                      step;        // Added each tick, fixed point
+  int32                      range;       // Cyclic values stay below this, fixed point
+  uint16                     ticks;       // Ticks left, 0 to move until stopped
+  uint8                      target;      // Written on the last tick
+  uint32                     due;         // osal_GetSystemClock() of the next tick
+} zclTransition_t;
+#endif // ZCL_TRANSITION
+
 typedef void *(*zclParseInProfileCmd_t)( uint8 endpoint, uint16 realClusterID, uint8 dataLen, uint8 *pData );
 typedef uint8 (*zclProcessInProfileCmd_t)( zclIncoming_t *msg, uint16 logicalClusterID );
 
@@ -131,6 +241,20 @@ static zclLibPlugin_t *plugins;
 static zclProfileClusterConvertRec_t *profileClusterList;
 static zclAttrRecsList *attrList;
 static byte zcl_TransID = 0;  // This is the unique message ID (counter)
+
+#ifdef ZCL_REPORT
+static zclReportCfg_t zclReportCfgs[ZCL_MAX_REPORT_CFGS];
+static uint8 zclReportSeqNum;
+#endif // ZCL_REPORT
+
+#ifdef ZCL_TRANSITION
+static zclTransition_t zclTransitions[ZCL_MAX_TRANSITIONS];
+#endif // ZCL_TRANSITION
+
+#ifdef ZCL_DISCOVER
+static zclDiscoverAll_t zclDiscoverAlls[ZCL_MAX_DISCOVERIES];
+static uint8 zclDiscoverSeqNum;
+#endif // ZCL_DISCOVER
 static zclAttrRecsList *attrList;
 
 /*********************************************************************
@@ -142,25 +266,34 @@ static uint8 zclCalcHdrSize( zclFrameHdr_t *hdr );
 static uint16 zclConvertClusterID( uint16 clusterID, uint16 profileID,
                                    uint8 convertToLogical );
 static zclLibPlugin_t *zclFindPlugin( uint16 realclusterID, uint16 profileID );
+static zclLibPlugin_t *zclFindPluginRange( uint16 logicalClusterID );
+static void zclConvertSort( zclProfileClusterConvertRec_t *pItem, uint8 *index, uint8 logical );
+static uint16 zclConvertFind( zclProfileClusterConvertRec_t *pItem, uint16 clusterID,
+                              uint8 convertToLogical );
+static void zclConvertMapPlugins( zclProfileClusterConvertRec_t *pItem );
+static uint8 zclAttrRecBefore( const zclAttrRec_t GENERIC *pAttr, uint16 realClusterID, uint16 attrId );
+static uint8 zclFindAttrIdx( zclAttrRecsList *pItem, uint16 realClusterID, uint16 attrId );
 
 static uint8 zcl_DeviceOperational( uint8 srcEP, uint16 realClusterID, uint8 frameType, uint8 cmd );
 
 static uint8 zclGetAttrDataLength( uint8  dataType, uint8 *pData);
+static uint8 zclFrameDataLength( uint8 dataType, uint8 *pBuf, uint8 *pEnd, uint8 *pLen );
 static uint8 zclGetDataTypeLength( uint8 dataType );
+static uint8 zclAttrIterData( zclAttrIterRec_t *pRec, uint8 *pBuf, uint8 *pEnd );
 
 #if defined(ZCL_READ) || defined(ZCL_WRITE) || defined(ZCL_REPORT)
 static void zclSerializeData( uint8 dataType, void *attrData, uint8 *buf );
 #endif // ZCL_READ || ZCL_WRITE || ZCL_REPORT
 
 #ifdef ZCL_READ
-static void *zclParseInReadRspCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, uint8 *pData );
 static uint8 zclProcessInReadCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID );
 static uint8 zclProcessInReadRspCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID );
+static void zclSendReadRspFrame( zclIncoming_t *pInMsg, endPointDesc_t *epDesc,
+                                 uint8 len, uint8 *buf );
 #endif // ZCL_READ
 
 #ifdef ZCL_WRITE
-static uint8 zclWriteAttrData( zclAttrRec_t *pAttr, zclWriteRec_t *pWriteRec );
-static void *zclParseInWriteRspCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, uint8 *pData );
+static uint8 zclWriteAttrData( const zclAttrRec_t GENERIC *pAttr, zclWriteRec_t *pWriteRec );
 static uint8 zclProcessInWriteCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID );
 static uint8 zclProcessInWriteUndividedCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID );
 static uint8 zclProcessInWriteRspCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID );
@@ -168,33 +301,66 @@ static uint8 zclProcessInWriteRspCmd( zclIncoming_t *pInMsg, uint16 logicalClust
 
 #ifdef ZCL_REPORT
 static uint8 zclAnalogDataType( uint8 dataType );
-static void *zclParseInConfigReportRspCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, uint8 *pData );
-static void *zclParseInReadReportCfgRspCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, uint8 *pData );
 static uint8 zclProcessInConfigReportCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID );
 static uint8 zclProcessInConfigReportRspCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID );
 static uint8 zclProcessInReadReportCfgCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID );
 static uint8 zclProcessInReadReportCfgRspCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID );
 static uint8 zclProcessInReportCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID );
+static uint8 zclAttrIterCount( zclIncoming_t *pInMsg );
+
+static void zclReportInit( void );
+static uint8 zclReportFindCfg( uint8 endpoint, uint16 realClusterID, uint16 attrId );
+static uint8 zclReportSetCfg( zclIncoming_t *pInMsg, zclAttrIterRec_t *pRec,
+                              const zclAttrRec_t GENERIC *pAttr );
+static const zclAttrRec_t GENERIC *zclReportGetAttr( zclReportCfg_t *pCfg );
+static void zclReportAttrChanged( const zclAttrRec_t GENERIC *pAttr );
+static uint8 zclReportValueChanged( zclReportCfg_t *pCfg, const zclAttrRec_t GENERIC *pAttr );
+static uint8 zclReportValueLen( uint8 dataType );
+static uint32 zclReportBuildValue( uint8 *pData, uint8 len );
+static uint32 zclReportTimeLeft( zclReportCfg_t *pCfg, uint32 now );
+static void zclReportSchedule( void );
+static void zclReportProcess( void );
+static void zclReportSend( uint8 first, uint32 now );
+static void zclReportSent( zclReportCfg_t *pCfg, uint32 now );
+static void zclReportInitNV( void );
+static void zclReportWriteNV( uint8 idx );
+static void zclReportRestoreFromNV( void );
 #endif // ZCL_REPORT
 
-static void *zclParseInErrorCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, uint8 *pData );
+#ifdef ZCL_TRANSITION
+static zclTransition_t *zclTransitionFind( uint8 endpoint, uint16 realClusterID,
+                                           uint16 attrId, uint8 alloc );
+static void zclTransitionStart( zclTransition_t *pTrans, uint8 endpoint,
+                                const zclAttrRec_t GENERIC *pAttr,
+                                uint16 remainingTimeId, int16 range, uint8 options );
+static void zclTransitionEnd( zclTransition_t *pTrans );
+static void zclTransitionWrite( const zclAttrRec_t GENERIC *pAttr, uint8 value );
+static void zclTransitionRemaining( zclTransition_t *pTrans, uint16 ticks );
+static void zclTransitionProcess( void );
+static void zclTransitionTimer( uint32 now );
+#endif // ZCL_TRANSITION
+
 static uint8 zclProcessInErrorCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID );
 
 #ifdef ZCL_DISCOVER
-static zclAttrRec_t *zclFindNextAttrRec( uint8 endpoint, uint16 realClusterID, uint16 *attr );
-static void *zclParseInDiscRspCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, uint8 *pData );
+static void zclDiscCursorStart( zclDiscCursor_t *pCursor, uint8 endpoint,
+                                uint16 realClusterID, uint16 startAttr );
+static const zclAttrRec_t GENERIC *zclDiscCursorNext( zclDiscCursor_t *pCursor );
+static ZStatus_t zclDiscoverAllSend( zclDiscoverAll_t *pDisc, uint16 startAttr );
+static void zclDiscoverAllExpire( void );
 static uint8 zclProcessInDiscCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID );
 static uint8 zclProcessInDiscRspCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID );
 #endif // ZCL_DISCOVER
 
 /*********************************************************************
- * Parse Profile Command Function Table
+ * Parse Profile Command Function Table - commands without a parse
+ * function are processed in place with zclAttrIterNext()
  */
 static CONST zclCmdItems_t zclCmdTable[] =
 {
 #ifdef ZCL_READ
-  /* ZCL_CMD_READ */                { zclParseInReadCmd,             zclProcessInReadCmd             },
-  /* ZCL_CMD_READ_RSP */            { zclParseInReadRspCmd,          zclProcessInReadRspCmd          },
+  /* ZCL_CMD_READ */                { NULL,                          zclProcessInReadCmd             },
+  /* ZCL_CMD_READ_RSP */            { NULL,                          zclProcessInReadRspCmd          },
 #else
   /* ZCL_CMD_READ */                { NULL,                          NULL                            },
   /* ZCL_CMD_READ_RSP */            { NULL,                          NULL                            },
@@ -203,7 +369,7 @@ static CONST zclCmdItems_t zclCmdTable[] =
 #ifdef ZCL_WRITE
   /* ZCL_CMD_WRITE */               { zclParseInWriteCmd,            zclProcessInWriteCmd            },
   /* ZCL_CMD_WRITE_UNDIVIDED */     { zclParseInWriteCmd,            zclProcessInWriteUndividedCmd   },
-  /* ZCL_CMD_WRITE_RSP */           { zclParseInWriteRspCmd,         zclProcessInWriteRspCmd         },
+  /* ZCL_CMD_WRITE_RSP */           { NULL,                          zclProcessInWriteRspCmd         },
   /* ZCL_CMD_WRITE_NO_RSP */        { zclParseInWriteCmd,            zclProcessInWriteCmd            },
 #else
   /* ZCL_CMD_WRITE */               { NULL,                          NULL                            },
@@ -213,11 +379,11 @@ static CONST zclCmdItems_t zclCmdTable[] =
 #endif // ZCL_WRITE
 
 #ifdef ZCL_REPORT
-  /* ZCL_CMD_CONFIG_REPORT */       { zclParseInConfigReportCmd,     zclProcessInConfigReportCmd     },
-  /* ZCL_CMD_CONFIG_REPORT_RSP */   { zclParseInConfigReportRspCmd,  zclProcessInConfigReportRspCmd  },
-  /* ZCL_CMD_READ_REPORT_CFG */     { zclParseInReadReportCfgCmd,    zclProcessInReadReportCfgCmd    },
-  /* ZCL_CMD_READ_REPORT_CFG_RSP */ { zclParseInReadReportCfgRspCmd, zclProcessInReadReportCfgRspCmd },
-  /* ZCL_CMD_REPORT */              { zclParseInReportCmd,           zclProcessInReportCmd           },
+  /* ZCL_CMD_CONFIG_REPORT */       { NULL,                          zclProcessInConfigReportCmd     },
+  /* ZCL_CMD_CONFIG_REPORT_RSP */   { NULL,                          zclProcessInConfigReportRspCmd  },
+  /* ZCL_CMD_READ_REPORT_CFG */     { NULL,                          zclProcessInReadReportCfgCmd    },
+  /* ZCL_CMD_READ_REPORT_CFG_RSP */ { NULL,                          zclProcessInReadReportCfgRspCmd },
+  /* ZCL_CMD_REPORT */              { NULL,                          zclProcessInReportCmd           },
 #else
   /* ZCL_CMD_CONFIG_REPORT */       { NULL,                          NULL                            },
   /* ZCL_CMD_CONFIG_REPORT_RSP */   { NULL,                          NULL                            },
@@ -226,11 +392,11 @@ static CONST zclCmdItems_t zclCmdTable[] =
   /* ZCL_CMD_REPORT */              { NULL,                          NULL                            },
 #endif // ZCL_REPORT
 
-  /* ZCL_CMD_ERROR */               { zclParseInErrorCmd,            zclProcessInErrorCmd            },
+  /* ZCL_CMD_ERROR */               { NULL,                          zclProcessInErrorCmd            },
   
 #ifdef ZCL_DISCOVER  
-  /* ZCL_CMD_DISCOVER */            { zclParseInDiscCmd,             zclProcessInDiscCmd             },
-  /* ZCL_CMD_DISCOVER_RSP */        { zclParseInDiscRspCmd,          zclProcessInDiscRspCmd          }
+  /* ZCL_CMD_DISCOVER */            { NULL,                          zclProcessInDiscCmd             },
+  /* ZCL_CMD_DISCOVER_RSP */        { NULL,                          zclProcessInDiscRspCmd          }
 #else
   /* ZCL_CMD_DISCOVER */            { NULL,                          NULL                            },
   /* ZCL_CMD_DISCOVER_RSP */        { NULL,                          NULL                            }
@@ -257,6 +423,19 @@ void zcl_Init( uint8 task_id )
   plugins = (zclLibPlugin_t  *)NULL;
   profileClusterList = (zclProfileClusterConvertRec_t *)NULL;
   attrList = (zclAttrRecsList *)NULL;
+
+#ifdef ZCL_REPORT
+  zclReportInit();
+#endif // ZCL_REPORT
+
+#ifdef ZCL_TRANSITION
+  osal_memset( zclTransitions, 0, sizeof( zclTransitions ) );
+#endif // ZCL_TRANSITION
+
+#ifdef ZCL_DISCOVER
+  osal_memset( zclDiscoverAlls, 0, sizeof( zclDiscoverAlls ) );
+  zclDiscoverSeqNum = 0;
+#endif // ZCL_DISCOVER
 }
 
 /*********************************************************************
@@ -307,6 +486,39 @@ uint16 zcl_event_loop( uint8 task_id, uint16 events )
     return (events ^ SYS_EVENT_MSG);
   }
 
+#ifdef ZCL_REPORT
+  if ( events & ZCL_REPORT_EVT )
+  {
+    // Send the reports that are due
+    zclReportProcess();
+
+    // return unprocessed events
+    return (events ^ ZCL_REPORT_EVT);
+  }
+#endif // ZCL_REPORT
+
+#ifdef ZCL_TRANSITION
+  if ( events & ZCL_TRANSITION_EVT )
+  {
+    // Move all the transitions in progress one tick
+    zclTransitionProcess();
+
+    // return unprocessed events
+    return (events ^ ZCL_TRANSITION_EVT);
+  }
+#endif // ZCL_TRANSITION
+
+#ifdef ZCL_DISCOVER
+  if ( events & ZCL_DISCOVER_EVT )
+  {
+    // End the discoveries that got no answer
+    zclDiscoverAllExpire();
+
+    // return unprocessed events
+    return (events ^ ZCL_DISCOVER_EVT);
+  }
+#endif // ZCL_DISCOVER
+
   // Discard unknown events
   return 0;
 }
@@ -328,6 +540,7 @@ ZStatus_t zcl_registerClusterConvertTable( uint16 profileId,
 {
   zclProfileClusterConvertRec_t *pNewItem;
   zclProfileClusterConvertRec_t *pLoop;
+  uint8 *pMem = NULL;
 
   // Fill in the new profile list
   pNewItem = osal_mem_alloc( sizeof( zclProfileClusterConvertRec_t ) );
@@ -339,6 +552,25 @@ ZStatus_t zcl_registerClusterConvertTable( uint16 profileId,
   pNewItem->numClusters = numClusters;
   pNewItem->list = clusterList;
 
+  // Sort the table both ways and map each entry to its plugin once, so an
+  // incoming frame is resolved with binary searches. Without the index (no
+  // memory, or too many clusters) the table is searched one by one.
+  if ( numClusters > 0 && numClusters <= 0xFF )
+  {
+    pMem = osal_mem_alloc( numClusters * (sizeof( zclLibPlugin_t * ) + 2) );
+  }
+  pNewItem->plugins = (zclLibPlugin_t **)pMem;
+  pNewItem->byActual = NULL;
+  pNewItem->byLogical = NULL;
+  if ( pMem )
+  {
+    pNewItem->byActual = pMem + (numClusters * sizeof( zclLibPlugin_t * ));
+    pNewItem->byLogical = pNewItem->byActual + numClusters;
+    zclConvertSort( pNewItem, pNewItem->byActual, FALSE );
+    zclConvertSort( pNewItem, pNewItem->byLogical, TRUE );
+    zclConvertMapPlugins( pNewItem );
+  }
+
   // Find spot in list
   if (  profileClusterList == NULL )
   {
@@ -374,6 +606,7 @@ ZStatus_t zcl_registerPlugin( uint16 startLogCluster,
 {
   zclLibPlugin_t *pNewItem;
   zclLibPlugin_t *pLoop;
+  zclProfileClusterConvertRec_t *pItem;
 
   // Fill in the new profile list
   pNewItem = osal_mem_alloc( sizeof( zclLibPlugin_t ) );
@@ -402,6 +635,10 @@ ZStatus_t zcl_registerPlugin( uint16 startLogCluster,
     pLoop->next = pNewItem;
   }
 
+  // Clusters in the new range may now have a plugin
+  for ( pItem = profileClusterList; pItem != NULL; pItem = pItem->next )
+    zclConvertMapPlugins( pItem );
+
   return ( ZSuccess );
 }
 
@@ -412,17 +649,22 @@ ZStatus_t zcl_registerPlugin( uint16 startLogCluster,
  *
  * @param       endpoint the attribute list belongs to
  * @param       numAttr - number of attributes in list
- * @param       newAttrList - array of Attribute records.
- *                            NOTE: THE ATTRIBUTE IDs (FOR A CLUSTER) MUST BE IN
- *                            ASCENDING ORDER. OTHERWISE, THE DISCOVERY RESPONSE
- *                            COMMAND WILL NOT HAVE THE RIGHT ATTRIBUTE INFO
+ * @param       newAttrList - array of Attribute records. Only the
+ *                            attribute values need to be in RAM, the
+ *                            records themselves may be CONST. Listed in
+ *                            cluster and attribute ID order, they are
+ *                            searched in place; otherwise ZCL indexes
+ *                            them, which costs a byte of RAM each.
  *
  * @return      ZSuccess if OK
  */
-ZStatus_t zcl_registerAttrList( uint8 endpoint, uint8 numAttr, zclAttrRec_t *newAttrList )
+ZStatus_t zcl_registerAttrList( uint8 endpoint, uint8 numAttr,
+                                const zclAttrRec_t GENERIC *newAttrList )
 {
   zclAttrRecsList *pNewItem;
   zclAttrRecsList *pLoop;
+  const zclAttrRec_t GENERIC *pAttr;
+  uint8 x, y;
 
   // Fill in the new profile list
   pNewItem = osal_mem_alloc( sizeof( zclAttrRecsList ) );
@@ -433,6 +675,39 @@ ZStatus_t zcl_registerAttrList( uint8 endpoint, uint8 numAttr, zclAttrRec_t *new
   pNewItem->endpoint = endpoint;
   pNewItem->numAttributes = numAttr;
   pNewItem->attrs = newAttrList;
+  pNewItem->index = NULL;
+
+  // Lookups use a binary search when the records are in order
+  pNewItem->sorted = TRUE;
+  for ( x = 1; x < numAttr && pNewItem->sorted; x++ )
+  {
+    pAttr = &newAttrList[x];
+    pNewItem->sorted = zclAttrRecBefore( &newAttrList[x-1], pAttr->clusterID,
+                                         pAttr->attr.attrId );
+  }
+
+  // Otherwise sort them once through an index. Without the index (no
+  // memory) the records are searched one by one.
+  if ( !pNewItem->sorted )
+  {
+    pNewItem->index = osal_mem_alloc( numAttr );
+  }
+  if ( pNewItem->index )
+  {
+    // Stable insertion sort: of duplicate records the first one in the
+    // list stays first, as found by the linear search
+    pNewItem->sorted = TRUE;
+    for ( x = 0; x < numAttr; x++ )
+    {
+      pAttr = &newAttrList[x];
+      for ( y = x; (y > 0) && zclAttrRecBefore( pAttr, newAttrList[pNewItem->index[y-1]].clusterID,
+                                                newAttrList[pNewItem->index[y-1]].attr.attrId ); y-- )
+      {
+        pNewItem->index[y] = pNewItem->index[y-1];
+      }
+      pNewItem->index[y] = x;
+    }
+  }
 
   // Find spot in list
   if ( attrList == NULL )
@@ -469,7 +744,7 @@ ZStatus_t zcl_registerAttrList( uint8 endpoint, uint8 numAttr, zclAttrRec_t *new
 static uint8 zcl_DeviceOperational( uint8 srcEP, uint16 realClusterID, 
                                     uint8 frameType, uint8 cmd )
 {
-  zclAttrRec_t *pAttr;
+  const zclAttrRec_t GENERIC *pAttr;
   uint8 deviceEnabled = DEVICE_ENABLED; // default value
 
   // If the device is Disabled (DeviceEnabled attribute is set to Disabled), it 
@@ -747,7 +1022,7 @@ ZStatus_t zcl_SendWriteRequest( uint8 srcEP, afAddrType_t *dstAddr, uint16 realC
   uint8 *buf;
   uint8 *pBuf;
   zclWriteRec_t *statusRec;
-  zclAttrRec_t *pAttr;
+  const zclAttrRec_t GENERIC *pAttr;
   uint8 attrDataLen;
   uint8 dataLen = 0;
   uint8 i;
@@ -881,7 +1156,7 @@ ZStatus_t zcl_SendConfigReportCmd( uint8 srcEP, afAddrType_t *dstAddr,
   uint8 dataLen = 0;
   zclCfgReportRec_t *reportRec;
   uint8 reportChangeLen; // length of Reportable Change field
-  zclAttrRec_t *pAttr;
+  const zclAttrRec_t GENERIC *pAttr;
   uint8 i;
   ZStatus_t status;
   
@@ -1095,7 +1370,7 @@ ZStatus_t zcl_SendReadReportCfgRspCmd( uint8 srcEP, afAddrType_t *dstAddr,
   uint8 dataLen = 0;
   zclReportCfgRspRec_t *reportRspRec;
   uint8 reportChangeLen;
-  zclAttrRec_t *pAttr;
+  const zclAttrRec_t GENERIC *pAttr;
   uint8 i;
   ZStatus_t status;
 
@@ -1200,7 +1475,7 @@ ZStatus_t zcl_SendReportCmd( uint8 srcEP, afAddrType_t *dstAddr,
                              uint8 direction, uint8 seqNum )
 {
   zclReport_t *reportRec;
-  zclAttrRec_t *pAttr;
+  const zclAttrRec_t GENERIC *pAttr;
   uint8 attrDataLen;
   uint8 dataLen = 0;
   uint8 *buf;
@@ -1263,6 +1538,33 @@ ZStatus_t zcl_SendReportCmd( uint8 srcEP, afAddrType_t *dstAddr,
   
   return ( status );
 }
+
+/*********************************************************************
+ * @fn      zcl_ReportAttrChanged
+ *
+ * @brief   Tell the reporting engine that the application changed the
+ *          value of an attribute. A report is sent, once the Minimum
+ *          Reporting Interval allows, if the value changed enough.
+ *          Writes received over the air are checked by ZCL itself.
+ *
+ * @param   endpoint - Application's endpoint
+ * @param   realClusterID - real cluster ID
+ * @param   attrId - attribute ID
+ *
+ * @return  ZSuccess if OK
+ */
+ZStatus_t zcl_ReportAttrChanged( uint8 endpoint, uint16 realClusterID, uint16 attrId )
+{
+  const zclAttrRec_t GENERIC *pAttr;
+
+  pAttr = zclFindAttrRec( endpoint, realClusterID, attrId );
+  if ( pAttr == NULL )
+    return ( ZInvalidParameter ); // EMBEDDED RETURN
+
+  zclReportAttrChanged( pAttr );
+
+  return ( ZSuccess );
+}
 #endif // ZCL_REPORT
        
 /*********************************************************************
@@ -1382,6 +1684,55 @@ ZStatus_t zcl_SendDiscoverRspCmd( uint8 srcEP, afAddrType_t *dstAddr,
   
   return ( status );
 }
+
+/*********************************************************************
+ * @fn      zcl_DiscoverAllAttrs
+ *
+ * @brief   Discover all the attributes of a remote cluster. Discover
+ *          Attributes commands are sent, each one starting after the
+ *          last attribute received, until the device says discovery is
+ *          complete. A discovery that gets no answer is dropped after
+ *          ZCL_DISCOVER_TIMEOUT and its callback called with NULL.
+ *
+ * @param   srcEP - Application's endpoint
+ * @param   dstAddr - device to discover, by short address
+ * @param   realClusterID - real cluster ID
+ * @param   maxAttrIDs - most attributes asked for in one command
+ * @param   pfnCB - called with each attribute found, then with NULL
+ *                  when the discovery is over
+ *
+ * @return  ZSuccess if OK, ZMemError if too many discoveries are running
+ */
+ZStatus_t zcl_DiscoverAllAttrs( uint8 srcEP, afAddrType_t *dstAddr, uint16 realClusterID,
+                                uint8 maxAttrIDs, zclDiscoverCB_t pfnCB )
+{
+  zclDiscoverAll_t *pDisc = NULL;
+  ZStatus_t status;
+  uint8 x;
+
+  if ( srcEP == 0 || pfnCB == NULL || maxAttrIDs == 0 || dstAddr->addrMode != afAddr16Bit )
+    return ( ZInvalidParameter ); // EMBEDDED RETURN
+
+  for ( x = 0; x < ZCL_MAX_DISCOVERIES && pDisc == NULL; x++ )
+  {
+    if ( zclDiscoverAlls[x].srcEP == 0 )
+      pDisc = &zclDiscoverAlls[x];
+  }
+  if ( pDisc == NULL )
+    return ( ZMemError ); // EMBEDDED RETURN
+
+  pDisc->srcEP = srcEP;
+  pDisc->maxAttrIDs = maxAttrIDs;
+  pDisc->clusterID = realClusterID;
+  osal_memcpy( &(pDisc->dstAddr), dstAddr, sizeof( afAddrType_t ) );
+  pDisc->pfnCB = pfnCB;
+
+  status = zclDiscoverAllSend( pDisc, 0 );
+  if ( status != ZSuccess )
+    pDisc->srcEP = 0;
+
+  return ( status );
+}
 #endif // ZCL_DISCOVER
 
 /*********************************************************************
@@ -1408,7 +1759,12 @@ static void zclProcessMessageMSG( afIncomingMSGPacket_t *pkt )
   zclErrorCmd_t errorCmd;
   ZStatus_t status = ZFailure;
 
-  if ( pkt->cmd.DataLength == 0 )
+  // The frame must at least hold the header it claims to have
+  if ( pkt->cmd.DataLength < ZCL_HDR_MIN_LEN )
+    return;   // Error, ignore the message
+
+  if ( zcl_FCManuSpecific( pkt->cmd.Data[0] ) &&
+       pkt->cmd.DataLength < (ZCL_HDR_MIN_LEN + 2) )
     return;   // Error, ignore the message
 
   // Initialize
@@ -1453,14 +1809,18 @@ static void zclProcessMessageMSG( afIncomingMSGPacket_t *pkt )
       return; 
     }
   
-    // Parse the command, remember that the return value is a pointer to allocated memory
     if ( (inMsg.hdr.commandID <= ZCL_CMD_MAX) && 
-         (zclCmdTable[inMsg.hdr.commandID].pfnParseInProfile != NULL ) )
+         (zclCmdTable[inMsg.hdr.commandID].pfnProcessInProfile != NULL ) )
     {
-      // Parse the command
-      inMsg.attrCmd = zclParseCmd( inMsg.hdr.commandID, pkt->endPoint, \
-                                   pkt->clusterId, inMsg.pDataLen, inMsg.pData );
-      if ( (inMsg.attrCmd != NULL) && (zclCmdTable[inMsg.hdr.commandID].pfnProcessInProfile != NULL) )
+      // Parse the command, remember that the return value is a pointer to allocated
+      // memory. Commands without a parse function walk their records in place.
+      if ( zclCmdTable[inMsg.hdr.commandID].pfnParseInProfile != NULL )
+      {
+        inMsg.attrCmd = zclParseCmd( inMsg.hdr.commandID, pkt->endPoint, \
+                                     pkt->clusterId, inMsg.pDataLen, inMsg.pData );
+      }
+      
+      if ( (inMsg.attrCmd != NULL) || (zclCmdTable[inMsg.hdr.commandID].pfnParseInProfile == NULL) )
       {
         // Process the command
         if ( zclProcessCmd( inMsg.hdr.commandID, &inMsg, logicalClusterID ) == FALSE )
@@ -1501,7 +1861,9 @@ static void zclProcessMessageMSG( afIncomingMSGPacket_t *pkt )
       if( !inMsg.msg->wasBroadcast && inMsg.msg->groupId == 0 )
       {
         errorCmd.commandID = inMsg.hdr.commandID;
-        if ( inMsg.hdr.fc.manuSpecific )
+        if ( status == ZCL_STATUS_MALFORMED_COMMAND )
+          errorCmd.errorCode = ZCL_STATUS_MALFORMED_COMMAND;
+        else if ( inMsg.hdr.fc.manuSpecific )
           errorCmd.errorCode = ZCL_STATUS_UNSUP_MANU_CLUSTER_COMMAND;
         else
           errorCmd.errorCode = ZCL_STATUS_UNSUP_CLUSTER_COMMAND;
@@ -1559,6 +1921,38 @@ uint8 *zclParseHdr( zclFrameHdr_t *hdr, uint8 *pData )
   return ( pData );
 }
 
+/*********************************************************************
+ * @fn      zcl_CmdPayloadOk
+ *
+ * @brief   Check that an incoming cluster specific command carries at
+ *          least the fixed part of its payload. Commands that are not in
+ *          the table have no fixed payload.
+ *
+ * @param   pInMsg - incoming message
+ * @param   logicalClusterID - logical cluster ID
+ * @param   pTable - shortest payload of each command
+ * @param   numCmds - number of entries in pTable
+ *
+ * @return  TRUE if the payload is long enough, FALSE if not
+ */
+uint8 zcl_CmdPayloadOk( zclIncoming_t *pInMsg, uint16 logicalClusterID,
+                        const zclCmdLen_t GENERIC *pTable, uint8 numCmds )
+{
+  uint8 i;
+
+  for ( i = 0; i < numCmds; i++, pTable++ )
+  {
+    if ( pTable->logicalClusterID == logicalClusterID &&
+         pTable->direction == pInMsg->hdr.fc.direction &&
+         pTable->commandID == pInMsg->hdr.commandID )
+    {
+      return ( pInMsg->pDataLen >= pTable->minLen ); // EMBEDDED RETURN
+    }
+  }
+
+  return ( TRUE );
+}
+
 /*********************************************************************
  * @fn      zclBuildHdr
  *
@@ -1630,7 +2024,7 @@ static uint8 zclCalcHdrSize( zclFrameHdr_t *hdr )
 static uint16 zclConvertClusterID( uint16 clusterID, uint16 profileID,
                                    uint8 convertToLogical )
 {
-  uint8 x;
+  uint16 x;
   zclProfileClusterConvertRec_t *pLoop;
 
   pLoop = profileClusterList;
@@ -1639,13 +2033,9 @@ static uint16 zclConvertClusterID( uint16 clusterID, uint16 profileID,
   {
     if ( pLoop->profileID == profileID )
     {
-      for ( x = 0; x < pLoop->numClusters; x++ )
-      {
-        if ( convertToLogical && pLoop->list[x].actualCluster == clusterID )
-          return ( pLoop->list[x].logicalCluster );
-        if ( !convertToLogical && pLoop->list[x].logicalCluster == clusterID )
-          return ( pLoop->list[x].actualCluster );
-      }
+      x = zclConvertFind( pLoop, clusterID, convertToLogical );
+      if ( x < pLoop->numClusters )
+        return ( CONVERT_KEY( pLoop->list, x, convertToLogical ) );
     }
     pLoop = pLoop->next;
   }
@@ -1653,6 +2043,107 @@ static uint16 zclConvertClusterID( uint16 clusterID, uint16 profileID,
   return ( (uint16)ZCL_INVALID_CLUSTER_ID );
 }
 
+/*********************************************************************
+ * @fn      zclConvertSort
+ *
+ * @brief   Sort a cluster conversion table into one of its indexes.
+ *          Entries with the same cluster ID keep their table order.
+ *
+ * @param   pItem - profile's cluster conversion table
+ * @param   index - index to fill in, numClusters entries
+ * @param   logical - TRUE to sort by logical cluster ID,
+ *                    FALSE to sort by actual cluster ID
+ *
+ * @return  none
+ */
+static void zclConvertSort( zclProfileClusterConvertRec_t *pItem, uint8 *index, uint8 logical )
+{
+  uint16 key;
+  uint8 x, y;
+
+  for ( x = 0; x < pItem->numClusters; x++ )
+  {
+    key = CONVERT_KEY( pItem->list, x, logical );
+    for ( y = x; (y > 0) && (CONVERT_KEY( pItem->list, index[y-1], logical ) > key); y-- )
+    {
+      index[y] = index[y-1];
+    }
+    index[y] = x;
+  }
+}
+
+/*********************************************************************
+ * @fn      zclConvertFind
+ *
+ * @brief   Find the entry of a cluster conversion table to convert a
+ *          cluster ID with.
+ *
+ * @param   pItem - profile's cluster conversion table
+ * @param   clusterID - cluster ID to convert from
+ * @param   convertToLogical - TRUE if clusterID is an actual cluster ID,
+ *                             FALSE if it is a logical cluster ID
+ *
+ * @return  position in the table, numClusters if not found
+ */
+static uint16 zclConvertFind( zclProfileClusterConvertRec_t *pItem, uint16 clusterID,
+                              uint8 convertToLogical )
+{
+  uint8 *index;
+  uint16 low = 0;
+  uint16 high = pItem->numClusters;
+  uint16 mid;
+
+  if ( pItem->plugins == NULL )
+  {
+    // Not indexed
+    for ( low = 0; low < pItem->numClusters; low++ )
+    {
+      if ( CONVERT_KEY( pItem->list, low, !convertToLogical ) == clusterID )
+        break;
+    }
+    return ( low ); // EMBEDDED RETURN
+  }
+
+  index = convertToLogical ? pItem->byActual : pItem->byLogical;
+  while ( low < high )
+  {
+    mid = low + ((high - low) >> 1);
+    if ( CONVERT_KEY( pItem->list, index[mid], !convertToLogical ) < clusterID )
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  if ( (low < pItem->numClusters) &&
+       (CONVERT_KEY( pItem->list, index[low], !convertToLogical ) == clusterID) )
+  {
+    return ( index[low] ); // EMBEDDED RETURN
+  }
+
+  return ( pItem->numClusters );
+}
+
+/*********************************************************************
+ * @fn      zclConvertMapPlugins
+ *
+ * @brief   Look up the plugin of every entry of an indexed cluster
+ *          conversion table.
+ *
+ * @param   pItem - profile's cluster conversion table
+ *
+ * @return  none
+ */
+static void zclConvertMapPlugins( zclProfileClusterConvertRec_t *pItem )
+{
+  uint16 x;
+
+  if ( pItem->plugins == NULL )
+    return; // EMBEDDED RETURN
+
+  for ( x = 0; x < pItem->numClusters; x++ )
+    pItem->plugins[x] = zclFindPluginRange( pItem->list[x].logicalCluster );
+}
+
 /*********************************************************************
  * @fn      zclFindPlugin
  *
@@ -1665,62 +2156,56 @@ static uint16 zclConvertClusterID( uint16 clusterID, uint16 profileID,
  */
 static zclLibPlugin_t *zclFindPlugin( uint16 realClusterID, uint16 profileID )
 {
-  zclLibPlugin_t *pLoop;
-  uint16 logicalClusterID;
+  zclProfileClusterConvertRec_t *pItem;
+  uint16 x;
 
-  logicalClusterID = zclConvertClusterID( realClusterID, profileID, TRUE );
-  if ( logicalClusterID != ZCL_INVALID_CLUSTER_ID )
+  for ( pItem = profileClusterList; pItem != NULL; pItem = pItem->next )
   {
-    pLoop = plugins;
-    while ( pLoop )
+    if ( pItem->profileID == profileID )
     {
-      if ( logicalClusterID >= pLoop->startLogCluster && logicalClusterID <= pLoop->endLogCluster )
-        return ( pLoop );
-      pLoop = pLoop->next;
+      x = zclConvertFind( pItem, realClusterID, TRUE );
+      if ( x < pItem->numClusters )
+      {
+        // Mapped when the table or the plugin was registered
+        if ( pItem->plugins )
+          return ( pItem->plugins[x] ); // EMBEDDED RETURN
+
+        return ( zclFindPluginRange( pItem->list[x].logicalCluster ) ); // EMBEDDED RETURN
+      }
     }
   }
+
   return ( (zclLibPlugin_t *)NULL );
 }
 
 /*********************************************************************
- * @fn      zclFindAttrRec
- *
- * @brief   Find the attribute record that matchs the parameters
+ * @fn      zclFindPluginRange
  *
- * @param   endpoint - Application's endpoint
- * @param   realClusterID - real cluster ID
- * @param   attr - attribute looking for
+ * @brief   Find the plugin whose range holds a LOGICAL cluster ID
  *
- * @return  pointer to attribute record, NULL if not found
+ * @param   logicalClusterID - cluster ID to look for
+ * 
+ * @return  pointer to plugin, NULL if not found
  */
-zclAttrRec_t *zclFindAttrRec( uint8 endpoint, uint16 realClusterID, uint16 attrId )
+static zclLibPlugin_t *zclFindPluginRange( uint16 logicalClusterID )
 {
-  uint8 x;
-  zclAttrRecsList *pLoop;
-
-  pLoop = attrList;
+  zclLibPlugin_t *pLoop;
 
+  pLoop = plugins;
   while ( pLoop )
   {
-    if ( pLoop->endpoint == endpoint )
-    {
-      for ( x = 0; x < pLoop->numAttributes; x++ )
-      {
-        if ( pLoop->attrs[x].clusterID == realClusterID && pLoop->attrs[x].attr.attrId == attrId )
-          return ( &(pLoop->attrs[x]) ); // EMBEDDED RETURN
-      }
-    }
+    if ( logicalClusterID >= pLoop->startLogCluster && logicalClusterID <= pLoop->endLogCluster )
+      return ( pLoop );
     pLoop = pLoop->next;
   }
 
-  return ( (zclAttrRec_t *)NULL );
+  return ( (zclLibPlugin_t *)NULL );
 }
 
-#ifdef ZCL_DISCOVER
 /*********************************************************************
- * @fn      zclFindNextAttrRec
+ * @fn      zclFindAttrRec
  *
- * @brief   Find the attribute (or next) record that matchs the parameters
+ * @brief   Find the attribute record that matchs the parameters
  *
  * @param   endpoint - Application's endpoint
  * @param   realClusterID - real cluster ID
@@ -1728,10 +2213,11 @@ zclAttrRec_t *zclFindAttrRec( uint8 endpoint, uint16 realClusterID, uint16 attrI
  *
  * @return  pointer to attribute record, NULL if not found
  */
-static zclAttrRec_t *zclFindNextAttrRec( uint8 endpoint, uint16 realClusterID, uint16 *attrId )
+const zclAttrRec_t GENERIC *zclFindAttrRec( uint8 endpoint, uint16 realClusterID, uint16 attrId )
 {
-  uint16 x;
+  uint8 x;
   zclAttrRecsList *pLoop;
+  const zclAttrRec_t GENERIC *pAttr;
 
   pLoop = attrList;
 
@@ -1739,51 +2225,223 @@ static zclAttrRec_t *zclFindNextAttrRec( uint8 endpoint, uint16 realClusterID, u
   {
     if ( pLoop->endpoint == endpoint )
     {
-      for ( x = 0; x < pLoop->numAttributes; x++ )
+      if ( pLoop->sorted )
+      {
+        x = zclFindAttrIdx( pLoop, realClusterID, attrId );
+        if ( x < pLoop->numAttributes )
+        {
+          pAttr = zclAttrRecAt( pLoop, x );
+          if ( pAttr->clusterID == realClusterID && pAttr->attr.attrId == attrId )
+            return ( pAttr ); // EMBEDDED RETURN
+        }
+      }
+      else
       {
-        if ( pLoop->attrs[x].clusterID == realClusterID && pLoop->attrs[x].attr.attrId >= *attrId )
+        for ( x = 0; x < pLoop->numAttributes; x++ )
         {
-          // Update attribute ID
-          *attrId = pLoop->attrs[x].attr.attrId;
-          return ( &(pLoop->attrs[x]) ); // EMBEDDED RETURN
+          if ( pLoop->attrs[x].clusterID == realClusterID && pLoop->attrs[x].attr.attrId == attrId )
+            return ( &(pLoop->attrs[x]) ); // EMBEDDED RETURN
         }
       }
     }
     pLoop = pLoop->next;
   }
 
-  return ( (zclAttrRec_t *)NULL );
+  return ( (const zclAttrRec_t GENERIC *)NULL );
 }
-#endif // ZCL_DISCOVER
 
-#if defined(ZCL_READ) || defined(ZCL_WRITE) || defined(ZCL_REPORT)
 /*********************************************************************
- * @fn      zclSerializeData
+ * @fn      zclAttrRecBefore
  *
- * @brief   Builds a buffer from the attribute data to sent out over
- *          the air.
+ * @brief   Compare an attribute record with a cluster and attribute ID,
+ *          in the order of the attribute index.
  *
- * @param   dataType - data types defined in zcl.h
- * @param   attrData - pointer to the attribute data
- * @param   buf - where to put the serialized data
+ * @param   pAttr - attribute record
+ * @param   realClusterID - real cluster ID
+ * @param   attrId - attribute ID
  *
- * @return  none
+ * @return  TRUE if the record sorts before the cluster and attribute ID
  */
-static void zclSerializeData( uint8 dataType, void *attrData, uint8 *buf )
+static uint8 zclAttrRecBefore( const zclAttrRec_t GENERIC *pAttr, uint16 realClusterID, uint16 attrId )
 {
-  uint8 *pStr;
-  uint8 len;
+  if ( pAttr->clusterID != realClusterID )
+    return ( pAttr->clusterID < realClusterID );
 
-  switch ( dataType )
-  {
-    case ZCL_DATATYPE_DATA8:
-    case ZCL_DATATYPE_BOOLEAN:
-    case ZCL_DATATYPE_BITMAP8:
-    case ZCL_DATATYPE_INT8:
-    case ZCL_DATATYPE_UINT8:
-    case ZCL_DATATYPE_ENUM8:
-      *buf = *((uint8 *)attrData);
-       break;
+  return ( pAttr->attr.attrId < attrId );
+}
+
+/*********************************************************************
+ * @fn      zclFindAttrIdx
+ *
+ * @brief   Binary search of a sorted attribute list.
+ *
+ * @param   pItem - attribute list in order (records or index)
+ * @param   realClusterID - real cluster ID
+ * @param   attrId - attribute looking for
+ *
+ * @return  position in the index of the first record that doesn't sort
+ *          before the cluster and attribute ID, numAttributes if none
+ */
+static uint8 zclFindAttrIdx( zclAttrRecsList *pItem, uint16 realClusterID, uint16 attrId )
+{
+  uint8 low = 0;
+  uint8 high = pItem->numAttributes;
+  uint8 mid;
+
+  while ( low < high )
+  {
+    mid = low + ((high - low) >> 1);
+    if ( zclAttrRecBefore( zclAttrRecAt( pItem, mid ), realClusterID, attrId ) )
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return ( low );
+}
+
+#ifdef ZCL_DISCOVER
+/*********************************************************************
+ * @fn      zclDiscCursorStart
+ *
+ * @brief   Start walking an endpoint's attributes of a cluster in
+ *          attribute ID order. Each sorted attribute list is positioned
+ *          once with a binary search, after that every step is O(1).
+ *
+ * @param   pCursor - cursor to start
+ * @param   endpoint - Application's endpoint
+ * @param   realClusterID - real cluster ID
+ * @param   startAttr - lowest attribute ID to return
+ *
+ * @return  none
+ */
+static void zclDiscCursorStart( zclDiscCursor_t *pCursor, uint8 endpoint,
+                                uint16 realClusterID, uint16 startAttr )
+{
+  zclAttrRecsList *pLoop;
+
+  pCursor->endpoint = endpoint;
+  pCursor->clusterID = realClusterID;
+  pCursor->nextAttr = startAttr;
+  pCursor->done = FALSE;
+
+  for ( pLoop = attrList; pLoop; pLoop = pLoop->next )
+  {
+    if ( pLoop->endpoint == endpoint && pLoop->sorted )
+      pLoop->discPos = zclFindAttrIdx( pLoop, realClusterID, startAttr );
+  }
+}
+
+/*********************************************************************
+ * @fn      zclDiscCursorNext
+ *
+ * @brief   Get the attribute with the lowest ID not returned yet. An
+ *          endpoint has one list in most cases; with several, the
+ *          lowest of their next records is taken.
+ *
+ * @param   pCursor - cursor started by zclDiscCursorStart()
+ *
+ * @return  pointer to attribute record, NULL if there are no more
+ */
+static const zclAttrRec_t GENERIC *zclDiscCursorNext( zclDiscCursor_t *pCursor )
+{
+  zclAttrRecsList *pLoop;
+  zclAttrRecsList *pNextList = NULL;
+  const zclAttrRec_t GENERIC *pAttr;
+  const zclAttrRec_t GENERIC *pNext = NULL;
+  uint8 x;
+
+  if ( pCursor->done )
+    return ( NULL ); // EMBEDDED RETURN
+
+  for ( pLoop = attrList; pLoop; pLoop = pLoop->next )
+  {
+    if ( pLoop->endpoint != pCursor->endpoint )
+      continue;
+
+    if ( pLoop->sorted )
+    {
+      // Skip what another list already returned
+      pAttr = NULL;
+      while ( pLoop->discPos < pLoop->numAttributes )
+      {
+        pAttr = zclAttrRecAt( pLoop, pLoop->discPos );
+        if ( pAttr->clusterID != pCursor->clusterID || pAttr->attr.attrId >= pCursor->nextAttr )
+          break;
+        pAttr = NULL;
+        pLoop->discPos++;
+      }
+
+      if ( pAttr && pAttr->clusterID == pCursor->clusterID
+          && (pNext == NULL || pAttr->attr.attrId < pNext->attr.attrId) )
+      {
+        pNext = pAttr;
+        pNextList = pLoop;
+      }
+    }
+    else
+    {
+      // No index (no memory), search the list
+      for ( x = 0; x < pLoop->numAttributes; x++ )
+      {
+        pAttr = &(pLoop->attrs[x]);
+        if ( pAttr->clusterID == pCursor->clusterID && pAttr->attr.attrId >= pCursor->nextAttr
+            && (pNext == NULL || pAttr->attr.attrId < pNext->attr.attrId) )
+        {
+          pNext = pAttr;
+          pNextList = NULL;
+        }
+      }
+    }
+  }
+
+  if ( pNext )
+  {
+    if ( pNextList )
+      pNextList->discPos++;
+
+    if ( pNext->attr.attrId == ZCL_ATTR_ID_MAX )
+      pCursor->done = TRUE;
+    else
+      pCursor->nextAttr = pNext->attr.attrId + 1;
+  }
+  else
+  {
+    pCursor->done = TRUE;
+  }
+
+  return ( pNext );
+}
+#endif // ZCL_DISCOVER
+
+#if defined(ZCL_READ) || defined(ZCL_WRITE) || defined(ZCL_REPORT)
+/*********************************************************************
+ * @fn      zclSerializeData
+ *
+ * @brief   Builds a buffer from the attribute data to sent out over
+ *          the air.
+ *
+ * @param   dataType - data types defined in zcl.h
+ * @param   attrData - pointer to the attribute data
+ * @param   buf - where to put the serialized data
+ *
+ * @return  none
+ */
+static void zclSerializeData( uint8 dataType, void *attrData, uint8 *buf )
+{
+  uint8 *pStr;
+  uint8 len;
+
+  switch ( dataType )
+  {
+    case ZCL_DATATYPE_DATA8:
+    case ZCL_DATATYPE_BOOLEAN:
+    case ZCL_DATATYPE_BITMAP8:
+    case ZCL_DATATYPE_INT8:
+    case ZCL_DATATYPE_UINT8:
+    case ZCL_DATATYPE_ENUM8:
+      *buf = *((uint8 *)attrData);
+       break;
 
     case ZCL_DATATYPE_DATA16:
     case ZCL_DATATYPE_BITMAP16:
@@ -2035,6 +2693,42 @@ static uint8 zclGetAttrDataLength( uint8  dataType, uint8 *pData)
   return ( dataLen );
 }
 
+/*********************************************************************
+ * @fn      zclFrameDataLength
+ *
+ * @brief   Return the length of attribute data in a received frame,
+ *          making sure all of it is there.
+ *
+ * @param   dataType - data type
+ * @param   pBuf - attribute data in the frame
+ * @param   pEnd - end of the frame
+ * @param   pLen - where to put the data length
+ *
+ * @return  TRUE if the data is all there, FALSE if truncated
+ */
+static uint8 zclFrameDataLength( uint8 dataType, uint8 *pBuf, uint8 *pEnd, uint8 *pLen )
+{
+  uint16 len;
+
+  if ( dataType == ZCL_DATATYPE_CHAR_STR || dataType == ZCL_DATATYPE_OCTET_STR )
+  {
+    if ( pBuf >= pEnd )
+      return ( FALSE ); // EMBEDDED RETURN
+    len = (uint16)(*pBuf) + 1; // string length + 1 for length field
+  }
+  else
+  {
+    len = zclGetDataTypeLength( dataType );
+  }
+
+  if ( pBuf > pEnd || len > (uint16)(pEnd - pBuf) )
+    return ( FALSE ); // EMBEDDED RETURN
+
+  *pLen = (uint8)len;
+
+  return ( TRUE );
+}
+
 /*********************************************************************
  * @fn      zclReadAttrData
  *
@@ -2045,7 +2739,7 @@ static uint8 zclGetAttrDataLength( uint8  dataType, uint8 *pData)
  *
  * @return Success
  */
-uint8 zclReadAttrData( uint8 *pAttrData, zclAttrRec_t *pAttr )
+uint8 zclReadAttrData( uint8 *pAttrData, const zclAttrRec_t GENERIC *pAttr )
 {
   uint8 dataLen;
     
@@ -2066,7 +2760,7 @@ uint8 zclReadAttrData( uint8 *pAttrData, zclAttrRec_t *pAttr )
  *
  * @return  Successful if data was written
  */
-static uint8 zclWriteAttrData( zclAttrRec_t *pAttr, zclWriteRec_t *pWriteRec )
+static uint8 zclWriteAttrData( const zclAttrRec_t GENERIC *pAttr, zclWriteRec_t *pWriteRec )
 {
   uint8 len;
 
@@ -2081,6 +2775,247 @@ static uint8 zclWriteAttrData( zclAttrRec_t *pAttr, zclWriteRec_t *pWriteRec )
 }
 #endif // ZCL_WRITE
 
+/*********************************************************************
+ * @fn      zclAttrIterInit
+ *
+ * @brief   Start walking the attribute records of an incoming "Profile"
+ *          command. The records are read straight out of the frame, so
+ *          nothing is allocated; the iterator is only good for as long
+ *          as the incoming message is.
+ *
+ * @param   pIter - iterator to initialize
+ * @param   pInMsg - incoming message, header already parsed
+ *
+ * @return  none
+ */
+void zclAttrIterInit( zclAttrIter_t *pIter, zclIncoming_t *pInMsg )
+{
+  pIter->pInMsg = pInMsg;
+  pIter->pBuf = pInMsg->pData;
+  pIter->pEnd = pInMsg->pData + pInMsg->pDataLen;
+
+  switch ( pInMsg->hdr.commandID )
+  {
+    case ZCL_CMD_ERROR:
+    case ZCL_CMD_DISCOVER:
+      // No attribute records
+      pIter->pBuf = pIter->pEnd;
+      break;
+
+    case ZCL_CMD_DISCOVER_RSP:
+      // Move pass the Discovery Complete field
+      if ( pIter->pBuf < pIter->pEnd )
+        pIter->pBuf++;
+      break;
+
+    default:
+      if ( pInMsg->hdr.commandID > ZCL_CMD_MAX )
+        pIter->pBuf = pIter->pEnd;
+      break;
+  }
+}
+
+/*********************************************************************
+ * @fn      zclAttrIterNext
+ *
+ * @brief   Get the next attribute record of the command. Every field is
+ *          checked against the end of the frame and a truncated record
+ *          ends the walk.
+ *
+ *          Write, Report and Configure Reporting records take the length
+ *          of their data from the local attribute. If that attribute is
+ *          unknown, the record comes back with status set to
+ *          ZCL_STATUS_UNSUPPORTED_ATTRIBUTE and the walk ends there.
+ *
+ *          A Write or Configure Reporting Response holding only a SUCCESS
+ *          status comes back as one record with attrID ZCL_ATTR_ID_MAX.
+ *
+ * @param   pIter - iterator
+ * @param   pRec - where to put the record
+ *
+ * @return  TRUE if a record was returned, FALSE if there are no more
+ */
+uint8 zclAttrIterNext( zclAttrIter_t *pIter, zclAttrIterRec_t *pRec )
+{
+  zclIncoming_t *pInMsg = pIter->pInMsg;
+  const zclAttrRec_t GENERIC *pAttr;
+  uint8 *pBuf = pIter->pBuf;
+  uint8 *pEnd = pIter->pEnd;
+  uint8 cmd = pInMsg->hdr.commandID;
+  uint8 ok = TRUE;
+
+  if ( pBuf >= pEnd )
+    return ( FALSE ); // EMBEDDED RETURN
+
+  osal_memset( pRec, 0, sizeof( zclAttrIterRec_t ) );
+
+  // These responses have the Status field ahead of the attribute ID
+  if ( cmd == ZCL_CMD_WRITE_RSP || cmd == ZCL_CMD_CONFIG_REPORT_RSP ||
+       cmd == ZCL_CMD_READ_REPORT_CFG_RSP )
+  {
+    pRec->status = *pBuf++;
+    if ( (pBuf == pEnd) && (cmd != ZCL_CMD_READ_REPORT_CFG_RSP) )
+    {
+      // All records were successful, the attribute ID is omitted
+      pRec->attrID = ZCL_ATTR_ID_MAX;
+      pIter->pBuf = pEnd;
+      return ( TRUE ); // EMBEDDED RETURN
+    }
+  }
+
+  if ( (pBuf + 2) > pEnd )
+  {
+    pIter->pBuf = pEnd;
+    return ( FALSE ); // EMBEDDED RETURN
+  }
+  pRec->attrID = BUILD_UINT16( pBuf[0], pBuf[1] );
+  pBuf += 2;
+
+  switch ( cmd )
+  {
+    case ZCL_CMD_READ_RSP:
+      ok = ( pBuf < pEnd );
+      if ( ok )
+        pRec->status = *pBuf++;
+      if ( ok && (pRec->status == ZCL_STATUS_SUCCESS) )
+      {
+        ok = ( pBuf < pEnd );
+        if ( ok )
+        {
+          pRec->dataType = *pBuf++;
+          ok = zclAttrIterData( pRec, pBuf, pEnd );
+          pBuf += pRec->dataLen;
+        }
+      }
+      break;
+
+    case ZCL_CMD_WRITE:
+    case ZCL_CMD_WRITE_UNDIVIDED:
+    case ZCL_CMD_WRITE_NO_RSP:
+    case ZCL_CMD_REPORT:
+      pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, pRec->attrID );
+      if ( pAttr == NULL )
+      {
+        // The length of the data field for the unsupported attribute is
+        // unknown -- nothing further can be walked
+        pRec->status = ZCL_STATUS_UNSUPPORTED_ATTRIBUTE;
+        pBuf = pEnd;
+      }
+      else
+      {
+        pRec->dataType = pAttr->attr.dataType;
+        ok = zclAttrIterData( pRec, pBuf, pEnd );
+        pBuf += pRec->dataLen;
+      }
+      break;
+
+#ifdef ZCL_REPORT
+    case ZCL_CMD_CONFIG_REPORT:
+      ok = ( pBuf < pEnd );
+      if ( ok )
+        pRec->direction = *pBuf++;
+      if ( ok && (pRec->direction != SEND_ATTR_REPORTS) )
+      {
+        // Attribute reports to be received
+        ok = ( (pBuf + 2) <= pEnd );
+        if ( ok )
+        {
+          pRec->timeoutPeriod = BUILD_UINT16( pBuf[0], pBuf[1] );
+          pBuf += 2;
+        }
+        break;
+      }
+      // Fall through - Min and Max Reporting Intervals and Reportable Change
+      // are laid out as in the Read Reporting Configuration Response
+
+    case ZCL_CMD_READ_REPORT_CFG_RSP:
+      if ( !ok || (pRec->status != ZCL_STATUS_SUCCESS) )
+        break;
+
+      ok = ( (pBuf + 4) <= pEnd );
+      if ( ok )
+      {
+        pRec->minReportInt = BUILD_UINT16( pBuf[0], pBuf[1] );
+        pRec->maxReportInt = BUILD_UINT16( pBuf[2], pBuf[3] );
+        pBuf += 4;
+
+        pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, pRec->attrID );
+        if ( pAttr == NULL )
+        {
+          // The length of the Reportable Change field for the unsupported
+          // attribute is unknown -- nothing further can be walked
+          pRec->status = ZCL_STATUS_UNSUPPORTED_ATTRIBUTE;
+          pBuf = pEnd;
+          break;
+        }
+
+        // For attributes of 'discrete' data types this field is omitted
+        pRec->dataType = pAttr->attr.dataType;
+        if ( zclAnalogDataType( pAttr->attr.dataType ) )
+        {
+          pRec->dataLen = zclGetDataTypeLength( pAttr->attr.dataType );
+          pRec->attrData = pBuf;
+          ok = ( (pBuf + pRec->dataLen) <= pEnd );
+          pBuf += pRec->dataLen;
+        }
+
+        if ( ok && (cmd == ZCL_CMD_READ_REPORT_CFG_RSP) )
+        {
+          ok = ( (pBuf + 2) <= pEnd );
+          if ( ok )
+          {
+            pRec->timeoutPeriod = BUILD_UINT16( pBuf[0], pBuf[1] );
+            pBuf += 2;
+          }
+        }
+      }
+      break;
+#endif // ZCL_REPORT
+
+    case ZCL_CMD_DISCOVER_RSP:
+      ok = ( pBuf < pEnd );
+      if ( ok )
+        pRec->dataType = *pBuf++;
+      break;
+
+    default:
+      // Attribute ID (and Status) only
+      break;
+  }
+
+  if ( !ok )
+  {
+    // Truncated record
+    pIter->pBuf = pEnd;
+    return ( FALSE ); // EMBEDDED RETURN
+  }
+
+  pIter->pBuf = pBuf;
+
+  return ( TRUE );
+}
+
+/*********************************************************************
+ * @fn      zclAttrIterData
+ *
+ * @brief   Point an iterator record at its attribute data.
+ *
+ * @param   pRec - record, with the data type filled in
+ * @param   pBuf - attribute data in the frame
+ * @param   pEnd - end of the frame
+ *
+ * @return  TRUE if the data is all there, FALSE if truncated
+ */
+static uint8 zclAttrIterData( zclAttrIterRec_t *pRec, uint8 *pBuf, uint8 *pEnd )
+{
+  if ( zclFrameDataLength( pRec->dataType, pBuf, pEnd, &(pRec->dataLen) ) == FALSE )
+    return ( FALSE ); // EMBEDDED RETURN
+
+  pRec->attrData = pBuf;
+
+  return ( TRUE );
+}
+
 #ifdef ZCL_READ
 /*********************************************************************
  * @fn      zclParseInReadCmd
@@ -2132,36 +3067,45 @@ void *zclParseInReadCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, ui
  *
  * @return  pointer to the parsed command structure
  */
-static void *zclParseInReadRspCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, uint8 *pData )
+void *zclParseInReadRspCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, uint8 *pData )
 {
   zclReadRspCmd_t *readRspCmd;
   zclReadRspStatus_t *statusRec;
   uint8 *pBuf = pData;
+  uint8 *pEnd = pData + dataLen;
   uint8 attrDataLen = 0;
   
-  readRspCmd = (zclReadRspCmd_t *)osal_mem_alloc( sizeof ( zclReadRspCmd_t ) + dataLen );
+  // A failed record is only 3 bytes long in the frame, but takes up a
+  // whole status record once parsed
+  readRspCmd = (zclReadRspCmd_t *)osal_mem_alloc( sizeof ( zclReadRspCmd_t ) + dataLen +
+                   (dataLen / 3) * (sizeof ( zclReadRspStatus_t ) - 3) );
   if ( readRspCmd )
   {
     readRspCmd->numAttr = 0;
     statusRec = readRspCmd->attrList;
-    while ( pBuf < ( pData + dataLen ) )
+    while ( (pEnd - pBuf) >= 3 ) // Attr ID + Status
     {
-      readRspCmd->numAttr++;
-
       statusRec->attrID = BUILD_UINT16( pBuf[0], pBuf[1] );
       pBuf += 2;
       statusRec->status = *pBuf++;
       
       if ( statusRec->status == ZCL_STATUS_SUCCESS )
       {
+        if ( pBuf >= pEnd )
+          break; // Truncated record
+
         statusRec->dataType = *pBuf++;
 
-        attrDataLen = zclGetAttrDataLength( statusRec->dataType, pBuf );
+        if ( zclFrameDataLength( statusRec->dataType, pBuf, pEnd, &attrDataLen ) == FALSE )
+          break; // Truncated record
+
         osal_memcpy( statusRec->data, pBuf, attrDataLen);
         pBuf += attrDataLen; // move pass attribute data
       }
       else
         attrDataLen = 0;
+
+      readRspCmd->numAttr++;
       statusRec = NEXT_READ_RSP(statusRec, attrDataLen);
     }
   }
@@ -2192,7 +3136,8 @@ void *zclParseInWriteCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, u
   zclWriteCmd_t *writeCmd;
   zclWriteRec_t *statusRec;
   uint8 *pBuf = pData;
-  zclAttrRec_t *pAttr;
+  uint8 *pEnd = pData + dataLen;
+  const zclAttrRec_t GENERIC *pAttr;
   uint8 attrDataLen;
   
   writeCmd = (zclWriteCmd_t *)osal_mem_alloc( sizeof ( zclWriteCmd_t ) + dataLen );
@@ -2200,7 +3145,7 @@ void *zclParseInWriteCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, u
   {
     writeCmd->numAttr = 0;
     statusRec = writeCmd->attrList;
-    while ( pBuf < ( pData + dataLen ) )
+    while ( (pEnd - pBuf) >= 2 ) // Attr ID
     {
       writeCmd->numAttr++; 
       
@@ -2214,7 +3159,12 @@ void *zclParseInWriteCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, u
         // the length of the data field for the unsupported attribute is unknown)
         break;
       }
-      attrDataLen = zclGetAttrDataLength( pAttr->attr.dataType, pBuf );
+
+      if ( zclFrameDataLength( pAttr->attr.dataType, pBuf, pEnd, &attrDataLen ) == FALSE )
+      {
+        writeCmd->numAttr--; // Truncated record
+        break;
+      }
       osal_memcpy( statusRec->attrData, pBuf, attrDataLen );
       pBuf += attrDataLen; // move pass attribute data
       statusRec = NEXT_WRITE( statusRec, attrDataLen );
@@ -2239,24 +3189,22 @@ void *zclParseInWriteCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, u
  *
  * @return  pointer to the parsed command structure
  */
-static void *zclParseInWriteRspCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, uint8 *pData )
+void *zclParseInWriteRspCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, uint8 *pData )
 {
   zclWriteRspCmd_t *writeRspCmd;
-  uint8 *pBuf = pData;
-  uint8 i = 0;
+  uint8 i;
 
   writeRspCmd = (zclWriteRspCmd_t *)osal_mem_alloc( sizeof ( zclWriteRspCmd_t ) + \
-                                            dataLen / sizeof ( zclWriteRspStatus_t ) );
+                                  (dataLen / 3) * sizeof ( zclWriteRspStatus_t ) );
   if ( writeRspCmd )
   {
-    while ( pBuf < ( pData + dataLen ) )
+    writeRspCmd->numAttr = dataLen / 3; // Status + Attr ID
+    for ( i = 0; i < writeRspCmd->numAttr; i++ )
     {
-      writeRspCmd->attrList[i].status = *pBuf++;
-      writeRspCmd->attrList[i++].attrID = BUILD_UINT16( pBuf[0], pBuf[1] );
-      pBuf += 2;
+      writeRspCmd->attrList[i].status = *pData++;
+      writeRspCmd->attrList[i].attrID = BUILD_UINT16( pData[0], pData[1] );
+      pData += 2;
     }
-    
-    writeRspCmd->numAttr = i; 
   }
 
   return ( (void *)writeRspCmd );
@@ -2285,13 +3233,14 @@ void *zclParseInConfigReportCmd( uint8 endpoint, uint16 realClusterID,
   zclCfgReportCmd_t *cfgReportCmd;
   zclCfgReportRec_t *reportRec;
   uint8 *pBuf = pData;
-  zclAttrRec_t *pAttr;
+  uint8 *pEnd = pData + dataLen;
+  const zclAttrRec_t GENERIC *pAttr;
   uint16 attrID;
   uint8 len = sizeof ( zclCfgReportCmd_t );
   uint8 reportChangeLen; // length of Reportable Change field
   
   // Calculate the length of the Request command
-  while ( pBuf < ( pData + dataLen ) )
+  while ( (pEnd - pBuf) >= 3 ) // Attr ID + Direction
   {
     len += sizeof ( zclCfgReportRec_t );
     
@@ -2301,6 +3250,9 @@ void *zclParseInConfigReportCmd( uint8 endpoint, uint16 realClusterID,
     // Is there a Reportable Change field?
     if ( *pBuf++ == SEND_ATTR_REPORTS )
     {
+      if ( (pEnd - pBuf) < 4 )
+        break; // Truncated record
+
       pBuf += 4; // move pass the Min and Max Reporting Intervals
       
       pAttr = zclFindAttrRec( endpoint, realClusterID, attrID );
@@ -2316,12 +3268,18 @@ void *zclParseInConfigReportCmd( uint8 endpoint, uint16 realClusterID,
       if ( zclAnalogDataType( pAttr->attr.dataType ) )
       {
         reportChangeLen = zclGetDataTypeLength( pAttr->attr.dataType );
+        if ( (pEnd - pBuf) < reportChangeLen )
+          break; // Truncated record
+
         pBuf += reportChangeLen;
         len += reportChangeLen;
       }
     }
     else
     {
+      if ( (pEnd - pBuf) < 2 )
+        break; // Truncated record
+
       pBuf += 2; // move pass the Timeout Period
     }
   } // while loop
@@ -2332,7 +3290,7 @@ void *zclParseInConfigReportCmd( uint8 endpoint, uint16 realClusterID,
     pBuf = pData;
     cfgReportCmd->numAttr = 0;
     reportRec = cfgReportCmd->attrList;
-    while ( pBuf < ( pData + dataLen ) )
+    while ( (pEnd - pBuf) >= 3 ) // Attr ID + Direction
     {
       cfgReportCmd->numAttr++; 
       reportChangeLen = 0; 
@@ -2344,6 +3302,12 @@ void *zclParseInConfigReportCmd( uint8 endpoint, uint16 realClusterID,
       reportRec->direction = *pBuf++;
       if ( reportRec->direction == SEND_ATTR_REPORTS )
       {
+        if ( (pEnd - pBuf) < 4 )
+        {
+          cfgReportCmd->numAttr--; // Truncated record
+          break;
+        }
+
         // Attribute to be reported
         reportRec->minReportInt = BUILD_UINT16( pBuf[0], pBuf[1] );
         pBuf += 2;
@@ -2362,13 +3326,25 @@ void *zclParseInConfigReportCmd( uint8 endpoint, uint16 realClusterID,
         // For attributes of 'discrete' data types this field is omitted
         if ( zclAnalogDataType( pAttr->attr.dataType ) )
         {
-          zcl_BuildAnalogData( pAttr->attr.dataType, reportRec->reportableChange, pBuf);
           reportChangeLen = zclGetDataTypeLength( pAttr->attr.dataType );
+          if ( (pEnd - pBuf) < reportChangeLen )
+          {
+            cfgReportCmd->numAttr--; // Truncated record
+            break;
+          }
+
+          zcl_BuildAnalogData( pAttr->attr.dataType, reportRec->reportableChange, pBuf);
           pBuf += reportChangeLen;
         }
       }
       else
       {
+        if ( (pEnd - pBuf) < 2 )
+        {
+          cfgReportCmd->numAttr--; // Truncated record
+          break;
+        }
+
         // Attribute reports to be received
         reportRec->timeoutPeriod = BUILD_UINT16( pBuf[0], pBuf[1] );
         pBuf += 2;
@@ -2395,8 +3371,8 @@ void *zclParseInConfigReportCmd( uint8 endpoint, uint16 realClusterID,
  *
  * @return  pointer to the parsed command structure
  */
-static void *zclParseInConfigReportRspCmd( uint8 endpoint, uint16 realClusterID, 
-                                           uint8 dataLen, uint8 *pData )
+void *zclParseInConfigReportRspCmd( uint8 endpoint, uint16 realClusterID, 
+                                    uint8 dataLen, uint8 *pData )
 {
   zclCfgReportRspCmd_t *cfgReportRspCmd;
   uint8 i; 
@@ -2405,7 +3381,7 @@ static void *zclParseInConfigReportRspCmd( uint8 endpoint, uint16 realClusterID,
                                                             dataLen );
   if ( cfgReportRspCmd )
   {
-    cfgReportRspCmd->numAttr = dataLen / sizeof ( zclCfgReportStatus_t );
+    cfgReportRspCmd->numAttr = dataLen / 3; // Status + Attr ID
     for ( i = 0; i < cfgReportRspCmd->numAttr; i++ )
     {
       cfgReportRspCmd->attrList[i].status = *pData++;
@@ -2468,29 +3444,40 @@ void *zclParseInReadReportCfgCmd( uint8 endpoint, uint16 realClusterID,
  *
  * @return  pointer to the parsed command structure
  */
-static void *zclParseInReadReportCfgRspCmd( uint8 endpoint, uint16 realClusterID, 
-                                            uint8 dataLen, uint8 *pData )
+void *zclParseInReadReportCfgRspCmd( uint8 endpoint, uint16 realClusterID, 
+                                     uint8 dataLen, uint8 *pData )
 {
   zclReadReportCfgRspCmd_t *readReportCfgRspCmd;
   zclReportCfgRspRec_t *reportRspRec;
   uint8 reportChangeLen;
   uint8 len = sizeof ( zclReadReportCfgRspCmd_t );
   uint8 *pBuf = pData;
-  zclAttrRec_t *pAttr;
+  uint8 *pEnd = pData + dataLen;
+  const zclAttrRec_t GENERIC *pAttr;
   uint16 attrID;
+  uint8 status;
   
   // Calculate the length of the response command
-  while ( pBuf < ( pData + dataLen ) )
+  while ( (pEnd - pBuf) >= 3 ) // Status + Attr ID
   {
     len += sizeof ( zclReportCfgRspRec_t );
     
-    pBuf++; // move pass the Status field
+    status = *pBuf++;
     attrID = BUILD_UINT16( pBuf[0], pBuf[1] );
-    pBuf += 6; // move pass the attribute ID + Min + Max Reporting Intervals
-    
-    // Find out the length of the Reportable Change field
-    pAttr = zclFindAttrRec( endpoint, realClusterID, attrID );
-    if ( pAttr == NULL )
+    pBuf += 2; // move pass the attribute ID
+
+    // A failed record carries no configuration
+    if ( status != ZCL_STATUS_SUCCESS )
+      continue;
+
+    if ( (pEnd - pBuf) < 4 )
+      break; // Truncated record
+
+    pBuf += 4; // move pass the Min and Max Reporting Intervals
+    
+    // Find out the length of the Reportable Change field
+    pAttr = zclFindAttrRec( endpoint, realClusterID, attrID );
+    if ( pAttr == NULL )
     {
       // Attribute is not supported -- do not process any further configure  
       // reporting records (because the length of the Reportable Change 
@@ -2499,12 +3486,15 @@ static void *zclParseInReadReportCfgRspCmd( uint8 endpoint, uint16 realClusterID
     }
         
     // For attributes of 'discrete' data types this field is omitted
+    reportChangeLen = 0;
     if ( zclAnalogDataType( pAttr->attr.dataType ) )
-    {
       reportChangeLen = zclGetDataTypeLength( pAttr->attr.dataType );
-      pBuf += reportChangeLen;
-      len += reportChangeLen;
-    }
+
+    if ( (pEnd - pBuf) < (reportChangeLen + 2) )
+      break; // Truncated record
+
+    pBuf += reportChangeLen;
+    len += reportChangeLen;
     pBuf += 2; // move pass the Timeout field
   } // while loop
   
@@ -2514,7 +3504,7 @@ static void *zclParseInReadReportCfgRspCmd( uint8 endpoint, uint16 realClusterID
     pBuf = pData;
     readReportCfgRspCmd->numAttr = 0;
     reportRspRec = readReportCfgRspCmd->attrList;
-    while ( pBuf < ( pData + dataLen ) )
+    while ( (pEnd - pBuf) >= 3 ) // Status + Attr ID
     {
       reportChangeLen = 0;
       readReportCfgRspCmd->numAttr++;
@@ -2525,6 +3515,12 @@ static void *zclParseInReadReportCfgRspCmd( uint8 endpoint, uint16 realClusterID
  
       if ( reportRspRec->status == ZCL_STATUS_SUCCESS )
       {
+        if ( (pEnd - pBuf) < 4 )
+        {
+          readReportCfgRspCmd->numAttr--; // Truncated record
+          break;
+        }
+
         reportRspRec->minReportInt = BUILD_UINT16( pBuf[0], pBuf[1] );
         pBuf += 2;
         reportRspRec->maxReportInt = BUILD_UINT16( pBuf[0], pBuf[1] );
@@ -2541,9 +3537,17 @@ static void *zclParseInReadReportCfgRspCmd( uint8 endpoint, uint16 realClusterID
         }
         
         if ( zclAnalogDataType( pAttr->attr.dataType ) )
+          reportChangeLen = zclGetDataTypeLength( pAttr->attr.dataType ); 
+
+        if ( (pEnd - pBuf) < (reportChangeLen + 2) )
+        {
+          readReportCfgRspCmd->numAttr--; // Truncated record
+          break;
+        }
+
+        if ( reportChangeLen > 0 )
         {
           zcl_BuildAnalogData( pAttr->attr.dataType, reportRspRec->reportableChange, pBuf);
-          reportChangeLen = zclGetDataTypeLength( pAttr->attr.dataType ); 
           pBuf += reportChangeLen;
         }
  
@@ -2577,7 +3581,8 @@ void *zclParseInReportCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen,
   zclReportCmd_t *reportCmd;
   zclReport_t *reportRec;
   uint8 *pBuf = pData;
-  zclAttrRec_t *pAttr;
+  uint8 *pEnd = pData + dataLen;
+  const zclAttrRec_t GENERIC *pAttr;
   uint8 attrDataLen;
   
   reportCmd = (zclReportCmd_t *)osal_mem_alloc( sizeof (zclReportCmd_t) + dataLen );
@@ -2585,7 +3590,7 @@ void *zclParseInReportCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen,
   {
     reportCmd->numAttr = 0;
     reportRec = reportCmd->attrList;
-    while ( pBuf < ( pData + dataLen ) )
+    while ( (pEnd - pBuf) >= 2 ) // Attr ID
     {
       reportCmd->numAttr++;
       
@@ -2601,7 +3606,11 @@ void *zclParseInReportCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen,
         break;
       }
       
-      attrDataLen = zclGetAttrDataLength( pAttr->attr.dataType, pBuf );  
+      if ( zclFrameDataLength( pAttr->attr.dataType, pBuf, pEnd, &attrDataLen ) == FALSE )
+      {
+        reportCmd->numAttr--; // Truncated record
+        break;
+      }
       osal_memcpy( reportRec->attrData, pBuf, attrDataLen );
       pBuf += attrDataLen; // move pass attribute data
       reportRec = NEXT_REPORT( reportRec, attrDataLen );
@@ -2627,10 +3636,13 @@ void *zclParseInReportCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen,
  *
  * @return  pointer to the parsed command structure
  */
-static void *zclParseInErrorCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, uint8 *pData )
+void *zclParseInErrorCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, uint8 *pData )
 {
   zclErrorCmd_t *errorCmd;
 
+  if ( dataLen < 2 ) // Command ID + Error Code
+    return ( NULL ); // EMBEDDED RETURN
+
   errorCmd = (zclErrorCmd_t *)osal_mem_alloc( sizeof ( zclErrorCmd_t ) );
   if ( errorCmd )
   {
@@ -2661,6 +3673,9 @@ void *zclParseInDiscCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, ui
 {
   zclDiscoverCmd_t *discoverCmd;
 
+  if ( dataLen < 3 ) // Start Attr ID + Max Attr IDs
+    return ( NULL ); // EMBEDDED RETURN
+
   discoverCmd = (zclDiscoverCmd_t *)osal_mem_alloc( sizeof ( zclDiscoverCmd_t ) );
   if ( discoverCmd )
   {
@@ -2688,11 +3703,14 @@ void *zclParseInDiscCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, ui
  * @return  pointer to the parsed command structure
  */
 #define ZCLDISCRSPCMD_DATALEN(a)  (a-1) // data len - Discovery Complete
-static void *zclParseInDiscRspCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, uint8 *pData )
+void *zclParseInDiscRspCmd( uint8 endpoint, uint16 realClusterID, uint8 dataLen, uint8 *pData )
 {
   zclDiscoverRspCmd_t *discoverRspCmd;
   uint8 i;
 
+  if ( dataLen < 1 ) // Discovery Complete
+    return ( NULL ); // EMBEDDED RETURN
+
   discoverRspCmd = (zclDiscoverRspCmd_t *)osal_mem_alloc( sizeof ( zclDiscoverRspCmd_t ) \
                                                  + ZCLDISCRSPCMD_DATALEN(dataLen) );
   if ( discoverRspCmd )
@@ -2726,60 +3744,118 @@ static void *zclParseInDiscRspCmd( uint8 endpoint, uint16 realClusterID, uint8 d
  */
 static uint8 zclProcessInReadCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID )
 {
-  zclReadCmd_t *readCmd;
-  zclReadRspCmd_t *readRspCmd;
-  zclReadRspStatus_t *statusRec;
-  zclAttrRec_t *pAttr;
+  zclAttrIter_t iter;
+  zclAttrIterRec_t rec;
+  endPointDesc_t *epDesc;
+  afDataReqMTU_t mtu;
+  zclFrameHdr_t hdr;
+  const zclAttrRec_t GENERIC *pAttr;
+  uint8 *buf;
+  uint8 *pBuf;
+  uint8 *pEnd;
+  uint8 *pPayload;
+  uint8 maxLen;
   uint8 dataLen;
-  uint8 len = sizeof( zclReadRspCmd_t );
-  uint8 i;
-  
-  readCmd = (zclReadCmd_t *)pInMsg->attrCmd;
+  uint8 status;
   
-  // calculate the length of the response status record
-  for (i = 0; i < readCmd->numAttr; i++)
-  {
-    len += sizeof (zclReadRspStatus_t);
+  epDesc = afFindEndPointDesc( pInMsg->msg->endPoint );
+  if ( epDesc == NULL )
+    return FALSE; // EMBEDDED RETURN
 
-    // Get Attribute Data length
-    pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, readCmd->attrID[i] );
-    if ( pAttr ) 
-      len += zclGetAttrDataLength( pAttr->attr.dataType, (uint8*)(pAttr->attr.dataPtr) );
-  } 
-  
-  readRspCmd = osal_mem_alloc( len );
-  if ( readRspCmd == NULL )
+  if ( zcl_DeviceOperational( pInMsg->msg->endPoint, pInMsg->msg->clusterId,
+                              ZCL_FRAME_TYPE_PROFILE_CMD, ZCL_CMD_READ_RSP ) == FALSE )
+    return TRUE; // EMBEDDED RETURN
+
+  osal_memset( &hdr, 0, sizeof( zclFrameHdr_t ) );
+  hdr.fc.type = ZCL_FRAME_TYPE_PROFILE_CMD;
+  hdr.fc.direction = ZCL_FRAME_SERVER_CLIENT_DIR;
+  hdr.transSeqNum = pInMsg->hdr.transSeqNum;
+  hdr.commandID = ZCL_CMD_READ_RSP;
+
+  // The response is serialized straight from the attribute storage into
+  // one frame sized buffer, header included. Whatever doesn't fit goes
+  // out in further Read Responses.
+  mtu.kvp = FALSE;
+  mtu.aps.secure = FALSE;
+  maxLen = afDataReqMTU( &mtu );
+
+  buf = osal_mem_alloc( maxLen );
+  if ( buf == NULL )
     return FALSE; // EMBEDDED RETURN
 
-  statusRec = readRspCmd->attrList;
-  readRspCmd->numAttr = readCmd->numAttr;
-  for (i = 0; i < readCmd->numAttr; i++)
+  pEnd = buf + maxLen;
+  pPayload = zclBuildHdr( &hdr, buf );
+  pBuf = pPayload;
+
+  zclAttrIterInit( &iter, pInMsg );
+  while ( zclAttrIterNext( &iter, &rec ) )
   {
-    statusRec->attrID = readCmd->attrID[i];
-    
-    pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, readCmd->attrID[i] );
+    pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, rec.attrID );
     if ( pAttr )
     {
-      statusRec->status = zclReadAttrData( statusRec->data, pAttr );
-      statusRec->dataType = pAttr->attr.dataType;
+      status = ZCL_STATUS_SUCCESS;
       dataLen = zclGetAttrDataLength( pAttr->attr.dataType, (uint8*)(pAttr->attr.dataPtr) );
+
+      // Would never fit, even in a response of its own
+      if ( (pPayload + 2 + 1 + 1 + dataLen) > pEnd )
+        status = ZCL_STATUS_INSUFFICIENT_SPACE;
     }
     else
     {
-      statusRec->status = ZCL_STATUS_UNSUPPORTED_ATTRIBUTE;
+      status = ZCL_STATUS_UNSUPPORTED_ATTRIBUTE;
+    }
+
+    if ( status != ZCL_STATUS_SUCCESS )
       dataLen = 0;
+
+    // Attribute ID + Status (+ Data Type + Data)
+    if ( (pBuf + 2 + 1 + ((status == ZCL_STATUS_SUCCESS) ? 1 + dataLen : 0)) > pEnd )
+    {
+      zclSendReadRspFrame( pInMsg, epDesc, (uint8)(pBuf - buf), buf );
+      pBuf = pPayload;
+    }
+
+    *pBuf++ = LO_UINT16( rec.attrID );
+    *pBuf++ = HI_UINT16( rec.attrID );
+    *pBuf++ = status;
+
+    if ( status == ZCL_STATUS_SUCCESS )
+    {
+      *pBuf++ = pAttr->attr.dataType;
+      zclSerializeData( pAttr->attr.dataType, pAttr->attr.dataPtr, pBuf );
+      pBuf += dataLen; // move pass attribute data
     }
-    statusRec = NEXT_READ_RSP(statusRec, dataLen);
   }
   
-  // Build and send Read Response command
-  zcl_SendReadRsp( pInMsg->msg->endPoint, &(pInMsg->msg->srcAddr), pInMsg->msg->clusterId,
-                   readRspCmd, ZCL_FRAME_SERVER_CLIENT_DIR, pInMsg->hdr.transSeqNum );
-  osal_mem_free( readRspCmd );
+  zclSendReadRspFrame( pInMsg, epDesc, (uint8)(pBuf - buf), buf );
+  osal_mem_free( buf );
     
   return TRUE;
 }
 
+/*********************************************************************
+ * @fn      zclSendReadRspFrame
+ *
+ * @brief   Send a Read Response frame built by zclProcessInReadCmd.
+ *
+ * @param   pInMsg - incoming Read command
+ * @param   epDesc - Application's endpoint
+ * @param   len - frame length, ZCL header included
+ * @param   buf - frame
+ *
+ * @return  none
+ */
+static void zclSendReadRspFrame( zclIncoming_t *pInMsg, endPointDesc_t *epDesc,
+                                 uint8 len, uint8 *buf )
+{
+  afAddrType_t dstAddr;
+
+  osal_memcpy( &dstAddr, &(pInMsg->msg->srcAddr), sizeof ( afAddrType_t ) );
+
+  AF_DataRequest( &dstAddr, epDesc, pInMsg->msg->clusterId, len, buf,
+                  &zcl_TransID, AF_MSG_ACK_REQUEST, AF_DEFAULT_RADIUS );
+}
+
 /*********************************************************************
  * @fn      zclProcessInReadRspCmd
  *
@@ -2792,11 +3868,11 @@ static uint8 zclProcessInReadCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID
  */
 static uint8 zclProcessInReadRspCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID )
 {
-  zclReadRspCmd_t *readRspCmd;
-  uint8 i;
+  zclAttrIter_t iter;
+  zclAttrIterRec_t rec;
 
-  readRspCmd = (zclReadRspCmd_t *)pInMsg->attrCmd;
-  for (i = 0; i < readRspCmd->numAttr; i++)
+  zclAttrIterInit( &iter, pInMsg );
+  while ( zclAttrIterNext( &iter, &rec ) )
   {
     // Notify the originator of the results of the original read attributes 
     // attempt and, for each successfull request, the value of the requested 
@@ -2824,8 +3900,9 @@ static uint8 zclProcessInWriteCmd( zclIncoming_t *pInMsg, uint16 logicalClusterI
   zclWriteCmd_t *writeCmd;
   zclWriteRec_t *statusRec;
   zclWriteRspCmd_t *writeRspCmd;
-  zclAttrRec_t *pAttr;
+  const zclAttrRec_t GENERIC *pAttr;
   uint8 sendRsp = FALSE;
+  uint8 numRsp;
   uint8 dataLen;
   uint8 status;
   uint8 i, j = 0;
@@ -2833,9 +3910,14 @@ static uint8 zclProcessInWriteCmd( zclIncoming_t *pInMsg, uint16 logicalClusterI
   writeCmd = (zclWriteCmd_t *)pInMsg->attrCmd;
   if ( pInMsg->hdr.commandID == ZCL_CMD_WRITE )
   {
+    // Room for a status record per write record, and at least one
+    numRsp = writeCmd->numAttr;
+    if ( numRsp == 0 )
+      numRsp = 1;
+    
     // We need to send a response back - allocate space for it
     writeRspCmd = (zclWriteRspCmd_t *)osal_mem_alloc( sizeof( zclWriteRspCmd_t ) + \
-                            sizeof( zclWriteRspStatus_t )* writeCmd->numAttr );
+                            sizeof( zclWriteRspStatus_t )* numRsp );
     if ( writeRspCmd == NULL )
       return FALSE; // EMBEDDED RETURN
     sendRsp = TRUE;
@@ -2852,6 +3934,11 @@ static uint8 zclProcessInWriteCmd( zclIncoming_t *pInMsg, uint16 logicalClusterI
       else
         status = zclWriteAttrData( pAttr, statusRec );
 
+#ifdef ZCL_REPORT
+      if ( status == ZCL_STATUS_SUCCESS )
+        zclReportAttrChanged( pAttr );
+#endif // ZCL_REPORT
+
       // If successful, a write attribute status record shall NOT be generated
       if ( sendRsp && status != ZCL_STATUS_SUCCESS )
       {
@@ -2910,7 +3997,7 @@ static void zclRevertWriteUndividedCmd( zclIncoming_t *pInMsg,
                                     zclWriteRec_t *curWriteRec, uint16 numAttr )
 {
   zclWriteRec_t *statusRec;
-  zclAttrRec_t *pAttr;
+  const zclAttrRec_t GENERIC *pAttr;
   uint8 dataLen;
   uint8 i;
 
@@ -2948,17 +4035,23 @@ static uint8 zclProcessInWriteUndividedCmd( zclIncoming_t *pInMsg, uint16 logica
   zclWriteRec_t *curWriteRec;
   zclWriteRec_t *curStatusRec;
   zclWriteRspCmd_t *writeRspCmd;
-  zclAttrRec_t *pAttr;
+  const zclAttrRec_t GENERIC *pAttr;
   uint8 dataLen;
-  uint8 curLen;
+  uint16 curLen = 0;
+  uint8 numRsp;
   uint8 status;
   uint8 i, j = 0;
 
   writeCmd = (zclWriteCmd_t *)pInMsg->attrCmd;
   
+  // Room for a status record per write record, and at least one
+  numRsp = writeCmd->numAttr;
+  if ( numRsp == 0 )
+    numRsp = 1;
+  
   // Allocate space for Write Response Command
   writeRspCmd = (zclWriteRspCmd_t *)osal_mem_alloc( sizeof( zclWriteRspCmd_t ) + \
-                                sizeof( zclWriteRspStatus_t )* writeCmd->numAttr );
+                                sizeof( zclWriteRspStatus_t )* numRsp );
   if ( writeRspCmd == NULL )
     return FALSE; // EMBEDDED RETURN
   
@@ -3015,6 +4108,12 @@ static uint8 zclProcessInWriteUndividedCmd( zclIncoming_t *pInMsg, uint16 logica
         status = pAttr->pfnWrtHdlr( pInMsg, logicalClusterID, statusRec );
       else
         status = zclWriteAttrData( pAttr, statusRec );
+
+#ifdef ZCL_REPORT
+      // A write undone below is caught by the value compare
+      if ( status == ZCL_STATUS_SUCCESS )
+        zclReportAttrChanged( pAttr );
+#endif // ZCL_REPORT
          
       // If successful, a write attribute status record shall NOT be generated
       if ( status != ZCL_STATUS_SUCCESS )
@@ -3064,11 +4163,11 @@ static uint8 zclProcessInWriteUndividedCmd( zclIncoming_t *pInMsg, uint16 logica
  */
 static uint8 zclProcessInWriteRspCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID )
 {
-  zclWriteRspCmd_t *writeRspCmd;
-  uint8 i;
+  zclAttrIter_t iter;
+  zclAttrIterRec_t rec;
 
-  writeRspCmd = (zclWriteRspCmd_t *)pInMsg->attrCmd;
-  for (i = 0; i < writeRspCmd->numAttr; i++)
+  zclAttrIterInit( &iter, pInMsg );
+  while ( zclAttrIterNext( &iter, &rec ) )
   {
     // Notify the device of the results of the its original write attributes
     // command.
@@ -3092,47 +4191,50 @@ static uint8 zclProcessInWriteRspCmd( zclIncoming_t *pInMsg, uint16 logicalClust
  */
 static uint8 zclProcessInConfigReportCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID )
 {
-  zclCfgReportCmd_t *cfgReportCmd;
-  zclCfgReportRec_t *reportRec;
+  zclAttrIter_t iter;
+  zclAttrIterRec_t rec;
   zclCfgReportRspCmd_t *cfgReportRspCmd;
-  zclAttrRec_t *pAttr;
-  uint8 reportChangeLen; // length of Reportable Change field
+  const zclAttrRec_t GENERIC *pAttr;
+  uint8 numAttr;
   uint8 status;
-  uint8 i, j = 0;
+  uint8 j = 0;
   
-  cfgReportCmd = (zclCfgReportCmd_t *)pInMsg->attrCmd;
+  // Room for a status record per configuration record, and at least one
+  numAttr = zclAttrIterCount( pInMsg );
+  if ( numAttr == 0 )
+    numAttr = 1;
   
   // Allocate space for the response command
   cfgReportRspCmd = (zclCfgReportRspCmd_t *)osal_mem_alloc( sizeof ( zclCfgReportRspCmd_t ) + \
-                                        sizeof ( zclCfgReportStatus_t) * cfgReportCmd->numAttr );
+                                        sizeof ( zclCfgReportStatus_t) * numAttr );
   if ( cfgReportRspCmd == NULL )
     return FALSE; // EMBEDDED RETURN
   
   // Process each Attribute Reporting Configuration record
-  reportRec = cfgReportCmd->attrList;
-  for ( i = 0; i < cfgReportCmd->numAttr; i++ )
+  zclAttrIterInit( &iter, pInMsg );
+  while ( zclAttrIterNext( &iter, &rec ) )
   {
-    pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, reportRec->attrID );
+    pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, rec.attrID );
     if ( pAttr == NULL )
     {
       // Attribute is not supported -- do not process any further configure  
       // reporting records (because the length of the Reportable Change 
       // field for the unsupported attribute is unknown).
       cfgReportRspCmd->attrList[j].status = ZCL_STATUS_UNSUPPORTED_ATTRIBUTE;
-      cfgReportRspCmd->attrList[j++].attrID = reportRec->attrID;
+      cfgReportRspCmd->attrList[j++].attrID = rec.attrID;
       break;
     }
     
-    reportChangeLen = 0;
     status = ZCL_STATUS_SUCCESS;
-    if ( reportRec->direction == SEND_ATTR_REPORTS )
+    if ( rec.direction == SEND_ATTR_REPORTS )
     {
       // This the attribute that is to be reported
-      if ( zcl_MandatoryReportableAttribute( pAttr ) == TRUE )
+      if ( zcl_MandatoryReportableAttribute( pAttr ) )
       {
-        if ( reportRec->minReportInt < ZCL_MIN_REPORTING_INTERVAL ||
-             ( reportRec->maxReportInt != 0 && 
-               reportRec->maxReportInt < reportRec->minReportInt ) )
+        if ( rec.maxReportInt != ZCL_REPORT_STOP &&
+             ( rec.minReportInt < ZCL_MIN_REPORTING_INTERVAL ||
+               ( rec.maxReportInt != 0 && 
+                 rec.maxReportInt < rec.minReportInt ) ) )
         {
           // Invalid fields
           status = ZCL_STATUS_INVALID_VALUE;
@@ -3140,8 +4242,7 @@ static uint8 zclProcessInConfigReportCmd( zclIncoming_t *pInMsg, uint16 logicalC
         else
         {
           // Set the Min and Max Reporting Intervals and Reportable Change
-          //status = zclSetAttrReportInterval( pAttr, cfgReportCmd );
-          status = ZCL_STATUS_UNREPORTABLE_ATTRIBUTE; // for now
+          status = zclReportSetCfg( pInMsg, &rec, pAttr );
         }
       }
       else
@@ -3149,14 +4250,11 @@ static uint8 zclProcessInConfigReportCmd( zclIncoming_t *pInMsg, uint16 logicalC
         // Attribute cannot be reported
         status = ZCL_STATUS_UNREPORTABLE_ATTRIBUTE;
       }
-
-      if ( zclAnalogDataType( pAttr->attr.dataType ) )
-        reportChangeLen = zclGetDataTypeLength( pAttr->attr.dataType );
     }
     else
     {
       // We shall expect reports of values of this attribute
-      if ( zcl_MandatoryReportableAttribute( pAttr ) == TRUE )
+      if ( zcl_MandatoryReportableAttribute( pAttr ) )
       {    
         // Set the Timeout Period
         //status = zclSetAttrTimeoutPeriod( pAttr, cfgReportCmd );
@@ -3173,11 +4271,9 @@ static uint8 zclProcessInConfigReportCmd( zclIncoming_t *pInMsg, uint16 logicalC
     if ( status != ZCL_STATUS_SUCCESS )
     {
       cfgReportRspCmd->attrList[j].status = status;
-      cfgReportRspCmd->attrList[j++].attrID = reportRec->attrID;
+      cfgReportRspCmd->attrList[j++].attrID = rec.attrID;
     }
-    
-    reportRec = NEXT_CFG_REPORT( reportRec, reportChangeLen );
-  } // for loop
+  } // while loop
   
   cfgReportRspCmd->numAttr = j;
   if ( cfgReportRspCmd->numAttr == 0 )
@@ -3210,15 +4306,14 @@ static uint8 zclProcessInConfigReportCmd( zclIncoming_t *pInMsg, uint16 logicalC
  */
 static uint8 zclProcessInConfigReportRspCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID )
 {
-  zclCfgReportRspCmd_t *cfgReportRspCmd;
-  zclAttrRec_t *pAttr;
-  uint8 i;
+  zclAttrIter_t iter;
+  zclAttrIterRec_t rec;
+  const zclAttrRec_t GENERIC *pAttr;
 
-  cfgReportRspCmd = (zclCfgReportRspCmd_t *)pInMsg->attrCmd;
-  for (i = 0; i < cfgReportRspCmd->numAttr; i++)
+  zclAttrIterInit( &iter, pInMsg );
+  while ( zclAttrIterNext( &iter, &rec ) )
   {
-    pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, 
-                            cfgReportRspCmd->attrList[i].attrID );
+    pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, rec.attrID );
     if ( pAttr )
     {
       // Notify the device of success (or otherwise) of the its original configure
@@ -3241,26 +4336,29 @@ static uint8 zclProcessInConfigReportRspCmd( zclIncoming_t *pInMsg, uint16 logic
  */
 static uint8 zclProcessInReadReportCfgCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID )
 {
-  zclReadReportCfgCmd_t *readReportCfgCmd;
+  zclAttrIter_t iter;
+  zclAttrIterRec_t rec;
   zclReadReportCfgRspCmd_t *readReportCfgRspCmd;
   zclReportCfgRspRec_t *reportRspRec;
-  zclAttrRec_t *pAttr;
+  const zclAttrRec_t GENERIC *pAttr;
+  afDataReqMTU_t mtu;
   uint8 reportChangeLen;
-  uint8 rspLen = sizeof ( zclReadReportCfgRspCmd_t );
+  uint16 rspLen = sizeof ( zclReadReportCfgRspCmd_t );
+  uint8 maxLen;
+  uint8 frameLen = 0;
+  uint8 recLen;
   uint8 status;
-  uint8 i;
+  uint8 x;
   
-  readReportCfgCmd = (zclReadReportCfgCmd_t *)pInMsg->attrCmd;
-
   // Find out the response length (Reportable Change field is of variable length)
-  for ( i = 0; i < readReportCfgCmd->numAttr; i++ )
+  zclAttrIterInit( &iter, pInMsg );
+  while ( zclAttrIterNext( &iter, &rec ) )
   {
-    reportChangeLen = 0;
     rspLen += sizeof ( zclReportCfgRspRec_t );
 
     // For supported attributes with 'analog' data type, find out the length of 
     // the Reportable Change field
-    pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, readReportCfgCmd->attrID[i] );
+    pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, rec.attrID );
     if ( pAttr && zclAnalogDataType( pAttr->attr.dataType ) )
       rspLen += zclGetDataTypeLength( pAttr->attr.dataType );
   }
@@ -3270,24 +4368,46 @@ static uint8 zclProcessInReadReportCfgCmd( zclIncoming_t *pInMsg, uint16 logical
   if ( readReportCfgRspCmd == NULL )
     return FALSE; // EMBEDDED RETURN
   
+  // Room for records in a response frame. Whatever doesn't fit goes out
+  // in further responses.
+  mtu.kvp = FALSE;
+  mtu.aps.secure = FALSE;
+  maxLen = afDataReqMTU( &mtu ) - ZCL_HDR_MIN_LEN;
+
   readReportCfgRspCmd->numAttr = 0;
   reportRspRec = readReportCfgRspCmd->attrList; 
-  for (i = 0; i < readReportCfgCmd->numAttr; i++)
+  zclAttrIterInit( &iter, pInMsg );
+  while ( zclAttrIterNext( &iter, &rec ) )
   {
     readReportCfgRspCmd->numAttr++;
     reportChangeLen = 0;
 
-    pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, 
-                            readReportCfgCmd->attrID[i] );
+    pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, rec.attrID );
     if ( pAttr != NULL )
     {
-      if ( zcl_MandatoryReportableAttribute(pAttr ) == TRUE )
+      if ( zcl_MandatoryReportableAttribute( pAttr ) )
       {
         // Get the Reporting Configuration
-        // status = zclReadReportCfg( readReportCfgCmd->attrID[i], reportRspRec );
-        status = ZCL_STATUS_UNREPORTABLE_ATTRIBUTE; // for now
-        if ( status == ZCL_STATUS_SUCCESS && zclAnalogDataType( pAttr->attr.dataType ) )
-          reportChangeLen = zclGetDataTypeLength( pAttr->attr.dataType );
+        x = zclReportFindCfg( pInMsg->msg->endPoint, pInMsg->msg->clusterId, rec.attrID );
+        if ( x < ZCL_MAX_REPORT_CFGS )
+        {
+          status = ZCL_STATUS_SUCCESS;
+          reportRspRec->minReportInt = zclReportCfgs[x].cfg.minReportInt;
+          reportRspRec->maxReportInt = zclReportCfgs[x].cfg.maxReportInt;
+          reportRspRec->timeoutPeriod = 0;
+          if ( zclAnalogDataType( pAttr->attr.dataType ) )
+          {
+            // Kept as received, the response wants it in native form
+            reportChangeLen = zclGetDataTypeLength( pAttr->attr.dataType );
+            zcl_BuildAnalogData( pAttr->attr.dataType, reportRspRec->reportableChange,
+                                 zclReportCfgs[x].cfg.reportableChange );
+          }
+        }
+        else
+        {
+          // Reporting isn't configured for this attribute
+          status = ZCL_STATUS_NOT_FOUND;
+        }
       }
       else
       {
@@ -3302,7 +4422,26 @@ static uint8 zclProcessInReadReportCfgCmd( zclIncoming_t *pInMsg, uint16 logical
     }
                   
     reportRspRec->status = status;
-    reportRspRec->attrID = readReportCfgCmd->attrID[i];
+    reportRspRec->attrID = rec.attrID;
+
+    // Status + Attribute ID (+ Intervals + Timeout Period + Reportable Change)
+    recLen = 1 + 2 + ((status == ZCL_STATUS_SUCCESS) ? 6 + reportChangeLen : 0);
+    if ( (frameLen + recLen) > maxLen && readReportCfgRspCmd->numAttr > 1 )
+    {
+      // Send the records before this one, then start over with it
+      readReportCfgRspCmd->numAttr--;
+      zcl_SendReadReportCfgRspCmd( pInMsg->msg->endPoint, &pInMsg->msg->srcAddr, 
+                                   pInMsg->msg->clusterId, readReportCfgRspCmd, 
+                                   ZCL_FRAME_SERVER_CLIENT_DIR, pInMsg->hdr.transSeqNum );
+
+      osal_memcpy( readReportCfgRspCmd->attrList, reportRspRec,
+                   sizeof ( zclReportCfgRspRec_t ) + reportChangeLen );
+      reportRspRec = readReportCfgRspCmd->attrList;
+      readReportCfgRspCmd->numAttr = 1;
+      frameLen = 0;
+    }
+    frameLen += recLen;
+
     reportRspRec = NEXT_REPORT_RSP( reportRspRec, reportChangeLen );
   }
 
@@ -3327,33 +4466,22 @@ static uint8 zclProcessInReadReportCfgCmd( zclIncoming_t *pInMsg, uint16 logical
  */
 static uint8 zclProcessInReadReportCfgRspCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID)
 {
-  zclReadReportCfgRspCmd_t *readReportCfgRspCmd;
-  zclReportCfgRspRec_t *reportRspRec;
-  uint8 reportChangeLen;
-  zclAttrRec_t *pAttr;
-  uint8 i;
+  zclAttrIter_t iter;
+  zclAttrIterRec_t rec;
 
-  readReportCfgRspCmd = (zclReadReportCfgRspCmd_t *)pInMsg->attrCmd;
-  reportRspRec = readReportCfgRspCmd->attrList;
-  for ( i = 0; i < readReportCfgRspCmd->numAttr; i++ )
+  zclAttrIterInit( &iter, pInMsg );
+  while ( zclAttrIterNext( &iter, &rec ) )
   {
-    pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, reportRspRec->attrID );
-    if ( pAttr == NULL )
+    if ( rec.status == ZCL_STATUS_UNSUPPORTED_ATTRIBUTE )
     {
-      // Attribute is not supported -- do not process any further configure  
-      // reporting records (because the length of the Reportable Change 
-      // field for the unsupported attribute is unknown).
+      // Attribute is not supported -- no further configure reporting records
+      // (because the length of the Reportable Change field for the
+      // unsupported attribute is unknown).
       break;
     }
     
     // Notify the device of the results of the its original read reporting
     // configuration command.
-      
-    if ( zclAnalogDataType( pAttr->attr.dataType ) )
-      reportChangeLen = zclGetDataTypeLength( pAttr->attr.dataType );
-    else
-      reportChangeLen = 0;
-    reportRspRec = NEXT_REPORT_RSP( reportRspRec, reportChangeLen );
   }
 
   return TRUE;   
@@ -3371,143 +4499,1244 @@ static uint8 zclProcessInReadReportCfgRspCmd( zclIncoming_t *pInMsg, uint16 logi
  */
 static uint8 zclProcessInReportCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID )
 {
-  zclReportCmd_t *reportCmd;
-  zclReport_t *reportRec;
-  uint8 dataLen;
-  zclAttrRec_t *pAttr;
-  uint8 i;
+  zclAttrIter_t iter;
+  zclAttrIterRec_t rec;
 
-  reportCmd = (zclReportCmd_t *)pInMsg->attrCmd;
-  reportRec = reportCmd->attrList;
-  for (i = 0; i < reportCmd->numAttr; i++)
+  zclAttrIterInit( &iter, pInMsg );
+  while ( zclAttrIterNext( &iter, &rec ) )
   {    
-    pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, reportRec->attrID );
-    if ( pAttr == NULL )
+    if ( rec.status == ZCL_STATUS_UNSUPPORTED_ATTRIBUTE )
     {
-      // Attribute is not supported -- do not process any further report  
-      // records (because the length of the Data field for the unsupported
-      // attribute is unknown).
+      // Attribute is not supported -- no further report records (because 
+      // the length of the Data field for the unsupported attribute is 
+      // unknown).
       break;
     }
     
     // Device is notified of the latest values of the attribute of another device.
-      
-    dataLen = zclGetAttrDataLength( pAttr->attr.dataType, reportRec->attrData );  
-    reportRec = NEXT_REPORT( reportRec, dataLen );
   }
 
   return TRUE;   
 }
-#endif // ZCL_REPORT
 
 /*********************************************************************
- * @fn      zclProcessInErrorCmd
+ * @fn      zclAttrIterCount
  *
- * @brief   Process the "Profile" Error Command
+ * @brief   Count the attribute records of an incoming "Profile" command.
  *
- * @param   pInMsg - incoming message to process
- * @param   logicalClusterID - logical cluster ID
+ * @param   pInMsg - incoming message
  *
- * @return  none
+ * @return  number of records
  */
-static uint8 zclProcessInErrorCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID )
+static uint8 zclAttrIterCount( zclIncoming_t *pInMsg )
 {
-  // zclErrorCmd_t *errorCmd = (zclErrorCmd_t *)pInMsg->attrCmd;
-   
-  // Device is notified of the command error.
+  zclAttrIter_t iter;
+  zclAttrIterRec_t rec;
+  uint8 count = 0;
 
-  return TRUE; 
+  zclAttrIterInit( &iter, pInMsg );
+  while ( zclAttrIterNext( &iter, &rec ) )
+    count++;
+
+  return ( count );
 }
 
-#ifdef ZCL_DISCOVER
 /*********************************************************************
- * @fn      zclProcessInDiscCmd
+ * @fn      zclReportInit
  *
- * @brief   Process the "Profile" Discover Command
+ * @brief   Initialize the reporting engine and restore the reporting
+ *          configurations from NV.
  *
- * @param   pInMsg - incoming message to process
- * @param   logicalClusterID - logical cluster ID
+ * @param   none
  *
  * @return  none
  */
-static uint8 zclProcessInDiscCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID )
+static void zclReportInit( void )
 {
-  zclDiscoverCmd_t *discoverCmd;
-  zclDiscoverRspCmd_t *discoverRspCmd;
-  uint8 discComplete = TRUE;
-  zclAttrRec_t *pAttr;
-  uint16 attrID;
-  uint8 i;
-  
-  discoverCmd = (zclDiscoverCmd_t *)pInMsg->attrCmd;
-  
-  // Find out the number of attributes supported within the specified range
-  for ( i = 0, attrID = discoverCmd->startAttr; i < discoverCmd->maxAttrIDs; i++, attrID++ )
+  osal_memset( zclReportCfgs, 0, sizeof( zclReportCfgs ) );
+  zclReportSeqNum = 0;
+
+  zclReportInitNV();
+  zclReportRestoreFromNV();
+
+  zclReportSchedule();
+}
+
+/*********************************************************************
+ * @fn      zclReportFindCfg
+ *
+ * @brief   Find the reporting configuration of an attribute
+ *
+ * @param   endpoint - Application's endpoint
+ * @param   realClusterID - real cluster ID
+ * @param   attrId - attribute ID
+ *
+ * @return  index in zclReportCfgs, ZCL_MAX_REPORT_CFGS if not found
+ */
+static uint8 zclReportFindCfg( uint8 endpoint, uint16 realClusterID, uint16 attrId )
+{
+  uint8 x;
+
+  for ( x = 0; x < ZCL_MAX_REPORT_CFGS; x++ )
   {
-    if ( zclFindNextAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, &attrID ) == NULL )
+    if ( zclReportCfgs[x].cfg.endpoint == endpoint &&
+         zclReportCfgs[x].cfg.clusterID == realClusterID &&
+         zclReportCfgs[x].cfg.attrID == attrId )
       break;
   }
-  
-  // Allocate space for the response command
-  discoverRspCmd = (zclDiscoverRspCmd_t *)osal_mem_alloc( sizeof (zclDiscoverRspCmd_t) + \
-                                                          sizeof ( zclDiscoverInfo_t ) * i );
-  if ( discoverRspCmd == NULL )
-    return FALSE; // EMEDDED RETURN
-  
-  discoverRspCmd->numAttr = i;
-  if ( discoverRspCmd->numAttr != 0 )
+
+  return ( x );
+}
+
+/*********************************************************************
+ * @fn      zclReportSetCfg
+ *
+ * @brief   Add, change or (Maximum Reporting Interval of ZCL_REPORT_STOP)
+ *          remove the reporting configuration of an attribute. Reports
+ *          are sent to the device that configured them.
+ *
+ * @param   pInMsg - incoming Configure Reporting command
+ * @param   reportRec - configuration record
+ * @param   pAttr - attribute to report
+ * @param   reportChangeLen - length of the Reportable Change field
+ *
+ * @return  ZCL_STATUS_SUCCESS, ZCL_STATUS_INSUFFICIENT_SPACE if the
+ *          table is full
+ */
+static uint8 zclReportSetCfg( zclIncoming_t *pInMsg, zclAttrIterRec_t *pRec,
+                              const zclAttrRec_t GENERIC *pAttr )
+{
+  zclReportCfg_t *pCfg;
+  uint8 x;
+
+  x = zclReportFindCfg( pInMsg->msg->endPoint, pInMsg->msg->clusterId, pRec->attrID );
+
+  if ( pRec->maxReportInt == ZCL_REPORT_STOP )
   {
-    for ( i = 0, attrID = discoverCmd->startAttr; i < discoverRspCmd->numAttr; i++, attrID++ )
+    if ( x < ZCL_MAX_REPORT_CFGS )
     {
-      pAttr = zclFindNextAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, &attrID );
-      if ( pAttr == NULL )
-      {
-        // Attribute not supported
-        break;
-      }
-      
-      discoverRspCmd->attrList[i].attrID = pAttr->attr.attrId;
-      discoverRspCmd->attrList[i].dataType = pAttr->attr.dataType;
+      osal_memset( &zclReportCfgs[x], 0, sizeof( zclReportCfg_t ) );
+      zclReportWriteNV( x );
+      zclReportSchedule();
     }
-    
-    // Are there more attributes to be discovered?
-    if ( zclFindNextAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, &attrID ) != NULL )
-      discComplete = FALSE;
+    return ( ZCL_STATUS_SUCCESS ); // EMBEDDED RETURN
   }
-  
-  discoverRspCmd->discComplete = discComplete;
-  zcl_SendDiscoverRspCmd( pInMsg->msg->endPoint, &pInMsg->msg->srcAddr, 
-                          pInMsg->msg->clusterId, discoverRspCmd, 
-                          ZCL_FRAME_SERVER_CLIENT_DIR, pInMsg->hdr.transSeqNum );
-  osal_mem_free( discoverRspCmd );
-  
-  return TRUE;
+
+  if ( x == ZCL_MAX_REPORT_CFGS )
+  {
+    // Look for a free entry
+    x = zclReportFindCfg( 0, 0, 0 );
+    if ( x == ZCL_MAX_REPORT_CFGS )
+      return ( ZCL_STATUS_INSUFFICIENT_SPACE ); // EMBEDDED RETURN
+  }
+
+  pCfg = &zclReportCfgs[x];
+  osal_memset( pCfg, 0, sizeof( zclReportCfg_t ) );
+  pCfg->cfg.endpoint = pInMsg->msg->endPoint;
+  pCfg->cfg.dstEP = pInMsg->msg->srcAddr.endPoint;
+  pCfg->cfg.dstAddr = pInMsg->msg->srcAddr.addr.shortAddr;
+  pCfg->cfg.clusterID = pInMsg->msg->clusterId;
+  pCfg->cfg.attrID = pRec->attrID;
+  pCfg->cfg.minReportInt = pRec->minReportInt;
+  pCfg->cfg.maxReportInt = pRec->maxReportInt;
+  if ( pRec->dataLen <= ZCL_REPORT_VALUE_LEN )
+    osal_memcpy( pCfg->cfg.reportableChange, pRec->attrData, pRec->dataLen );
+  pCfg->pAttr = pAttr;
+
+  // Report the current value once the Minimum Reporting Interval is over
+  pCfg->lastReport = osal_GetSystemClock();
+  pCfg->flags = ZCL_REPORT_PENDING;
+
+  zclReportWriteNV( x );
+  zclReportSchedule();
+
+  return ( ZCL_STATUS_SUCCESS );
 }
 
 /*********************************************************************
- * @fn      zclProcessInDiscRspCmd
+ * @fn      zclReportGetAttr
  *
- * @brief   Process the "Profile" Discover Response Command
+ * @brief   Get the attribute record of a reporting configuration
  *
- * @param   pInMsg - incoming message to process
- * @param   logicalClusterID - logical cluster ID
+ * @param   pCfg - reporting configuration
+ *
+ * @return  pointer to attribute record, NULL if not registered (yet)
+ */
+static const zclAttrRec_t GENERIC *zclReportGetAttr( zclReportCfg_t *pCfg )
+{
+  if ( pCfg->pAttr == NULL )
+    pCfg->pAttr = zclFindAttrRec( pCfg->cfg.endpoint, pCfg->cfg.clusterID, pCfg->cfg.attrID );
+
+  return ( pCfg->pAttr );
+}
+
+/*********************************************************************
+ * @fn      zclReportAttrChanged
+ *
+ * @brief   Check the reporting configurations of an attribute that may
+ *          have changed, and schedule a report if it changed enough.
+ *
+ * @param   pAttr - attribute record
  *
  * @return  none
  */
-static uint8 zclProcessInDiscRspCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID )
+static void zclReportAttrChanged( const zclAttrRec_t GENERIC *pAttr )
 {
-  zclDiscoverRspCmd_t *discoverRspCmd;
-  uint8 i;
-  
-  discoverRspCmd = (zclDiscoverRspCmd_t *)pInMsg->attrCmd;
-  for ( i = 0; i < discoverRspCmd->numAttr; i++ )
+  zclReportCfg_t *pCfg;
+  uint8 changed = FALSE;
+  uint8 x;
+
+  for ( x = 0; x < ZCL_MAX_REPORT_CFGS; x++ )
   {
-    // Device is notified of the result of its attribute discovery command.
+    pCfg = &zclReportCfgs[x];
+    if ( pCfg->cfg.endpoint == 0 || (pCfg->flags & ZCL_REPORT_PENDING) ||
+         zclReportGetAttr( pCfg ) != pAttr )
+      continue;
+
+    // Values that can't be compared count as changed
+    if ( zclReportValueLen( pAttr->attr.dataType ) == 0 ||
+         zclReportValueChanged( pCfg, pAttr ) )
+    {
+      pCfg->flags |= ZCL_REPORT_PENDING;
+      changed = TRUE;
+    }
   }
-  
-  return TRUE;
+
+  if ( changed )
+    zclReportSchedule();
 }
-#endif // ZCL_DISCOVER
+
+/*********************************************************************
+ * @fn      zclReportValueChanged
+ *
+ * @brief   Compare an attribute's value with the value last reported.
+ *
+ * @param   pCfg - reporting configuration
+ * @param   pAttr - attribute record
+ *
+ * @return  TRUE if the value changed by at least the Reportable Change
+ *          (analog types) or at all (discrete types)
+ */
+static uint8 zclReportValueChanged( zclReportCfg_t *pCfg, const zclAttrRec_t GENERIC *pAttr )
+{
+  uint8 value[ZCL_REPORT_VALUE_LEN];
+  uint32 newValue;
+  uint32 oldValue;
+  uint32 delta;
+  uint8 len;
+  uint8 x;
+
+  len = zclReportValueLen( pAttr->attr.dataType );
+  if ( len == 0 )
+    return ( FALSE ); // EMBEDDED RETURN
+
+  if ( !(pCfg->flags & ZCL_REPORT_VALUE_VALID) )
+    return ( TRUE ); // EMBEDDED RETURN
+
+  // Compare the serialized values, they are independent of the CPU
+  zclSerializeData( pAttr->attr.dataType, pAttr->attr.dataPtr, value );
+  for ( x = 0; x < len && value[x] == pCfg->lastValue[x]; x++ )
+    ;
+  if ( x == len )
+    return ( FALSE ); // EMBEDDED RETURN
+
+  newValue = zclReportBuildValue( value, len );
+  oldValue = zclReportBuildValue( pCfg->lastValue, len );
+
+  switch ( pAttr->attr.dataType )
+  {
+    case ZCL_DATATYPE_UINT8:
+    case ZCL_DATATYPE_UINT16:
+    case ZCL_DATATYPE_UINT24:
+    case ZCL_DATATYPE_UINT32:
+      delta = (newValue > oldValue) ? (newValue - oldValue) : (oldValue - newValue);
+      break;
+
+    case ZCL_DATATYPE_INT8:
+    case ZCL_DATATYPE_INT16:
+    case ZCL_DATATYPE_INT24:
+    case ZCL_DATATYPE_INT32:
+      // Sign extend
+      if ( len < 4 && (newValue & ((uint32)1 << ((len * 8) - 1))) )
+        newValue |= ~(((uint32)1 << (len * 8)) - 1);
+      if ( len < 4 && (oldValue & ((uint32)1 << ((len * 8) - 1))) )
+        oldValue |= ~(((uint32)1 << (len * 8)) - 1);
+      delta = ((int32)newValue > (int32)oldValue) ? (newValue - oldValue) : (oldValue - newValue);
+      break;
+
+    default:
+      // Discrete, or analog types we can't subtract
+      return ( TRUE ); // EMBEDDED RETURN
+  }
+
+  return ( delta >= zclReportBuildValue( pCfg->cfg.reportableChange, len ) );
+}
+
+/*********************************************************************
+ * @fn      zclReportValueLen
+ *
+ * @brief   Length of the attribute values the engine can compare.
+ *
+ * @param   dataType - attribute data type
+ *
+ * @return  serialized length, 0 if the values aren't compared
+ */
+static uint8 zclReportValueLen( uint8 dataType )
+{
+  uint8 len;
+
+  // Double precision isn't serialized
+  if ( dataType == ZCL_DATATYPE_DOUBLE_PREC )
+    return ( 0 ); // EMBEDDED RETURN
+
+  len = zclGetDataTypeLength( dataType );
+  if ( len > ZCL_REPORT_VALUE_LEN )
+    len = 0;
+
+  return ( len );
+}
+
+/*********************************************************************
+ * @fn      zclReportBuildValue
+ *
+ * @brief   Build an unsigned value from serialized (LSB first) data.
+ *
+ * @param   pData - serialized data
+ * @param   len - length, up to 4
+ *
+ * @return  value
+ */
+static uint32 zclReportBuildValue( uint8 *pData, uint8 len )
+{
+  uint32 value = 0;
+
+  if ( len > 4 )
+    len = 4;
+
+  while ( len-- )
+    value = (value << 8) | pData[len];
+
+  return ( value );
+}
+
+/*********************************************************************
+ * @fn      zclReportTimeLeft
+ *
+ * @brief   Time until a reporting configuration is due for a report.
+ *
+ * @param   pCfg - reporting configuration
+ * @param   now - osal_GetSystemClock()
+ *
+ * @return  milliseconds, 0 if due, 0xFFFFFFFF if nothing to report
+ */
+static uint32 zclReportTimeLeft( zclReportCfg_t *pCfg, uint32 now )
+{
+  uint32 elapsed = now - pCfg->lastReport;
+  uint32 interval;
+
+  if ( pCfg->flags & ZCL_REPORT_PENDING )
+    interval = (uint32)pCfg->cfg.minReportInt * 1000;
+  else if ( pCfg->cfg.maxReportInt != 0 )
+    interval = (uint32)pCfg->cfg.maxReportInt * 1000;
+  else
+    return ( 0xFFFFFFFF ); // EMBEDDED RETURN
+
+  return ( (elapsed < interval) ? (interval - elapsed) : 0 );
+}
+
+/*********************************************************************
+ * @fn      zclReportSchedule
+ *
+ * @brief   Start the one reporting timer for the next report due,
+ *          over all endpoints.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void zclReportSchedule( void )
+{
+  uint32 now = osal_GetSystemClock();
+  uint32 next = 0xFFFFFFFF;
+  uint32 left;
+  uint8 x;
+
+  for ( x = 0; x < ZCL_MAX_REPORT_CFGS; x++ )
+  {
+    if ( zclReportCfgs[x].cfg.endpoint != 0 )
+    {
+      left = zclReportTimeLeft( &zclReportCfgs[x], now );
+      if ( left < next )
+        next = left;
+    }
+  }
+
+  if ( next == 0xFFFFFFFF )
+  {
+    osal_stop_timerEx( zcl_TaskID, ZCL_REPORT_EVT );
+  }
+  else if ( next == 0 )
+  {
+    osal_stop_timerEx( zcl_TaskID, ZCL_REPORT_EVT );
+    osal_set_event( zcl_TaskID, ZCL_REPORT_EVT );
+  }
+  else
+  {
+    if ( next > ZCL_REPORT_MAX_TIMEOUT )
+      next = ZCL_REPORT_MAX_TIMEOUT;
+    osal_start_timerEx( zcl_TaskID, ZCL_REPORT_EVT, (uint16)next );
+  }
+}
+
+/*********************************************************************
+ * @fn      zclReportProcess
+ *
+ * @brief   Look for value changes and send the reports that are due.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void zclReportProcess( void )
+{
+  zclReportCfg_t *pCfg;
+  const zclAttrRec_t GENERIC *pAttr;
+  uint32 now = osal_GetSystemClock();
+  uint8 x;
+
+  for ( x = 0; x < ZCL_MAX_REPORT_CFGS; x++ )
+  {
+    pCfg = &zclReportCfgs[x];
+    if ( pCfg->cfg.endpoint == 0 )
+      continue;
+
+    pAttr = zclReportGetAttr( pCfg );
+    if ( pAttr == NULL )
+      continue;
+
+    // Catch changes the application didn't tell about
+    if ( !(pCfg->flags & ZCL_REPORT_PENDING) && zclReportValueChanged( pCfg, pAttr ) )
+      pCfg->flags |= ZCL_REPORT_PENDING;
+
+    if ( zclReportTimeLeft( pCfg, now ) == 0 )
+      pCfg->flags |= ZCL_REPORT_DUE;
+  }
+
+  for ( x = 0; x < ZCL_MAX_REPORT_CFGS; x++ )
+  {
+    if ( zclReportCfgs[x].flags & ZCL_REPORT_DUE )
+      zclReportSend( x, now );
+  }
+
+  // Whatever couldn't be sent waits for another interval
+  for ( x = 0; x < ZCL_MAX_REPORT_CFGS; x++ )
+  {
+    if ( zclReportCfgs[x].flags & ZCL_REPORT_DUE )
+    {
+      zclReportCfgs[x].flags &= ~ZCL_REPORT_DUE;
+      zclReportCfgs[x].lastReport = now;
+    }
+  }
+
+  zclReportSchedule();
+}
+
+/*********************************************************************
+ * @fn      zclReportSend
+ *
+ * @brief   Send one Report Attributes command with a due attribute and
+ *          all the other due attributes of the same endpoint, cluster
+ *          and destination that fit in the frame.
+ *
+ * @param   first - index of the first due reporting configuration
+ * @param   now - osal_GetSystemClock()
+ *
+ * @return  none
+ */
+static void zclReportSend( uint8 first, uint32 now )
+{
+  zclReportCfg_t *pFirst = &zclReportCfgs[first];
+  zclReportCfg_t *pCfg;
+  endPointDesc_t *epDesc;
+  afDataReqMTU_t mtu;
+  afAddrType_t dstAddr;
+  zclFrameHdr_t hdr;
+  uint8 *buf;
+  uint8 *pBuf;
+  uint8 *pEnd;
+  uint8 *pPayload;
+  uint8 dataLen;
+  uint8 x;
+
+  epDesc = afFindEndPointDesc( pFirst->cfg.endpoint );
+  if ( epDesc == NULL ||
+       zcl_DeviceOperational( pFirst->cfg.endpoint, pFirst->cfg.clusterID,
+                              ZCL_FRAME_TYPE_PROFILE_CMD, ZCL_CMD_REPORT ) == FALSE )
+  {
+    zclReportSent( pFirst, now );
+    return; // EMBEDDED RETURN
+  }
+
+  mtu.kvp = FALSE;
+  mtu.aps.secure = FALSE;
+  dataLen = afDataReqMTU( &mtu );
+
+  buf = osal_mem_alloc( dataLen );
+  if ( buf == NULL )
+    return; // EMBEDDED RETURN
+
+  osal_memset( &hdr, 0, sizeof( zclFrameHdr_t ) );
+  hdr.fc.type = ZCL_FRAME_TYPE_PROFILE_CMD;
+  hdr.fc.direction = ZCL_FRAME_SERVER_CLIENT_DIR;
+  hdr.transSeqNum = zclReportSeqNum++;
+  hdr.commandID = ZCL_CMD_REPORT;
+
+  pEnd = buf + dataLen;
+  pPayload = zclBuildHdr( &hdr, buf );
+  pBuf = pPayload;
+
+  for ( x = first; x < ZCL_MAX_REPORT_CFGS; x++ )
+  {
+    pCfg = &zclReportCfgs[x];
+    if ( !(pCfg->flags & ZCL_REPORT_DUE) ||
+         pCfg->cfg.endpoint != pFirst->cfg.endpoint ||
+         pCfg->cfg.clusterID != pFirst->cfg.clusterID ||
+         pCfg->cfg.dstAddr != pFirst->cfg.dstAddr ||
+         pCfg->cfg.dstEP != pFirst->cfg.dstEP )
+      continue;
+
+    // Attribute ID + Data
+    dataLen = zclGetAttrDataLength( pCfg->pAttr->attr.dataType,
+                                    (uint8 *)(pCfg->pAttr->attr.dataPtr) );
+    if ( (pBuf + 2 + dataLen) > pEnd )
+    {
+      if ( pBuf == pPayload )
+        zclReportSent( pCfg, now ); // Never fits, drop it
+
+      continue; // Goes in a later frame
+    }
+
+    *pBuf++ = LO_UINT16( pCfg->cfg.attrID );
+    *pBuf++ = HI_UINT16( pCfg->cfg.attrID );
+    zclSerializeData( pCfg->pAttr->attr.dataType, pCfg->pAttr->attr.dataPtr, pBuf );
+    pBuf += dataLen; // move pass attribute data
+
+    zclReportSent( pCfg, now );
+  }
+
+  if ( pBuf != pPayload )
+  {
+    dstAddr.addrMode = afAddr16Bit;
+    dstAddr.addr.shortAddr = pFirst->cfg.dstAddr;
+    dstAddr.endPoint = pFirst->cfg.dstEP;
+
+    AF_DataRequest( &dstAddr, epDesc, pFirst->cfg.clusterID, (uint8)(pBuf - buf), buf,
+                    &zcl_TransID, AF_MSG_ACK_REQUEST, AF_DEFAULT_RADIUS );
+  }
+
+  osal_mem_free( buf );
+}
+
+/*********************************************************************
+ * @fn      zclReportSent
+ *
+ * @brief   Restart the intervals of a reporting configuration and
+ *          remember the value reported.
+ *
+ * @param   pCfg - reporting configuration
+ * @param   now - osal_GetSystemClock()
+ *
+ * @return  none
+ */
+static void zclReportSent( zclReportCfg_t *pCfg, uint32 now )
+{
+  pCfg->lastReport = now;
+  pCfg->flags &= ~(ZCL_REPORT_PENDING | ZCL_REPORT_DUE);
+
+  if ( pCfg->pAttr && zclReportValueLen( pCfg->pAttr->attr.dataType ) )
+  {
+    zclSerializeData( pCfg->pAttr->attr.dataType, pCfg->pAttr->attr.dataPtr,
+                      pCfg->lastValue );
+    pCfg->flags |= ZCL_REPORT_VALUE_VALID;
+  }
+}
+
+/*********************************************************************
+ * @fn      zclReportInitNV
+ *
+ * @brief   Initialize the NV Reporting Configuration Table Item
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void zclReportInitNV( void )
+{
+  uint8 x;
+
+  if ( osal_nv_item_init( ZCD_NV_REPORT_CFG_TABLE,
+                          (uint16)(sizeof( zclReportCfgNV_t ) * ZCL_MAX_REPORT_CFGS),
+                          NULL ) != ZSUCCESS )
+  {
+    // New item, write the (empty) defaults
+    for ( x = 0; x < ZCL_MAX_REPORT_CFGS; x++ )
+      zclReportWriteNV( x );
+  }
+}
+
+/*********************************************************************
+ * @fn      zclReportWriteNV
+ *
+ * @brief   Save one reporting configuration in NV
+ *
+ * @param   idx - index in zclReportCfgs
+ *
+ * @return  none
+ */
+static void zclReportWriteNV( uint8 idx )
+{
+  osal_nv_write( ZCD_NV_REPORT_CFG_TABLE,
+                 (uint16)(idx * sizeof( zclReportCfgNV_t )),
+                 sizeof( zclReportCfgNV_t ), &(zclReportCfgs[idx].cfg) );
+}
+
+/*********************************************************************
+ * @fn      zclReportRestoreFromNV
+ *
+ * @brief   Restore the reporting configurations from NV. Each one
+ *          reports its attribute once its Minimum Reporting Interval
+ *          is over.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void zclReportRestoreFromNV( void )
+{
+  uint32 now = osal_GetSystemClock();
+  uint8 x;
+
+  for ( x = 0; x < ZCL_MAX_REPORT_CFGS; x++ )
+  {
+    if ( osal_nv_read( ZCD_NV_REPORT_CFG_TABLE,
+                       (uint16)(x * sizeof( zclReportCfgNV_t )),
+                       sizeof( zclReportCfgNV_t ), &(zclReportCfgs[x].cfg) ) != ZSUCCESS )
+    {
+      zclReportCfgs[x].cfg.endpoint = 0;
+    }
+
+    if ( zclReportCfgs[x].cfg.endpoint != 0 )
+    {
+      zclReportCfgs[x].lastReport = now;
+      zclReportCfgs[x].flags = ZCL_REPORT_PENDING;
+    }
+  }
+}
+#endif // ZCL_REPORT
+
+/*********************************************************************
+ * @fn      zclProcessInErrorCmd
+ *
+ * @brief   Process the "Profile" Error Command
+ *
+ * @param   pInMsg - incoming message to process
+ * @param   logicalClusterID - logical cluster ID
+ *
+ * @return  none
+ */
+static uint8 zclProcessInErrorCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID )
+{
+  // Command ID and Error Code are at pInMsg->pData[0] and pInMsg->pData[1]
+   
+  // Device is notified of the command error.
+
+  return TRUE; 
+}
+
+#ifdef ZCL_DISCOVER
+/*********************************************************************
+ * @fn      zclProcessInDiscCmd
+ *
+ * @brief   Process the "Profile" Discover Command
+ *
+ * @param   pInMsg - incoming message to process
+ * @param   logicalClusterID - logical cluster ID
+ *
+ * @return  none
+ */
+static uint8 zclProcessInDiscCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID )
+{
+  zclDiscCursor_t cursor;
+  zclDiscoverRspCmd_t *discoverRspCmd;
+  const zclAttrRec_t GENERIC *pAttr;
+  afDataReqMTU_t mtu;
+  zclFrameHdr_t hdr;
+  uint8 maxAttrIDs;
+  uint8 i;
+  
+  if ( pInMsg->pDataLen < 3 )
+    return FALSE; // EMBEDDED RETURN
+
+  // As many records as the response frame holds
+  osal_memset( &hdr, 0, sizeof( zclFrameHdr_t ) );
+  hdr.fc.type = ZCL_FRAME_TYPE_PROFILE_CMD;
+  hdr.commandID = ZCL_CMD_DISCOVER_RSP;
+  mtu.kvp = FALSE;
+  mtu.aps.secure = FALSE;
+  maxAttrIDs = ( afDataReqMTU( &mtu ) - zclCalcHdrSize( &hdr ) - 1 ) / ZCL_DISCOVER_REC_LEN;
+  if ( pInMsg->pData[2] < maxAttrIDs )
+    maxAttrIDs = pInMsg->pData[2];
+  
+  // Allocate space for the response command
+  discoverRspCmd = (zclDiscoverRspCmd_t *)osal_mem_alloc( sizeof (zclDiscoverRspCmd_t) + \
+                                                          sizeof ( zclDiscoverInfo_t ) * maxAttrIDs );
+  if ( discoverRspCmd == NULL )
+    return FALSE; // EMEDDED RETURN
+  
+  // One pass over the attributes, plus one more record to tell if
+  // the discovery is complete
+  zclDiscCursorStart( &cursor, pInMsg->msg->endPoint, pInMsg->msg->clusterId,
+                      BUILD_UINT16( pInMsg->pData[0], pInMsg->pData[1] ) );
+  for ( i = 0; i < maxAttrIDs; i++ )
+  {
+    pAttr = zclDiscCursorNext( &cursor );
+    if ( pAttr == NULL )
+      break;
+      
+    discoverRspCmd->attrList[i].attrID = pAttr->attr.attrId;
+    discoverRspCmd->attrList[i].dataType = pAttr->attr.dataType;
+  }
+  
+  discoverRspCmd->numAttr = i;
+  discoverRspCmd->discComplete = ( zclDiscCursorNext( &cursor ) == NULL );
+  zcl_SendDiscoverRspCmd( pInMsg->msg->endPoint, &pInMsg->msg->srcAddr, 
+                          pInMsg->msg->clusterId, discoverRspCmd, 
+                          ZCL_FRAME_SERVER_CLIENT_DIR, pInMsg->hdr.transSeqNum );
+  osal_mem_free( discoverRspCmd );
+  
+  return TRUE;
+}
+
+/*********************************************************************
+ * @fn      zclProcessInDiscRspCmd
+ *
+ * @brief   Process the "Profile" Discover Response Command
+ *
+ * @param   pInMsg - incoming message to process
+ * @param   logicalClusterID - logical cluster ID
+ *
+ * @return  none
+ */
+static uint8 zclProcessInDiscRspCmd( zclIncoming_t *pInMsg, uint16 logicalClusterID )
+{
+  zclAttrIter_t iter;
+  zclAttrIterRec_t rec;
+  zclDiscoverAll_t *pDisc = NULL;
+  zclDiscoverInfo_t info;
+  uint16 lastAttr = 0;
+  uint8 found = FALSE;
+  uint8 x;
+  
+  // Is it the answer to a zcl_DiscoverAllAttrs()?
+  for ( x = 0; x < ZCL_MAX_DISCOVERIES; x++ )
+  {
+    if ( zclDiscoverAlls[x].srcEP == pInMsg->msg->endPoint
+        && zclDiscoverAlls[x].seqNum == pInMsg->hdr.transSeqNum
+        && zclDiscoverAlls[x].clusterID == pInMsg->msg->clusterId
+        && zclDiscoverAlls[x].dstAddr.addr.shortAddr == pInMsg->msg->srcAddr.addr.shortAddr )
+    {
+      pDisc = &zclDiscoverAlls[x];
+      break;
+    }
+  }
+
+  zclAttrIterInit( &iter, pInMsg );
+  while ( zclAttrIterNext( &iter, &rec ) )
+  {
+    // Device is notified of the result of its attribute discovery command.
+    if ( pDisc )
+    {
+      info.attrID = rec.attrID;
+      info.dataType = rec.dataType;
+      pDisc->pfnCB( pDisc->srcEP, &(pInMsg->msg->srcAddr), pDisc->clusterID, &info );
+      lastAttr = rec.attrID;
+      found = TRUE;
+    }
+  }
+
+  if ( pDisc )
+  {
+    // Ask for the rest, unless the response says there's no more (or
+    // can't go any further)
+    if ( pInMsg->pDataLen == 0 || pInMsg->pData[0] || !found || lastAttr == ZCL_ATTR_ID_MAX
+        || zclDiscoverAllSend( pDisc, lastAttr + 1 ) != ZSuccess )
+    {
+      pDisc->srcEP = 0;
+      pDisc->pfnCB( pInMsg->msg->endPoint, &(pInMsg->msg->srcAddr), pDisc->clusterID, NULL );
+    }
+  }
+  
+  return TRUE;
+}
+
+/*********************************************************************
+ * @fn      zclDiscoverAllSend
+ *
+ * @brief   Send the next Discover Attributes command of a discovery
+ *
+ * @param   pDisc - discovery in progress
+ * @param   startAttr - first attribute ID asked for
+ *
+ * @return  ZSuccess if OK
+ */
+static ZStatus_t zclDiscoverAllSend( zclDiscoverAll_t *pDisc, uint16 startAttr )
+{
+  zclDiscoverCmd_t discoverCmd;
+
+  discoverCmd.startAttr = startAttr;
+  discoverCmd.maxAttrIDs = pDisc->maxAttrIDs;
+
+  pDisc->seqNum = zclDiscoverSeqNum++;
+  pDisc->sent = osal_GetSystemClock();
+
+  // The timer runs for the oldest discovery, a later one is picked up
+  // when it expires
+  if ( osal_get_timeoutEx( zcl_TaskID, ZCL_DISCOVER_EVT ) == 0 )
+    osal_start_timerEx( zcl_TaskID, ZCL_DISCOVER_EVT, ZCL_DISCOVER_TIMEOUT );
+
+  return ( zcl_SendDiscoverCmd( pDisc->srcEP, &(pDisc->dstAddr), pDisc->clusterID,
+                                &discoverCmd, ZCL_FRAME_CLIENT_SERVER_DIR, pDisc->seqNum ) );
+}
+
+/*********************************************************************
+ * @fn      zclDiscoverAllExpire
+ *
+ * @brief   End the discoveries that got no answer within
+ *          ZCL_DISCOVER_TIMEOUT, calling their callback with NULL, and
+ *          restart the timer for the next one to run out
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void zclDiscoverAllExpire( void )
+{
+  zclDiscoverAll_t *pDisc;
+  zclDiscoverAll_t old;
+  uint32 now = osal_GetSystemClock();
+  uint32 elapsed;
+  uint16 next = 0;
+  uint8 x;
+
+  for ( x = 0; x < ZCL_MAX_DISCOVERIES; x++ )
+  {
+    pDisc = &zclDiscoverAlls[x];
+    if ( pDisc->srcEP == 0 )
+      continue;
+
+    elapsed = now - pDisc->sent;
+    if ( elapsed >= ZCL_DISCOVER_TIMEOUT )
+    {
+      // Free the entry first, the callback may start a new discovery
+      osal_memcpy( &old, pDisc, sizeof( zclDiscoverAll_t ) );
+      pDisc->srcEP = 0;
+      old.pfnCB( old.srcEP, &(old.dstAddr), old.clusterID, NULL );
+    }
+    else if ( next == 0 || (ZCL_DISCOVER_TIMEOUT - elapsed) < next )
+    {
+      next = (uint16)(ZCL_DISCOVER_TIMEOUT - elapsed);
+    }
+  }
+
+  if ( next )
+    osal_start_timerEx( zcl_TaskID, ZCL_DISCOVER_EVT, next );
+}
+#endif // ZCL_DISCOVER
+
+#ifdef ZCL_TRANSITION
+/*********************************************************************
+ * @fn      zcl_StartTransition
+ *
+ * @brief   Move a uint8 attribute to a value over a transition time.
+ *          Each tick, a tenth of a second after the one before, adds a
+ *          fixed point step to the value and the last tick writes the
+ *          target, so the attribute gets there exactly when the
+ *          transition time is up. A new transition on an attribute
+ *          replaces the one in progress.
+ *
+ * @param   endpoint - Application's endpoint
+ * @param   realClusterID - real cluster ID
+ * @param   attrId - attribute that moves
+ * @param   remainingTimeId - uint16 attribute counting down the time left,
+ *                            ZCL_TRANSITION_NO_ATTR if none
+ * @param   maxValue - highest value of the attribute
+ * @param   target - value to move to
+ * @param   transTime - transition time, in 1/10ths of a second
+ * @param   options - ZCL_TRANSITION_WRAP for a cyclic value, with the
+ *                    direction it moves in
+ *
+ * @return  ZSuccess if OK, ZInvalidParameter if the attribute isn't
+ *          registered, ZMemError if all the transitions are in use
+ */
+ZStatus_t zcl_StartTransition( uint8 endpoint, uint16 realClusterID, uint16 attrId,
+                               uint16 remainingTimeId, uint8 maxValue,
+                               uint8 target, uint16 transTime, uint8 options )
+{
+  zclTransition_t *pTrans;
+  const zclAttrRec_t GENERIC *pAttr;
+  int16 range = (int16)maxValue + 1;
+  int16 delta;
+  uint8 dir;
+
+  pAttr = zclFindAttrRec( endpoint, realClusterID, attrId );
+  if ( pAttr == NULL || pAttr->attr.dataType != ZCL_DATATYPE_UINT8 )
+    return ( ZInvalidParameter ); // EMBEDDED RETURN
+
+  if ( target > maxValue )
+    target = maxValue;
+
+  delta = (int16)target - *((uint8 *)pAttr->attr.dataPtr);
+  if ( (options & ZCL_TRANSITION_WRAP) && delta != 0 )
+  {
+    // Distance going up, then pick the way around
+    if ( delta < 0 )
+      delta += range;
+
+    dir = options & ZCL_TRANSITION_DIR_MASK;
+    if ( dir == ZCL_TRANSITION_SHORTEST )
+      dir = ( delta * 2 <= range ) ? ZCL_TRANSITION_UP : ZCL_TRANSITION_DOWN;
+    else if ( dir == ZCL_TRANSITION_LONGEST )
+      dir = ( delta * 2 > range ) ? ZCL_TRANSITION_UP : ZCL_TRANSITION_DOWN;
+
+    if ( dir == ZCL_TRANSITION_DOWN )
+      delta -= range;
+  }
+
+  pTrans = zclTransitionFind( endpoint, realClusterID, attrId, ( transTime && delta ) );
+  if ( transTime == 0 || delta == 0 )
+  {
+    // Nothing to run, go straight there
+    if ( pTrans )
+      zclTransitionEnd( pTrans );
+    zclTransitionWrite( pAttr, target );
+    return ( ZSuccess ); // EMBEDDED RETURN
+  }
+
+  if ( pTrans == NULL )
+    return ( ZMemError ); // EMBEDDED RETURN
+
+  pTrans->value = (int32)*((uint8 *)pAttr->attr.dataPtr) << ZCL_TRANSITION_SHIFT;
+  // Scaled by multiplying, delta may be negative
+  pTrans->step = ((int32)delta * ((int32)1 << ZCL_TRANSITION_SHIFT)) / (int32)transTime;
+  pTrans->ticks = transTime;
+  pTrans->target = target;
+  zclTransitionStart( pTrans, endpoint, pAttr, remainingTimeId, range, options );
+
+  return ( ZSuccess );
+}
+
+/*********************************************************************
+ * @fn      zcl_StartMove
+ *
+ * @brief   Move a uint8 attribute at a rate. A value that doesn't wrap
+ *          stops at 0 or maxValue, on time for the rate; a cyclic value
+ *          keeps going round until zcl_StopTransition() is called.
+ *
+ * @param   endpoint - Application's endpoint
+ * @param   realClusterID - real cluster ID
+ * @param   attrId - attribute that moves
+ * @param   remainingTimeId - uint16 attribute counting down the time left,
+ *                            ZCL_TRANSITION_NO_ATTR if none
+ * @param   maxValue - highest value of the attribute
+ * @param   rate - units per second
+ * @param   options - ZCL_TRANSITION_UP or ZCL_TRANSITION_DOWN, with
+ *                    ZCL_TRANSITION_WRAP for a cyclic value
+ *
+ * @return  ZSuccess if OK, ZInvalidParameter if the attribute isn't
+ *          registered or the rate is 0, ZMemError if all the
+ *          transitions are in use
+ */
+ZStatus_t zcl_StartMove( uint8 endpoint, uint16 realClusterID, uint16 attrId,
+                         uint16 remainingTimeId, uint8 maxValue,
+                         uint8 rate, uint8 options )
+{
+  zclTransition_t *pTrans;
+  const zclAttrRec_t GENERIC *pAttr;
+  uint8 down = ( (options & ZCL_TRANSITION_DIR_MASK) == ZCL_TRANSITION_DOWN );
+  uint8 cur;
+  uint16 dist;
+
+  pAttr = zclFindAttrRec( endpoint, realClusterID, attrId );
+  if ( pAttr == NULL || pAttr->attr.dataType != ZCL_DATATYPE_UINT8 || rate == 0 )
+    return ( ZInvalidParameter ); // EMBEDDED RETURN
+
+  if ( (options & ZCL_TRANSITION_WRAP) == 0 )
+  {
+    // Becomes a transition to the limit, rounded up to a whole tick
+    cur = *((uint8 *)pAttr->attr.dataPtr);
+    dist = down ? cur : ( cur < maxValue ? maxValue - cur : 0 );
+    dist = ( dist * ZCL_TRANSITION_TICKS_PER_SEC + rate - 1 ) / rate;
+
+    return ( zcl_StartTransition( endpoint, realClusterID, attrId, remainingTimeId,
+                                  maxValue, down ? 0 : maxValue, dist, options ) );
+  }
+
+  pTrans = zclTransitionFind( endpoint, realClusterID, attrId, TRUE );
+  if ( pTrans == NULL )
+    return ( ZMemError ); // EMBEDDED RETURN
+
+  pTrans->value = (int32)*((uint8 *)pAttr->attr.dataPtr) << ZCL_TRANSITION_SHIFT;
+  pTrans->step = ((int32)rate << ZCL_TRANSITION_SHIFT) / ZCL_TRANSITION_TICKS_PER_SEC;
+  if ( down )
+    pTrans->step = -pTrans->step;
+  pTrans->ticks = 0;
+  pTrans->target = 0;
+  zclTransitionStart( pTrans, endpoint, pAttr, remainingTimeId, (int16)maxValue + 1, options );
+
+  return ( ZSuccess );
+}
+
+/*********************************************************************
+ * @fn      zcl_StopTransition
+ *
+ * @brief   Stop the transition of an attribute, leaving the attribute
+ *          at its current value.
+ *
+ * @param   endpoint - Application's endpoint
+ * @param   realClusterID - real cluster ID
+ * @param   attrId - attribute ID
+ *
+ * @return  none
+ */
+void zcl_StopTransition( uint8 endpoint, uint16 realClusterID, uint16 attrId )
+{
+  zclTransition_t *pTrans;
+
+  pTrans = zclTransitionFind( endpoint, realClusterID, attrId, FALSE );
+  if ( pTrans )
+    zclTransitionEnd( pTrans );
+}
+
+/*********************************************************************
+ * @fn      zclTransitionFind
+ *
+ * @brief   Find the transition of an attribute
+ *
+ * @param   endpoint - Application's endpoint
+ * @param   realClusterID - real cluster ID
+ * @param   attrId - attribute ID
+ * @param   alloc - TRUE to return a free entry if there's no transition
+ *
+ * @return  pointer to the transition, NULL if not found
+ */
+static zclTransition_t *zclTransitionFind( uint8 endpoint, uint16 realClusterID,
+                                           uint16 attrId, uint8 alloc )
+{
+  zclTransition_t *pFree = NULL;
+  zclTransition_t *pTrans;
+  uint8 x;
+
+  for ( x = 0; x < ZCL_MAX_TRANSITIONS; x++ )
+  {
+    pTrans = &zclTransitions[x];
+    if ( pTrans->endpoint == 0 )
+    {
+      if ( pFree == NULL )
+        pFree = pTrans;
+    }
+    else if ( pTrans->endpoint == endpoint && pTrans->pAttr->clusterID == realClusterID &&
+              pTrans->pAttr->attr.attrId == attrId )
+    {
+      return ( pTrans ); // EMBEDDED RETURN
+    }
+  }
+
+  return ( alloc ? pFree : NULL );
+}
+
+/*********************************************************************
+ * @fn      zclTransitionStart
+ *
+ * @brief   Fill in the rest of a transition and make sure the timer is
+ *          running. The first tick is a whole tick from now, whatever
+ *          the phase of the transitions already in progress;
+ *          transitions started together (e.g. by a group command)
+ *          still share their ticks.
+ *
+ * @param   pTrans - transition, with its value, step, ticks and target
+ * @param   endpoint - Application's endpoint
+ * @param   pAttr - attribute that moves
+ * @param   remainingTimeId - Remaining Time attribute ID
+ * @param   range - number of values of the attribute
+ * @param   options - transition options
+ *
+ * @return  none
+ */
+static void zclTransitionStart( zclTransition_t *pTrans, uint8 endpoint,
+                                const zclAttrRec_t GENERIC *pAttr,
+                                uint16 remainingTimeId, int16 range, uint8 options )
+{
+  pTrans->endpoint = endpoint;
+  pTrans->options = options;
+  pTrans->pAttr = pAttr;
+  pTrans->range = (int32)range << ZCL_TRANSITION_SHIFT;
+
+  pTrans->pRemaining = NULL;
+  if ( remainingTimeId != ZCL_TRANSITION_NO_ATTR )
+  {
+    pAttr = zclFindAttrRec( endpoint, pAttr->clusterID, remainingTimeId );
+    if ( pAttr && pAttr->attr.dataType == ZCL_DATATYPE_UINT16 )
+      pTrans->pRemaining = pAttr;
+  }
+  zclTransitionRemaining( pTrans, pTrans->ticks );
+
+  pTrans->due = osal_GetSystemClock() + ZCL_TRANSITION_TICK;
+  zclTransitionTimer( pTrans->due - ZCL_TRANSITION_TICK );
+}
+
+/*********************************************************************
+ * @fn      zclTransitionEnd
+ *
+ * @brief   Free a transition and clear its Remaining Time
+ *
+ * @param   pTrans - transition
+ *
+ * @return  none
+ */
+static void zclTransitionEnd( zclTransition_t *pTrans )
+{
+  zclTransitionRemaining( pTrans, 0 );
+  pTrans->endpoint = 0;
+}
+
+/*********************************************************************
+ * @fn      zclTransitionWrite
+ *
+ * @brief   Write a new value to a uint8 attribute and tell the
+ *          reporting engine if it changed
+ *
+ * @param   pAttr - attribute
+ * @param   value - new value
+ *
+ * @return  none
+ */
+static void zclTransitionWrite( const zclAttrRec_t GENERIC *pAttr, uint8 value )
+{
+  if ( *((uint8 *)pAttr->attr.dataPtr) != value )
+  {
+    *((uint8 *)pAttr->attr.dataPtr) = value;
+#ifdef ZCL_REPORT
+    zclReportAttrChanged( pAttr );
+#endif // ZCL_REPORT
+  }
+}
+
+/*********************************************************************
+ * @fn      zclTransitionRemaining
+ *
+ * @brief   Update the Remaining Time attribute of a transition
+ *
+ * @param   pTrans - transition
+ * @param   ticks - time left, in 1/10ths of a second
+ *
+ * @return  none
+ */
+static void zclTransitionRemaining( zclTransition_t *pTrans, uint16 ticks )
+{
+  if ( pTrans->pRemaining && *((uint16 *)pTrans->pRemaining->attr.dataPtr) != ticks )
+  {
+    *((uint16 *)pTrans->pRemaining->attr.dataPtr) = ticks;
+#ifdef ZCL_REPORT
+    zclReportAttrChanged( pTrans->pRemaining );
+#endif // ZCL_REPORT
+  }
+}
+
+/*********************************************************************
+ * @fn      zclTransitionProcess
+ *
+ * @brief   Move the transitions whose tick is due one tick, then restart
+ *          the timer for the next one
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void zclTransitionProcess( void )
+{
+  zclTransition_t *pTrans;
+  uint32 now = osal_GetSystemClock();
+  uint8 x;
+
+  for ( x = 0; x < ZCL_MAX_TRANSITIONS; x++ )
+  {
+    pTrans = &zclTransitions[x];
+    if ( pTrans->endpoint == 0 || (int32)(pTrans->due - now) > 0 )
+      continue;
+
+    pTrans->due += ZCL_TRANSITION_TICK;
+
+    if ( pTrans->ticks == 1 )
+    {
+      // Last tick: land on the target, whatever the rounding of the step
+      zclTransitionWrite( pTrans->pAttr, pTrans->target );
+      zclTransitionEnd( pTrans );
+      continue;
+    }
+
+    pTrans->value += pTrans->step;
+    if ( pTrans->options & ZCL_TRANSITION_WRAP )
+    {
+      if ( pTrans->value < 0 )
+        pTrans->value += pTrans->range;
+      else if ( pTrans->value >= pTrans->range )
+        pTrans->value -= pTrans->range;
+    }
+
+    // A move of a cyclic value has no end (ticks is 0)
+    if ( pTrans->ticks )
+      zclTransitionRemaining( pTrans, --pTrans->ticks );
+
+    zclTransitionWrite( pTrans->pAttr, (uint8)(pTrans->value >> ZCL_TRANSITION_SHIFT) );
+  }
+
+  zclTransitionTimer( now );
+}
+
+/*********************************************************************
+ * @fn      zclTransitionTimer
+ *
+ * @brief   Start the timer for the earliest tick due, if any transition
+ *          is in progress. A tick already late runs at once.
+ *
+ * @param   now - osal_GetSystemClock()
+ *
+ * @return  none
+ */
+static void zclTransitionTimer( uint32 now )
+{
+  zclTransition_t *pTrans;
+  int32 next = -1;
+  int32 left;
+  uint8 x;
+
+  for ( x = 0; x < ZCL_MAX_TRANSITIONS; x++ )
+  {
+    pTrans = &zclTransitions[x];
+    if ( pTrans->endpoint == 0 )
+      continue;
+
+    left = (int32)(pTrans->due - now);
+    if ( left < 1 )
+      left = 1;
+    if ( next < 0 || left < next )
+      next = left;
+  }
+
+  if ( next > 0 )
+    osal_start_timerEx( zcl_TaskID, ZCL_TRANSITION_EVT, (uint16)next );
+}
+#endif // ZCL_TRANSITION
 
 /*********************************************************************
 *********************************************************************/
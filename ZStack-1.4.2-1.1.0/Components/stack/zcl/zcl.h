@@ -130,6 +130,31 @@ extern "C"
 #define ACCESS_CONTROL_WRITE                            0x02
 #define ACCESS_CONTROL_COMMAND                          0x04
 
+// The maximum number of attribute reporting configurations (all endpoints)
+#if !defined( ZCL_MAX_REPORT_CFGS )
+  #define ZCL_MAX_REPORT_CFGS                           8
+#endif
+
+// The maximum number of zcl_DiscoverAllAttrs() running at once
+#if !defined( ZCL_MAX_DISCOVERIES )
+  #define ZCL_MAX_DISCOVERIES                           2
+#endif
+
+// The maximum number of attribute transitions running at once (all endpoints)
+#if !defined( ZCL_MAX_TRANSITIONS )
+  #define ZCL_MAX_TRANSITIONS                           6
+#endif
+
+/*** Transition options ***/
+#define ZCL_TRANSITION_UP                               0x00
+#define ZCL_TRANSITION_DOWN                             0x01 // Move: value decreases
+#define ZCL_TRANSITION_SHORTEST                         0x02 // Wrapping values only
+#define ZCL_TRANSITION_LONGEST                          0x03 // Wrapping values only
+#define ZCL_TRANSITION_DIR_MASK                         0x03
+#define ZCL_TRANSITION_WRAP                             0x80 // Value is cyclic (hue)
+
+#define ZCL_TRANSITION_NO_ATTR                          ZCL_ATTR_ID_MAX
+
 #define ZCL_INVALID_CLUSTER_ID                          0xFFFF
 #define ZCL_ATTR_ID_MAX                                 0xFFFF
 
@@ -324,6 +349,15 @@ typedef struct
   zclDiscoverInfo_t attrList[];   // supported attributes list
 } zclDiscoverRspCmd_t;
 
+// Function pointer type to receive the attributes found by
+// zcl_DiscoverAllAttrs(), pInfo is NULL when the discovery is over.
+//   srcEP - Application's endpoint
+//   srcAddr - discovered device
+//   realClusterID - real cluster ID
+//   pInfo - attribute found
+typedef void (*zclDiscoverCB_t)( uint8 srcEP, afAddrType_t *srcAddr, uint16 realClusterID,
+                                 zclDiscoverInfo_t *pInfo );
+
 
 /*********************************************************************
  * Cluster ID Conversion table - since the cluster IDs are assigned by
@@ -347,9 +381,35 @@ typedef struct
   zclFrameHdr_t         hdr;         // ZCL header parsed
   uint8                 *pData;      // pointer to data after header
   uint8                 pDataLen;    // length of remaining data
-  void                  *attrCmd;    // pointer to the parsed attribute or command
+  void                  *attrCmd;    // pointer to the parsed attribute or command,
+                                     // NULL if walked in place (zclAttrIterNext)
 } zclIncoming_t;
 
+// Attribute record of an incoming "Profile" command, walked in place. The
+// fields that don't apply to the command are left zero.
+typedef struct
+{
+  uint16 attrID;             // attribute ID
+  uint8  status;             // record status (response commands)
+  uint8  dataType;           // attribute data type, from the frame or the
+                             // local attribute record
+  uint8  direction;          // Configure Reporting direction
+  uint16 minReportInt;       // minimum reporting interval
+  uint16 maxReportInt;       // maximum reporting interval
+  uint16 timeoutPeriod;      // timeout period
+  uint8  dataLen;            // number of bytes at attrData
+  uint8  *attrData;          // attribute data or reportable change - points
+                             // into the incoming frame (serialized)
+} zclAttrIterRec_t;
+
+// Attribute record iterator - see zclAttrIterInit()
+typedef struct
+{
+  zclIncoming_t *pInMsg;     // message being walked
+  uint8         *pBuf;       // next record
+  uint8         *pEnd;       // end of the command payload
+} zclAttrIter_t;
+
 // Outgoing ZCL Cluster Specific Commands
 typedef struct
 {
@@ -372,6 +432,17 @@ typedef ZStatus_t (*zclInHdlr_t)( zclIncoming_t *msg, uint16 logicalClusterID );
 //   writeRec - received data to be written
 typedef ZStatus_t (*zclInWrtHdlr_t)( zclIncoming_t *msg, uint16 logicalClusterID, zclWriteRec_t *writeRec );  
 
+// Shortest payload of a cluster specific command. A cluster library keeps
+// a table of these and checks incoming commands against it with
+// zcl_CmdPayloadOk() before parsing them.
+typedef struct
+{
+  uint16  logicalClusterID; // Logical cluster ID
+  uint8   direction;        // ZCL_FRAME_CLIENT_SERVER_DIR or ZCL_FRAME_SERVER_CLIENT_DIR
+  uint8   commandID;        // Cluster specific command ID
+  uint8   minLen;           // Fixed part of the payload, in bytes
+} zclCmdLen_t;
+
 // Attribute record
 typedef struct
 {
@@ -381,6 +452,9 @@ typedef struct
   void    *dataPtr;       // Pointer to data field
 } zclAttribute_t;
 
+// Attribute records don't change once registered, so an application's
+// list can be declared CONST (code space) with only the values (dataPtr)
+// in RAM. List them by cluster ID, then attribute ID, to save the index.
 typedef struct
 {
   uint16          clusterID;    // Real cluster ID
@@ -457,7 +531,8 @@ extern ZStatus_t zcl_registerPlugin( uint16 startLogCluster, uint16 endLogCluste
 /*
  *  Register Application's Attribute table
  */
-extern ZStatus_t zcl_registerAttrList( uint8 endpoint, uint8 numAttrs, zclAttrRec_t *attrList );
+extern ZStatus_t zcl_registerAttrList( uint8 endpoint, uint8 numAttrs,
+                                       const zclAttrRec_t GENERIC *attrList );
 
 /*
  *  Function for Sending a Command
@@ -535,8 +610,35 @@ extern ZStatus_t zcl_SendReadReportCfgRspCmd( uint8 srcEP, afAddrType_t *dstAddr
 extern ZStatus_t zcl_SendReportCmd( uint8 srcEP, afAddrType_t *dstAddr,
                               uint16 realClusterID, zclReportCmd_t *reportCmd,
                               uint8 direction, uint8 seqNum );
+
+/*
+ *  Function for the Application to tell the reporting engine that it has
+ *  changed the value of an attribute
+ */
+extern ZStatus_t zcl_ReportAttrChanged( uint8 endpoint, uint16 realClusterID, uint16 attrId );
 #endif // ZCL_REPORT
 
+#ifdef ZCL_TRANSITION
+/*
+ *  Function to move an attribute to a value over a transition time
+ */
+extern ZStatus_t zcl_StartTransition( uint8 endpoint, uint16 realClusterID, uint16 attrId,
+                                      uint16 remainingTimeId, uint8 maxValue,
+                                      uint8 target, uint16 transTime, uint8 options );
+
+/*
+ *  Function to move an attribute at a rate until it reaches its limit
+ */
+extern ZStatus_t zcl_StartMove( uint8 endpoint, uint16 realClusterID, uint16 attrId,
+                                uint16 remainingTimeId, uint8 maxValue,
+                                uint8 rate, uint8 options );
+
+/*
+ *  Function to stop the transition of an attribute where it is
+ */
+extern void zcl_StopTransition( uint8 endpoint, uint16 realClusterID, uint16 attrId );
+#endif // ZCL_TRANSITION
+
 /*
  *  Function for sending the Command Error command
  */
@@ -558,14 +660,35 @@ extern ZStatus_t zcl_SendDiscoverCmd( uint8 srcEP, afAddrType_t *dstAddr,
 extern ZStatus_t zcl_SendDiscoverRspCmd( uint8 srcEP, afAddrType_t *dstAddr,
                       uint16 realClusterID, zclDiscoverRspCmd_t *discoverRspCmd,
                       uint8 direction, uint8 seqNum );
+
+/*
+ *  Function for discovering all the attributes of a remote cluster
+ */
+extern ZStatus_t zcl_DiscoverAllAttrs( uint8 srcEP, afAddrType_t *dstAddr, uint16 realClusterID,
+                                       uint8 maxAttrIDs, zclDiscoverCB_t pfnCB );
 #endif // ZCL_DISCOVER
 
+/*
+ * Function to start walking the attribute records of a "Profile" command
+ */
+extern void zclAttrIterInit( zclAttrIter_t *pIter, zclIncoming_t *pInMsg );
+
+/*
+ * Function to get the next attribute record of a "Profile" command
+ */
+extern uint8 zclAttrIterNext( zclAttrIter_t *pIter, zclAttrIterRec_t *pRec );
+
 #ifdef ZCL_READ
 /*
  * Function to parse the "Profile" Read Commands
  */
 extern void *zclParseInReadCmd( uint8 srcEP, uint16 realClusterID,
                                 uint8 dataLen, uint8 *pData );
+/*
+ * Function to parse the "Profile" Read Response Commands
+ */
+extern void *zclParseInReadRspCmd( uint8 endpoint, uint16 realClusterID,
+                                   uint8 dataLen, uint8 *pData );
 #endif // ZCL_READ
 
 #ifdef ZCL_WRITE
@@ -575,6 +698,11 @@ extern void *zclParseInReadCmd( uint8 srcEP, uint16 realClusterID,
  */
 extern void *zclParseInWriteCmd( uint8 srcEP, uint16 realClusterID,
                                  uint8 dataLen, uint8 *pData );
+/*
+ * Function to parse the "Profile" Write Response Commands
+ */
+extern void *zclParseInWriteRspCmd( uint8 endpoint, uint16 realClusterID,
+                                    uint8 dataLen, uint8 *pData );
 #endif // ZCL_WRITE
 
 #ifdef ZCL_REPORT
@@ -583,11 +711,21 @@ extern void *zclParseInWriteCmd( uint8 srcEP, uint16 realClusterID,
  */
 extern void *zclParseInConfigReportCmd( uint8 endpoint, uint16 realClusterID,
                                         uint8 dataLen, uint8 *pData );
+/*
+ * Function to parse the "Profile" Configure Reporting Response Command
+ */
+extern void *zclParseInConfigReportRspCmd( uint8 endpoint, uint16 realClusterID,
+                                           uint8 dataLen, uint8 *pData );
 /*
  * Function to parse the "Profile" Read Reporting Configuration Command
  */
 extern void *zclParseInReadReportCfgCmd( uint8 endpoint, uint16 realClusterID,
                                          uint8 dataLen, uint8 *pData );
+/*
+ * Function to parse the "Profile" Read Reporting Configuration Response Command
+ */
+extern void *zclParseInReadReportCfgRspCmd( uint8 endpoint, uint16 realClusterID,
+                                            uint8 dataLen, uint8 *pData );
 /*
  * Function to parse the "Profile" Report attribute Command
  */
@@ -600,8 +738,19 @@ extern void *zclParseInReportCmd( uint8 endpoint, uint16 realClusterID,
  * Function to parse the "Profile" Discover Commands
  */
 extern void *zclParseInDiscCmd( uint8 srcEP, uint16 realClusterID, uint8 dataLen, uint8 *pData );
+/*
+ * Function to parse the "Profile" Discover Response Commands
+ */
+extern void *zclParseInDiscRspCmd( uint8 endpoint, uint16 realClusterID,
+                                   uint8 dataLen, uint8 *pData );
 #endif // ZCL_DISCOVER
 
+/*
+ * Function to parse the "Profile" Error Command
+ */
+extern void *zclParseInErrorCmd( uint8 endpoint, uint16 realClusterID,
+                                 uint8 dataLen, uint8 *pData );
+
 /*
  * Function to parse header of the ZCL format
  */
@@ -610,12 +759,18 @@ extern uint8 *zclParseHdr( zclFrameHdr_t *hdr, uint8 *pData );
 /*
  * Function to find the attribute record that matchs the parameters
  */
-extern zclAttrRec_t *zclFindAttrRec( uint8 endpoint, uint16 realClusterID, uint16 attr );
+extern const zclAttrRec_t GENERIC *zclFindAttrRec( uint8 endpoint, uint16 realClusterID, uint16 attr );
 
 /*
  * Function to read the attribute's current value
  */
-extern uint8 zclReadAttrData( uint8 *pAttrData, zclAttrRec_t *pAttr );
+extern uint8 zclReadAttrData( uint8 *pAttrData, const zclAttrRec_t GENERIC *pAttr );
+
+/*
+ * Function to check that a cluster specific command is long enough to parse
+ */
+extern uint8 zcl_CmdPayloadOk( zclIncoming_t *pInMsg, uint16 logicalClusterID,
+                               const zclCmdLen_t GENERIC *pTable, uint8 numCmds );
 
 /*********************************************************************
 *********************************************************************/
@@ -42,6 +42,15 @@
 /*********************************************************************
  * CONSTANTS
  */
+#ifdef ZCL_SCENES
+// Endpoint of a free Scene table slot
+#define ZCL_GEN_SCENE_FREE                 0x00
+#endif // ZCL_SCENES
+
+#if defined(ZCL_LEVEL_CTRL) && defined(ZCL_TRANSITION)
+// Highest Current Level
+#define ZCL_GEN_LEVEL_MAX                  0xFF
+#endif // ZCL_LEVEL_CTRL && ZCL_TRANSITION
 
 /*********************************************************************
  * TYPEDEFS
@@ -55,8 +64,8 @@ typedef struct zclGenCBRec
 
 typedef struct zclGenSceneItem
 {
-  struct zclGenSceneItem    *next;
-  uint8                     endpoint; // Used to link it into the endpoint descriptor
+  uint8                     endpoint; // Used to link it into the endpoint descriptor,
+                                      // ZCL_GEN_SCENE_FREE if the slot is free
   zclGeneral_Scene_t        scene;    // Scene info
 } zclGenSceneItem_t;
 
@@ -67,10 +76,12 @@ typedef struct zclGenAlarmItem
   zclGeneral_Alarm_t        alarm;    // Alarm info
 } zclGenAlarmItem_t;
 
-// Scene NV types
+// Scene NV types - the records are kept slot by slot, a free slot has
+// endpoint ZCL_GEN_SCENE_FREE
 typedef struct
 {
-  uint16                    numRecs;
+  uint16                    numRecs;  // number of slots kept in NV, the
+                                      // slots past them are free
 } nvGenScenesHdr_t;
 
 typedef struct zclGenSceneNVItem
@@ -93,12 +104,65 @@ typedef struct zclGenSceneNVItem
 static zclGenCBRec_t *zclGenCBs = (zclGenCBRec_t *)NULL;
 static uint8 zclGenPluginRegisted = FALSE;
 #ifdef ZCL_SCENES
-static zclGenSceneItem_t *zclGenSceneTable = (zclGenSceneItem_t *)NULL;
+static zclGenSceneItem_t zclGenSceneTable[ZCL_GEN_MAX_SCENES];
+static uint8 zclGenSceneIndex[ZCL_GEN_MAX_SCENES]; // used slots sorted by
+                                                   // endpoint, group and scene ID
+static uint8 zclGenSceneCnt = 0;                   // number of used slots
+static uint8 zclGenSceneNVCnt = 0;                 // slots kept in NV, the
+                                                   // rest are free
 #endif // ZCL_SCENES
 #ifdef ZCL_ALARMS
 static zclGenAlarmItem_t *zclGenAlarmTable = (zclGenAlarmItem_t *)NULL;
 #endif // ZCL_ALARMS
 
+// Shortest payload of the commands that carry one
+static CONST zclCmdLen_t zclGenCmdLen[] =
+{
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_IDENTIFY,   ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_IDENTIFY_QUERY_RSP,        2 },
+
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_GROUPS,     ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_GROUP_ADD,                 3 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_GROUPS,     ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_GROUP_VIEW,                2 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_GROUPS,     ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_GROUP_GET_MEMBERSHIP,      1 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_GROUPS,     ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_GROUP_REMOVE,              2 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_GROUPS,     ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_GROUP_ADD_IF_IDENTIFYING,  3 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_GROUPS,     ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_GROUP_ADD_RSP,             3 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_GROUPS,     ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_GROUP_VIEW_RSP,            3 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_GROUPS,     ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_GROUP_GET_MEMBERSHIP_RSP,  2 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_GROUPS,     ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_GROUP_REMOVE_RSP,          3 },
+
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_SCENES,     ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_SCENE_ADD,                 6 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_SCENES,     ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_SCENE_VIEW,                3 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_SCENES,     ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_SCENE_REMOVE,              3 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_SCENES,     ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_SCENE_REMOVE_ALL,          2 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_SCENES,     ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_SCENE_STORE,               3 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_SCENES,     ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_SCENE_RECALL,              3 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_SCENES,     ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_SCENE_GET_MEMBERSHIP,      2 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_SCENES,     ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_SCENE_ADD_RSP,             4 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_SCENES,     ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_SCENE_VIEW_RSP,            4 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_SCENES,     ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_SCENE_REMOVE_RSP,          4 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_SCENES,     ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_SCENE_REMOVE_ALL_RSP,      3 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_SCENES,     ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_SCENE_STORE_RSP,           4 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_SCENES,     ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_SCENE_GET_MEMBERSHIP_RSP,  4 },
+
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_LEVEL_CTRL, ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_LEVEL_MOVE_TO_LEVEL,       3 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_LEVEL_CTRL, ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_LEVEL_MOVE,                2 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_LEVEL_CTRL, ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_LEVEL_STEP,                4 },
+
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_ALARMS,     ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_ALARMS_RESET,              3 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_ALARMS,     ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_ALARMS_ALARM,              3 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_ALARMS,     ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_ALARMS_GET_RSP,            1 },
+
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_LOCATION,   ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_LOCATION_SET_ABSOLUTE,     10 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_LOCATION,   ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_LOCATION_SET_DEV_CFG,      9 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_LOCATION,   ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_LOCATION_GET_DEV_CFG,      Z_EXTADDR_LEN },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_LOCATION,   ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_LOCATION_GET_DATA,         2 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_LOCATION,   ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_LOCATION_DEV_CFG_RSP,      1 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_LOCATION,   ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_LOCATION_DATA_RSP,         1 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_LOCATION,   ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_LOCATION_DATA_NOTIF,       1 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_LOCATION,   ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_LOCATION_COMPACT_DATA_NOTIF, 1 },
+  { ZCL_GEN_LOGICAL_CLUSTER_ID_LOCATION,   ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_LOCATION_RSSI_PING,        1 },
+};
+
 /*********************************************************************
  * LOCAL FUNCTIONS
  */
@@ -137,6 +201,9 @@ static ZStatus_t zclGeneral_ProcessInOnOff( zclIncoming_t *pInMsg );
 
 #ifdef ZCL_LEVEL_CTRL
 static ZStatus_t zclGeneral_ProcessInLevelControl( zclIncoming_t *pInMsg );
+#ifdef ZCL_TRANSITION
+static void zclGeneral_LevelControlTransition( zclIncoming_t *pInMsg );
+#endif // ZCL_TRANSITION
 #endif // ZCL_LEVEL_CTRL
 
 // Alarms cluster
@@ -152,9 +219,15 @@ static ZStatus_t zclGeneral_ProcessInLocationClient( zclIncoming_t *pInMsg );
 #endif // ZCL_LOCATION
 
 #ifdef ZCL_SCENES
+static uint8 zclGeneral_SceneBefore( zclGenSceneItem_t *pItem, uint8 endpoint,
+                                     uint16 groupID, uint8 sceneID );
+static uint8 zclGeneral_SceneLowerBound( uint8 endpoint, uint16 groupID, uint8 sceneID );
+static void zclGeneral_SceneIndexAdd( uint8 slot );
+static void zclGeneral_SceneIndexRemove( uint8 pos );
+static uint8 zclGeneral_SceneSlot( zclGeneral_Scene_t *pScene );
 static uint8 zclGeneral_ScenesInitNV( void );
 static void zclGeneral_ScenesSetDefaultNV( void );
-static void zclGeneral_ScenesWriteNV( void );
+static void zclGeneral_ScenesWriteNV( uint8 slot );
 static uint16 zclGeneral_ScenesRestoreFromNV( void );
 #endif // ZCL_SCENES
 
@@ -1191,6 +1264,12 @@ static ZStatus_t zclGeneral_HdlInSpecificCommands( zclIncoming_t *pInMsg, uint16
 {
   ZStatus_t stat = ZSuccess;
 
+  if ( zcl_CmdPayloadOk( pInMsg, logicalClusterID, zclGenCmdLen,
+                         sizeof( zclGenCmdLen ) / sizeof( zclCmdLen_t ) ) == FALSE )
+  {
+    return ( ZCL_STATUS_MALFORMED_COMMAND ); // EMBEDDED RETURN
+  }
+
   switch ( logicalClusterID )
   {
 #ifdef ZCL_BASIC
@@ -1307,7 +1386,7 @@ static ZStatus_t zclGeneral_ProcessInBasic( zclIncoming_t *pInMsg )
 static ZStatus_t zclGeneral_ProcessInIdentity( zclIncoming_t *pInMsg )
 {
   zclGeneral_AppCallbacks_t *pCBs;
-  zclAttrRec_t *pAttr;
+  const zclAttrRec_t GENERIC *pAttr;
   uint16 identifyTime = 0;
   uint16 timeout;
 
@@ -1355,7 +1434,7 @@ static ZStatus_t zclGeneral_ProcessInIdentity( zclIncoming_t *pInMsg )
  */
 static ZStatus_t zclGeneral_ProcessInGroupsServer( zclIncoming_t *pInMsg )
 {
-  zclAttrRec_t *pAttr;
+  const zclAttrRec_t GENERIC *pAttr;
   aps_Group_t group;
   aps_Group_t *pGroup;
   uint8 *pData;
@@ -1371,18 +1450,21 @@ static ZStatus_t zclGeneral_ProcessInGroupsServer( zclIncoming_t *pInMsg )
   osal_memset( (uint8*)&group, 0, sizeof( aps_Group_t ) );
 
   pData = pInMsg->pData;
-  group.ID = BUILD_UINT16( pData[0], pData[1] );
+  if ( pInMsg->pDataLen >= 2 )
+    group.ID = BUILD_UINT16( pData[0], pData[1] );
   switch ( pInMsg->hdr.commandID )
   {
     case COMMAND_GROUP_ADD:
       pData += 2;   // Move past group ID
       nameLen = *pData++;
+      if ( nameLen > pInMsg->pDataLen - 3 )
+        nameLen = pInMsg->pDataLen - 3;
       if ( nameLen > (APS_GROUP_NAME_LEN-1) )
         nameLen = (APS_GROUP_NAME_LEN-1);
       group.name[0] = nameLen;
       osal_memcpy( &(group.name[1]), pData, nameLen );
   
-      status = aps_AddGroup( pInMsg->msg->endPoint, &group );
+      status = afAddGroup( pInMsg->msg->endPoint, &group );
       if ( status != ZSuccess )
       {
         if ( status == ZApsDuplicateEntry )
@@ -1413,6 +1495,8 @@ static ZStatus_t zclGeneral_ProcessInGroupsServer( zclIncoming_t *pInMsg )
 
     case COMMAND_GROUP_GET_MEMBERSHIP:
       grpCnt = *pData++;
+      if ( grpCnt > (pInMsg->pDataLen - 1) / 2 )
+        grpCnt = (pInMsg->pDataLen - 1) / 2;
       if ( grpCnt == 0 )
       {
         // Find out all the groups of which the endpoint is a member.
@@ -1426,7 +1510,8 @@ static ZStatus_t zclGeneral_ProcessInGroupsServer( zclIncoming_t *pInMsg )
           group.ID = BUILD_UINT16( pData[0], pData[1] );
           pData += 2;
 
-          if ( aps_FindGroup( pInMsg->msg->endPoint, group.ID ) )
+          if ( grpRspCnt < APS_MAX_GROUPS &&
+               aps_FindGroup( pInMsg->msg->endPoint, group.ID ) )
             grpList[grpRspCnt++] = group.ID;
         }
       }
@@ -1440,7 +1525,7 @@ static ZStatus_t zclGeneral_ProcessInGroupsServer( zclIncoming_t *pInMsg )
       break;
       
     case COMMAND_GROUP_REMOVE:
-      if ( aps_RemoveGroup( pInMsg->msg->endPoint, group.ID ) )
+      if ( afRemoveGroup( pInMsg->msg->endPoint, group.ID ) )
         status = ZCL_STATUS_SUCCESS;
       else
         status = ZCL_STATUS_NOT_FOUND;
@@ -1449,7 +1534,7 @@ static ZStatus_t zclGeneral_ProcessInGroupsServer( zclIncoming_t *pInMsg )
       break;
 
     case COMMAND_GROUP_REMOVE_ALL:
-      aps_RemoveAllGroup( pInMsg->msg->endPoint );
+      afRemoveAllGroups( pInMsg->msg->endPoint );
       break;
     
     case COMMAND_GROUP_ADD_IF_IDENTIFYING:
@@ -1463,12 +1548,14 @@ static ZStatus_t zclGeneral_ProcessInGroupsServer( zclIncoming_t *pInMsg )
       {
         pData += 2;   // Move past group ID
         nameLen = *pData++;
+        if ( nameLen > pInMsg->pDataLen - 3 )
+          nameLen = pInMsg->pDataLen - 3;
         if ( nameLen > (APS_GROUP_NAME_LEN-1) )
           nameLen = (APS_GROUP_NAME_LEN-1);
         group.name[0] = nameLen;
         osal_memcpy( &(group.name[1]), pData, nameLen );
         
-        aps_AddGroup( pInMsg->msg->endPoint, &group );
+        afAddGroup( pInMsg->msg->endPoint, &group );
       }
       break;
       
@@ -1511,12 +1598,15 @@ static ZStatus_t zclGeneral_ProcessInGroupsClient( zclIncoming_t *pInMsg )
     case COMMAND_GROUP_VIEW_RSP:
     case COMMAND_GROUP_REMOVE_RSP:
       status = *pData++;
-      group.ID = BUILD_UINT16( pInMsg->pData[0], pInMsg->pData[1] );
+      group.ID = BUILD_UINT16( pData[0], pData[1] );
 
-      if ( status == ZCL_STATUS_SUCCESS && pInMsg->hdr.commandID == COMMAND_GROUP_VIEW_RSP )
+      if ( status == ZCL_STATUS_SUCCESS && pInMsg->hdr.commandID == COMMAND_GROUP_VIEW_RSP &&
+           pInMsg->pDataLen >= 4 )
       {
         pData += 2;   // Move past ID
         nameLen = *pData++;
+        if ( nameLen > pInMsg->pDataLen - 4 )
+          nameLen = pInMsg->pDataLen - 4;
         if ( nameLen > (APS_GROUP_NAME_LEN-1) )
           nameLen = (APS_GROUP_NAME_LEN-1);
         group.name[0] = nameLen;
@@ -1533,6 +1623,10 @@ static ZStatus_t zclGeneral_ProcessInGroupsClient( zclIncoming_t *pInMsg )
     case COMMAND_GROUP_GET_MEMBERSHIP_RSP:
       capacity = *pData++;
       grpCnt = *pData++;
+      if ( grpCnt > (pInMsg->pDataLen - 2) / 2 )
+        grpCnt = (pInMsg->pDataLen - 2) / 2;
+      if ( grpCnt > APS_MAX_GROUPS )
+        grpCnt = APS_MAX_GROUPS;
  
       for ( i = 0; i < grpCnt; i++ )
       {
@@ -1559,46 +1653,43 @@ static ZStatus_t zclGeneral_ProcessInGroupsClient( zclIncoming_t *pInMsg )
 /*********************************************************************
  * @fn      zclGeneral_AddScene
  *
- * @brief   Add a scene for an endpoint
+ * @brief   Add a scene for an endpoint. A scene with the same group and
+ *          scene ID is replaced.
  *
  * @param   endpoint -
  * @param   scene - new scene item
  *
- * @return  ZStatus_t
+ * @return  ZStatus_t - ZMemError if the Scene table is full
  */
 ZStatus_t zclGeneral_AddScene( uint8 endpoint, zclGeneral_Scene_t *scene )
 {
-  zclGenSceneItem_t *pNewItem;
-  zclGenSceneItem_t *pLoop;
-
-  // Fill in the new profile list
-  pNewItem = osal_mem_alloc( sizeof( zclGenSceneItem_t ) );
-  if ( pNewItem == NULL )
-    return ( ZMemError );
-
-  // Fill in the plugin record.
-  pNewItem->next = (zclGenSceneItem_t *)NULL;
-  pNewItem->endpoint = endpoint;
-  osal_memcpy( (uint8*)&(pNewItem->scene), (uint8*)scene, sizeof ( zclGeneral_Scene_t ));
+  zclGeneral_Scene_t *pScene;
+  uint8 slot;
 
-  // Find spot in list
-  if (  zclGenSceneTable == NULL )
+  pScene = zclGeneral_FindScene( endpoint, scene->groupID, scene->ID );
+  if ( pScene != NULL )
   {
-    zclGenSceneTable = pNewItem;
+    slot = zclGeneral_SceneSlot( pScene );
   }
   else
   {
-    // Look for end of list
-    pLoop = zclGenSceneTable;
-    while ( pLoop->next != NULL )
-      pLoop = pLoop->next;
+    // Look for a free slot
+    for ( slot = 0; slot < ZCL_GEN_MAX_SCENES; slot++ )
+    {
+      if ( zclGenSceneTable[slot].endpoint == ZCL_GEN_SCENE_FREE )
+        break;
+    }
+    if ( slot == ZCL_GEN_MAX_SCENES )
+      return ( ZMemError ); // EMBEDDED RETURN
 
-    // Put new item at end of list
-    pLoop->next = pNewItem;
+    zclGenSceneTable[slot].endpoint = endpoint;
+    zclGeneral_SceneIndexAdd( slot );
   }
 
+  osal_memcpy( (uint8*)&(zclGenSceneTable[slot].scene), (uint8*)scene, sizeof ( zclGeneral_Scene_t ));
+
   // Update NV
-  zclGeneral_ScenesWriteNV();
+  zclGeneral_ScenesWriteNV( slot );
   
   return ( ZSuccess );
 }
@@ -1608,7 +1699,7 @@ ZStatus_t zclGeneral_AddScene( uint8 endpoint, zclGeneral_Scene_t *scene )
  *
  * @brief   Find a scene with endpoint and sceneID
  *
- * @param   endpoint -
+ * @param   endpoint - 0xFF for any endpoint
  * @param   groupID - what group the scene belongs to
  * @param   sceneID - ID to look for scene
  *
@@ -1616,18 +1707,30 @@ ZStatus_t zclGeneral_AddScene( uint8 endpoint, zclGeneral_Scene_t *scene )
  */
 zclGeneral_Scene_t *zclGeneral_FindScene( uint8 endpoint, uint16 groupID, uint8 sceneID )
 {
-  zclGenSceneItem_t *pLoop;
+  zclGenSceneItem_t *pItem;
+  uint8 x;
 
-  // Look for end of list
-  pLoop = zclGenSceneTable;
-  while ( pLoop )
+  if ( endpoint == 0xFF )
   {
-    if ( (pLoop->endpoint == endpoint || endpoint == 0xFF)
-        && pLoop->scene.groupID == groupID && pLoop->scene.ID == sceneID )
+    // Any endpoint - the index can't be used
+    for ( x = 0; x < zclGenSceneCnt; x++ )
     {
-      return ( &(pLoop->scene) );
+      pItem = &zclGenSceneTable[zclGenSceneIndex[x]];
+      if ( pItem->scene.groupID == groupID && pItem->scene.ID == sceneID )
+        return ( &(pItem->scene) ); // EMBEDDED RETURN
+    }
+    return ( (zclGeneral_Scene_t *)NULL ); // EMBEDDED RETURN
+  }
+
+  x = zclGeneral_SceneLowerBound( endpoint, groupID, sceneID );
+  if ( x < zclGenSceneCnt )
+  {
+    pItem = &zclGenSceneTable[zclGenSceneIndex[x]];
+    if ( pItem->endpoint == endpoint
+        && pItem->scene.groupID == groupID && pItem->scene.ID == sceneID )
+    {
+      return ( &(pItem->scene) );
     }
-    pLoop = pLoop->next;
   }
 
   return ( (zclGeneral_Scene_t *)NULL );
@@ -1645,16 +1748,17 @@ zclGeneral_Scene_t *zclGeneral_FindScene( uint8 endpoint, uint16 groupID, uint8
  */
 uint8 zclGeneral_FindAllScenesForGroup( uint8 endpoint, uint16 groupID, uint8 *sceneList )
 {
-  zclGenSceneItem_t *pLoop;
+  zclGenSceneItem_t *pItem;
+  uint8 x;
   uint8 cnt = 0;
 
-  // Look for end of list
-  pLoop = zclGenSceneTable;
-  while ( pLoop )
+  // The group's scenes are next to each other in the index
+  for ( x = zclGeneral_SceneLowerBound( endpoint, groupID, 0 ); x < zclGenSceneCnt; x++ )
   {
-    if ( pLoop->endpoint == endpoint && pLoop->scene.groupID == groupID )
-      sceneList[cnt++] = pLoop->scene.ID;
-    pLoop = pLoop->next;
+    pItem = &zclGenSceneTable[zclGenSceneIndex[x]];
+    if ( pItem->endpoint != endpoint || pItem->scene.groupID != groupID )
+      break;
+    sceneList[cnt++] = pItem->scene.ID;
   }
   return ( cnt );
 }
@@ -1672,32 +1776,26 @@ uint8 zclGeneral_FindAllScenesForGroup( uint8 endpoint, uint16 groupID, uint8 *s
  */
 uint8 zclGeneral_RemoveScene( uint8 endpoint, uint16 groupID, uint8 sceneID )
 {
-  zclGenSceneItem_t *pLoop;
-  zclGenSceneItem_t *pPrev;
+  zclGenSceneItem_t *pItem;
+  uint8 x;
+  uint8 slot;
 
-  // Look for end of list
-  pLoop = zclGenSceneTable;
-  pPrev = NULL;
-  while ( pLoop )
+  x = zclGeneral_SceneLowerBound( endpoint, groupID, sceneID );
+  if ( x < zclGenSceneCnt )
   {
-    if ( pLoop->endpoint == endpoint
-        && pLoop->scene.groupID == groupID && pLoop->scene.ID == sceneID )
+    slot = zclGenSceneIndex[x];
+    pItem = &zclGenSceneTable[slot];
+    if ( pItem->endpoint == endpoint
+        && pItem->scene.groupID == groupID && pItem->scene.ID == sceneID )
     {
-      if ( pPrev == NULL )
-        zclGenSceneTable = pLoop->next;
-      else
-        pPrev->next = pLoop->next;
-
-      // Free the memory
-      osal_mem_free( pLoop );
+      zclGeneral_SceneIndexRemove( x );
+      pItem->endpoint = ZCL_GEN_SCENE_FREE;
 
       // Update NV
-      zclGeneral_ScenesWriteNV();
+      zclGeneral_ScenesWriteNV( slot );
   
       return ( TRUE );
     }
-    pPrev = pLoop;
-    pLoop = pLoop->next;
   }
 
   return ( FALSE );
@@ -1715,36 +1813,25 @@ uint8 zclGeneral_RemoveScene( uint8 endpoint, uint16 groupID, uint8 sceneID )
  */
 void zclGeneral_RemoveAllScenes( uint8 endpoint, uint16 groupID )
 {
-  zclGenSceneItem_t *pLoop;
-  zclGenSceneItem_t *pPrev;
-  zclGenSceneItem_t *pNext;
+  zclGenSceneItem_t *pItem;
+  uint8 x;
+  uint8 slot;
 
-  // Look for end of list
-  pLoop = zclGenSceneTable;
-  pPrev = NULL;
-  while ( pLoop )
+  // The group's scenes are next to each other in the index
+  x = zclGeneral_SceneLowerBound( endpoint, groupID, 0 );
+  while ( x < zclGenSceneCnt )
   {
-    if ( pLoop->endpoint == endpoint && pLoop->scene.groupID == groupID )
-    {
-      if ( pPrev == NULL )
-        zclGenSceneTable = pLoop->next;
-      else
-        pPrev->next = pLoop->next;
-      pNext = pLoop->next;
+    slot = zclGenSceneIndex[x];
+    pItem = &zclGenSceneTable[slot];
+    if ( pItem->endpoint != endpoint || pItem->scene.groupID != groupID )
+      break;
 
-      // Free the memory
-      osal_mem_free( pLoop );
-      pLoop = pNext;
-    }
-    else
-    {
-      pPrev = pLoop;
-      pLoop = pLoop->next;
-    }
+    zclGeneral_SceneIndexRemove( x );
+    pItem->endpoint = ZCL_GEN_SCENE_FREE;
+
+    // Update NV
+    zclGeneral_ScenesWriteNV( slot );
   }
-  
-  // Update NV
-  zclGeneral_ScenesWriteNV();
 }
 
 /*********************************************************************
@@ -1758,16 +1845,15 @@ void zclGeneral_RemoveAllScenes( uint8 endpoint, uint16 groupID )
  */
 uint8 zclGeneral_CountScenes( uint8 endpoint )
 {
-  zclGenSceneItem_t *pLoop;
+  uint8 x;
   uint8 cnt = 0;
 
-  // Look for end of list
-  pLoop = zclGenSceneTable;
-  while ( pLoop )
+  // The endpoint's scenes are next to each other in the index
+  for ( x = zclGeneral_SceneLowerBound( endpoint, 0, 0 ); x < zclGenSceneCnt; x++ )
   {
-    if ( pLoop->endpoint == endpoint  )
-      cnt++;
-    pLoop = pLoop->next;
+    if ( zclGenSceneTable[zclGenSceneIndex[x]].endpoint != endpoint )
+      break;
+    cnt++;
   }
   return ( cnt );
 }
@@ -1783,17 +1869,117 @@ uint8 zclGeneral_CountScenes( uint8 endpoint )
  */
 uint8 zclGeneral_CountAllScenes( void )
 {
-  zclGenSceneItem_t *pLoop;
-  uint8 cnt = 0;
+  return ( zclGenSceneCnt );
+}
 
-  // Look for end of list
-  pLoop = zclGenSceneTable;
-  while ( pLoop )
+/*********************************************************************
+ * @fn      zclGeneral_SceneBefore
+ *
+ * @brief   Compare a Scene table entry with an endpoint, group and scene
+ *          ID, in the order of the Scene index.
+ *
+ * @param   pItem - Scene table entry
+ * @param   endpoint -
+ * @param   groupID -
+ * @param   sceneID -
+ *
+ * @return  TRUE if the entry sorts before the endpoint, group and scene ID
+ */
+static uint8 zclGeneral_SceneBefore( zclGenSceneItem_t *pItem, uint8 endpoint,
+                                     uint16 groupID, uint8 sceneID )
+{
+  if ( pItem->endpoint != endpoint )
+    return ( pItem->endpoint < endpoint );
+
+  if ( pItem->scene.groupID != groupID )
+    return ( pItem->scene.groupID < groupID );
+
+  return ( pItem->scene.ID < sceneID );
+}
+
+/*********************************************************************
+ * @fn      zclGeneral_SceneLowerBound
+ *
+ * @brief   Binary search of the Scene index.
+ *
+ * @param   endpoint -
+ * @param   groupID -
+ * @param   sceneID -
+ *
+ * @return  position in the index of the first entry that doesn't sort
+ *          before the endpoint, group and scene ID
+ */
+static uint8 zclGeneral_SceneLowerBound( uint8 endpoint, uint16 groupID, uint8 sceneID )
+{
+  uint8 low = 0;
+  uint8 high = zclGenSceneCnt;
+  uint8 mid;
+
+  while ( low < high )
   {
-    cnt++;
-    pLoop = pLoop->next;
+    mid = low + ((high - low) >> 1);
+    if ( zclGeneral_SceneBefore( &zclGenSceneTable[zclGenSceneIndex[mid]],
+                                 endpoint, groupID, sceneID ) )
+      low = mid + 1;
+    else
+      high = mid;
   }
-  return ( cnt );
+
+  return ( low );
+}
+
+/*********************************************************************
+ * @fn      zclGeneral_SceneIndexAdd
+ *
+ * @brief   Put a Scene table slot in the index
+ *
+ * @param   slot - slot, endpoint and scene already filled in
+ *
+ * @return  none
+ */
+static void zclGeneral_SceneIndexAdd( uint8 slot )
+{
+  zclGenSceneItem_t *pItem = &zclGenSceneTable[slot];
+  uint8 pos;
+  uint8 x;
+
+  pos = zclGeneral_SceneLowerBound( pItem->endpoint, pItem->scene.groupID, pItem->scene.ID );
+  for ( x = zclGenSceneCnt; x > pos; x-- )
+    zclGenSceneIndex[x] = zclGenSceneIndex[x-1];
+
+  zclGenSceneIndex[pos] = slot;
+  zclGenSceneCnt++;
+}
+
+/*********************************************************************
+ * @fn      zclGeneral_SceneIndexRemove
+ *
+ * @brief   Take an entry out of the Scene index
+ *
+ * @param   pos - position in the index
+ *
+ * @return  none
+ */
+static void zclGeneral_SceneIndexRemove( uint8 pos )
+{
+  zclGenSceneCnt--;
+  for ( ; pos < zclGenSceneCnt; pos++ )
+    zclGenSceneIndex[pos] = zclGenSceneIndex[pos+1];
+}
+
+/*********************************************************************
+ * @fn      zclGeneral_SceneSlot
+ *
+ * @brief   Find the Scene table slot holding a scene
+ *
+ * @param   pScene - scene returned by zclGeneral_FindScene()
+ *
+ * @return  slot number
+ */
+static uint8 zclGeneral_SceneSlot( zclGeneral_Scene_t *pScene )
+{
+  return ( (uint8)(((uint8 *)pScene - (uint8 *)&(zclGenSceneTable[0].scene))
+                   / sizeof( zclGenSceneItem_t )) );
 }
 
 /*********************************************************************
@@ -1818,11 +2004,17 @@ static ZStatus_t zclGeneral_ProcessInScenesServer( zclIncoming_t *pInMsg )
   uint8 sendRsp = FALSE;
   ZStatus_t stat = ZSuccess;
 
+  // Every known command starts with a group ID, the payload table checked
+  // its length; the unknown ones may not even have that.
+  if ( pInMsg->hdr.commandID > COMMAND_SCENE_GET_MEMBERSHIP )
+    return ( ZFailure ); // EMBEDDED RETURN
+
   osal_memset( (uint8*)&scene, 0, sizeof( zclGeneral_Scene_t ) );
 
   scene.groupID = BUILD_UINT16( pData[0], pData[1] );
   pData += 2;   // Move past group ID
-  scene.ID = *pData++;
+  if ( pInMsg->pDataLen >= 3 ) // Not in Remove All and Get Membership
+    scene.ID = *pData++;
   
   switch ( pInMsg->hdr.commandID )
   {
@@ -1831,10 +2023,12 @@ static ZStatus_t zclGeneral_ProcessInScenesServer( zclIncoming_t *pInMsg )
       scene.transTime = BUILD_UINT16( pData[0], pData[1] );
       pData += 2;
       nameLen= *pData++; // Name length
-      if ( nameLen > (ZCL_GEN_SCENE_NAME_LEN-1) )
-        nameLen = (ZCL_GEN_SCENE_NAME_LEN-1);
+      if ( nameLen > pInMsg->pDataLen - 6 )
+        nameLen = pInMsg->pDataLen - 6;
       scene.name[0] = nameLen;
-      osal_memcpy( &(scene.name[1]), pData, nameLen );
+      if ( scene.name[0] > (ZCL_GEN_SCENE_NAME_LEN-1) )
+        scene.name[0] = (ZCL_GEN_SCENE_NAME_LEN-1);
+      osal_memcpy( &(scene.name[1]), pData, scene.name[0] );
       pData += nameLen; // move pass name
 
       scene.extLen = pInMsg->pDataLen - ( (uint8)( (uint16)pData - (uint16)pInMsg->pData ) );
@@ -1866,7 +2060,7 @@ static ZStatus_t zclGeneral_ProcessInScenesServer( zclIncoming_t *pInMsg )
             pScene->extLen = scene.extLen;
             
             // Update NV
-            zclGeneral_ScenesWriteNV();
+            zclGeneral_ScenesWriteNV( zclGeneral_SceneSlot( pScene ) );
           }
           else
           {
@@ -1985,7 +2179,7 @@ static ZStatus_t zclGeneral_ProcessInScenesServer( zclIncoming_t *pInMsg )
           else if ( sceneChanged )
           {
             // The Scene already exists so update only NV
-            zclGeneral_ScenesWriteNV();
+            zclGeneral_ScenesWriteNV( zclGeneral_SceneSlot( pScene ) );
           }
         }
         else
@@ -2078,6 +2272,13 @@ static ZStatus_t zclGeneral_ProcessInScenesClient( zclIncoming_t *pInMsg )
   uint8 i;
   ZStatus_t stat = ZSuccess;
 
+  // Every known response starts with a status and a group ID, the payload
+  // table checked its length; the unknown ones (Recall has no response)
+  // may not even have those.
+  if ( pInMsg->hdr.commandID > COMMAND_SCENE_GET_MEMBERSHIP_RSP ||
+       pInMsg->hdr.commandID == COMMAND_SCENE_RECALL )
+    return ( ZFailure ); // EMBEDDED RETURN
+
   osal_memset( (uint8*)&scene, 0, sizeof( zclGeneral_Scene_t ) );
 
   // Get the status field first
@@ -2086,7 +2287,7 @@ static ZStatus_t zclGeneral_ProcessInScenesClient( zclIncoming_t *pInMsg )
   if ( pInMsg->hdr.commandID == COMMAND_SCENE_GET_MEMBERSHIP_RSP )
     capacity = *pData++;
 
-  scene.groupID = BUILD_UINT16( pInMsg->pData[0], pInMsg->pData[1] );
+  scene.groupID = BUILD_UINT16( pData[0], pData[1] );
   pData += 2;   // Move past group ID
 
   switch ( pInMsg->hdr.commandID )
@@ -2094,14 +2295,19 @@ static ZStatus_t zclGeneral_ProcessInScenesClient( zclIncoming_t *pInMsg )
     case COMMAND_SCENE_VIEW_RSP:
       // Parse the rest of the incoming message
       scene.ID = *pData++; // Not applicable to Remove All Response command
-      scene.transTime = BUILD_UINT16( pInMsg->pData[0], pInMsg->pData[1] );
-      pData += 2;
-      nameLen = *pData++; // Name length
-      if ( nameLen > (ZCL_GEN_SCENE_NAME_LEN-1) )
-        nameLen = (ZCL_GEN_SCENE_NAME_LEN-1);
-      scene.name[0] = nameLen;
-      osal_memcpy( &(scene.name[1]), pData, nameLen );
-      pData += nameLen; // move pass name
+      if ( status == ZCL_STATUS_SUCCESS && pInMsg->pDataLen >= 7 )
+      {
+        scene.transTime = BUILD_UINT16( pData[0], pData[1] );
+        pData += 2;
+        nameLen = *pData++; // Name length
+        if ( nameLen > pInMsg->pDataLen - 7 )
+          nameLen = pInMsg->pDataLen - 7;
+        if ( nameLen > (ZCL_GEN_SCENE_NAME_LEN-1) )
+          nameLen = (ZCL_GEN_SCENE_NAME_LEN-1);
+        scene.name[0] = nameLen;
+        osal_memcpy( &(scene.name[1]), pData, nameLen );
+        pData += nameLen; // move pass name
+      }
 
       //*** Do something with the extension field(s)
 
@@ -2120,9 +2326,13 @@ static ZStatus_t zclGeneral_ProcessInScenesClient( zclIncoming_t *pInMsg )
       break;
       
     case COMMAND_SCENE_GET_MEMBERSHIP_RSP:
-      if ( status == ZCL_STATUS_SUCCESS )
+      if ( status == ZCL_STATUS_SUCCESS && pInMsg->pDataLen >= 5 )
       {
         sceneCnt = *pData++;
+        if ( sceneCnt > pInMsg->pDataLen - 5 )
+          sceneCnt = pInMsg->pDataLen - 5;
+        if ( sceneCnt > ZCL_GEN_MAX_SCENES )
+          sceneCnt = ZCL_GEN_MAX_SCENES;
         for ( i = 0; i < sceneCnt; i++ )
           sceneList[i] = *pData++;
       }
@@ -2191,6 +2401,10 @@ static ZStatus_t zclGeneral_ProcessInLevelControl( zclIncoming_t *pInMsg )
 
   if ( zcl_ServerCmd( pInMsg->hdr.fc.direction ) )
   {
+#ifdef ZCL_TRANSITION
+    zclGeneral_LevelControlTransition( pInMsg );
+#endif // ZCL_TRANSITION
+
     pCBs = zclGeneral_FindCallbacks( pInMsg->msg->endPoint );
     if ( pCBs )
     {
@@ -2227,6 +2441,73 @@ static ZStatus_t zclGeneral_ProcessInLevelControl( zclIncoming_t *pInMsg )
   
   return ( stat );
 }
+
+#ifdef ZCL_TRANSITION
+/*********************************************************************
+ * @fn      zclGeneral_LevelControlTransition
+ *
+ * @brief   Run a received Level Control command on the Current Level
+ *          attribute, if the endpoint registered it.
+ *
+ * @param   pInMsg - pointer to the incoming message
+ *
+ * @return  none
+ */
+static void zclGeneral_LevelControlTransition( zclIncoming_t *pInMsg )
+{
+  const zclAttrRec_t GENERIC *pAttr;
+  uint8 endpoint = pInMsg->msg->endPoint;
+  uint16 clusterID = pInMsg->msg->clusterId;
+  uint8 mode;
+  uint16 level;
+
+  switch ( pInMsg->hdr.commandID )
+  {
+    case COMMAND_LEVEL_MOVE_TO_LEVEL:
+      zcl_StartTransition( endpoint, clusterID, ATTRID_LEVEL_CURRENT_LEVEL,
+                           ATTRID_LEVEL_REMAINING_TIME, ZCL_GEN_LEVEL_MAX, pInMsg->pData[0],
+                           BUILD_UINT16( pInMsg->pData[1], pInMsg->pData[2] ), 0 );
+      break;
+
+    case COMMAND_LEVEL_MOVE:
+      mode = pInMsg->pData[0];
+      if ( mode == LEVEL_MOVE_STOP )
+      {
+        zcl_StopTransition( endpoint, clusterID, ATTRID_LEVEL_CURRENT_LEVEL );
+      }
+      else
+      {
+        zcl_StartMove( endpoint, clusterID, ATTRID_LEVEL_CURRENT_LEVEL,
+                       ATTRID_LEVEL_REMAINING_TIME, ZCL_GEN_LEVEL_MAX, pInMsg->pData[1],
+                       ( mode == LEVEL_MOVE_DOWN || mode == LEVEL_MOVE_DOWN_AND_OFF ) ?
+                       ZCL_TRANSITION_DOWN : ZCL_TRANSITION_UP );
+      }
+      break;
+
+    case COMMAND_LEVEL_STEP:
+      mode = pInMsg->pData[0];
+      pAttr = zclFindAttrRec( endpoint, clusterID, ATTRID_LEVEL_CURRENT_LEVEL );
+      if ( pAttr && pAttr->attr.dataType == ZCL_DATATYPE_UINT8 )
+      {
+        level = *((uint8 *)pAttr->attr.dataPtr);
+        if ( mode == LEVEL_STEP_DOWN || mode == LEVEL_STEP_DOWN_AND_OFF )
+          level = ( level > pInMsg->pData[1] ) ? level - pInMsg->pData[1] : 0;
+        else if ( level + pInMsg->pData[1] > ZCL_GEN_LEVEL_MAX )
+          level = ZCL_GEN_LEVEL_MAX;
+        else
+          level += pInMsg->pData[1];
+
+        zcl_StartTransition( endpoint, clusterID, ATTRID_LEVEL_CURRENT_LEVEL,
+                             ATTRID_LEVEL_REMAINING_TIME, ZCL_GEN_LEVEL_MAX, (uint8)level,
+                             BUILD_UINT16( pInMsg->pData[2], pInMsg->pData[3] ), 0 );
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+#endif // ZCL_TRANSITION
 #endif // ZCL_LEVEL_CTRL
 
 #ifdef ZCL_ALARMS
@@ -2518,26 +2799,38 @@ static ZStatus_t zclGeneral_ProcessInAlarmsClient( zclIncoming_t *pInMsg )
       pCBs = zclGeneral_FindCallbacks( pInMsg->msg->endPoint );
       if ( pCBs && pCBs->pfnAlarm )
       {
-        status = *pData++;
         alarmCode = *pData++;
         clusterID = BUILD_UINT16( pData[0], pData[1] );
-        pData += 2;
-        timeStamp = BUILD_UINT32( pData[0], pData[1], pData[2], pData[3] );
       
         pCBs->pfnAlarm( &(pInMsg->msg->srcAddr), pInMsg->hdr.commandID, 
-                        status, alarmCode, clusterID, timeStamp );
+                        0, alarmCode, clusterID, 0 );
       }
       break;  
       
     case COMMAND_ALARMS_GET_RSP: 
+      status = *pData++;
+      if ( status == ZCL_STATUS_SUCCESS && pInMsg->pDataLen < 8 )
+      {
+        stat = ZCL_STATUS_MALFORMED_COMMAND;
+        break;
+      }
+
       pCBs = zclGeneral_FindCallbacks( pInMsg->msg->endPoint );
       if ( pCBs && pCBs->pfnAlarm )
       {
-        alarmCode = *pData++;
-        clusterID = BUILD_UINT16( pData[0], pData[1] );
+        alarmCode = 0;
+        clusterID = 0;
+        timeStamp = 0;
+        if ( status == ZCL_STATUS_SUCCESS )
+        {
+          alarmCode = *pData++;
+          clusterID = BUILD_UINT16( pData[0], pData[1] );
+          pData += 2;
+          timeStamp = BUILD_UINT32( pData[0], pData[1], pData[2], pData[3] );
+        }
       
         pCBs->pfnAlarm( &(pInMsg->msg->srcAddr), pInMsg->hdr.commandID, 
-                        0, alarmCode, clusterID, 0 );
+                        status, alarmCode, clusterID, timeStamp );
       }
       break;
    
@@ -2625,7 +2918,14 @@ static ZStatus_t zclGeneral_ProcessInLocationServer( zclIncoming_t *pInMsg )
       loc.numResponses = *pData++;
       
       if ( loc.brdcastResponse == 0 ) // command is sent as a unicast
+      {
+        if ( pInMsg->pDataLen < (2 + Z_EXTADDR_LEN) )
+        {
+          stat = ZCL_STATUS_MALFORMED_COMMAND;
+          break;
+        }
         osal_cpyExtAddr( loc.targetAddr, pData );
+      }
       
       pCBs = zclGeneral_FindCallbacks( pInMsg->msg->endPoint );
       if ( pCBs && pCBs->pfnLocation )
@@ -2644,6 +2944,38 @@ static ZStatus_t zclGeneral_ProcessInLocationServer( zclIncoming_t *pInMsg )
   return ( stat );
 }
 
+/*********************************************************************
+ * @fn      zclGeneral_LocationDataLen
+ *
+ * @brief   Length of the Location Data field of a received Location
+ *          Data Response or Notification, Location Type included.
+ *
+ * @param   cmd - command ID
+ * @param   type - Location Type
+ *
+ * @return  field length
+ */
+static uint8 zclGeneral_LocationDataLen( uint8 cmd, uint8 type )
+{
+  uint8 len = 1 + 2 + 2; // Location Type + Coordinates 1 and 2
+
+  if ( locationType2D( type ) == 0 )
+    len += 2; // Coordinate 3
+
+  if ( cmd != COMMAND_LOCATION_COMPACT_DATA_NOTIF )
+    len += 2 + 2; // Power + Path Loss Exponent
+
+  if ( locationTypeAbsolute( type ) == 0 )
+  {
+    if ( cmd != COMMAND_LOCATION_COMPACT_DATA_NOTIF )
+      len += 1; // Location Method
+
+    len += 1 + 2; // Quality Measure + Location Age
+  }
+
+  return ( len );
+}
+
 /*********************************************************************
  * @fn      zclGeneral_ProcessInLocationDataRsp
  *
@@ -2657,6 +2989,7 @@ static void zclGeneral_ProcessInLocationDataRsp( zclIncoming_t *pInMsg )
 {
   zclGeneral_AppCallbacks_t *pCBs;
   uint8 *pData = pInMsg->pData;
+  uint8 *pEnd = pInMsg->pData + pInMsg->pDataLen;
   zclLocationDataRsp_t loc;
 
   pCBs = zclGeneral_FindCallbacks( pInMsg->msg->endPoint );
@@ -2668,6 +3001,11 @@ static void zclGeneral_ProcessInLocationDataRsp( zclIncoming_t *pInMsg )
     if ( pInMsg->hdr.commandID != COMMAND_LOCATION_DATA_RSP || 
          loc.status == ZCL_STATUS_SUCCESS )
     {
+      // Make sure the whole Location Data field is there
+      if ( pData >= pEnd || 
+           (pEnd - pData) < zclGeneral_LocationDataLen( pInMsg->hdr.commandID, *pData ) )
+        return; // EMBEDDED RETURN
+
       loc.data.type = *pData++;
       loc.data.absLoc.coordinate1 = BUILD_UINT16( pData[0], pData[1] );
       pData += 2;
@@ -2727,7 +3065,7 @@ static ZStatus_t zclGeneral_ProcessInLocationClient( zclIncoming_t *pInMsg )
         zclLocationDevCfgRsp_t devCfgRsp;
 
         devCfgRsp.status = *pData++;
-        if ( devCfgRsp.status == ZCL_STATUS_SUCCESS )
+        if ( devCfgRsp.status == ZCL_STATUS_SUCCESS && pInMsg->pDataLen >= 10 )
         {
           devCfgRsp.data.power = BUILD_UINT16( pData[0], pData[1] );
           pData += 2;
@@ -2823,46 +3161,50 @@ static void zclGeneral_ScenesSetDefaultNV( void )
 /*********************************************************************
  * @fn          zclGeneral_ScenesWriteNV
  *
- * @brief       Save the Scene Table in NV
+ * @brief       Save one Scene table slot in NV. The slots past the
+ *              ones kept in NV are free, a slot there is only written
+ *              once used and then added to the header count.
  *
- * @param       none
+ * @param       slot - Scene table slot
  *
  * @return      none
  */
-static void zclGeneral_ScenesWriteNV( void )
+static void zclGeneral_ScenesWriteNV( uint8 slot )
 {
   nvGenScenesHdr_t hdr;
-  zclGenSceneItem_t *pLoop;
   zclGenSceneNVItem_t item;
-  
-  hdr.numRecs = 0;
-  
-  // Look for end of list
-  pLoop = zclGenSceneTable;
-  while ( pLoop )
-  {
-    // Build the record
-    item.endpoint = pLoop->endpoint;
-    osal_memcpy( &(item.scene), &(pLoop->scene), sizeof ( zclGeneral_Scene_t ) );
+
+  if ( slot >= ZCL_GEN_MAX_SCENES )
+    return; // EMBEDDED RETURN
+
+  if ( (slot >= zclGenSceneNVCnt) &&
+       (zclGenSceneTable[slot].endpoint == ZCL_GEN_SCENE_FREE) )
+    return; // EMBEDDED RETURN
+
+  // Build the record
+  item.endpoint = zclGenSceneTable[slot].endpoint;
+  osal_memcpy( &(item.scene), &(zclGenSceneTable[slot].scene), sizeof ( zclGeneral_Scene_t ) );
     
-    // Save the record to NV
-    osal_nv_write( ZCD_NV_SCENE_TABLE,
-            (uint16)((sizeof( nvGenScenesHdr_t )) + (hdr.numRecs * sizeof ( zclGenSceneNVItem_t ))),
+  // Save the record to NV
+  osal_nv_write( ZCD_NV_SCENE_TABLE,
+            (uint16)((sizeof( nvGenScenesHdr_t )) + (slot * sizeof ( zclGenSceneNVItem_t ))),
                     sizeof ( zclGenSceneNVItem_t ), &item );
-    
-    hdr.numRecs++;
-    
-    pLoop = pLoop->next;
-  }
 
-  // Save off the header
-  osal_nv_write( ZCD_NV_SCENE_TABLE, 0, sizeof( nvGenScenesHdr_t ), &hdr );
+  if ( slot >= zclGenSceneNVCnt )
+  {
+    // The record is in place, count it in
+    zclGenSceneNVCnt = slot + 1;
+    hdr.numRecs = zclGenSceneNVCnt;
+    osal_nv_write( ZCD_NV_SCENE_TABLE, 0, sizeof( nvGenScenesHdr_t ), &hdr );
+  }
 }
 
 /*********************************************************************
  * @fn          zclGeneral_ScenesRestoreFromNV
  *
- * @brief       Restore the Scene table from NV
+ * @brief       Restore the Scene table from NV. Only the slots counted
+ *              in the header are read, the rest are free. A table saved
+ *              as a packed list is the same as its first slots in use.
  *
  * @param       none
  *
@@ -2870,7 +3212,7 @@ static void zclGeneral_ScenesWriteNV( void )
  */
 static uint16 zclGeneral_ScenesRestoreFromNV( void )
 {
-  uint16 x;
+  uint8 x;
   nvGenScenesHdr_t hdr;
 
   zclGenSceneNVItem_t item;
@@ -2878,18 +3220,23 @@ static uint16 zclGeneral_ScenesRestoreFromNV( void )
 
   if ( osal_nv_read( ZCD_NV_SCENE_TABLE, 0, sizeof(nvGenScenesHdr_t), &hdr ) == ZSuccess )
   {
-    // Read in the device list
-    for ( x = 0; x < hdr.numRecs; x++ )
+    zclGenSceneNVCnt = ( hdr.numRecs < ZCL_GEN_MAX_SCENES ) ?
+                       (uint8)hdr.numRecs : ZCL_GEN_MAX_SCENES;
+
+    // Read in the slots
+    for ( x = 0; x < zclGenSceneNVCnt; x++ )
     {
       if ( osal_nv_read( ZCD_NV_SCENE_TABLE,
                 (uint16)(sizeof(nvGenScenesHdr_t) + (x * sizeof ( zclGenSceneNVItem_t ))),
-                                  sizeof ( zclGenSceneNVItem_t ), &item ) == ZSUCCESS )
+                                  sizeof ( zclGenSceneNVItem_t ), &item ) == ZSUCCESS 
+                && item.endpoint != ZCL_GEN_SCENE_FREE 
+                && zclGeneral_FindScene( item.endpoint, item.scene.groupID, item.scene.ID ) == NULL )
       {
         // Add the scene
-        if ( zclGeneral_AddScene( item.endpoint, &(item.scene) ) == ZSuccess )
-        {
-          numAdded++;
-        }
+        zclGenSceneTable[x].endpoint = item.endpoint;
+        osal_memcpy( &(zclGenSceneTable[x].scene), &(item.scene), sizeof ( zclGeneral_Scene_t ) );
+        zclGeneral_SceneIndexAdd( x );
+        numAdded++;
       }
     }
   }
@@ -277,6 +277,9 @@ static ZStatus_t zclHVAC_ProcessInThermostatCmds( zclIncoming_t *pInMsg )
   if  ( pInMsg->hdr.commandID != COMMAND_THERMOSTAT_SETPOINT_RAISE_LOWER )
     return (ZFailure);   // Error ignore the command
 
+  if ( pInMsg->pDataLen < 2 ) // Mode + Amount
+    return ( ZCL_STATUS_MALFORMED_COMMAND );
+
   pCBs = zclHVAC_FindCallbacks( pInMsg->msg->endPoint );
   if ( pCBs && pCBs->pfnHVAC_SetpointRaiseLower )
     pCBs->pfnHVAC_SetpointRaiseLower( pInMsg->pData[0], pInMsg->pData[1] );
@@ -33,6 +33,7 @@
 /*********************************************************************
  * CONSTANTS
  */
+#define LIGHTING_COLOR_CONTROL_MAX_VALUE    0xFE  // Highest hue and saturation
 
 /*********************************************************************
  * TYPEDEFS
@@ -58,6 +59,29 @@ typedef struct zclLightingCBRec
 static zclLightingCBRec_t *zclLightingCBs = (zclLightingCBRec_t *)NULL;
 static uint8 zclLightingPluginRegisted = FALSE;
 
+// Shortest payload of the commands that carry one
+static CONST zclCmdLen_t zclLightingCmdLen[] =
+{
+  { ZCL_LIGHTING_LOGICAL_CLUSTER_ID_COLOR_CONTROL, ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_LIGHTING_MOVE_TO_HUE,                4 },
+  { ZCL_LIGHTING_LOGICAL_CLUSTER_ID_COLOR_CONTROL, ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_LIGHTING_MOVE_HUE,                   2 },
+  { ZCL_LIGHTING_LOGICAL_CLUSTER_ID_COLOR_CONTROL, ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_LIGHTING_STEP_HUE,                   4 },
+  { ZCL_LIGHTING_LOGICAL_CLUSTER_ID_COLOR_CONTROL, ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_LIGHTING_MOVE_TO_SATURATION,         3 },
+  { ZCL_LIGHTING_LOGICAL_CLUSTER_ID_COLOR_CONTROL, ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_LIGHTING_MOVE_SATURATION,            2 },
+  { ZCL_LIGHTING_LOGICAL_CLUSTER_ID_COLOR_CONTROL, ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_LIGHTING_STEP_SATURATION,            4 },
+  { ZCL_LIGHTING_LOGICAL_CLUSTER_ID_COLOR_CONTROL, ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_LIGHTING_MOVE_TO_HUE_AND_SATURATION, 4 },
+};
+
+#ifdef ZCL_TRANSITION
+// Transition options for each Move to Hue direction
+static CONST uint8 zclLighting_HueDirection[] =
+{
+  ZCL_TRANSITION_WRAP | ZCL_TRANSITION_SHORTEST,  // SHORTEST_DISTANCE
+  ZCL_TRANSITION_WRAP | ZCL_TRANSITION_LONGEST,   // LONGEST_DISTANCE
+  ZCL_TRANSITION_WRAP | ZCL_TRANSITION_UP,        // UP
+  ZCL_TRANSITION_WRAP | ZCL_TRANSITION_DOWN       // DOWN
+};
+#endif // ZCL_TRANSITION
+
 /*********************************************************************
  * LOCAL FUNCTIONS
  */
@@ -75,6 +99,15 @@ static void zclLighting_ProcessInCmd_ColorControl_MoveSaturation( zclIncoming_t
 static void zclLighting_ProcessInCmd_ColorControl_StepSaturation( zclIncoming_t *pInMsg );
 static void zclLighting_ProcessInCmd_ColorControl_MoveToHueAndSaturation( zclIncoming_t *pInMsg );
 
+#ifdef ZCL_TRANSITION
+static void zclLighting_MoveTo( zclIncoming_t *pInMsg, uint16 attrId, uint8 target,
+                                uint16 transitionTime, uint8 options );
+static void zclLighting_Move( zclIncoming_t *pInMsg, uint16 attrId, uint8 stop,
+                              uint8 down, uint8 rate, uint8 wrap );
+static void zclLighting_Step( zclIncoming_t *pInMsg, uint16 attrId, uint8 down,
+                              uint8 stepSize, uint16 transitionTime, uint8 wrap );
+#endif // ZCL_TRANSITION
+
 
 /*********************************************************************
  * @fn      zclLighting_RegisterCmdCallbacks
@@ -397,6 +430,12 @@ static ZStatus_t zclLighting_HdlInSpecificCommands( zclIncoming_t *pInMsg, uint1
 {
   ZStatus_t stat = ZSuccess;
 
+  if ( zcl_CmdPayloadOk( pInMsg, logicalClusterID, zclLightingCmdLen,
+                         sizeof( zclLightingCmdLen ) / sizeof( zclCmdLen_t ) ) == FALSE )
+  {
+    return ( ZCL_STATUS_MALFORMED_COMMAND ); // EMBEDDED RETURN
+  }
+
   switch ( logicalClusterID )				
   {
     case ZCL_LIGHTING_LOGICAL_CLUSTER_ID_COLOR_CONTROL:
@@ -427,6 +466,10 @@ static ZStatus_t zclLighting_ProcessInColorControlCmds( zclIncoming_t *pInMsg )
 {
   ZStatus_t stat = ZSuccess;
 
+  // All the Color Control commands go to the server
+  if ( zcl_ServerCmd( pInMsg->hdr.fc.direction ) == FALSE )
+    return ( ZFailure ); // EMBEDDED RETURN
+
   switch ( pInMsg->hdr.commandID )				
   {
     case COMMAND_LIGHTING_MOVE_TO_HUE:
@@ -481,12 +524,19 @@ static void zclLighting_ProcessInCmd_ColorControl_MoveToHue( zclIncoming_t *pInM
   if  ( pInMsg->hdr.commandID != COMMAND_LIGHTING_MOVE_TO_HUE )
     return;   // Error ignore the command
 
+  transitionTime = BUILD_UINT16( pInMsg->pData[2], pInMsg->pData[3] );
+
   pCBs = zclLighting_FindCallbacks( pInMsg->msg->endPoint );
   if ( pCBs && pCBs->pfnColorControl_MoveToHue )
-  {
-    transitionTime = BUILD_UINT16( pInMsg->pData[2], pInMsg->pData[3] );
     pCBs->pfnColorControl_MoveToHue( pInMsg->pData[0], pInMsg->pData[1], transitionTime );
+
+#ifdef ZCL_TRANSITION
+  if ( pInMsg->pData[1] <= LIGHTING_MOVE_TO_HUE_DIRECTION_DOWN )
+  {
+    zclLighting_MoveTo( pInMsg, ATTRID_LIGHTING_COLOR_CONTROL_CURRENT_HUE, pInMsg->pData[0], transitionTime,
+                        zclLighting_HueDirection[pInMsg->pData[1]] );
   }
+#endif // ZCL_TRANSITION
 }
 
 /*********************************************************************
@@ -515,6 +565,11 @@ static void zclLighting_ProcessInCmd_ColorControl_MoveHue( zclIncoming_t *pInMsg
     pCBs = zclLighting_FindCallbacks( pInMsg->msg->endPoint );
     if ( pCBs && pCBs->pfnColorControl_MoveHue )
       pCBs->pfnColorControl_MoveHue( moveMode, rate );
+
+#ifdef ZCL_TRANSITION
+    zclLighting_Move( pInMsg, ATTRID_LIGHTING_COLOR_CONTROL_CURRENT_HUE, ( moveMode == LIGHTING_MOVE_HUE_STOP ),
+                      ( moveMode == LIGHTING_MOVE_HUE_DOWN ), rate, TRUE );
+#endif // ZCL_TRANSITION
   }
   else
   {
@@ -543,12 +598,16 @@ static void zclLighting_ProcessInCmd_ColorControl_StepHue( zclIncoming_t *pInMsg
   if  ( pInMsg->hdr.commandID != COMMAND_LIGHTING_STEP_HUE )
     return;   // Error ignore the command
 
+  transitionTime = BUILD_UINT16( pInMsg->pData[2], pInMsg->pData[3] );
+
   pCBs = zclLighting_FindCallbacks( pInMsg->msg->endPoint );
   if ( pCBs && pCBs->pfnColorControl_StepHue )
-  {
-    transitionTime = BUILD_UINT16( pInMsg->pData[2], pInMsg->pData[3] );
     pCBs->pfnColorControl_StepHue( pInMsg->pData[0], pInMsg->pData[1], transitionTime );
-  }
+
+#ifdef ZCL_TRANSITION
+  zclLighting_Step( pInMsg, ATTRID_LIGHTING_COLOR_CONTROL_CURRENT_HUE, ( pInMsg->pData[0] == LIGHTING_STEP_HUE_DOWN ),
+                    pInMsg->pData[1], transitionTime, TRUE );
+#endif // ZCL_TRANSITION
 }
 
 /*********************************************************************
@@ -567,12 +626,15 @@ static void zclLighting_ProcessInCmd_ColorControl_MoveToSaturation( zclIncoming_
   if  ( pInMsg->hdr.commandID != COMMAND_LIGHTING_MOVE_TO_SATURATION )
     return;   // Error ignore the command
 
+  transitionTime = BUILD_UINT16( pInMsg->pData[1], pInMsg->pData[2] );
+
   pCBs = zclLighting_FindCallbacks( pInMsg->msg->endPoint );
   if ( pCBs && pCBs->pfnColorControl_MoveToSaturation )
-  {
-    transitionTime = BUILD_UINT16( pInMsg->pData[1], pInMsg->pData[2] );
     pCBs->pfnColorControl_MoveToSaturation( pInMsg->pData[0], transitionTime );
-  }
+
+#ifdef ZCL_TRANSITION
+  zclLighting_MoveTo( pInMsg, ATTRID_LIGHTING_COLOR_CONTROL_CURRENT_SATURATION, pInMsg->pData[0], transitionTime, 0 );
+#endif // ZCL_TRANSITION
 }
 
 /*********************************************************************
@@ -601,6 +663,11 @@ static void zclLighting_ProcessInCmd_ColorControl_MoveSaturation( zclIncoming_t
     pCBs = zclLighting_FindCallbacks( pInMsg->msg->endPoint );
     if ( pCBs && pCBs->pfnColorControl_MoveSaturation )
       pCBs->pfnColorControl_MoveSaturation( moveMode, rate );
+
+#ifdef ZCL_TRANSITION
+    zclLighting_Move( pInMsg, ATTRID_LIGHTING_COLOR_CONTROL_CURRENT_SATURATION, ( moveMode == LIGHTING_MOVE_SATURATION_STOP ),
+                      ( moveMode == LIGHTING_MOVE_SATURATION_DOWN ), (uint8)rate, FALSE );
+#endif // ZCL_TRANSITION
   }
   else
   {
@@ -629,13 +696,19 @@ static void zclLighting_ProcessInCmd_ColorControl_StepSaturation( zclIncoming_t
   if  ( pInMsg->hdr.commandID != COMMAND_LIGHTING_STEP_SATURATION )
     return;   // Error ignore the command
 
+  transitionTime = BUILD_UINT16( pInMsg->pData[2], pInMsg->pData[3] );
+
   pCBs = zclLighting_FindCallbacks( pInMsg->msg->endPoint );
   if ( pCBs && pCBs->pfnColorControl_StepSaturation )
   { 
-    transitionTime = BUILD_UINT16( pInMsg->pData[2], pInMsg->pData[3] );
     pCBs->pfnColorControl_StepSaturation( pInMsg->pData[0], pInMsg->pData[1],
                                           transitionTime );
   }
+
+#ifdef ZCL_TRANSITION
+  zclLighting_Step( pInMsg, ATTRID_LIGHTING_COLOR_CONTROL_CURRENT_SATURATION, ( pInMsg->pData[0] == LIGHTING_STEP_SATURATION_DOWN ),
+                    pInMsg->pData[1], transitionTime, FALSE );
+#endif // ZCL_TRANSITION
 }
 
 /*********************************************************************
@@ -654,14 +727,127 @@ static void zclLighting_ProcessInCmd_ColorControl_MoveToHueAndSaturation( zclInc
   if  ( pInMsg->hdr.commandID != COMMAND_LIGHTING_MOVE_TO_HUE_AND_SATURATION )
     return;   // Error ignore the command
 
+  transitionTime = BUILD_UINT16( pInMsg->pData[2], pInMsg->pData[3] );
+
   pCBs = zclLighting_FindCallbacks( pInMsg->msg->endPoint );
   if ( pCBs && pCBs->pfnColorControl_MoveToHueAndSaturation )
   {
-    transitionTime = BUILD_UINT16( pInMsg->pData[2], pInMsg->pData[3] );
     pCBs->pfnColorControl_MoveToHueAndSaturation( pInMsg->pData[0], pInMsg->pData[1],
                                                   transitionTime );
   }
+
+#ifdef ZCL_TRANSITION
+  // Both run from the same tick, so they end together
+  zclLighting_MoveTo( pInMsg, ATTRID_LIGHTING_COLOR_CONTROL_CURRENT_HUE, pInMsg->pData[0], transitionTime,
+                      ZCL_TRANSITION_WRAP | ZCL_TRANSITION_SHORTEST );
+  zclLighting_MoveTo( pInMsg, ATTRID_LIGHTING_COLOR_CONTROL_CURRENT_SATURATION, pInMsg->pData[1], transitionTime, 0 );
+#endif // ZCL_TRANSITION
+}
+
+
+#ifdef ZCL_TRANSITION
+/*********************************************************************
+ * @fn      zclLighting_MoveTo
+ *
+ * @brief   Start the transition of a Color Control attribute to a value
+ *
+ * @param   pInMsg - pointer to the incoming message
+ * @param   attrId - CURRENT_HUE or CURRENT_SATURATION
+ * @param   target - value to move to
+ * @param   transitionTime - in 1/10ths of a second
+ * @param   options - ZCL transition options
+ *
+ */
+static void zclLighting_MoveTo( zclIncoming_t *pInMsg, uint16 attrId, uint8 target,
+                                uint16 transitionTime, uint8 options )
+{
+  zcl_StartTransition( pInMsg->msg->endPoint, pInMsg->msg->clusterId, attrId,
+                       ATTRID_LIGHTING_COLOR_CONTROL_REMAINING_TIME,
+                       LIGHTING_COLOR_CONTROL_MAX_VALUE, target, transitionTime, options );
+}
+
+/*********************************************************************
+ * @fn      zclLighting_Move
+ *
+ * @brief   Start or stop moving a Color Control attribute at a rate
+ *
+ * @param   pInMsg - pointer to the incoming message
+ * @param   attrId - CURRENT_HUE or CURRENT_SATURATION
+ * @param   stop - TRUE to stop the attribute where it is
+ * @param   down - TRUE to move down
+ * @param   rate - units per second
+ * @param   wrap - TRUE if the value goes round (hue)
+ *
+ */
+static void zclLighting_Move( zclIncoming_t *pInMsg, uint16 attrId, uint8 stop,
+                              uint8 down, uint8 rate, uint8 wrap )
+{
+  uint8 options;
+
+  if ( stop )
+  {
+    zcl_StopTransition( pInMsg->msg->endPoint, pInMsg->msg->clusterId, attrId );
+  }
+  else
+  {
+    options = down ? ZCL_TRANSITION_DOWN : ZCL_TRANSITION_UP;
+    if ( wrap )
+      options |= ZCL_TRANSITION_WRAP;
+
+    zcl_StartMove( pInMsg->msg->endPoint, pInMsg->msg->clusterId, attrId,
+                   ATTRID_LIGHTING_COLOR_CONTROL_REMAINING_TIME,
+                   LIGHTING_COLOR_CONTROL_MAX_VALUE, rate, options );
+  }
+}
+
+/*********************************************************************
+ * @fn      zclLighting_Step
+ *
+ * @brief   Start the transition of a Color Control attribute by a step
+ *          from its current value
+ *
+ * @param   pInMsg - pointer to the incoming message
+ * @param   attrId - CURRENT_HUE or CURRENT_SATURATION
+ * @param   down - TRUE to step down
+ * @param   stepSize - change of the value
+ * @param   transitionTime - in 1/10ths of a second
+ * @param   wrap - TRUE if the value goes round (hue), else it stops
+ *                 at its limits
+ *
+ */
+static void zclLighting_Step( zclIncoming_t *pInMsg, uint16 attrId, uint8 down,
+                              uint8 stepSize, uint16 transitionTime, uint8 wrap )
+{
+  const zclAttrRec_t GENERIC *pAttr;
+  uint16 range = (uint16)LIGHTING_COLOR_CONTROL_MAX_VALUE + 1;
+  uint16 target;
+  uint8 options = down ? ZCL_TRANSITION_DOWN : ZCL_TRANSITION_UP;
+
+  pAttr = zclFindAttrRec( pInMsg->msg->endPoint, pInMsg->msg->clusterId, attrId );
+  if ( pAttr == NULL || pAttr->attr.dataType != ZCL_DATATYPE_UINT8 )
+    return;
+
+  target = *((uint8 *)pAttr->attr.dataPtr);
+  if ( wrap )
+  {
+    stepSize %= range;
+    target = ( target + ( down ? range - stepSize : stepSize ) ) % range;
+    options |= ZCL_TRANSITION_WRAP;
+  }
+  else if ( down )
+  {
+    target = ( target > stepSize ) ? target - stepSize : 0;
+  }
+  else
+  {
+    target += stepSize;
+    if ( target > LIGHTING_COLOR_CONTROL_MAX_VALUE )
+      target = LIGHTING_COLOR_CONTROL_MAX_VALUE;
+  }
+
+  zclLighting_MoveTo( pInMsg, attrId, (uint8)target, transitionTime, options );
 }
+#endif // ZCL_TRANSITION
 
 
 /****************************************************************************
@@ -263,6 +263,9 @@ static ZStatus_t zclPI_ProcessIn_BACnetCmds( zclIncoming_t *pInMsg )
   if  ( pInMsg->hdr.commandID != COMMAND_PI_RAW_BACNET_DATA )
     return (ZFailure);   // Error ignore the command
 
+  if ( pInMsg->pDataLen < 1 || pInMsg->pDataLen < 1 + pInMsg->pData[0] )
+    return ( ZCL_STATUS_MALFORMED_COMMAND ); // Length + BACnet data
+
   pCBs = zclPI_FindCallbacks( pInMsg->msg->endPoint );
   if ( pCBs && pCBs->pfnPI_BACnet )
     pCBs->pfnPI_BACnet( pInMsg->pData[0], &(pInMsg->pData[1]) );
@@ -78,6 +78,24 @@ const uint8 zclSS_UknownIeeeAddress[8] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0
 static zclSSCBRec_t *zclSSCBs = (zclSSCBRec_t *)NULL;
 static uint8 zclSSPluginRegisted = FALSE;
 
+// Shortest payload of the commands that carry one
+static CONST zclCmdLen_t zclSSCmdLen[] =
+{
+  { ZCL_SS_LOGICAL_CLUSTER_ID_IAS_ZONE, ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_SS_IAS_ZONE_STATUS_ENROLL_RESPONSE,       2 },
+  { ZCL_SS_LOGICAL_CLUSTER_ID_IAS_ZONE, ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_SS_IAS_ZONE_STATUS_CHANGE_NOTIFICATION,  2 },
+  { ZCL_SS_LOGICAL_CLUSTER_ID_IAS_ZONE, ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_SS_IAS_ZONE_STATUS_ENROLL_REQUEST,       4 },
+
+  { ZCL_SS_LOGICAL_CLUSTER_ID_IAS_ACE,  ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_SS_IAS_ACE_ARM,                          1 },
+  { ZCL_SS_LOGICAL_CLUSTER_ID_IAS_ACE,  ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_SS_IAS_ACE_BYPASS,                       1 },
+  { ZCL_SS_LOGICAL_CLUSTER_ID_IAS_ACE,  ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_SS_IAS_ACE_GET_ZONE_INFORMATION,         1 },
+  { ZCL_SS_LOGICAL_CLUSTER_ID_IAS_ACE,  ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_SS_IAS_ACE_ARM_RESPONSE,                 1 },
+  { ZCL_SS_LOGICAL_CLUSTER_ID_IAS_ACE,  ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_SS_IAS_ACE_GET_ZONE_ID_MAP_RESPONSE,     32 },
+  { ZCL_SS_LOGICAL_CLUSTER_ID_IAS_ACE,  ZCL_FRAME_SERVER_CLIENT_DIR, COMMAND_SS_IAS_ACE_GET_ZONE_INFORMATION_RESPONSE, 3 + Z_EXTADDR_LEN },
+
+  { ZCL_SS_LOGICAL_CLUSTER_ID_IAS_WD,   ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_SS_IAS_WD_START_WARNING,                 3 },
+  { ZCL_SS_LOGICAL_CLUSTER_ID_IAS_WD,   ZCL_FRAME_CLIENT_SERVER_DIR, COMMAND_SS_IAS_WD_SQUAWK,                        1 },
+};
+
 #if defined(ZCL_ZONE) || defined(ZCL_ACE)
 static zclSS_ZoneItem_t *zclSS_ZoneTable = (zclSS_ZoneItem_t *)NULL;
 #endif // ZCL_ZONE || ZCL_ACE
@@ -579,6 +597,12 @@ static ZStatus_t zclSS_HdlInSpecificCommands( zclIncoming_t *pInMsg, uint16 logi
 {
   ZStatus_t stat = ZSuccess;
 
+  if ( zcl_CmdPayloadOk( pInMsg, logicalClusterID, zclSSCmdLen,
+                         sizeof( zclSSCmdLen ) / sizeof( zclCmdLen_t ) ) == FALSE )
+  {
+    return ( ZCL_STATUS_MALFORMED_COMMAND ); // EMBEDDED RETURN
+  }
+
   switch ( logicalClusterID )				
   {
 #ifdef ZCL_ZONE
@@ -1025,7 +1049,7 @@ static void zclSS_ProcessInCmd_ZoneStatus_EnrollRequest( zclIncoming_t *pInMsg )
   IAS_ACE_ZoneTable_t zone;
   uint16 zoneType;
   uint16 manuCode;
-  uint8 zoneID;
+  uint8 zoneID = 0;   // Not assigned unless enrolled
   uint8 status;
 
   if ( pInMsg->hdr.commandID != COMMAND_SS_IAS_ZONE_STATUS_ENROLL_REQUEST )
@@ -1147,6 +1171,9 @@ static void zclSS_ProcessInCmd_ACE_Bypass( zclIncoming_t *pInMsg )
   if  ( pInMsg->hdr.commandID != COMMAND_SS_IAS_ACE_BYPASS )
     return;   // Error ignore the command
 
+  if ( pInMsg->pDataLen < 1 + pInMsg->pData[0] )
+    return;   // Zone ID list cut short, ignore the command
+
   pCBs = zclSS_FindCallbacks( pInMsg->msg->endPoint );
   if ( pCBs && pCBs->pfnACE_Bypass )
     pCBs->pfnACE_Bypass( pInMsg->pData[0], &(pInMsg->pData[1]) ) ;
@@ -1388,6 +1415,10 @@ static ZStatus_t zclSS_ProcessInWDCmds( zclIncoming_t *pInMsg )
 {
   ZStatus_t stat = ZSuccess;
 
+  // All the IAS WD commands go to the server
+  if ( zcl_ServerCmd( pInMsg->hdr.fc.direction ) == FALSE )
+    return ( ZFailure ); // EMBEDDED RETURN
+
   switch ( pInMsg->hdr.commandID )				
   {
     case COMMAND_SS_IAS_WD_START_WARNING:
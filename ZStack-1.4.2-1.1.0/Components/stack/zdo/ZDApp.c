@@ -32,6 +32,9 @@
 #include "NLMEDE.h"
 #include "AddrMgr.h"
 #include "ZDCache.h"
+#include "ZDInventory.h"
+#include "ZDTopology.h"
+#include "ZDResolve.h"
 #include "ZDProfile.h"
 #include "ZDObject.h"
 #include "ZDConfig.h"
@@ -51,6 +54,7 @@
 #endif
 
 /* HAL */
+#include "hal_assert.h"
 #include "hal_led.h"
 #include "hal_lcd.h"
 #include "hal_key.h"
@@ -117,6 +121,15 @@
  * TYPEDEFS
  */
 
+// One bit per task ID, see ZDAPP_SUB_TASK_MAX
+#if ( ZDAPP_SUB_TASK_MAX > 32 )
+  #error "ZDAPP_SUB_TASK_MAX must be 32 or less"
+#elif ( ZDAPP_SUB_TASK_MAX > 16 )
+  typedef uint32 ZDApp_SubMap_t;
+#else
+  typedef uint16 ZDApp_SubMap_t;
+#endif
+
 /*********************************************************************
  * GLOBAL VARIABLES
  */
@@ -149,6 +162,8 @@ byte  _tmpRejoinState;
  * EXTERNAL VARIABLES
  */
 
+extern byte taskIDs;  // OSAL tasks added, the next task ID
+
 /*********************************************************************
  * EXTERNAL FUNCTIONS
  */
@@ -197,6 +212,21 @@ void ZDApp_LeaveUpdate( uint16 nwkAddr, uint8* extAddr,
                         uint8 removeChildren );
 void ZDApp_NodeProfileSync( ZDO_NetworkDiscoveryCfm_t* cfm );
 
+ZDApp_SubMap_t ZDApp_RspTargets( uint8 type, uint16 srcAddr );
+osal_event_hdr_t *ZDApp_RspAlloc( uint8 len );
+void ZDApp_RspFanOut( uint8 type, ZDApp_SubMap_t targets,
+                      osal_event_hdr_t *pRsp, uint8 len );
+ZStatus_t ZDApp_RegisterForLegacy( byte TaskID, uint8 type );
+static void ZDApp_SharedRspFreeCB( byte *msg_ptr, uint16 len );
+
+#if defined ( ZDO_FAST_RESUME )
+  void ZDApp_ResumeOnline( void );
+  void ZDApp_ResumeSend( void );
+  void ZDApp_ResumeEnd( uint8 state );
+  void ZDApp_ResumeFallback( void );
+  void ZDApp_ResumeTimerEvent( void );
+#endif
+
 /*********************************************************************
  * LOCAL VARIABLES
  */
@@ -221,20 +251,29 @@ uint8 ZDApp_LeaveCtrl;
                         // to parent. Set to make the device do an Orphan scan.
 #endif
 
-#if defined ( ZDO_IEEEADDR_REQUEST )
-  static byte ZDApp_IEEEAddrRsp_TaskID = 0;  // Initialized to NO TASK
-#endif
+// Subscribers of each ZDO notification, one bit per task ID, and the
+// ones of them that take the shared buffer.
+static ZDApp_SubMap_t ZDApp_SubTasks[ZDAPP_SUB_TYPES];
+static ZDApp_SubMap_t ZDApp_SubShared[ZDAPP_SUB_TYPES];
 
-#if defined ( ZDO_NWKADDR_REQUEST )
-  static byte ZDApp_NwkAddrRsp_TaskID = 0;  // Initialized to NO TASK
-#endif
+// Task registered by the ZDApp_RegisterForXxx() functions for each
+// notification, TASK_NO_TASK if none
+static byte ZDApp_SubLegacy[ZDAPP_SUB_TYPES];
 
-static byte ZDApp_MatchDescRsp_TaskID = 0;  // Initialized to NO TASK
-static byte ZDApp_EndDeviceAnnounce_TaskID = 0;  // Initialized to NO TASK
+// Source address filters, taskID is TASK_NO_TASK when free
+typedef struct
+{
+  byte   taskID;
+  uint8  type;
+  uint16 srcAddr;
+} ZDApp_SubFilter_t;
 
-#if defined ( ZDO_BIND_UNBIND_REQUEST )
-  static byte ZDApp_BindUnbindRsp_TaskID = TASK_NO_TASK;
-#endif
+static ZDApp_SubFilter_t ZDApp_SubFilter[ZDAPP_SUB_FILTER_MAX];
+
+// OSAL free hook ID of the ZDO_SHARED_RSP messages, which carry a pointer
+// to the reference count of their notification after the ZDO_SharedRsp_t.
+// Without one, ZDAPP_SUB_SHARED subscribers get copies.
+static byte ZDApp_SharedFreeId;
 
 #if defined ( ZDO_BIND_UNBIND_RESPONSE ) && !defined ( REFLECTOR )
   static byte ZDApp_BindReq_TaskID = 0;  // Initialized to NO TASK
@@ -248,6 +287,11 @@ static byte ZDApp_EndDeviceAnnounce_TaskID = 0;  // Initialized to NO TASK
   static uint8 retryCnt;
 #endif
 
+#if defined ( ZDO_FAST_RESUME )
+  static ZDApp_ResumeStats_t ZDApp_ResumeStats;
+  static uint32 ZDApp_ResumeDue;  // Time the pending check runs out
+#endif
+
 // a little awkward -- this is will hold the list of versions that are legal given other
 // constraints such as NV value, macro values etc. list used in ZDO_NetworkDiscoveryConfirmCB()
 // when a joining device is deciding which network to join.
@@ -293,6 +337,15 @@ void ZDApp_Init( byte task_id )
   // to register the endpoint.
   afRegister( (endPointDesc_t *)&ZDApp_epDesc );
 
+  // No source filtered subscriptions yet
+  osal_memset( ZDApp_SubFilter, TASK_NO_TASK, sizeof( ZDApp_SubFilter ) );
+  osal_memset( ZDApp_SubLegacy, TASK_NO_TASK, sizeof( ZDApp_SubLegacy ) );
+  ZDApp_SharedFreeId = osal_msg_register_free_cb( ZDApp_SharedRspFreeCB );
+
+  // Every task must fit in the subscriber bitmaps, raise
+  // ZDAPP_SUB_TASK_MAX otherwise
+  HAL_ASSERT( taskIDs <= ZDAPP_SUB_TASK_MAX );
+
 #if defined( ZDO_USERDESC_RESPONSE )
   ZDApp_InitUserDesc();
 #endif // ZDO_USERDESC_RESPONSE
@@ -301,6 +354,18 @@ void ZDApp_Init( byte task_id )
   ZDCacheInit();
 #endif
 
+#if defined( ZDO_INVENTORY )
+  ZDInventoryInit();
+#endif
+
+#if defined( ZDO_TOPOLOGY )
+  ZDTopologyInit();
+#endif
+
+#if defined( ZDO_RESOLVE )
+  ZDResolveInit();
+#endif
+
   // Setup the Zigbee Network Protocol Version
   ZDAppSetupProtoVersion();
 
@@ -393,6 +458,10 @@ UINT16 ZDApp_event_loop( byte task_id, UINT16 events )
 
   if ( events & ZDO_STATE_CHANGE_EVT )
   {
+#if defined ( ZDO_FAST_RESUME )
+    ZDApp_ResumeOnline();
+#endif
+
     ZDO_UpdateNwkStatus( devState );
 
     // Return unprocessed events
@@ -413,7 +482,11 @@ UINT16 ZDApp_event_loop( byte task_id, UINT16 events )
     // process the new device event
     if ( ZDSecMgrNewDeviceEvent() == TRUE )
     {
+#if defined ( ZDSECMGR_ADMIT )
+      osal_start_timerEx( ZDAppTaskID, ZDO_NEW_DEVICE, ZDSECMGR_ADMIT_INTERVAL );
+#else
       osal_start_timerEx( ZDAppTaskID, ZDO_NEW_DEVICE, 1000 );
+#endif
     }
 
     // Return unprocessed events
@@ -460,6 +533,56 @@ UINT16 ZDApp_event_loop( byte task_id, UINT16 events )
   }
 #endif
 
+  if ( events & ZDO_AF_TIMER )
+  {
+    afTimerEvent();
+
+    // Return unprocessed events
+    return (events ^ ZDO_AF_TIMER);
+  }
+
+  if ( events & ZDO_AF_TXQ_TIMER )
+  {
+    afTxQueueEvent();
+
+    // Return unprocessed events
+    return (events ^ ZDO_AF_TXQ_TIMER);
+  }
+
+#if defined( ZDO_INVENTORY )
+  if ( events & ZDO_INVENTORY_TIMER )
+  {
+    ZDInventoryTimerEvent();
+
+    // Return unprocessed events
+    return (events ^ ZDO_INVENTORY_TIMER);
+  }
+#endif
+
+#if defined( ZDO_TOPOLOGY ) || defined( ZDO_RESOLVE ) || defined( ZDO_FAST_RESUME ) \
+ || defined( ZDO_COORDINATOR )
+  if ( events & ZDO_SERVICE_TIMER )
+  {
+    // Each service checks its own deadlines, the timer may fire
+    // sooner than it asked for.
+#if defined( ZDO_TOPOLOGY )
+    ZDTopologyTimerEvent();
+#endif
+#if defined( ZDO_RESOLVE )
+    ZDResolveTimerEvent();
+#endif
+#if defined( ZDO_FAST_RESUME )
+    ZDApp_ResumeTimerEvent();
+#endif
+#if defined( ZDO_COORDINATOR )
+    ZDO_MatchTimerEvent();
+#endif
+
+    // Return unprocessed events
+    return (events ^ ZDO_SERVICE_TIMER);
+  }
+#endif
+
   if ( events & ZDO_DEVICE_RESET )
   {
     // The device has been in the UNAUTH state, so reset
@@ -547,6 +670,17 @@ uint8 ZDOInitDevice( uint16 startDelay )
   }
 #endif
 
+#if defined ( ZDO_FAST_RESUME )
+  osal_memset( &ZDApp_ResumeStats, 0, sizeof( ZDApp_ResumeStats_t ) );
+  ZDApp_ResumeStats.init = osal_GetSystemClock();
+
+  if ( networkStateNV == ZDO_INITDEV_RESTORED_NETWORK_STATE )
+  {
+    // Trust the NV network state now, it is checked once the device is up
+    ZDApp_ResumeStats.state = ZDAPP_RESUME_FAST;
+  }
+#endif
+
   if ( networkStateNV == ZDO_INITDEV_NEW_NETWORK_STATE )
   {
     ZDAppDetermineDeviceType();
@@ -758,6 +892,11 @@ void ZDApp_SaveNetworkStateEvt( void )
                  NWK_NV_BINDING_ENABLE    |
                  NWK_NV_ADDRMGR_ENABLE );
 
+ #if defined ( ZDSECMGR_COMMERCIAL )
+  // Update the LINK key entries in NV
+  ZDSecMgrWriteNV();
+ #endif
+
   // Reset the NV startup option to resume from NV by
   // clearing the "New" join option.
   zgWriteStartupOptions( FALSE, ZCD_STARTOPT_DEFAULT_NETWORK_STATE );
@@ -809,6 +948,11 @@ uint8 ZDApp_RestoreNetworkState( void )
     else
       nvStat = NV_ITEM_UNINIT;
 
+#if defined ( ZDSECMGR_COMMERCIAL ) && defined ( NV_RESTORE )
+    // Restore the LINK key entries along with the network state
+    ZDSecMgrInitNV( (uint8)( nvStat == ZSUCCESS ) );
+#endif
+
 #if   ( SECURE != 0  )
     nwkFrameCounterChanges = 0;
     osal_memset( &keyItems, 0, sizeof( nwkActiveKeyItems ) );
@@ -1293,6 +1437,17 @@ void ZDApp_ProcessNetworkJoin( void )
     }
     else
     {
+#if defined ( ZDO_FAST_RESUME )
+      if ( ZDApp_ResumeStats.state == ZDAPP_RESUME_FAST )
+      {
+        // The parent did not answer on the NV channel, go straight
+        // on to the orphan scan of all channels.
+        ZDApp_ResumeEnd( ZDAPP_RESUME_FAILED );
+        ZDApp_NetworkInit( 0 );
+        return;
+      }
+#endif
+
       if ( (devStartMode == MODE_RESUME) && (++retryCnt >= MAX_RESUME_RETRY) )
       {
         if ( _NIB.nwkPanId == 0xFFFF || _NIB.nwkPanId == INVALID_PAN_ID )
@@ -1536,6 +1691,283 @@ void ZDApp_ResetTimerCancel( void )
   osal_stop_timerEx( ZDAppTaskID, ZDO_DEVICE_RESET );
 }
 
+/*********************************************************************
+ * @fn      ZDApp_ServiceTimer
+ *
+ * @brief   Start the timer shared by the ZDO services, unless it is
+ *          already set to expire sooner.
+ *
+ * @param   timeout - time(ms) before the services are run
+ *
+ * @return  none
+ */
+void ZDApp_ServiceTimer( uint16 timeout )
+{
+  uint16 left = osal_get_timeoutEx( ZDAppTaskID, ZDO_SERVICE_TIMER );
+
+  if ( (left == 0) || (left > timeout) )
+  {
+    osal_start_timerEx( ZDAppTaskID, ZDO_SERVICE_TIMER, timeout );
+  }
+}
+
+#if defined ( ZDO_FAST_RESUME )
+/*********************************************************************
+ * @fn      ZDApp_ResumeChannels
+ *
+ * @brief   Channels to orphan scan for the parent when resuming. The
+ *          first scan after a restore only looks at the NV channel.
+ *
+ * @param   none
+ *
+ * @return  channel mask
+ */
+uint32 ZDApp_ResumeChannels( void )
+{
+  uint32 channels = zgDefaultChannelList;
+
+  if ( ZDApp_ResumeStats.state == ZDAPP_RESUME_FAST )
+  {
+    channels = (uint32)1 << _NIB.nwkLogicalChannel;
+  }
+
+  return ( channels );
+}
+
+/*********************************************************************
+ * @fn      ZDApp_ResumeOnline
+ *
+ * @brief   Record the first time the device is up after ZDOInitDevice()
+ *          and, when it came up from the NV network state, start
+ *          checking that the network is still there.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void ZDApp_ResumeOnline( void )
+{
+  uint8 up;
+
+  if ( ZDO_Config_Node_Descriptor.LogicalType == NODETYPE_DEVICE )
+  {
+    up = ( devState == DEV_END_DEVICE );
+  }
+  else
+  {
+    // A router only counts once it routes
+    up = ( (devState == DEV_ROUTER) || (devState == DEV_ZB_COORD) );
+  }
+
+  if ( up && (ZDApp_ResumeStats.online == 0) )
+  {
+    ZDApp_ResumeStats.online = osal_GetSystemClock();
+
+    if ( ZDApp_ResumeStats.state == ZDAPP_RESUME_FAST )
+    {
+      if ( devState == DEV_ZB_COORD )
+      {
+        // Nobody to ask, the coordinator is the network
+        ZDApp_ResumeEnd( ZDAPP_RESUME_VERIFIED );
+      }
+      else
+      {
+        ZDApp_ResumeStats.state = ZDAPP_RESUME_VERIFY;
+        ZDApp_ResumeSend();
+      }
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      ZDApp_ResumeSend
+ *
+ * @brief   Send the next check, an IEEE_addr_req to the parent. Every
+ *          other check goes to the coordinator instead, so a parent
+ *          that answers but lost its own route is still noticed. In
+ *          backoff the wait doubles with every check, up to
+ *          ZDAPP_RESUME_BACKOFF_MAX.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void ZDApp_ResumeSend( void )
+{
+  uint16 dstAddr = NLME_GetCoordShortAddr();
+  uint16 timeout = ZDAPP_RESUME_TIMEOUT;
+  uint8 cnt;
+
+  if ( ZDApp_ResumeStats.tries & 0x01 )
+  {
+    dstAddr = NWK_PAN_COORD_ADDR;
+  }
+
+  if ( ZDApp_ResumeStats.tries == 0 )
+  {
+    ZDApp_ResumeStats.firstTx = osal_GetSystemClock();
+  }
+  if ( ZDApp_ResumeStats.tries != 0xFF )
+  {
+    ZDApp_ResumeStats.tries++;
+  }
+
+  for ( cnt = ZDApp_ResumeStats.tries; cnt > ZDAPP_RESUME_TRIES; cnt-- )
+  {
+    if ( timeout >= (ZDAPP_RESUME_BACKOFF_MAX / 2) )
+    {
+      timeout = ZDAPP_RESUME_BACKOFF_MAX;
+      break;
+    }
+    timeout <<= 1;
+  }
+
+  // A failed send is retried like a lost one
+  ZDP_IEEEAddrReq( dstAddr, ZDP_ADDR_REQTYPE_SINGLE, 0, false );
+
+  ZDApp_ResumeDue = osal_GetSystemClock() + timeout;
+  ZDApp_ServiceTimer( timeout );
+}
+
+/*********************************************************************
+ * @fn      ZDApp_ResumeEnd
+ *
+ * @brief   Finish the fast resume, or move a router to backoff, and
+ *          report its latency.
+ *
+ * @param   state - ZDAPP_RESUME_VERIFIED, ZDAPP_RESUME_FAILED or
+ *                  ZDAPP_RESUME_BACKOFF
+ *
+ * @return  none
+ */
+void ZDApp_ResumeEnd( uint8 state )
+{
+  ZDApp_ResumeStats.state = state;
+  if ( state != ZDAPP_RESUME_BACKOFF )
+  {
+    ZDApp_ResumeStats.done = osal_GetSystemClock();
+  }
+
+#if defined ( MT_ZDO_FUNC )
+  if ( _zdoCallbackSub & CB_ID_ZDO_RESUME_STATS_RSP )
+  {
+    zdo_MTCB_ResumeStatsCB( &ZDApp_ResumeStats );
+  }
+#endif
+}
+
+/*********************************************************************
+ * @fn      ZDApp_ResumeFallback
+ *
+ * @brief   The network did not answer the checks. An end device gives
+ *          up the NV network state, looks for a parent through
+ *          discovery and rejoins. A router keeps the NV network state,
+ *          since after a power cut its parent or the coordinator may
+ *          simply still be starting, and goes on checking at a backoff.
+ *          After ZDAPP_RESUME_BACKOFF_TRIES more checks it falls back
+ *          to discovery too.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void ZDApp_ResumeFallback( void )
+{
+  if ( (ZDO_Config_Node_Descriptor.LogicalType == NODETYPE_DEVICE) ||
+       (ZDApp_ResumeStats.tries >=
+        (ZDAPP_RESUME_TRIES + ZDAPP_RESUME_BACKOFF_TRIES)) )
+  {
+    ZDApp_ResumeEnd( ZDAPP_RESUME_FAILED );
+
+    devStartMode = MODE_REJOIN;
+    _tmpRejoinState = true;
+    ZDApp_NetworkInit( 0 );
+
+    // indicate state change to apps
+    devState = DEV_INIT;
+    osal_set_event( ZDAppTaskID, ZDO_STATE_CHANGE_EVT );
+  }
+  else
+  {
+    if ( ZDApp_ResumeStats.state != ZDAPP_RESUME_BACKOFF )
+    {
+      ZDApp_ResumeEnd( ZDAPP_RESUME_BACKOFF );
+    }
+    ZDApp_ResumeSend();
+  }
+}
+
+/*********************************************************************
+ * @fn      ZDApp_ResumeTimerEvent
+ *
+ * @brief   Resend the check or fall back once it runs out. Called on
+ *          ZDO_SERVICE_TIMER, which may fire for another service.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void ZDApp_ResumeTimerEvent( void )
+{
+  uint32 now = osal_GetSystemClock();
+
+  if ( (ZDApp_ResumeStats.state == ZDAPP_RESUME_VERIFY) ||
+       (ZDApp_ResumeStats.state == ZDAPP_RESUME_BACKOFF) )
+  {
+    if ( (int32)(now - ZDApp_ResumeDue) < 0 )
+    {
+      ZDApp_ServiceTimer( (uint16)(ZDApp_ResumeDue - now) );
+    }
+    else if ( ZDApp_ResumeStats.tries < ZDAPP_RESUME_TRIES )
+    {
+      ZDApp_ResumeSend();
+    }
+    else
+    {
+      ZDApp_ResumeFallback();
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      ZDApp_ResumeAddrRsp
+ *
+ * @brief   A successful answer from the parent or the coordinator,
+ *          the devices checked, shows the NV network state still
+ *          works, so it ends the check.
+ *
+ * @param   srcAddr - source of the address response
+ * @param   status - status of the address response
+ *
+ * @return  none
+ */
+void ZDApp_ResumeAddrRsp( uint16 srcAddr, byte status )
+{
+  if ( ((ZDApp_ResumeStats.state == ZDAPP_RESUME_VERIFY) ||
+        (ZDApp_ResumeStats.state == ZDAPP_RESUME_BACKOFF)) &&
+       (status == ZDP_SUCCESS) &&
+       ((srcAddr == NLME_GetCoordShortAddr()) ||
+        (srcAddr == NWK_PAN_COORD_ADDR)) )
+  {
+    ZDApp_ResumeEnd( ZDAPP_RESUME_VERIFIED );
+  }
+}
+
+/*********************************************************************
+ * @fn      ZDApp_ResumeStatsGet
+ *
+ * @brief   Get the fast resume latency of the last start.
+ *
+ * @param   none
+ *
+ * @return  pointer to the latency record
+ */
+ZDApp_ResumeStats_t *ZDApp_ResumeStatsGet( void )
+{
+  return ( &ZDApp_ResumeStats );
+}
+#endif // ZDO_FAST_RESUME
+
 /*********************************************************************
  * @fn      ZDApp_LeaveCtrlInit
  *
@@ -2071,6 +2503,7 @@ void ZDApp_NwkAddrRspCB( zAddrType_t *SrcAddr, byte Status, byte *IEEEAddr,
                          byte StartIndex, uint16 *AssocDevList )
 {
   uint8 bufLen;
+  ZDApp_SubMap_t targets;
   ZDO_NwkAddrResp_t *pNwkAddrRsp;
 
 #if defined ( MT_ZDO_FUNC )
@@ -2084,12 +2517,13 @@ void ZDApp_NwkAddrRspCB( zAddrType_t *SrcAddr, byte Status, byte *IEEEAddr,
   }
 #endif  //MT_ZDO_FUNC
 
-  if ( ZDApp_NwkAddrRsp_TaskID )
+  targets = ZDApp_RspTargets( ZDAPP_SUB_NWK_ADDR_RSP, SrcAddr->addr.shortAddr );
+  if ( targets )
   {
-    // Send the NWK Address response structure to the registered task
+    // Send the NWK Address response structure to the registered tasks
     bufLen = sizeof( ZDO_NwkAddrResp_t ) + sizeof( uint16 ) * NumAssocDev;
 
-    pNwkAddrRsp = (ZDO_NwkAddrResp_t *)osal_msg_allocate( bufLen );
+    pNwkAddrRsp = (ZDO_NwkAddrResp_t *)ZDApp_RspAlloc( bufLen );
 
     if ( pNwkAddrRsp )
     {
@@ -2102,7 +2536,8 @@ void ZDApp_NwkAddrRspCB( zAddrType_t *SrcAddr, byte Status, byte *IEEEAddr,
       pNwkAddrRsp->startIndex = StartIndex;
       osal_memcpy( pNwkAddrRsp->devList, AssocDevList, (sizeof( uint16 ) * NumAssocDev) );
 
-      osal_msg_send( ZDApp_NwkAddrRsp_TaskID, (uint8 *)pNwkAddrRsp );
+      ZDApp_RspFanOut( ZDAPP_SUB_NWK_ADDR_RSP, targets,
+                       (osal_event_hdr_t *)pNwkAddrRsp, bufLen );
     }
   }
 }
@@ -2130,6 +2565,7 @@ void ZDApp_IEEEAddrRspCB( zAddrType_t *SrcAddr, byte Status, byte *IEEEAddr,
                           byte StartIndex, uint16 *AssocDevList )
 {
   uint8 bufLen;
+  ZDApp_SubMap_t targets;
   ZDO_IEEEAddrResp_t *pIEEEAddrRsp;
 
 #if defined ( MT_ZDO_FUNC )
@@ -2143,12 +2579,13 @@ void ZDApp_IEEEAddrRspCB( zAddrType_t *SrcAddr, byte Status, byte *IEEEAddr,
   }
 #endif  //MT_ZDO_FUNC
 
-  if ( ZDApp_IEEEAddrRsp_TaskID )
+  targets = ZDApp_RspTargets( ZDAPP_SUB_IEEE_ADDR_RSP, SrcAddr->addr.shortAddr );
+  if ( targets )
   {
-    // Send the IEEE Address response structure to the registered task
+    // Send the IEEE Address response structure to the registered tasks
     bufLen = sizeof( ZDO_IEEEAddrResp_t ) + sizeof( uint16 ) * NumAssocDev;
 
-    pIEEEAddrRsp = (ZDO_IEEEAddrResp_t *)osal_msg_allocate( bufLen );
+    pIEEEAddrRsp = (ZDO_IEEEAddrResp_t *)ZDApp_RspAlloc( bufLen );
     if ( pIEEEAddrRsp )
     {
       pIEEEAddrRsp->hdr.event = ZDO_IEEE_ADDR_RESP;
@@ -2160,7 +2597,8 @@ void ZDApp_IEEEAddrRspCB( zAddrType_t *SrcAddr, byte Status, byte *IEEEAddr,
       pIEEEAddrRsp->startIndex = StartIndex;
       osal_memcpy( pIEEEAddrRsp->devList, AssocDevList, (sizeof( uint16 ) * NumAssocDev) );
 
-      osal_msg_send( ZDApp_IEEEAddrRsp_TaskID, (uint8 *)pIEEEAddrRsp );
+      ZDApp_RspFanOut( ZDAPP_SUB_IEEE_ADDR_RSP, targets,
+                       (osal_event_hdr_t *)pIEEEAddrRsp, bufLen );
     }
   }
 }
@@ -2185,6 +2623,10 @@ void ZDApp_IEEEAddrRspCB( zAddrType_t *SrcAddr, byte Status, byte *IEEEAddr,
 void ZDApp_NodeDescRspCB( zAddrType_t *SrcAddr, byte Status, uint16 aoi,
                           NodeDescriptorFormat_t *pNodeDesc )
 {
+#if defined ( ZDO_INVENTORY )
+  ZDInventoryNodeDescRsp( Status, aoi, pNodeDesc );
+#endif
+
 #if defined ( MT_ZDO_FUNC )
   /* First check if MT has subscribed for this callback. If so , pass it as
   a event to MonitorTest and return control to calling function after that */
@@ -2249,6 +2691,10 @@ void ZDApp_SimpleDescRspCB( zAddrType_t *SrcAddr, byte Status,
                             uint16 aoi, byte endPoint,
                             SimpleDescriptionFormat_t *pSimpleDesc )
 {
+#if defined ( ZDO_INVENTORY )
+  ZDInventorySimpleDescRsp( Status, aoi, pSimpleDesc );
+#endif
+
 #if defined ( MT_ZDO_FUNC )
   /* First check if MT has subscribed for this callback. If so , pass it as
   a event to MonitorTest and return control to calling function after that */
@@ -2279,6 +2725,10 @@ void ZDApp_SimpleDescRspCB( zAddrType_t *SrcAddr, byte Status,
 void ZDApp_ActiveEPRspCB( zAddrType_t *src, byte Status,
                                                      byte epCnt, byte *epList )
 {
+#if defined ( ZDO_INVENTORY )
+  ZDInventoryActiveEPRsp( Status, src->addr.shortAddr, epCnt, epList );
+#endif
+
 #if defined ( MT_ZDO_FUNC )
   /* First check if MT has subscribed for this callback. If so , pass it as
   a event to MonitorTest and return control to calling function after that */
@@ -2318,6 +2768,8 @@ void ZDApp_ActiveEPRspCB( zAddrType_t *src, byte Status,
 void ZDApp_MatchDescRspCB( zAddrType_t *src, byte Status,
                                                      byte epCnt, byte *epList )
 {
+  ZDApp_SubMap_t targets;
+
 #if defined ( MT_ZDO_FUNC )
   /* First check if MT has subscribed for this callback. If so , pass it as
   a event to MonitorTest and return control to calling function after that */
@@ -2334,11 +2786,12 @@ void ZDApp_MatchDescRspCB( zAddrType_t *src, byte Status,
     return;
   }
 
-  if ( ZDApp_MatchDescRsp_TaskID )
+  targets = ZDApp_RspTargets( ZDAPP_SUB_MATCH_DESC_RSP, src->addr.shortAddr );
+  if ( targets )
   {
-    // Send the IEEE Address response structure to the registered task.
+    // Send the Match Descriptor response structure to the registered tasks.
     uint8 bufLen = sizeof( ZDO_MatchDescResp_t ) + epCnt;
-    ZDO_MatchDescResp_t *pMatchDescRsp = (ZDO_MatchDescResp_t *)osal_msg_allocate( bufLen );
+    ZDO_MatchDescResp_t *pMatchDescRsp = (ZDO_MatchDescResp_t *)ZDApp_RspAlloc( bufLen );
 
     if ( pMatchDescRsp )
     {
@@ -2349,7 +2802,8 @@ void ZDApp_MatchDescRspCB( zAddrType_t *src, byte Status,
       pMatchDescRsp->epCnt = epCnt;
       osal_memcpy( pMatchDescRsp->epList, epList, epCnt );
 
-      osal_msg_send( ZDApp_MatchDescRsp_TaskID, (uint8 *)pMatchDescRsp );
+      ZDApp_RspFanOut( ZDAPP_SUB_MATCH_DESC_RSP, targets,
+                       (osal_event_hdr_t *)pMatchDescRsp, bufLen );
     }
   }
 
@@ -2414,7 +2868,8 @@ void ZDApp_EndDeviceBindRsp( zAddrType_t *SrcAddr, byte Status )
  */
 void ZDApp_BindRsp( zAddrType_t *SrcAddr, byte Status )
 {
-  ZDO_BindRsp_t bindRsp;
+  ZDO_BindRsp_t *pBindRsp;
+  ZDApp_SubMap_t targets;
 
 #if defined ( MT_ZDO_FUNC )
   /* First check if MT has subscribed for this callback. If so , pass it as
@@ -2426,16 +2881,21 @@ void ZDApp_BindRsp( zAddrType_t *SrcAddr, byte Status )
   }
 #endif  //MT_ZDO_FUNC
 
-  if ( ZDApp_BindUnbindRsp_TaskID != TASK_NO_TASK )
+  targets = ZDApp_RspTargets( ZDAPP_SUB_BIND_RSP, SrcAddr->addr.shortAddr );
+  if ( targets )
   {
-    // Send the response structure to the registered task
-    bindRsp.nwkAddr = SrcAddr->addr.shortAddr;
-    bindRsp.status  = Status;
+    // Send the response structure to the registered tasks
+    pBindRsp = (ZDO_BindRsp_t *)ZDApp_RspAlloc( sizeof( ZDO_BindRsp_t ) );
 
-    ZDApp_SendMsg( ZDApp_BindUnbindRsp_TaskID,
-                   ZDO_BIND_RESP,
-                   sizeof(ZDO_BindRsp_t),
-                   (byte*)(&bindRsp) );
+    if ( pBindRsp )
+    {
+      pBindRsp->hdr.event = ZDO_BIND_RESP;
+      pBindRsp->nwkAddr = SrcAddr->addr.shortAddr;
+      pBindRsp->status  = Status;
+
+      ZDApp_RspFanOut( ZDAPP_SUB_BIND_RSP, targets,
+                       (osal_event_hdr_t *)pBindRsp, sizeof( ZDO_BindRsp_t ) );
+    }
   }
 }
 #endif // ZDO_BIND_UNBIND_REQUEST
@@ -2455,7 +2915,8 @@ void ZDApp_BindRsp( zAddrType_t *SrcAddr, byte Status )
  */
 void ZDApp_UnbindRsp( zAddrType_t *SrcAddr, byte Status )
 {
-  ZDO_UnbindRsp_t unbindRsp;
+  ZDO_UnbindRsp_t *pUnbindRsp;
+  ZDApp_SubMap_t targets;
 
 #if defined ( MT_ZDO_FUNC )
   /* First check if MT has subscribed for this callback. If so , pass it as
@@ -2467,16 +2928,21 @@ void ZDApp_UnbindRsp( zAddrType_t *SrcAddr, byte Status )
   }
 #endif  //MT_ZDO_FUNC
 
-  if ( ZDApp_BindUnbindRsp_TaskID != TASK_NO_TASK )
+  targets = ZDApp_RspTargets( ZDAPP_SUB_BIND_RSP, SrcAddr->addr.shortAddr );
+  if ( targets )
   {
-    // Send the response structure to the registered task
-    unbindRsp.nwkAddr = SrcAddr->addr.shortAddr;
-    unbindRsp.status  = Status;
+    // Send the response structure to the registered tasks
+    pUnbindRsp = (ZDO_UnbindRsp_t *)ZDApp_RspAlloc( sizeof( ZDO_UnbindRsp_t ) );
 
-    ZDApp_SendMsg( ZDApp_BindUnbindRsp_TaskID,
-                   ZDO_UNBIND_RESP,
-                   sizeof(ZDO_UnbindRsp_t),
-                   (byte*)(&unbindRsp) );
+    if ( pUnbindRsp )
+    {
+      pUnbindRsp->hdr.event = ZDO_UNBIND_RESP;
+      pUnbindRsp->nwkAddr = SrcAddr->addr.shortAddr;
+      pUnbindRsp->status  = Status;
+
+      ZDApp_RspFanOut( ZDAPP_SUB_BIND_RSP, targets,
+                       (osal_event_hdr_t *)pUnbindRsp, sizeof( ZDO_UnbindRsp_t ) );
+    }
   }
 }
 #endif // ZDO_BIND_UNBIND_REQUEST
@@ -2771,6 +3237,21 @@ ZStatus_t ZDO_JoinIndicationCB( uint16 ShortAddress, byte *ExtendedAddress,
     ZDX_PostCoordinatorIEEE(ShortAddress);
 #endif
 
+#if defined ( ZDSECMGR_ADMIT )
+  // Notify to save info into NV, but don't push back a save already
+  // pending or a join storm would hold it off until the storm ends
+  if ( !osal_get_timeoutEx( ZDAppTaskID, ZDO_NWK_UPDATE_NV ) )
+  {
+    osal_start_timerEx( ZDAppTaskID, ZDO_NWK_UPDATE_NV, 1000 );
+  }
+
+  // queue the new device for its key
+  if ( _NIB.SecurityLevel )
+  {
+    ZDSecMgrAdmitJoin( ShortAddress, ExtendedAddress,
+                       NLME_GetShortAddr(), FALSE );
+  }
+#else
   // Notify to save info into NV
   osal_start_timerEx( ZDAppTaskID, ZDO_NWK_UPDATE_NV, 1000 );
 
@@ -2779,6 +3260,7 @@ ZStatus_t ZDO_JoinIndicationCB( uint16 ShortAddress, byte *ExtendedAddress,
   if ( _NIB.SecurityLevel )
     osal_start_timerEx( ZDAppTaskID, ZDO_NEW_DEVICE, 600 );
 #endif  // SECURE
+#endif  // ZDSECMGR_ADMIT
 
   return ( ZSuccess );
 }
@@ -3031,6 +3513,11 @@ void ZDApp_MgmtLqiRspCB( uint16 SrcAddr, byte Status, byte NeighborLqiEntries,
 {
   byte x;
 
+#if defined ( ZDO_TOPOLOGY )
+  ZDTopologyLqiRsp( SrcAddr, Status, NeighborLqiEntries, StartIndex,
+                    NeighborLqiCount, pList );
+#endif
+
 #if defined ( MT_ZDO_FUNC )
   /* First check if MT has subscribed for this callback. If so , pass it as
   a event to MonitorTest and return control to calling function after that */
@@ -3129,6 +3616,10 @@ void ZDApp_MgmtRtgRspCB( uint16 SrcAddr, byte Status, byte rtgCount,
 {
   byte x;
 
+#if defined ( ZDO_TOPOLOGY )
+  ZDTopologyRtgRsp( SrcAddr, Status, rtgCount, StartIndex, rtgListCount, pList );
+#endif
+
 #if defined ( MT_ZDO_FUNC )
   /* First check if MT has subscribed for this callback. If so , pass it as
   a event to MonitorTest and return control to calling function after that */
@@ -3480,20 +3971,34 @@ void ZDApp_ServerDiscRspCB( uint16 srcAddr, byte status,
 void ZDApp_EndDeviceAnnounceCB( uint16 SrcAddr, uint16 nwkAddr, uint8 *extAddr,
                                uint8 capabilities )
 {
-  ZDO_EndDeviceAnnounce_t Announce;
+  ZDO_EndDeviceAnnounce_t *pAnnounce;
+  ZDApp_SubMap_t targets;
 
   // If it interests you - put your own code here.
 
-  if ( ZDApp_EndDeviceAnnounce_TaskID )
+#if defined ( ZDO_INVENTORY )
+  ZDInventoryAnnounce( nwkAddr );
+#endif
+
+  targets = ZDApp_RspTargets( ZDAPP_SUB_END_DEV_ANNCE, SrcAddr );
+  if ( targets )
   {
-    // Build the structure
-    Announce.srcAddr = SrcAddr;
-    Announce.nwkAddr = nwkAddr;
-    osal_cpyExtAddr( Announce.extAddr, extAddr );
-    Announce.capabilities = capabilities;
+    pAnnounce = (ZDO_EndDeviceAnnounce_t *)ZDApp_RspAlloc(
+                                     sizeof( ZDO_EndDeviceAnnounce_t ) );
 
-    ZDApp_SendMsg( ZDApp_EndDeviceAnnounce_TaskID, ZDO_END_DEVICE_ANNOUNCE,
-                  sizeof( ZDO_EndDeviceAnnounce_t ), (uint8 *)&Announce );
+    if ( pAnnounce )
+    {
+      // Build the structure
+      pAnnounce->hdr.event = ZDO_END_DEVICE_ANNOUNCE;
+      pAnnounce->srcAddr = SrcAddr;
+      pAnnounce->nwkAddr = nwkAddr;
+      osal_cpyExtAddr( pAnnounce->extAddr, extAddr );
+      pAnnounce->capabilities = capabilities;
+
+      ZDApp_RspFanOut( ZDAPP_SUB_END_DEV_ANNCE, targets,
+                       (osal_event_hdr_t *)pAnnounce,
+                       sizeof( ZDO_EndDeviceAnnounce_t ) );
+    }
   }
 }
 
@@ -3535,6 +4040,307 @@ void ZDApp_NetworkInit( uint16 delay )
   }
 }
 
+/*********************************************************************
+ * @fn      ZDApp_RegisterForZDORsp()
+ *
+ * @brief   Subscribe a task to a ZDO notification. Any number of tasks
+ *          can subscribe to the same one; registering again changes
+ *          the options and source filter of the task.
+ *
+ * @param   TaskID - ID of task to send messages, below ZDAPP_SUB_TASK_MAX
+ * @param   type - ZDAPP_SUB_IEEE_ADDR_RSP ...
+ * @param   options - ZDAPP_SUB_COPY for an own copy of each message,
+ *                    ZDAPP_SUB_SHARED for ZDO_SHARED_RSP references
+ * @param   srcAddr - only notify for messages from this device, or
+ *                    ZDAPP_SUB_ANY_SRC
+ *
+ * @return  ZSuccess, ZInvalidParameter or ZMemError if no source
+ *          filter is free
+ */
+ZStatus_t ZDApp_RegisterForZDORsp( byte TaskID, uint8 type,
+                                   uint8 options, uint16 srcAddr )
+{
+  ZDApp_SubFilter_t *pFilter = NULL;
+  ZDApp_SubMap_t bit;
+  uint8 i;
+
+  if ( (TaskID >= ZDAPP_SUB_TASK_MAX) || (type >= ZDAPP_SUB_TYPES) )
+  {
+    return ( ZInvalidParameter );
+  }
+
+  // The task's own filter for the type, else a free one
+  for ( i = 0; i < ZDAPP_SUB_FILTER_MAX; i++ )
+  {
+    if ( (ZDApp_SubFilter[i].taskID == TaskID) &&
+         (ZDApp_SubFilter[i].type == type) )
+    {
+      pFilter = &ZDApp_SubFilter[i];
+      break;
+    }
+
+    if ( (pFilter == NULL) && (ZDApp_SubFilter[i].taskID == TASK_NO_TASK) )
+    {
+      pFilter = &ZDApp_SubFilter[i];
+    }
+  }
+
+  if ( srcAddr != ZDAPP_SUB_ANY_SRC )
+  {
+    if ( pFilter == NULL )
+    {
+      return ( ZMemError );
+    }
+
+    pFilter->taskID = TaskID;
+    pFilter->type = type;
+    pFilter->srcAddr = srcAddr;
+  }
+  else if ( (pFilter != NULL) && (pFilter->taskID == TaskID) )
+  {
+    pFilter->taskID = TASK_NO_TASK;
+  }
+
+  bit = (ZDApp_SubMap_t)1 << TaskID;
+  ZDApp_SubTasks[type] |= bit;
+
+  if ( options & ZDAPP_SUB_SHARED )
+  {
+    ZDApp_SubShared[type] |= bit;
+  }
+  else
+  {
+    ZDApp_SubShared[type] &= ~bit;
+  }
+
+  return ( ZSuccess );
+}
+
+/*********************************************************************
+ * @fn      ZDApp_DeregisterForZDORsp()
+ *
+ * @brief   Unsubscribe a task from a ZDO notification.
+ *
+ * @param   TaskID - ID of the subscribed task
+ * @param   type - ZDAPP_SUB_IEEE_ADDR_RSP ...
+ *
+ * @return  none
+ */
+void ZDApp_DeregisterForZDORsp( byte TaskID, uint8 type )
+{
+  ZDApp_SubMap_t bit;
+  uint8 i;
+
+  if ( (TaskID < ZDAPP_SUB_TASK_MAX) && (type < ZDAPP_SUB_TYPES) )
+  {
+    bit = (ZDApp_SubMap_t)1 << TaskID;
+    ZDApp_SubTasks[type] &= ~bit;
+    ZDApp_SubShared[type] &= ~bit;
+
+    if ( ZDApp_SubLegacy[type] == TaskID )
+    {
+      ZDApp_SubLegacy[type] = TASK_NO_TASK;
+    }
+
+    for ( i = 0; i < ZDAPP_SUB_FILTER_MAX; i++ )
+    {
+      if ( (ZDApp_SubFilter[i].taskID == TaskID) &&
+           (ZDApp_SubFilter[i].type == type) )
+      {
+        ZDApp_SubFilter[i].taskID = TASK_NO_TASK;
+      }
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      ZDApp_RspTargets()
+ *
+ * @brief   Find the tasks to notify of a message.
+ *
+ * @param   type - ZDAPP_SUB_IEEE_ADDR_RSP ...
+ * @param   srcAddr - source of the message
+ *
+ * @return  bitmap of task IDs, 0 if nobody is interested
+ */
+ZDApp_SubMap_t ZDApp_RspTargets( uint8 type, uint16 srcAddr )
+{
+  ZDApp_SubMap_t targets = ZDApp_SubTasks[type];
+  uint8 i;
+
+  for ( i = 0; i < ZDAPP_SUB_FILTER_MAX; i++ )
+  {
+    if ( (ZDApp_SubFilter[i].taskID != TASK_NO_TASK) &&
+         (ZDApp_SubFilter[i].type == type) &&
+         (ZDApp_SubFilter[i].srcAddr != srcAddr) )
+    {
+      targets &= ~((ZDApp_SubMap_t)1 << ZDApp_SubFilter[i].taskID);
+    }
+  }
+
+  return ( targets );
+}
+
+/*********************************************************************
+ * @fn      ZDApp_RspAlloc()
+ *
+ * @brief   Allocate a notification, built once for all its subscribers
+ *          and passed to ZDApp_RspFanOut(). It is an OSAL message with
+ *          room for the ZDO_SHARED_RSP reference count after it, so it
+ *          can go as is to a ZDAPP_SUB_COPY subscriber.
+ *
+ * @param   len - length of the message
+ *
+ * @return  pointer to the message, NULL if out of memory
+ */
+osal_event_hdr_t *ZDApp_RspAlloc( uint8 len )
+{
+  return ( (osal_event_hdr_t *)osal_msg_allocate( len + sizeof( uint8 ) ) );
+}
+
+/*********************************************************************
+ * @fn      ZDApp_RspFanOut()
+ *
+ * @brief   Send a notification from ZDApp_RspAlloc() to its subscribers.
+ *          ZDAPP_SUB_SHARED tasks get a ZDO_SHARED_RSP reference to the
+ *          buffer. ZDAPP_SUB_COPY tasks get their own message: the last
+ *          one gets the buffer itself if nobody references it, the
+ *          others a copy. Otherwise the buffer is freed here, or by
+ *          ZDApp_SharedRspFreeCB() with the last reference.
+ *
+ * @param   type - ZDAPP_SUB_IEEE_ADDR_RSP ...
+ * @param   targets - tasks from ZDApp_RspTargets()
+ * @param   pRsp - the notification
+ * @param   len - length of the notification
+ *
+ * @return  none
+ */
+void ZDApp_RspFanOut( uint8 type, ZDApp_SubMap_t targets,
+                      osal_event_hdr_t *pRsp, uint8 len )
+{
+  uint8 *pRefCnt = (uint8 *)pRsp + len;
+  ZDO_SharedRsp_t *pShared;
+  osal_event_hdr_t *pCopy;
+  ZDApp_SubMap_t shared = 0;
+  byte taskID;
+
+  *pRefCnt = 0;
+
+  if ( ZDApp_SharedFreeId != OSAL_MSG_FREE_NONE )
+  {
+    shared = targets & ZDApp_SubShared[type];
+    targets &= ~shared;
+  }
+
+  for ( taskID = 0; shared != 0; taskID++, shared >>= 1 )
+  {
+    if ( (shared & 0x01) == 0 )
+    {
+      continue;
+    }
+
+    pShared = (ZDO_SharedRsp_t *)osal_msg_allocate( sizeof( ZDO_SharedRsp_t ) +
+                                                    sizeof( uint8 * ) );
+    if ( pShared )
+    {
+      pShared->hdr.event = ZDO_SHARED_RSP;
+      pShared->hdr.status = type;
+      pShared->pRsp = pRsp;
+      *((uint8 **)(pShared + 1)) = pRefCnt;
+      OSAL_MSG_FREE_ID( pShared ) = ZDApp_SharedFreeId;
+      (*pRefCnt)++;
+
+      osal_msg_send( taskID, (uint8 *)pShared );
+    }
+  }
+
+  for ( taskID = 0; targets != 0; taskID++, targets >>= 1 )
+  {
+    if ( (targets & 0x01) == 0 )
+    {
+      continue;
+    }
+
+    if ( (targets == 0x01) && (*pRefCnt == 0) )
+    {
+      // Last subscriber and no references, no need for a copy
+      osal_msg_send( taskID, (uint8 *)pRsp );
+      return;  // EMBEDDED RETURN
+    }
+
+    pCopy = (osal_event_hdr_t *)osal_msg_allocate( len );
+
+    if ( pCopy )
+    {
+      osal_memcpy( pCopy, pRsp, len );
+      osal_msg_send( taskID, (uint8 *)pCopy );
+    }
+  }
+
+  if ( *pRefCnt == 0 )
+  {
+    osal_msg_deallocate( (uint8 *)pRsp );
+  }
+}
+
+/*********************************************************************
+ * @fn      ZDApp_SharedRspFreeCB()
+ *
+ * @brief   OSAL message deallocation hook, only called for the
+ *          ZDO_SHARED_RSP messages tagged with ZDApp_SharedFreeId.
+ *          Frees the notification with its last reference.
+ *
+ * @param   msg_ptr - ZDO_SharedRsp_t message about to be freed
+ * @param   len - length of the message
+ *
+ * @return  none
+ */
+static void ZDApp_SharedRspFreeCB( byte *msg_ptr, uint16 len )
+{
+  ZDO_SharedRsp_t *pShared = (ZDO_SharedRsp_t *)msg_ptr;
+  uint8 *pRefCnt = *((uint8 **)(pShared + 1));
+
+  (void)len;
+
+  if ( --(*pRefCnt) == 0 )
+  {
+    osal_msg_deallocate( (uint8 *)pShared->pRsp );
+  }
+}
+
+/*********************************************************************
+ * @fn      ZDApp_RegisterForLegacy()
+ *
+ * @brief   Register the one task of a ZDApp_RegisterForXxx() function,
+ *          replacing the task it registered before. Tasks subscribed
+ *          with ZDApp_RegisterForZDORsp() are left alone.
+ *
+ * @param   TaskID - ID of task to send messages
+ * @param   type - ZDAPP_SUB_IEEE_ADDR_RSP ...
+ *
+ * @return  ZSuccess or ZInvalidParameter
+ */
+ZStatus_t ZDApp_RegisterForLegacy( byte TaskID, uint8 type )
+{
+  ZStatus_t status;
+  byte prev = ZDApp_SubLegacy[type];
+
+  status = ZDApp_RegisterForZDORsp( TaskID, type, ZDAPP_SUB_COPY,
+                                    ZDAPP_SUB_ANY_SRC );
+
+  if ( status == ZSuccess )
+  {
+    // Only 1 task at a time
+    if ( (prev != TASK_NO_TASK) && (prev != TaskID) )
+    {
+      ZDApp_DeregisterForZDORsp( prev, type );
+    }
+    ZDApp_SubLegacy[type] = TaskID;
+  }
+
+  return ( status );
+}
+
 #if defined ( ZDO_IEEEADDR_REQUEST )
 /*********************************************************************
  * @fn      ZDApp_RegisterForIEEEAddrRsp()
@@ -3543,11 +4349,11 @@ void ZDApp_NetworkInit( uint16 delay )
  *
  * @param   TaskID - ID of task to send message
  *
- * @return  none
+ * @return  ZSuccess or ZInvalidParameter
  */
-void ZDApp_RegisterForIEEEAddrRsp( byte TaskID )
+ZStatus_t ZDApp_RegisterForIEEEAddrRsp( byte TaskID )
 {
-  ZDApp_IEEEAddrRsp_TaskID = TaskID;    // Only 1 task at a time
+  return ( ZDApp_RegisterForLegacy( TaskID, ZDAPP_SUB_IEEE_ADDR_RSP ) );
 }
 #endif // defined ( ZDO_IEEEADDR_REQUEST )
 
@@ -3559,11 +4365,11 @@ void ZDApp_RegisterForIEEEAddrRsp( byte TaskID )
  *
  * @param   TaskID - ID of task to send message
  *
- * @return  none
+ * @return  ZSuccess or ZInvalidParameter
  */
-void ZDApp_RegisterForNwkAddrRsp( byte TaskID )
+ZStatus_t ZDApp_RegisterForNwkAddrRsp( byte TaskID )
 {
-  ZDApp_NwkAddrRsp_TaskID = TaskID;    // Only 1 task at a time
+  return ( ZDApp_RegisterForLegacy( TaskID, ZDAPP_SUB_NWK_ADDR_RSP ) );
 }
 #endif // defined ( ZDO_NWKADDR_REQUEST )
 
@@ -3574,11 +4380,11 @@ void ZDApp_RegisterForNwkAddrRsp( byte TaskID )
  *
  * @param   TaskID - ID of task to send message
  *
- * @return  none
+ * @return  ZSuccess or ZInvalidParameter
  */
-void ZDApp_RegisterForMatchDescRsp( byte TaskID )
+ZStatus_t ZDApp_RegisterForMatchDescRsp( byte TaskID )
 {
-  ZDApp_MatchDescRsp_TaskID = TaskID;    // Only 1 task at a time
+  return ( ZDApp_RegisterForLegacy( TaskID, ZDAPP_SUB_MATCH_DESC_RSP ) );
 }
 
 /*********************************************************************
@@ -3588,11 +4394,11 @@ void ZDApp_RegisterForMatchDescRsp( byte TaskID )
  *
  * @param   TaskID - ID of task to send message
  *
- * @return  none
+ * @return  ZSuccess or ZInvalidParameter
  */
-void ZDApp_RegisterForEndDeviceAnnounce( byte TaskID )
+ZStatus_t ZDApp_RegisterForEndDeviceAnnounce( byte TaskID )
 {
-  ZDApp_EndDeviceAnnounce_TaskID = TaskID;    // Only 1 task at a time
+  return ( ZDApp_RegisterForLegacy( TaskID, ZDAPP_SUB_END_DEV_ANNCE ) );
 }
 
 #if defined ( ZDO_BIND_UNBIND_REQUEST )
@@ -3603,11 +4409,11 @@ void ZDApp_RegisterForEndDeviceAnnounce( byte TaskID )
  *
  * @param   TaskID - ID of task to send message
  *
- * @return  none
+ * @return  ZSuccess or ZInvalidParameter
  */
-void ZDApp_RegisterForBindRsp( byte TaskID )
+ZStatus_t ZDApp_RegisterForBindRsp( byte TaskID )
 {
-  ZDApp_BindUnbindRsp_TaskID = TaskID;    // Only 1 task at a time
+  return ( ZDApp_RegisterForLegacy( TaskID, ZDAPP_SUB_BIND_RSP ) );
 }
 #endif // ZDO_BIND_UNBIND_REQUEST
 
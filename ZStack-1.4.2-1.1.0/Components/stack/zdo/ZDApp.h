@@ -59,6 +59,10 @@ extern "C"
 #define ZDO_SECMGR_EVENT          0x0100
 #define ZDO_NWK_UPDATE_NV         0x0200
 #define ZDO_FRAMECOUNTER_CHANGE   0x0400
+#define ZDO_AF_TIMER              0x0800  // Runs afTimerEvent()
+#define ZDO_AF_TXQ_TIMER          0x1000  // Runs afTxQueueEvent()
+#define ZDO_INVENTORY_TIMER       0x2000  // Runs ZDInventoryTimerEvent()
+#define ZDO_SERVICE_TIMER         0x4000  // Runs the topology, resolve, resume and bind match timers
 
 // Incoming to ZDO
 #define ZDO_NWK_DISC_CNF        0x01
@@ -122,6 +126,70 @@ extern "C"
 #define ZDO_INITDEV_NEW_NETWORK_STATE           0x01
 #define ZDO_INITDEV_LEAVE_NOT_STARTED           0x02
 
+#if defined ( ZDO_FAST_RESUME )
+  // A device restoring its network state from NV comes up at once on
+  // the stored channel, PAN ID and parent, then checks the network
+  // still answers. This is the time(ms) to wait for an answer before
+  // asking again.
+  #if !defined( ZDAPP_RESUME_TIMEOUT )
+    #define ZDAPP_RESUME_TIMEOUT    2000
+  #endif
+
+  // Checks sent before an end device gives up the NV network state
+  // and falls back to discovery. A router keeps the NV network state,
+  // its children still depend on it, and goes on checking at a backoff.
+  #if !defined( ZDAPP_RESUME_TRIES )
+    #define ZDAPP_RESUME_TRIES      4
+  #endif
+
+  // Longest time(ms) between the checks of a router in backoff.
+  #if !defined( ZDAPP_RESUME_BACKOFF_MAX )
+    #define ZDAPP_RESUME_BACKOFF_MAX  60000
+  #endif
+
+  // Checks a router sends in backoff before it also falls back to
+  // discovery, about 3 minutes with the defaults. The network may have
+  // moved to another channel or PAN ID.
+  #if !defined( ZDAPP_RESUME_BACKOFF_TRIES )
+    #define ZDAPP_RESUME_BACKOFF_TRIES  6
+  #endif
+
+  // ZDApp_ResumeStats_t state
+  #define ZDAPP_RESUME_NONE         0x00  // New network state, nothing to resume
+  #define ZDAPP_RESUME_FAST         0x01  // Starting from the NV network state
+  #define ZDAPP_RESUME_VERIFY       0x02  // Up, waiting for the network to answer
+  #define ZDAPP_RESUME_VERIFIED     0x03  // The network answered
+  #define ZDAPP_RESUME_FAILED       0x04  // Fell back to discovery
+  #define ZDAPP_RESUME_BACKOFF      0x05  // Router kept the NV network state, still checking
+#endif // ZDO_FAST_RESUME
+
+// ZDO notifications a task can subscribe to, ZDApp_RegisterForZDORsp()
+#define ZDAPP_SUB_IEEE_ADDR_RSP     0
+#define ZDAPP_SUB_NWK_ADDR_RSP      1
+#define ZDAPP_SUB_MATCH_DESC_RSP    2
+#define ZDAPP_SUB_END_DEV_ANNCE     3
+#define ZDAPP_SUB_BIND_RSP          4   // Bind_rsp and Unbind_rsp
+#define ZDAPP_SUB_TYPES             5
+
+// Subscribers are kept in a bitmap of task IDs per notification, so
+// only tasks below this ID can subscribe. 16 or 32, ZDApp_Init() checks
+// that every OSAL task fits.
+#if !defined( ZDAPP_SUB_TASK_MAX )
+  #define ZDAPP_SUB_TASK_MAX        16
+#endif
+
+// ZDApp_RegisterForZDORsp() options
+#define ZDAPP_SUB_COPY              0x00  // Own copy of each notification
+#define ZDAPP_SUB_SHARED            0x01  // ZDO_SHARED_RSP, see ZDO_SharedRsp_t
+
+// ZDApp_RegisterForZDORsp() srcAddr for no source filter
+#define ZDAPP_SUB_ANY_SRC           INVALID_NODE_ADDR
+
+// Subscriptions filtered by source address, for all tasks together.
+#if !defined( ZDAPP_SUB_FILTER_MAX )
+  #define ZDAPP_SUB_FILTER_MAX      4
+#endif
+
 #if defined ( MANAGED_SCAN )
   // Only use in a battery powered device
 
@@ -325,6 +393,31 @@ typedef struct
   uint8  status;
 } ZDO_UnbindRsp_t;
 
+// ZDO_SHARED_RSP message. All ZDAPP_SUB_SHARED subscribers of a
+// notification get a reference to the same read-only buffer, holding the
+// message a ZDAPP_SUB_COPY subscriber would get. The message is freed
+// with osal_msg_deallocate() as usual, which frees the buffer with the
+// last reference.
+typedef struct
+{
+  osal_event_hdr_t hdr;       // hdr.status is the ZDAPP_SUB_xxx notification
+  osal_event_hdr_t *pRsp;     // e.g. ZDO_MatchDescResp_t for ZDAPP_SUB_MATCH_DESC_RSP
+} ZDO_SharedRsp_t;
+
+#if defined ( ZDO_FAST_RESUME )
+// fast resume latency -- osal_GetSystemClock() times in ms since boot,
+// 0 if not reached
+typedef struct
+{
+  uint8  state;     // ZDAPP_RESUME_NONE ...
+  uint8  tries;     // checks sent
+  uint32 init;      // ZDOInitDevice() called
+  uint32 online;    // end device up, or router routing
+  uint32 firstTx;   // first check sent
+  uint32 done;      // network answered or given up, 0 in backoff
+} ZDApp_ResumeStats_t;
+#endif
+
 /*********************************************************************
  * GLOBAL VARIABLES
  */
@@ -404,6 +497,28 @@ extern uint8 ZDOInitDevice( uint16 startDelay );
 #define ZDApp_AutoFindDestination( endPoint )   ZDApp_AutoFindDestinationEx( endPoint, (uint8 *)0 )
 extern void ZDApp_AutoFindDestinationEx( byte endPoint, uint8 *task_id );
 
+/*
+ * Start ZDO_SERVICE_TIMER, unless it already runs out sooner
+ */
+extern void ZDApp_ServiceTimer( uint16 timeout );
+
+#if defined ( ZDO_FAST_RESUME )
+/*
+ * Channels to look for the parent on when resuming
+ */
+extern uint32 ZDApp_ResumeChannels( void );
+
+/*
+ * Called with every NWK_addr_rsp and IEEE_addr_rsp received
+ */
+extern void ZDApp_ResumeAddrRsp( uint16 srcAddr, byte status );
+
+/*
+ * Get the fast resume latency of the last start
+ */
+extern ZDApp_ResumeStats_t *ZDApp_ResumeStatsGet( void );
+#endif
+
 /*
  *
  * @MT SPI_CMD_ZDO_AUTO_ENDDEVICEBIND_REQ
@@ -765,31 +880,49 @@ extern uint8 ZDApp_StopJoiningCycle( void );
  * ZDO Information Notification Registration Functions
  */
 
+/*
+ * Subscribe a task to a ZDO notification (ZDAPP_SUB_IEEE_ADDR_RSP ...),
+ * as a copy or shared (ZDAPP_SUB_COPY or ZDAPP_SUB_SHARED), from one
+ * source address or from any (ZDAPP_SUB_ANY_SRC). Any number of tasks
+ * can subscribe to the same notification.
+ *
+ * The ZDApp_RegisterForXxx() functions below keep one task at a time,
+ * as they always did: registering another task replaces the one they
+ * registered before, but not the tasks subscribed here.
+ */
+extern ZStatus_t ZDApp_RegisterForZDORsp( byte TaskID, uint8 type,
+                                          uint8 options, uint16 srcAddr );
+
+/*
+ * Unsubscribe a task from a ZDO notification
+ */
+extern void ZDApp_DeregisterForZDORsp( byte TaskID, uint8 type );
+
 /*
  * Register to receive IEEE Addr Response messages
  */
-extern void ZDApp_RegisterForIEEEAddrRsp( byte TaskID );
+extern ZStatus_t ZDApp_RegisterForIEEEAddrRsp( byte TaskID );
 
 /*
  * Register to receive NWK Addr Response messages
  */
-extern void ZDApp_RegisterForNwkAddrRsp( byte TaskID );
+extern ZStatus_t ZDApp_RegisterForNwkAddrRsp( byte TaskID );
 
 /*
  * Register to receive Match Descriptor Response messages
  */
-extern void ZDApp_RegisterForMatchDescRsp( byte TaskID );
+extern ZStatus_t ZDApp_RegisterForMatchDescRsp( byte TaskID );
 
 /*
  * Register to receive End Device Announce messages
  */
-extern void ZDApp_RegisterForEndDeviceAnnounce( byte TaskID );
+extern ZStatus_t ZDApp_RegisterForEndDeviceAnnounce( byte TaskID );
 
 #if defined ( ZDO_BIND_UNBIND_REQUEST )
 /*
  * Register to receive Bind_rsp and Unbind_rsp messages
  */
-extern void ZDApp_RegisterForBindRsp( byte TaskID );
+extern ZStatus_t ZDApp_RegisterForBindRsp( byte TaskID );
 #endif
 
 #if defined ( ZDO_BIND_UNBIND_RESPONSE ) && !defined ( REFLECTOR )
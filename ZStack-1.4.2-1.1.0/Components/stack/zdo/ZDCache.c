@@ -31,6 +31,12 @@
  * MACROS
  */
 
+#if ( CACHE_DEV_MAX > 0 )
+  // Bucket of a network address in the NwkHash index.
+  #define CACHE_HASH_NWK( ADDR ) \
+    ( ((byte)(ADDR) ^ (byte)((ADDR) >> 8)) & (CACHE_HASH_SIZE - 1) )
+#endif
+
 /*********************************************************************
  * CONSTANTS
  */
@@ -78,6 +84,14 @@ typedef enum {
 } eCacheState;
 #endif
 
+#if ( CACHE_DEV_MAX > 0 )
+  #if ( CACHE_DEV_MAX < 0xFF )
+    typedef byte cacheIdx_t;
+  #else
+    typedef uint16 cacheIdx_t;
+  #endif
+#endif
+
 /*********************************************************************
  * GLOBAL VARIABLES
  */
@@ -96,16 +110,28 @@ typedef enum {
 
 #if ( CACHE_DEV_MAX > 0 )
 static byte processDiscoveryStoreReq  ( byte *data );
-static byte processSimpleDescStoreReq ( byte *data, byte idx );
+static byte processSimpleDescStoreReq ( byte *data, cacheIdx_t idx );
 static void processFindNodeCacheReq   ( byte *data );
-
-static byte getCnt    ( void );
-static byte getIdx    ( uint16 addr );
-static byte getNth    ( byte Nth );
-static byte getIdxExt ( byte *ieee );
-static byte getIdxEP  ( byte idx, byte ep );
+static byte matchDescEPs( cacheIdx_t idx, byte *buf, byte inCnt,
+      uint16 *inClusters, byte outCnt, uint16 *outClusters, uint16 profileID );
+
+static cacheIdx_t getCnt    ( void );
+static cacheIdx_t getIdx    ( uint16 addr );
+static cacheIdx_t getNth    ( byte Nth );
+static cacheIdx_t getIdxExt ( byte *ieee );
+static byte getIdxEP  ( cacheIdx_t idx, byte ep );
 static byte purgeAddr ( uint16 addr );
 static byte purgeIEEE ( byte *ieee );
+static byte hashExt   ( byte *ieee );
+
+static cacheIdx_t cacheNew( uint16 addr, byte *ieee );
+static void cacheDrop ( cacheIdx_t idx );
+static void cacheTouch( cacheIdx_t idx );
+static void lruLink   ( cacheIdx_t idx );
+static void lruUnlink ( cacheIdx_t idx );
+static void simpFree  ( SimpleDescriptionFormat_t *pDesc );
+static uint16 *poolAlloc( uint16 len, cacheIdx_t keep );
+static void poolFree  ( uint16 *ptr, uint16 len );
 #endif
 
 /*********************************************************************
@@ -120,14 +146,36 @@ static byte secUse;
 #if ( CACHE_DEV_MAX > 0 )
 static uint16                      NwkAddr[CACHE_DEV_MAX];
 static byte                        ExtAddr[CACHE_DEV_MAX][Z_EXTADDR_LEN];
-static uint32                       Expiry[CACHE_DEV_MAX];
+#if ( CACHE_EXPIRY > 0 )
+static uint16                       Expiry[CACHE_DEV_MAX];
+#endif
 static NodeDescriptorFormat_t     NodeDesc[CACHE_DEV_MAX];
 static NodePowerDescriptorFormat_t NodePwr[CACHE_DEV_MAX];
 static byte                          EPCnt[CACHE_DEV_MAX];
 static byte                          EPArr[CACHE_DEV_MAX][CACHE_EP_MAX];
 static SimpleDescriptionFormat_t  SimpDesc[CACHE_DEV_MAX][CACHE_EP_MAX];
-static uint16               InClusters[CACHE_DEV_MAX][CACHE_EP_MAX][CACHE_CR_MAX];
-static uint16              OutClusters[CACHE_DEV_MAX][CACHE_EP_MAX][CACHE_CR_MAX];
+
+// Hash chains by network and IEEE address. NwkNext also chains free entries.
+static cacheIdx_t                  NwkNext[CACHE_DEV_MAX];
+static cacheIdx_t                  ExtNext[CACHE_DEV_MAX];
+static cacheIdx_t                  NwkHash[CACHE_HASH_SIZE];
+static cacheIdx_t                  ExtHash[CACHE_HASH_SIZE];
+static cacheIdx_t                 FreeHead;
+
+// Entries from least to most recently used. Every touch restarts the
+// entry's expiry, so this is also the expiry queue.
+static cacheIdx_t                 LruOlder[CACHE_DEV_MAX];
+static cacheIdx_t                 LruNewer[CACHE_DEV_MAX];
+static cacheIdx_t                LruOldest;
+static cacheIdx_t                LruNewest;
+static cacheIdx_t                CacheUsed;
+#if ( CACHE_EXPIRY > 0 )
+static uint16                    CacheTick;
+#endif
+
+// Cluster lists of the cached simple descriptors, packed without gaps.
+static uint16              ClusterPool[CACHE_POOL_MAX];
+static uint16                 PoolUsed;
 #elif ( CACHE_DEV_MAX == 0 )
 static uint16 cacheFindAddr[FIND_RSP_MAX];
 static byte EPArr[CACHE_EP_MAX];
@@ -149,30 +197,23 @@ static byte cacheRsp;  // Results of last discovery cache request.
 static byte processDiscoveryStoreReq( byte *data )
 {
   uint16 aoi = BUILD_UINT16( data[0], data[1] );
+  byte *ieee = data + 2;
   byte rtrn = ZDP_INSUFFICIENT_SPACE;
-  byte idx;
 
-  data += 2;
   // First purge any outdated cache with this network address or IEEE.
   purgeAddr( aoi );
-  purgeIEEE( data );
+  purgeIEEE( ieee );
 
-  // If an invalid addr cannot be found, the cache arrays are full.
-  if ( (idx = getIdx( INVALID_NODE_ADDR )) != CACHE_DEV_MAX )
-  {
-    osal_cpyExtAddr( ExtAddr[idx], data );
-    data += Z_EXTADDR_LEN;
+  data += (2 + Z_EXTADDR_LEN);
 
-    if ( (*data++ == sizeof( NodeDescriptorFormat_t )) &&
-         (*data++ == sizeof( NodePowerDescriptorFormat_t )) &&
-         (*data++ <= CACHE_EP_MAX) &&
-         (*data   < CACHE_EP_MAX) )
-    {
-      rtrn = ZDP_SUCCESS;
-      NwkAddr[idx] = aoi;
-      Expiry[idx] = 0;  //TBD - what value & how to keep alive?
-      EPCnt[idx] = 0;
-    }
+  if ( (*data++ == sizeof( NodeDescriptorFormat_t )) &&
+       (*data++ == sizeof( NodePowerDescriptorFormat_t )) &&
+       (*data++ <= CACHE_EP_MAX) &&
+       (*data   < CACHE_EP_MAX) )
+  {
+    // Evicts the least recently used entry if the cache is full.
+    cacheNew( aoi, ieee );
+    rtrn = ZDP_SUCCESS;
   }
 
   return rtrn;
@@ -185,10 +226,11 @@ static byte processDiscoveryStoreReq( byte *data )
  *
  * @return      none
  */
-static byte processSimpleDescStoreReq( byte *data, byte idx )
+static byte processSimpleDescStoreReq( byte *data, cacheIdx_t idx )
 {
   byte rtrn = ZDP_INSUFFICIENT_SPACE;
   SimpleDescriptionFormat_t desc;
+  byte epIdx;
 
   // Skip first byte == total length of descriptor.
   if (ZDO_ParseSimpleDescBuf( data+1, &desc ))  {
@@ -196,18 +238,26 @@ static byte processSimpleDescStoreReq( byte *data, byte idx )
     return ZDP_NOT_PERMITTED;
   }
 
-  if ( (desc.AppNumInClusters <= CACHE_CR_MAX) &&
-       (desc.AppNumOutClusters <= CACHE_CR_MAX) )
+  epIdx = getIdxEP( idx, desc.EndPoint );
+
+  if ( epIdx == CACHE_EP_MAX )
+  {
+    rtrn = ZDP_NOT_PERMITTED;
+  }
+  else
   {
-    byte epIdx = getIdxEP( idx, desc.EndPoint );
+    SimpleDescriptionFormat_t *pDesc = &(SimpDesc[idx][epIdx]);
+    uint16 *ptr;
 
-    if ( epIdx == CACHE_EP_MAX )
-    {
-      rtrn = ZDP_NOT_PERMITTED;
-    }
-    else
+    // The old cluster lists go back to the pool before the new ones are sized.
+    simpFree( pDesc );
+
+    ptr = poolAlloc( desc.AppNumInClusters + desc.AppNumOutClusters, idx );
+
+    if ( ptr != NULL )
     {
-      SimpleDescriptionFormat_t *pDesc = &(SimpDesc[idx][epIdx]);
+      pDesc->pAppInClusterList = ptr;
+      pDesc->pAppOutClusterList = ptr + desc.AppNumInClusters;
 
       osal_memcpy( pDesc->pAppInClusterList, desc.pAppInClusterList,
                                                        desc.AppNumInClusters*sizeof(uint16) );
@@ -247,7 +297,7 @@ static byte processSimpleDescStoreReq( byte *data, byte idx )
 static void processFindNodeCacheReq( byte *data )
 {
   uint16 aoi = BUILD_UINT16( data[0], data[1] );
-  byte idx = getIdx( aoi );
+  cacheIdx_t idx = getIdx( aoi );
 
   if ( idx == CACHE_DEV_MAX )
   {
@@ -275,11 +325,11 @@ static void processFindNodeCacheReq( byte *data )
  *
  * @return      none
  */
-static void processMgmtCacheReq( byte idx )
+static void processMgmtCacheReq( byte start )
 {
   const byte max =
-              (((CACHE_DEV_MAX-idx) * (2 + Z_EXTADDR_LEN) + 1) < MAX_PKT_LEN) ?
-               ((CACHE_DEV_MAX-idx) * (2 + Z_EXTADDR_LEN) + 1) : MAX_PKT_LEN;
+              (((CACHE_DEV_MAX-start) * (2 + Z_EXTADDR_LEN) + 1) < MAX_PKT_LEN) ?
+               ((CACHE_DEV_MAX-start) * (2 + Z_EXTADDR_LEN) + 1) : MAX_PKT_LEN;
   byte *buf = osal_mem_alloc( max );
   byte status = ZDP_INSUFFICIENT_SPACE;
   byte cnt = 1;
@@ -291,12 +341,14 @@ static void processMgmtCacheReq( byte idx )
   else
   {
     byte *ptr = buf;
+    cacheIdx_t idx;
+
     *ptr++ = ZDP_SUCCESS;
-    *ptr++ = getCnt();
-    *ptr++ = idx;
+    *ptr++ = (byte)getCnt();
+    *ptr++ = start;
     *ptr++ = 0;
 
-    for ( idx = getNth( idx ); idx < CACHE_DEV_MAX; idx++ )
+    for ( idx = getNth( start ); idx < CACHE_DEV_MAX; idx++ )
     {
       if ( cnt >= (max - (2 + Z_EXTADDR_LEN)) )
       {
@@ -316,32 +368,60 @@ static void processMgmtCacheReq( byte idx )
 
   SendMsg( Mgmt_Cache_rsp, cnt, buf );
 
-  if ( buf != NULL )
+  if ( buf != &status )
   {
     osal_mem_free( buf );
   }
 }
 
 /*********************************************************************
- * @fn      getCnt
+ * @fn      matchDescEPs
  *
- * @return  The count of valid cache entries.
+ * @brief   Fill in a Match_Desc_rsp for one cached device.
+ *
+ * @param   idx - a valid index of a cached device.
+ * @param   buf - response buffer; the AOI, count and endpoints are written.
  *
+ * @return  The count of matching endpoints.
  */
-static byte getCnt( void )
+static byte matchDescEPs( cacheIdx_t idx, byte *buf, byte inCnt,
+       uint16 *inClusters, byte outCnt, uint16 *outClusters, uint16 profileID )
 {
-  byte cnt = 0;
-  byte idx;
+  SimpleDescriptionFormat_t *sDesc = SimpDesc[idx];
+  byte epIdx, epCnt = 0;
 
-  for ( idx = 0; idx < CACHE_DEV_MAX; idx++ )
+  for ( epIdx = 0; epIdx < EPCnt[idx]; epIdx++, sDesc++ )
   {
-    if ( NwkAddr[idx] != INVALID_NODE_ADDR )
+    if ( sDesc->AppProfId == profileID )
     {
-      cnt++;
+      // If there are no search input/ouput clusters - respond.
+      if ( ((inCnt == 0) && (outCnt == 0))                               ||
+             ZDO_AnyClusterMatches( inCnt, inClusters,
+                     sDesc->AppNumInClusters, sDesc->pAppInClusterList ) ||
+             ZDO_AnyClusterMatches( outCnt, outClusters,
+                     sDesc->AppNumOutClusters, sDesc->pAppOutClusterList ))
+      {
+        buf[4 + epCnt++] = sDesc->EndPoint;
+      }
     }
   }
 
-  return cnt;
+  buf[1] = LO_UINT16( NwkAddr[idx] );
+  buf[2] = HI_UINT16( NwkAddr[idx] );
+  buf[3] = epCnt;
+
+  return epCnt;
+}
+
+/*********************************************************************
+ * @fn      getCnt
+ *
+ * @return  The count of valid cache entries.
+ *
+ */
+static cacheIdx_t getCnt( void )
+{
+  return CacheUsed;
 }
 
 /*********************************************************************
@@ -355,16 +435,13 @@ static byte getCnt( void )
  * @return  If address found, return the valid index, else CACHE_DEV_MAX.
  *
  */
-static byte getIdx( uint16 addr )
+static cacheIdx_t getIdx( uint16 addr )
 {
-  byte idx;
+  cacheIdx_t idx = NwkHash[ CACHE_HASH_NWK( addr ) ];
 
-  for ( idx = 0; idx < CACHE_DEV_MAX; idx++ )
+  while ( (idx != CACHE_DEV_MAX) && (NwkAddr[idx] != addr) )
   {
-    if ( addr == NwkAddr[idx] )
-    {
-      break;
-    }
+    idx = NwkNext[idx];
   }
 
   return idx;
@@ -379,10 +456,10 @@ static byte getIdx( uint16 addr )
  *          else CACHE_DEV_MAX.
  *
  */
-static byte getNth( byte Nth )
+static cacheIdx_t getNth( byte Nth )
 {
-  byte cnt = 0;
-  byte idx;
+  cacheIdx_t cnt = 0;
+  cacheIdx_t idx;
 
   for ( idx = 0; idx < CACHE_DEV_MAX; idx++ )
   {
@@ -409,17 +486,13 @@ static byte getNth( byte Nth )
  * @return  If address found, return the valid index, else CACHE_DEV_MAX.
  *
  */
-static byte getIdxExt( byte *ieee )
+static cacheIdx_t getIdxExt( byte *ieee )
 {
-  byte idx;
+  cacheIdx_t idx = ExtHash[ hashExt( ieee ) ];
 
-  for ( idx = 0; idx < CACHE_DEV_MAX; idx++ )
+  while ( (idx != CACHE_DEV_MAX) && !osal_ExtAddrEqual( ieee, ExtAddr[idx] ) )
   {
-    if ( osal_ExtAddrEqual( ieee, ExtAddr[idx] ) &&
-                                          (NwkAddr[idx] != INVALID_NODE_ADDR) )
-    {
-      break;
-    }
+    idx = ExtNext[idx];
   }
 
   return idx;
@@ -437,7 +510,7 @@ static byte getIdxExt( byte *ieee )
  * @return  If EndPoint found, return the valid index, else CACHE_EP_MAX.
  *
  */
-static byte getIdxEP( byte idx, byte ep )
+static byte getIdxEP( cacheIdx_t idx, byte ep )
 {
   byte epIdx;
 
@@ -460,50 +533,324 @@ static byte getIdxEP( byte idx, byte ep )
 /*********************************************************************
  * @fn      purgeAddr
  *
- * @brief   Purge every instance of given network address from Discovery Cache.
+ * @brief   Purge the given network address from Discovery Cache.
  *
  * @param   uint16 - a 16-bit network address.
  *
+ * @return  The count of entries purged.
  */
 static byte purgeAddr( uint16 addr )
 {
-  byte idx, cnt = 0;
+  cacheIdx_t idx = getIdx( addr );
 
-  for ( idx = 0; idx < CACHE_DEV_MAX; idx++ )
+  if ( idx == CACHE_DEV_MAX )
   {
-    if ( NwkAddr[idx] == addr )
-    {
-      NwkAddr[idx] = INVALID_NODE_ADDR;
-      cnt++;
-    }
+    return 0;  // EMBEDDED RETURN
   }
 
-  return cnt;
+  cacheDrop( idx );
+  return 1;
 }
 
 /*********************************************************************
  * @fn      purgeIEEE
  *
- * @brief   Purge every instance of given IEEE from Discovery Cache.
+ * @brief   Purge the given IEEE from Discovery Cache.
  *
  * @param   ZLongAddr_t - a valid IEEE address.
  *
+ * @return  The count of entries purged.
  */
 static byte purgeIEEE( byte *ieee )
 {
-  byte idx, cnt = 0;
+  cacheIdx_t idx = getIdxExt( ieee );
 
-  for ( idx = 0; idx < CACHE_DEV_MAX; idx++ )
+  if ( idx == CACHE_DEV_MAX )
+  {
+    return 0;  // EMBEDDED RETURN
+  }
+
+  cacheDrop( idx );
+  return 1;
+}
+
+/*********************************************************************
+ * @fn      hashExt
+ *
+ * @brief   Hash an IEEE address into the ExtHash index.
+ *
+ * @param   ieee - a valid extended IEEE address.
+ *
+ * @return  The bucket of the address.
+ */
+static byte hashExt( byte *ieee )
+{
+  byte hash = 0;
+  byte cnt;
+
+  for ( cnt = 0; cnt < Z_EXTADDR_LEN; cnt++ )
+  {
+    hash ^= ieee[cnt];
+  }
+
+  return ( hash & (CACHE_HASH_SIZE - 1) );
+}
+
+/*********************************************************************
+ * @fn      cacheNew
+ *
+ * @brief   Take a free entry, evicting the least recently used one if
+ *          there is none, and index it under both addresses.
+ *
+ * @param   addr - network address of the new entry.
+ * @param   ieee - IEEE address of the new entry.
+ *
+ * @return  The index of the new entry.
+ */
+static cacheIdx_t cacheNew( uint16 addr, byte *ieee )
+{
+  cacheIdx_t idx;
+  byte hash;
+
+  if ( FreeHead == CACHE_DEV_MAX )
+  {
+    cacheDrop( LruOldest );
+  }
+
+  idx = FreeHead;
+  FreeHead = NwkNext[idx];
+
+  NwkAddr[idx] = addr;
+  osal_cpyExtAddr( ExtAddr[idx], ieee );
+  EPCnt[idx] = 0;
+
+  hash = CACHE_HASH_NWK( addr );
+  NwkNext[idx] = NwkHash[hash];
+  NwkHash[hash] = idx;
+
+  hash = hashExt( ieee );
+  ExtNext[idx] = ExtHash[hash];
+  ExtHash[hash] = idx;
+
+  lruLink( idx );
+  CacheUsed++;
+
+  return idx;
+}
+
+/*********************************************************************
+ * @fn      cacheDrop
+ *
+ * @brief   Remove an entry from the indexes, return its cluster lists to
+ *          the pool and put it on the free list.
+ *
+ * @param   idx - a valid index of a cached device.
+ *
+ * @return  none
+ */
+static void cacheDrop( cacheIdx_t idx )
+{
+  cacheIdx_t *pIdx;
+  byte epIdx;
+
+  pIdx = &NwkHash[ CACHE_HASH_NWK( NwkAddr[idx] ) ];
+  while ( *pIdx != idx )
+  {
+    pIdx = &NwkNext[*pIdx];
+  }
+  *pIdx = NwkNext[idx];
+
+  pIdx = &ExtHash[ hashExt( ExtAddr[idx] ) ];
+  while ( *pIdx != idx )
+  {
+    pIdx = &ExtNext[*pIdx];
+  }
+  *pIdx = ExtNext[idx];
+
+  lruUnlink( idx );
+
+  for ( epIdx = 0; epIdx < CACHE_EP_MAX; epIdx++ )
+  {
+    simpFree( &SimpDesc[idx][epIdx] );
+  }
+
+  NwkAddr[idx] = INVALID_NODE_ADDR;
+  NwkNext[idx] = FreeHead;
+  FreeHead = idx;
+  CacheUsed--;
+}
+
+/*********************************************************************
+ * @fn      cacheTouch
+ *
+ * @brief   Mark an entry as the most recently used and restart its expiry.
+ *
+ * @param   idx - a valid index of a cached device.
+ *
+ * @return  none
+ */
+static void cacheTouch( cacheIdx_t idx )
+{
+  lruUnlink( idx );
+  lruLink( idx );
+}
+
+/*********************************************************************
+ * @fn      lruLink
+ *
+ * @brief   Append an unlinked entry to the newest end of the LRU queue.
+ *
+ * @param   idx - a valid index of a cached device.
+ *
+ * @return  none
+ */
+static void lruLink( cacheIdx_t idx )
+{
+  LruOlder[idx] = LruNewest;
+  LruNewer[idx] = CACHE_DEV_MAX;
+
+  if ( LruNewest == CACHE_DEV_MAX )
+  {
+    LruOldest = idx;
+  }
+  else
+  {
+    LruNewer[LruNewest] = idx;
+  }
+  LruNewest = idx;
+
+#if ( CACHE_EXPIRY > 0 )
+  Expiry[idx] = CacheTick + CACHE_EXPIRY;
+#endif
+}
+
+/*********************************************************************
+ * @fn      lruUnlink
+ *
+ * @brief   Take an entry out of the LRU queue.
+ *
+ * @param   idx - a valid index of a cached device.
+ *
+ * @return  none
+ */
+static void lruUnlink( cacheIdx_t idx )
+{
+  if ( LruOlder[idx] == CACHE_DEV_MAX )
+  {
+    LruOldest = LruNewer[idx];
+  }
+  else
+  {
+    LruNewer[ LruOlder[idx] ] = LruNewer[idx];
+  }
+
+  if ( LruNewer[idx] == CACHE_DEV_MAX )
+  {
+    LruNewest = LruOlder[idx];
+  }
+  else
+  {
+    LruOlder[ LruNewer[idx] ] = LruOlder[idx];
+  }
+}
+
+/*********************************************************************
+ * @fn      simpFree
+ *
+ * @brief   Return the cluster lists of a cached simple descriptor to the pool.
+ *
+ * @param   pDesc - a cached simple descriptor.
+ *
+ * @return  none
+ */
+static void simpFree( SimpleDescriptionFormat_t *pDesc )
+{
+  uint16 len = pDesc->AppNumInClusters + pDesc->AppNumOutClusters;
+
+  if ( len != 0 )
+  {
+    poolFree( pDesc->pAppInClusterList, len );
+  }
+
+  pDesc->AppNumInClusters = 0;
+  pDesc->AppNumOutClusters = 0;
+  pDesc->pAppInClusterList = NULL;
+  pDesc->pAppOutClusterList = NULL;
+}
+
+/*********************************************************************
+ * @fn      poolAlloc
+ *
+ * @brief   Take space for cluster lists from the end of the pool, evicting
+ *          least recently used entries until it fits.
+ *
+ * @param   len - count of cluster IDs needed.
+ * @param   keep - the entry being stored to; it must be the newest entry
+ *                 and is never evicted.
+ *
+ * @return  Pointer to the space, or NULL if the pool is too small.
+ */
+static uint16 *poolAlloc( uint16 len, cacheIdx_t keep )
+{
+  uint16 *ptr;
+
+  // Would never fit, don't flush the cache trying
+  if ( len > CACHE_POOL_MAX )
   {
-    if ( osal_ExtAddrEqual( ieee, ExtAddr[idx] ) &&
-                                          (NwkAddr[idx] != INVALID_NODE_ADDR) )
+    return NULL;  // EMBEDDED RETURN
+  }
+
+  while ( (CACHE_POOL_MAX - PoolUsed) < len )
+  {
+    if ( LruOldest == keep )
     {
-      NwkAddr[idx] = INVALID_NODE_ADDR;
-      cnt++;
+      return NULL;  // EMBEDDED RETURN
     }
+    cacheDrop( LruOldest );
   }
 
-  return cnt;
+  ptr = ClusterPool + PoolUsed;
+  PoolUsed += len;
+
+  return ptr;
+}
+
+/*********************************************************************
+ * @fn      poolFree
+ *
+ * @brief   Release space in the pool by sliding the lists after it down,
+ *          then re-point the descriptors that moved.
+ *
+ * @param   ptr - start of the space, as returned by poolAlloc().
+ * @param   len - count of cluster IDs in the space.
+ *
+ * @return  none
+ */
+static void poolFree( uint16 *ptr, uint16 len )
+{
+  SimpleDescriptionFormat_t *pDesc;
+  cacheIdx_t idx;
+  byte epIdx;
+
+  // osal_memcpy() copies upwards, so sliding down over the hole is safe.
+  osal_memcpy( ptr, ptr + len,
+               (uint16)((ClusterPool + PoolUsed) - (ptr + len)) * sizeof( uint16 ) );
+  PoolUsed -= len;
+
+  for ( idx = 0; idx < CACHE_DEV_MAX; idx++ )
+  {
+    pDesc = SimpDesc[idx];
+
+    for ( epIdx = 0; epIdx < CACHE_EP_MAX; epIdx++, pDesc++ )
+    {
+      if ( ((pDesc->AppNumInClusters + pDesc->AppNumOutClusters) != 0) &&
+           (pDesc->pAppInClusterList > ptr) )
+      {
+        pDesc->pAppInClusterList -= len;
+        pDesc->pAppOutClusterList -= len;
+      }
+    }
+  }
 }
 #endif
 
@@ -523,19 +870,26 @@ void ZDCacheInit( void )
   (void)secUse;
 
 #if ( CACHE_DEV_MAX > 0 )
-  byte idx;
+  cacheIdx_t idx;
 
   for ( idx = 0; idx < CACHE_DEV_MAX; idx++ )
   {
-    byte epIdx;
     NwkAddr[idx] = INVALID_NODE_ADDR;
+    NwkNext[idx] = idx + 1;  // The last entry ends the free list.
+  }
+  osal_memset( SimpDesc, 0, sizeof( SimpDesc ) );
 
-    for ( epIdx = 0; epIdx < CACHE_EP_MAX; epIdx++ )
-    {
-      SimpDesc[idx][epIdx].pAppInClusterList = InClusters[idx][epIdx];
-      SimpDesc[idx][epIdx].pAppOutClusterList= OutClusters[idx][epIdx];
-    }
+  for ( idx = 0; idx < CACHE_HASH_SIZE; idx++ )
+  {
+    NwkHash[idx] = CACHE_DEV_MAX;
+    ExtHash[idx] = CACHE_DEV_MAX;
   }
+
+  FreeHead = 0;
+  LruOldest = CACHE_DEV_MAX;
+  LruNewest = CACHE_DEV_MAX;
+  CacheUsed = 0;
+  PoolUsed = 0;
 #elif ( CACHE_DEV_MAX == 0 )
   // Client cache work done by ZDCacheTimerEvent, driven by NWK_AUTO_POLL_EVT.
 #endif
@@ -550,18 +904,16 @@ void ZDCacheInit( void )
 void ZDCacheTimerEvent( void )
 {
 #if ( CACHE_DEV_MAX > 0 )
-  byte idx;
+#if ( CACHE_EXPIRY > 0 )
+  CacheTick++;
 
-  for ( idx = 0; idx < CACHE_DEV_MAX; idx++ )
+  // Entries expire in LRU order, so only the oldest needs checking.
+  while ( (LruOldest != CACHE_DEV_MAX) &&
+          ((int16)(CacheTick - Expiry[LruOldest]) >= 0) )
   {
-    if ( NwkAddr[idx] != INVALID_NODE_ADDR )
-    {
-      if ( --Expiry[idx] == 0 )
-      {
-        NwkAddr[idx] = INVALID_NODE_ADDR;
-      }
-    }
+    cacheDrop( LruOldest );
   }
+#endif
 #elif ( CACHE_DEV_MAX == 0 )
   static eCacheState state = eCacheWait;
   static byte reqIdx = 0;
@@ -837,10 +1189,7 @@ void ZDCacheProcessReq( zAddrType_t *src, byte *msg, byte len,
   }
   else if ( cmd == Discovery_Register_req )
   {
-    if ( getIdx( INVALID_NODE_ADDR ) == CACHE_DEV_MAX )
-    {
-      status = ZDP_TABLE_FULL;
-    }
+    // A full cache still has room: the least recently used entry is evicted.
   }
   else if ( cmd == Discovery_store_req )
   {
@@ -859,7 +1208,8 @@ void ZDCacheProcessReq( zAddrType_t *src, byte *msg, byte len,
   else
   {
     uint16 aoi = BUILD_UINT16( msg[0], msg[1] );
-    byte idx = getIdx( aoi );
+    cacheIdx_t idx = getIdx( aoi );
+    byte epIdx;
 
     if ( cmd == Remove_node_cache_req )
     {
@@ -875,6 +1225,7 @@ void ZDCacheProcessReq( zAddrType_t *src, byte *msg, byte len,
     else
     {
       msg += (2 + Z_EXTADDR_LEN);
+      cacheTouch( idx );
 
       switch ( cmd )
       {
@@ -889,6 +1240,12 @@ void ZDCacheProcessReq( zAddrType_t *src, byte *msg, byte len,
       case Active_EP_store_req:
         if ( *msg < CACHE_EP_MAX )
         {
+          // Simple descriptors stored against the old endpoint list are stale.
+          for ( epIdx = 0; epIdx < CACHE_EP_MAX; epIdx++ )
+          {
+            simpFree( &SimpDesc[idx][epIdx] );
+          }
+
           EPCnt[idx] = *msg++;
           osal_memcpy( EPArr+idx, msg, EPCnt[idx] );
         }
@@ -923,9 +1280,8 @@ void ZDCacheProcessMatchDescReq( byte seq, zAddrType_t *src,
                                        uint16 profileID, uint16 aoi, byte sty )
 {
   byte buf[ 1 + 2 + 1 + CACHE_EP_MAX ];  // Status + AOI + Len + EP list.
-  byte aoiMatch = (aoi == NWK_BROADCAST_SHORTADDR) ? TRUE : FALSE;
-  SimpleDescriptionFormat_t *sDesc;
-  byte idx, epIdx, epCnt;
+  cacheIdx_t idx;
+  byte epCnt = 0;
   secUse = sty;
 
   if ( !CACHE_SERVER )
@@ -934,63 +1290,42 @@ void ZDCacheProcessMatchDescReq( byte seq, zAddrType_t *src,
   }
 
   buf[0] = ZDP_SUCCESS;
-  buf[1] = LO_UINT16( aoi );
-  buf[2] = HI_UINT16( aoi );
-  buf[3] = 0;
-
   msgAddr.addr.shortAddr = src->addr.shortAddr;
 
-  // Respond by proxy for all devices that have registered an endpoint.
-  for ( idx = 0; idx < CACHE_DEV_MAX; idx++ )
+  if ( aoi == NWK_BROADCAST_SHORTADDR )
   {
-    if ( ((aoi == NWK_BROADCAST_SHORTADDR) &&
-          (NwkAddr[idx] != INVALID_NODE_ADDR)) || (aoi == NwkAddr[idx]) )
+    // Respond by proxy for all devices that have registered an endpoint.
+    for ( idx = LruNewest; idx != CACHE_DEV_MAX; idx = LruOlder[idx] )
     {
-      sDesc = SimpDesc[idx];
-      epCnt = 4;
-
-      for ( epIdx = 0; epIdx < EPCnt[idx]; epIdx++, sDesc++ )
+      if ( matchDescEPs( idx, buf, inCnt, inClusters,
+                                     outCnt, outClusters, profileID ) != 0 )
       {
-        if ( sDesc->AppProfId == profileID )
-        {
-          // If there are no search input/ouput clusters - respond.
-          if ( ((inCnt == 0) && (outCnt == 0))                               ||
-                 ZDO_AnyClusterMatches( inCnt, inClusters,
-                         sDesc->AppNumInClusters, sDesc->pAppInClusterList ) ||
-                 ZDO_AnyClusterMatches( outCnt, outClusters,
-                         sDesc->AppNumOutClusters, sDesc->pAppOutClusterList ))
-          {
-            buf[epCnt++] = sDesc->EndPoint;
-          }
-        }
-      }
-
-      if ( epCnt > 4 )
-      {
-        buf[1] = LO_UINT16( NwkAddr[idx] );
-        buf[2] = HI_UINT16( NwkAddr[idx] );
-        buf[3] = epCnt-4;
-        SendMsg( Match_Desc_rsp, epCnt, buf );
+        SendMsg( Match_Desc_rsp, 4 + buf[3], buf );
       }
+    }
+  }
+  else
+  {
+    buf[1] = LO_UINT16( aoi );
+    buf[2] = HI_UINT16( aoi );
+    buf[3] = 0;
 
-      if ( aoi == NwkAddr[idx] )
+    if ( (idx = getIdx( aoi )) == CACHE_DEV_MAX )
+    {
+      buf[0] = ZDP_DEVICE_NOT_FOUND;
+    }
+    else
+    {
+      cacheTouch( idx );
+      epCnt = matchDescEPs( idx, buf, inCnt, inClusters,
+                                      outCnt, outClusters, profileID );
+      if ( epCnt == 0 )
       {
-        aoiMatch = TRUE;
-
-        if ( epCnt == 4 )
-        {
-          buf[0] = ZDP_NO_MATCH;
-          SendMsg( Match_Desc_rsp, 4, buf );
-        }
-        break;
+        buf[0] = ZDP_NO_MATCH;
       }
     }
-  }
 
-  if ( !aoiMatch )
-  {
-    buf[0] = ZDP_DEVICE_NOT_FOUND;
-    SendMsg( Match_Desc_rsp, 4, buf );
+    SendMsg( Match_Desc_rsp, 4 + epCnt, buf );
   }
 }
 
@@ -1006,15 +1341,16 @@ void ZDCacheProcessMatchDescReq( byte seq, zAddrType_t *src,
  */
 void *ZDCacheGetDesc( uint16 aoi, eDesc_t type, byte *stat )
 {
-  byte epIdx, idx = getIdx( aoi );
+  cacheIdx_t idx = getIdx( aoi );
+  byte epIdx;
   void *rtrn = NULL;
-  byte *ptr;
 
   if ( idx != CACHE_DEV_MAX )
   {
     byte cnt;
 
     *stat = ZDP_SUCCESS;
+    cacheTouch( idx );
 
     switch ( type )
     {
@@ -1034,16 +1370,11 @@ void *ZDCacheGetDesc( uint16 aoi, eDesc_t type, byte *stat )
        *     all active endpts other than ZDO. Thus, stat must be pointing to
        *     an array of at least CACHE_EP_MAX bytes.
        */
-      ptr = EPArr[ idx ];
-      for ( cnt = 0, idx = 0; idx < CACHE_EP_MAX; idx++ )
+      for ( cnt = 0, epIdx = 0; epIdx < EPCnt[idx]; epIdx++ )
       {
-        if ( ptr[idx] == 0xff )
-          break;
-        else if ( ptr[idx] == ZDO_EP )
-          continue;
-        else
+        if ( EPArr[idx][epIdx] != ZDO_EP )
         {
-          *stat++ = ptr[idx];
+          *stat++ = EPArr[idx][epIdx];
           cnt++;
         }
       }
@@ -1091,16 +1422,12 @@ void *ZDCacheGetDesc( uint16 aoi, eDesc_t type, byte *stat )
 uint16 ZDCacheGetNwkAddr( byte *ieee )
 {
   uint16 addr = INVALID_NODE_ADDR;
-  byte idx;
+  cacheIdx_t idx = getIdxExt( ieee );
 
-  for ( idx = 0; idx < CACHE_DEV_MAX; idx++ )
+  if ( idx != CACHE_DEV_MAX )
   {
-    if ( osal_ExtAddrEqual( ieee, ExtAddr[idx] ) &&
-                                          (NwkAddr[idx] != INVALID_NODE_ADDR) )
-    {
-      addr = NwkAddr[idx];
-      break;
-    }
+    cacheTouch( idx );
+    addr = NwkAddr[idx];
   }
 
   return addr;
@@ -1120,15 +1447,12 @@ uint16 ZDCacheGetNwkAddr( byte *ieee )
 byte * ZDCacheGetExtAddr( uint16 aoi )
 {
   byte *ieee = NULL;
-  byte idx;
+  cacheIdx_t idx = getIdx( aoi );
 
-  for ( idx = 0; idx < CACHE_DEV_MAX; idx++ )
+  if ( idx != CACHE_DEV_MAX )
   {
-    if ( aoi == NwkAddr[idx] )
-    {
-      ieee = ExtAddr[idx];
-      break;
-    }
+    cacheTouch( idx );
+    ieee = ExtAddr[idx];
   }
 
   return ieee;
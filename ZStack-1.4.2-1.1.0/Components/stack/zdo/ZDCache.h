@@ -55,11 +55,32 @@ extern "C"
   #endif
 #endif
 
-// Max Clusters cached per endpoint per requesting device.
+// Clusters cached per endpoint per requesting device; sizes CACHE_POOL_MAX.
 #if !defined( CACHE_CR_MAX )
   #define CACHE_CR_MAX  4
 #endif
 
+#if ( CACHE_DEV_MAX > 0 )
+  // Buckets in each of the NWK and IEEE address hash indexes, a power of 2.
+  // Raise it along with CACHE_DEV_MAX to keep the hash chains short.
+  #if !defined( CACHE_HASH_SIZE )
+    #define CACHE_HASH_SIZE  8
+  #endif
+
+  // Cluster IDs cached for all devices together, shared by the simple
+  // descriptors in store order. The default gives the same RAM as fixed
+  // lists of CACHE_CR_MAX input and output clusters per cached endpoint.
+  #if !defined( CACHE_POOL_MAX )
+    #define CACHE_POOL_MAX  ( CACHE_DEV_MAX * CACHE_EP_MAX * CACHE_CR_MAX * 2 )
+  #endif
+
+  // ZDCacheTimerEvent ticks an unused entry is kept, 0 to keep it until it
+  // is evicted to make room for another device.
+  #if !defined( CACHE_EXPIRY )
+    #define CACHE_EXPIRY  0
+  #endif
+#endif
+
 #define Discovery_store_req     ((uint16)0x0015)
 #define Node_Desc_store_req     ((uint16)0x0016)
 #define Power_Desc_store_req    ((uint16)0x0017)
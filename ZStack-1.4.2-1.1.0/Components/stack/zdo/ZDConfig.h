@@ -128,6 +128,31 @@ extern "C"
 
 #endif  // !MT_ZDO_FUNC
 
+#if defined ( ZDO_INVENTORY )
+  // The Network Inventory drives these requests itself.
+  #define ZDO_IEEEADDR_REQUEST
+  #define ZDO_NODEDESC_REQUEST
+  #define ZDO_SIMPLEDESC_REQUEST
+  #define ZDO_ACTIVEEP_REQUEST
+#endif
+
+#if defined ( ZDO_TOPOLOGY )
+  // The Topology Crawler drives these requests itself.
+  #define ZDO_MGMT_LQI_REQUEST
+  #define ZDO_MGMT_RTG_REQUEST
+#endif
+
+#if defined ( ZDO_RESOLVE )
+  // The Address Resolution sends these requests itself.
+  #define ZDO_NWKADDR_REQUEST
+  #define ZDO_IEEEADDR_REQUEST
+#endif
+
+#if defined ( ZDO_FAST_RESUME )
+  // The fast resume checks the network with this request.
+  #define ZDO_IEEEADDR_REQUEST
+#endif
+
 
 /*********************************************************************
  * Constants
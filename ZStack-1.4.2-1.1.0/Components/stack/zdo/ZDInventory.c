@@ -0,0 +1,633 @@
+/*********************************************************************
+    Filename:       ZDInventory.c
+    Revised:        $Date: 2007-06-12 10:20:00 -0700 (Tue, 12 Jun 2007) $
+    Revision:       $Revision: 14600 $
+
+    Description: Implementation of the ZDO Network Inventory functionality.
+
+    Notes:
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+#if defined( ZDO_INVENTORY )
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "ZComDef.h"
+#include "OSAL.h"
+#include "AF.h"
+#include "NLMEDE.h"
+#include "AssocList.h"
+#include "ZDConfig.h"
+#include "ZDProfile.h"
+#include "ZDApp.h"
+#include "ZDInventory.h"
+
+#if defined( MT_ZDO_FUNC )
+  #include "MT_ZDO.h"
+#endif
+
+/*********************************************************************
+ * MACROS
+ */
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Timer ticks a request waits for its response.
+#define INV_RSP_TICKS  ( INV_RSP_TIMEOUT / INV_TX_INTERVAL )
+
+#if ( INV_RSP_TICKS == 0 ) || ( INV_RSP_TICKS > 255 )
+  #error "INV_RSP_TIMEOUT must be 1 to 255 times INV_TX_INTERVAL"
+#endif
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+/*********************************************************************
+ * GLOBAL VARIABLES
+ */
+
+/*********************************************************************
+ * EXTERNAL VARIABLES
+ */
+
+/*********************************************************************
+ * EXTERNAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static invDevice_t invTable[INV_DEV_MAX];
+static byte invCnt;      // Entries used in invTable
+static byte invPending;  // Requests in flight
+static byte invCursor;   // invTable index the next request search starts at
+static byte invActive;
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+static invDevice_t *invFind( uint16 nwkAddr, byte state );
+static void invSend( invDevice_t *pDev );
+static void invSetState( invDevice_t *pDev, byte state );
+static void invReport( byte status, invDevice_t *pDev );
+
+/*********************************************************************
+ * @fn          invFind
+ *
+ * @brief       Find the inventory entry of a device.
+ *
+ * @param       nwkAddr - Network address of the device.
+ * @param       state - State the entry must be in, INV_STATE_MASK for any.
+ *
+ * @return      Pointer to the entry, NULL if not found.
+ */
+static invDevice_t *invFind( uint16 nwkAddr, byte state )
+{
+  invDevice_t *pDev = invTable;
+  byte cnt;
+
+  for ( cnt = invCnt; cnt != 0; cnt--, pDev++ )
+  {
+    if ( pDev->nwkAddr == nwkAddr )
+    {
+      if ( (state == INV_STATE_MASK) ||
+           ((pDev->state & INV_STATE_MASK) == state) )
+      {
+        return pDev;  // EMBEDDED RETURN
+      }
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+/*********************************************************************
+ * @fn          invSend
+ *
+ * @brief       Send the request for the current state of a device.
+ *              A request that cannot be sent is retried on timeout
+ *              like one that is lost over the air.
+ *
+ * @param       pDev - Inventory entry.
+ *
+ * @return      none
+ */
+static void invSend( invDevice_t *pDev )
+{
+  zAddrType_t dstAddr;
+
+  dstAddr.addrMode = Addr16Bit;
+  dstAddr.addr.shortAddr = pDev->nwkAddr;
+
+  switch ( pDev->state )
+  {
+    case INV_STATE_IEEE:
+      // The extended response also lists the device's children, a page
+      // at a time.
+      (void)ZDP_IEEEAddrReq( pDev->nwkAddr, ZDP_ADDR_REQTYPE_EXTENDED,
+                             pDev->assocNext, 0 );
+      break;
+
+    case INV_STATE_NODE:
+      (void)ZDP_NodeDescReq( &dstAddr, pDev->nwkAddr, 0 );
+      break;
+
+    case INV_STATE_ACTIVE_EP:
+      (void)ZDP_ActiveEPReq( &dstAddr, pDev->nwkAddr, 0 );
+      break;
+
+    case INV_STATE_SIMPLE:
+      (void)ZDP_SimpleDescReq( &dstAddr, pDev->nwkAddr,
+                               pDev->epList[pDev->epNext].endPoint, 0 );
+      break;
+
+    default:
+      return;  // EMBEDDED RETURN
+  }
+
+  pDev->state |= INV_STATE_PENDING;
+  pDev->ticks = INV_RSP_TICKS;
+  pDev->tries++;
+  invPending++;
+}
+
+/*********************************************************************
+ * @fn          invSetState
+ *
+ * @brief       Move a device to its next state after a response or a
+ *              final timeout, reporting it when it is finished.
+ *
+ * @param       pDev - Inventory entry.
+ * @param       state - New INV_STATE_ value.
+ *
+ * @return      none
+ */
+static void invSetState( invDevice_t *pDev, byte state )
+{
+  if ( pDev->state & INV_STATE_PENDING )
+  {
+    invPending--;
+  }
+
+  pDev->state = state;
+  pDev->tries = 0;
+
+  if ( state == INV_STATE_DONE )
+  {
+    invReport( ZSuccess, pDev );
+  }
+  else if ( state == INV_STATE_FAILED )
+  {
+    invReport( ZFailure, pDev );
+  }
+}
+
+/*********************************************************************
+ * @fn          invReport
+ *
+ * @brief       Stream a finished device, or the end of the inventory
+ *              pass, to the host.
+ *
+ * @param       status - ZSuccess or ZFailure.
+ * @param       pDev - Inventory entry, NULL for the end of the pass.
+ *
+ * @return      none
+ */
+static void invReport( byte status, invDevice_t *pDev )
+{
+#if defined( MT_ZDO_FUNC )
+  if ( _zdoCallbackSub & CB_ID_ZDO_INVENTORY_RSP )
+  {
+    zdo_MTCB_InventoryRspCB( status, pDev );
+  }
+#else
+  (void)status;
+  (void)pDev;
+#endif
+}
+
+/*********************************************************************
+ * @fn          ZDInventoryInit
+ *
+ * @brief       Initialize the ZDO Network Inventory.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDInventoryInit( void )
+{
+  invCnt = 0;
+  invPending = 0;
+  invCursor = 0;
+  invActive = FALSE;
+}
+
+/*********************************************************************
+ * @fn          ZDInventoryStart
+ *
+ * @brief       Start a new inventory pass. The table is cleared and
+ *              seeded with the local device's children; the rest of the
+ *              network is found through the children lists returned by
+ *              the routers.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDInventoryStart( void )
+{
+  ZDInventoryInit();
+  invActive = TRUE;
+
+#if defined( RTR_NWK )
+  {
+    byte cnt;
+    uint16 *pList = AssocMakeList( &cnt );
+
+    if ( pList )
+    {
+      byte idx;
+
+      for ( idx = 0; idx < cnt; idx++ )
+      {
+        (void)ZDInventoryAdd( pList[idx] );
+      }
+      osal_mem_free( pList );
+    }
+  }
+#endif
+
+  osal_set_event( ZDAppTaskID, ZDO_INVENTORY_TIMER );
+}
+
+/*********************************************************************
+ * @fn          ZDInventoryStop
+ *
+ * @brief       Stop the inventory pass. The table is kept for
+ *              ZDInventoryGet; responses still in flight are ignored.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDInventoryStop( void )
+{
+  invActive = FALSE;
+  osal_stop_timerEx( ZDAppTaskID, ZDO_INVENTORY_TIMER );
+}
+
+/*********************************************************************
+ * @fn          ZDInventoryAdd
+ *
+ * @brief       Add a device to the inventory. Devices added while a
+ *              pass is running are picked up by it.
+ *
+ * @param       nwkAddr - Network address of the device.
+ *
+ * @return      ZSuccess if added or already present, ZInvalidParameter
+ *              for the local device, ZFailure if the table is full.
+ */
+byte ZDInventoryAdd( uint16 nwkAddr )
+{
+  invDevice_t *pDev;
+
+  if ( (nwkAddr == NLME_GetShortAddr()) || (nwkAddr >= NWK_BROADCAST_SHORTADDR_DEVZCZR) )
+  {
+    return ZInvalidParameter;  // EMBEDDED RETURN
+  }
+
+  if ( invFind( nwkAddr, INV_STATE_MASK ) )
+  {
+    return ZSuccess;  // EMBEDDED RETURN
+  }
+
+  if ( invCnt == INV_DEV_MAX )
+  {
+    return ZFailure;  // EMBEDDED RETURN
+  }
+
+  pDev = &invTable[invCnt++];
+  osal_memset( pDev, 0, sizeof( invDevice_t ) );
+  pDev->nwkAddr = nwkAddr;
+  pDev->state = INV_STATE_IEEE;
+
+  if ( invActive )
+  {
+    // Restart the timer if the pass had already finished its table.
+    if ( osal_get_timeoutEx( ZDAppTaskID, ZDO_INVENTORY_TIMER ) == 0 )
+    {
+      osal_set_event( ZDAppTaskID, ZDO_INVENTORY_TIMER );
+    }
+  }
+
+  return ZSuccess;
+}
+
+/*********************************************************************
+ * @fn          ZDInventoryAnnounce
+ *
+ * @brief       Add a device that announced itself while a pass is
+ *              running, so late joiners are inventoried too.
+ *
+ * @param       nwkAddr - Network address of the device.
+ *
+ * @return      none
+ */
+void ZDInventoryAnnounce( uint16 nwkAddr )
+{
+  if ( invActive )
+  {
+    (void)ZDInventoryAdd( nwkAddr );
+  }
+}
+
+/*********************************************************************
+ * @fn          ZDInventoryTimerEvent
+ *
+ * @brief       Inventory tick, every INV_TX_INTERVAL while a pass runs.
+ *              Times out requests in flight and sends at most one new
+ *              request, taking devices in turn so that a slow device
+ *              does not hold up the others. The end of the pass is
+ *              reported once every device is finished; the pass stays
+ *              open for devices added later until ZDInventoryStop.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDInventoryTimerEvent( void )
+{
+  invDevice_t *pDev;
+  byte busy = FALSE;
+  byte idx;
+
+  if ( !invActive )
+  {
+    return;  // EMBEDDED RETURN
+  }
+
+  for ( pDev = invTable, idx = invCnt; idx != 0; idx--, pDev++ )
+  {
+    if ( (pDev->state & INV_STATE_PENDING) && (--pDev->ticks == 0) )
+    {
+      pDev->state &= INV_STATE_MASK;
+      invPending--;
+
+      if ( pDev->tries >= INV_MAX_TRIES )
+      {
+        invSetState( pDev, INV_STATE_FAILED );
+      }
+    }
+
+    if ( pDev->state < INV_STATE_DONE || (pDev->state & INV_STATE_PENDING) )
+    {
+      busy = TRUE;
+    }
+  }
+
+  if ( invPending < INV_MAX_PENDING )
+  {
+    for ( idx = 0; idx < invCnt; idx++ )
+    {
+      if ( invCursor >= invCnt )
+      {
+        invCursor = 0;
+      }
+      pDev = &invTable[invCursor++];
+
+      if ( pDev->state < INV_STATE_DONE )
+      {
+        invSend( pDev );
+        break;
+      }
+    }
+  }
+
+  if ( busy )
+  {
+    osal_start_timerEx( ZDAppTaskID, ZDO_INVENTORY_TIMER, INV_TX_INTERVAL );
+  }
+  else
+  {
+    invReport( ZSuccess, NULL );
+  }
+}
+
+/*********************************************************************
+ * @fn          ZDInventoryGet
+ *
+ * @brief       Look up a device in the inventory table.
+ *
+ * @param       nwkAddr - Network address of the device.
+ *
+ * @return      Pointer to the entry, NULL if not found.
+ */
+invDevice_t *ZDInventoryGet( uint16 nwkAddr )
+{
+  return invFind( nwkAddr, INV_STATE_MASK );
+}
+
+/*********************************************************************
+ * @fn          ZDInventoryIEEEAddrRsp
+ *
+ * @brief       Record an IEEE_addr_rsp and add the listed children.
+ *              While the device has children past this page, the next
+ *              page is requested before moving on to its node
+ *              descriptor.
+ *
+ * @param       srcAddr - Source of the response.
+ * @param       status - Response status.
+ * @param       ieee - IEEE address of the device.
+ * @param       aoi - Network address of the device, if successful.
+ * @param       cnt - Number of associated devices.
+ * @param       idx - Start index of assocList.
+ * @param       listCnt - Number of associated devices in assocList.
+ * @param       assocList - Associated devices idx to idx + listCnt - 1.
+ *
+ * @return      none
+ */
+void ZDInventoryIEEEAddrRsp( uint16 srcAddr, byte status, byte *ieee,
+                        uint16 aoi, byte cnt, byte idx, byte listCnt, uint16 *assocList )
+{
+  invDevice_t *pDev;
+  uint16 next = idx + listCnt;
+
+  if ( !invActive )
+  {
+    return;  // EMBEDDED RETURN
+  }
+
+  if ( status != ZDP_SUCCESS )
+  {
+    if ( (pDev = invFind( srcAddr, INV_STATE_IEEE )) )
+    {
+      invSetState( pDev, INV_STATE_FAILED );
+    }
+    return;  // EMBEDDED RETURN
+  }
+
+  if ( assocList )
+  {
+    for ( ; listCnt != 0; listCnt-- )
+    {
+      (void)ZDInventoryAdd( *assocList++ );
+    }
+  }
+
+  if ( (pDev = invFind( aoi, INV_STATE_IEEE )) )
+  {
+    osal_cpyExtAddr( pDev->extAddr, ieee );
+
+    // A page that moves past the last one asked for leads to the next;
+    // a repeated or empty page ends the list.
+    if ( (next < cnt) && (next > pDev->assocNext) )
+    {
+      pDev->assocNext = (byte)next;
+      invSetState( pDev, INV_STATE_IEEE );
+    }
+    else
+    {
+      invSetState( pDev, INV_STATE_NODE );
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn          ZDInventoryNodeDescRsp
+ *
+ * @brief       Record a Node_Desc_rsp.
+ *
+ * @param       status - Response status.
+ * @param       aoi - Network address of the device.
+ * @param       pNodeDesc - Node descriptor, NULL on failure.
+ *
+ * @return      none
+ */
+void ZDInventoryNodeDescRsp( byte status, uint16 aoi,
+                             NodeDescriptorFormat_t *pNodeDesc )
+{
+  invDevice_t *pDev;
+
+  if ( !invActive || !(pDev = invFind( aoi, INV_STATE_NODE )) )
+  {
+    return;  // EMBEDDED RETURN
+  }
+
+  if ( (status != ZDP_SUCCESS) || !pNodeDesc )
+  {
+    invSetState( pDev, INV_STATE_FAILED );
+  }
+  else
+  {
+    pDev->logicalType = pNodeDesc->LogicalType;
+    pDev->capabilities = pNodeDesc->CapabilityFlags;
+    invSetState( pDev, INV_STATE_ACTIVE_EP );
+  }
+}
+
+/*********************************************************************
+ * @fn          ZDInventoryActiveEPRsp
+ *
+ * @brief       Record an Active_EP_rsp. Endpoints past INV_EP_MAX are
+ *              dropped.
+ *
+ * @param       status - Response status.
+ * @param       aoi - Network address of the device.
+ * @param       epCnt - Number of endpoints in epList.
+ * @param       epList - Active endpoints.
+ *
+ * @return      none
+ */
+void ZDInventoryActiveEPRsp( byte status, uint16 aoi,
+                             byte epCnt, byte *epList )
+{
+  invDevice_t *pDev;
+  byte idx;
+
+  if ( !invActive || !(pDev = invFind( aoi, INV_STATE_ACTIVE_EP )) )
+  {
+    return;  // EMBEDDED RETURN
+  }
+
+  if ( status != ZDP_SUCCESS )
+  {
+    invSetState( pDev, INV_STATE_FAILED );
+    return;  // EMBEDDED RETURN
+  }
+
+  if ( epCnt > INV_EP_MAX )
+  {
+    epCnt = INV_EP_MAX;
+  }
+
+  for ( idx = 0; idx < epCnt; idx++ )
+  {
+    pDev->epList[idx].endPoint = epList[idx];
+  }
+  pDev->epCnt = epCnt;
+  pDev->epNext = 0;
+
+  invSetState( pDev, (epCnt == 0) ? INV_STATE_DONE : INV_STATE_SIMPLE );
+}
+
+/*********************************************************************
+ * @fn          ZDInventorySimpleDescRsp
+ *
+ * @brief       Record a Simple_Desc_rsp for the endpoint requested.
+ *              An endpoint that returns an error is left with only its
+ *              number recorded.
+ *
+ * @param       status - Response status.
+ * @param       aoi - Network address of the device.
+ * @param       pSimpleDesc - Simple descriptor, NULL on failure.
+ *
+ * @return      none
+ */
+void ZDInventorySimpleDescRsp( byte status, uint16 aoi,
+                               SimpleDescriptionFormat_t *pSimpleDesc )
+{
+  invDevice_t *pDev;
+  invEndPoint_t *pEP;
+
+  if ( !invActive || !(pDev = invFind( aoi, INV_STATE_SIMPLE )) )
+  {
+    return;  // EMBEDDED RETURN
+  }
+
+  pEP = &pDev->epList[pDev->epNext];
+
+  if ( (status == ZDP_SUCCESS) && pSimpleDesc )
+  {
+    if ( pSimpleDesc->EndPoint != pEP->endPoint )
+    {
+      return;  // EMBEDDED RETURN - late response to an earlier try
+    }
+
+    pEP->profileID = pSimpleDesc->AppProfId;
+    pEP->deviceID = pSimpleDesc->AppDeviceId;
+    pEP->numInClusters = pSimpleDesc->AppNumInClusters;
+    pEP->numOutClusters = pSimpleDesc->AppNumOutClusters;
+  }
+
+  pDev->epNext++;
+  invSetState( pDev, (pDev->epNext == pDev->epCnt) ? INV_STATE_DONE
+                                                   : INV_STATE_SIMPLE );
+}
+
+/*********************************************************************
+*********************************************************************/
+
+#endif  // ZDO_INVENTORY
@@ -0,0 +1,155 @@
+#ifndef ZDINVENTORY_H
+#define ZDINVENTORY_H
+
+/*********************************************************************
+    Filename:       ZDInventory.h
+    Revised:        $Date: 2007-06-12 10:20:00 -0700 (Tue, 12 Jun 2007) $
+    Revision:       $Revision: 14600 $
+
+    Description: Declaration of the ZDO Network Inventory functionality.
+
+      The inventory walks the network from the local device's children,
+      collecting each device's IEEE address, node descriptor, active
+      endpoints and simple descriptors. Requests to different devices
+      are pipelined, bounded by INV_MAX_PENDING and paced at one
+      request every INV_TX_INTERVAL.
+
+    Notes:
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#if defined( ZDO_INVENTORY )
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "ZComDef.h"
+#include "AF.h"
+
+/*********************************************************************
+ * MACROS
+ */
+
+// Devices held in the inventory table. Raise it to the size of the site.
+#if !defined( INV_DEV_MAX )
+  #define INV_DEV_MAX  16
+#endif
+
+// Endpoints recorded per device; further endpoints are not requested.
+#if !defined( INV_EP_MAX )
+  #define INV_EP_MAX  4
+#endif
+
+// Requests allowed in flight at once, each to a different device.
+#if !defined( INV_MAX_PENDING )
+  #define INV_MAX_PENDING  4
+#endif
+
+// Times a request is sent before the device is marked failed.
+#if !defined( INV_MAX_TRIES )
+  #define INV_MAX_TRIES  3
+#endif
+
+// Inventory timer tick in milliseconds. At most one request is sent
+// per tick, which sets the rate limit.
+#if !defined( INV_TX_INTERVAL )
+  #define INV_TX_INTERVAL  100
+#endif
+
+// Milliseconds to wait for a response before the request is retried.
+#if !defined( INV_RSP_TIMEOUT )
+  #define INV_RSP_TIMEOUT  5000
+#endif
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Inventory device states, invDevice_t.state.
+#define INV_STATE_IEEE        0x00  // Waiting for IEEE_addr_rsp
+#define INV_STATE_NODE        0x01  // Waiting for Node_Desc_rsp
+#define INV_STATE_ACTIVE_EP   0x02  // Waiting for Active_EP_rsp
+#define INV_STATE_SIMPLE      0x03  // Waiting for Simple_Desc_rsp of epNext
+#define INV_STATE_DONE        0x04
+#define INV_STATE_FAILED      0x05
+#define INV_STATE_MASK        0x7F
+#define INV_STATE_PENDING     0x80  // Request for the state is in flight
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  byte   endPoint;
+  uint16 profileID;
+  uint16 deviceID;
+  byte   numInClusters;
+  byte   numOutClusters;
+} invEndPoint_t;
+
+typedef struct
+{
+  uint16 nwkAddr;
+  byte   extAddr[Z_EXTADDR_LEN];
+  byte   state;
+  byte   ticks;         // Ticks left before the pending request times out
+  byte   tries;
+  byte   logicalType;   // From the node descriptor
+  byte   capabilities;  // MAC capability flags from the node descriptor
+  byte   epCnt;         // Active endpoints recorded in epList
+  byte   epNext;        // Index in epList of the next Simple_Desc_req
+  byte   assocNext;     // StartIndex of the next IEEE_addr_req
+  invEndPoint_t epList[INV_EP_MAX];
+} invDevice_t;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+extern void ZDInventoryInit( void );
+
+extern void ZDInventoryStart( void );
+
+extern void ZDInventoryStop( void );
+
+extern byte ZDInventoryAdd( uint16 nwkAddr );
+
+extern void ZDInventoryAnnounce( uint16 nwkAddr );
+
+extern void ZDInventoryTimerEvent( void );
+
+extern invDevice_t *ZDInventoryGet( uint16 nwkAddr );
+
+extern void ZDInventoryIEEEAddrRsp( uint16 srcAddr, byte status, byte *ieee,
+                       uint16 aoi, byte cnt, byte idx, byte listCnt, uint16 *assocList );
+
+extern void ZDInventoryNodeDescRsp( byte status, uint16 aoi,
+                                    NodeDescriptorFormat_t *pNodeDesc );
+
+extern void ZDInventoryActiveEPRsp( byte status, uint16 aoi,
+                                    byte epCnt, byte *epList );
+
+extern void ZDInventorySimpleDescRsp( byte status, uint16 aoi,
+                                      SimpleDescriptionFormat_t *pSimpleDesc );
+
+/*********************************************************************
+*********************************************************************/
+
+#endif  // ZDO_INVENTORY
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZDINVENTORY_H */
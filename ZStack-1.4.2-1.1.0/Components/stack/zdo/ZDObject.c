@@ -35,6 +35,8 @@
 #include "ZDProfile.h"
 #include "ZDConfig.h"
 #include "ZDCache.h"
+#include "ZDInventory.h"
+#include "ZDResolve.h"
 #include "ZDSecMgr.h"
 #include "ZDApp.h"
 #include "nwk_util.h"   // NLME_IsAddressBroadcast()
@@ -91,32 +93,36 @@ enum
   ZDMATCH_SENDING_BINDS   // Received both requests, sending unbind/binds
 };
 
-enum
-{
-  ZDMATCH_REASON_START,
-  ZDMATCH_REASON_TIMEOUT,
-  ZDMATCH_REASON_UNBIND_RSP,
-  ZDMATCH_REASON_BIND_RSP
-};
-
 enum
 {
   ZDMATCH_SENDING_NOT,
   ZDMATCH_SENDING_UNBIND,
-  ZDMATCH_SENDING_BIND
+  ZDMATCH_SENDING_BIND,
+  ZDMATCH_SENDING_DONE
 };
 
+// One binding of a matched pair, from an output cluster of its source
+// device to the same input cluster of the other device
+typedef struct
+{
+  uint16 clusterID;
+  uint8  fromEd2;         // TRUE if ed2 is the source device
+  uint8  sending;         // One of the above, expecting response if unbind/bind
+  uint8  transSeq;        // Of the request in flight
+} ZDMatchBind_t;
+
 typedef struct
 {
   ZDEndDeviceBind_t ed1;
   ZDEndDeviceBind_t ed2;
-  uint8  state;            // One of the above states
-  uint8  sending;         // 0 - not sent, 1 - unbind, 2 bind - expecting response
-  uint8  transSeq;
-  uint8  ed1numMatched;
-  uint16 *ed1Matched;
-  uint8  ed2numMatched;
-  uint16 *ed2Matched;
+  uint8  state;           // One of the above states
+  uint8  status;          // End_Device_Bind_rsp status so far
+  uint8  mismatch;        // Another request came while waiting, but did not match
+  uint8  numBinds;
+  uint8  nextBind;        // First entry of binds not started
+  uint8  pending;         // Bindings with a request in flight
+  ZDMatchBind_t *binds;
+  uint32 due;             // Time the wait for a request or response runs out
 } ZDMatchEndDeviceBind_t;
 #endif
 
@@ -148,7 +154,7 @@ static ZDO_EDBind_t *ZDO_EDBind;     // Null when not used
 #endif
 
 #if defined ( ZDO_COORDINATOR )
-  ZDMatchEndDeviceBind_t *matchED = (ZDMatchEndDeviceBind_t *)NULL;
+  static ZDMatchEndDeviceBind_t *ZDMatchTable[ZDMATCH_MAX];  // Null when not used
 #endif
 
 /*********************************************************************
@@ -156,6 +162,12 @@ static ZDO_EDBind_t *ZDO_EDBind;     // Null when not used
  */
 static void ZDODeviceSetup( void );
 static uint16 *ZDO_CreateAlignedUINT16List(uint8 num, uint8 *buf);
+static void ZDO_CopyUINT16List( uint16 *ptr, uint8 num, uint8 *buf, uint8 inc );
+#if defined( ZDO_CACHE ) && ( CACHE_DEV_MAX > 0 )
+  static void ZDO_CacheMatchDescReq( byte seq, zAddrType_t *src, uint16 aoi,
+                      uint16 profileID, byte numIn, byte *inList,
+                      byte numOut, byte *outList, byte sty );
+#endif
 #if defined ( MANAGED_SCAN )
   static void ZDOManagedScan_Next( void );
 #endif
@@ -163,15 +175,18 @@ static uint16 *ZDO_CreateAlignedUINT16List(uint8 num, uint8 *buf);
   static void ZDO_RemoveEndDeviceBind( void );
   static void ZDO_SendEDBindRsp( byte TransSeq, zAddrType_t *dstAddr, byte Status, byte secUse );
 #endif
-#if defined ( REFLECTOR ) || defined( ZDO_COORDINATOR )
+#if defined ( REFLECTOR )
   static byte ZDO_CompareClusterLists( byte numList1, uint16 *list1,
                                 byte numList2, uint16 *list2, uint16 *pMatches );
 #endif
 #if defined ( ZDO_COORDINATOR )
-  static void ZDO_RemoveMatchMemory( void );
+  static void ZDO_RemoveMatchMemory( ZDMatchEndDeviceBind_t *match );
   static uint8 ZDO_CopyMatchInfo( ZDEndDeviceBind_t *destReq, ZDEndDeviceBind_t *srcReq );
-  static uint8 ZDMatchSendState( uint8 reason, uint8 status, uint8 TransSeq );
-  static void ZDO_EndDeviceBindMatchTimeoutCB( void );
+  static uint8 ZDMatchBinds( ZDMatchEndDeviceBind_t *match );
+  static void ZDMatchSendReq( ZDMatchEndDeviceBind_t *match, ZDMatchBind_t *pBind );
+  static void ZDMatchSendState( ZDMatchEndDeviceBind_t *match );
+  static uint8 ZDMatchProcessRsp( uint16 srcAddr, uint16 ClusterID, uint8 Status, uint8 TransSeq );
+  static void ZDMatchEnd( ZDMatchEndDeviceBind_t *match, uint8 status );
 #endif
 
 /*********************************************************************
@@ -349,8 +364,13 @@ void ZDO_StartDevice( byte logicalType, devStartModes_t startMode, byte beaconOr
       else
       {
         devState = DEV_NWK_ORPHAN;
+#if defined ( ZDO_FAST_RESUME )
+        ret = NLME_OrphanJoinRequest( ZDApp_ResumeChannels(),
+                                      zgDefaultStartingScanDuration );
+#else
         ret = NLME_OrphanJoinRequest( zgDefaultChannelList,
                                       zgDefaultStartingScanDuration );
+#endif
       }
     }
     else
@@ -446,7 +466,7 @@ static void ZDO_SendEDBindRsp( byte TransSeq, zAddrType_t *dstAddr, byte Status,
 }
 #endif // REFLECTOR
 
-#if defined ( REFLECTOR ) || defined ( ZDO_COORDINATOR )
+#if defined ( REFLECTOR )
 /*********************************************************************
  * @fn          ZDO_CompareClusterLists
  *
@@ -480,7 +500,7 @@ static byte ZDO_CompareClusterLists( byte numList1, uint16 *list1,
 
   return ( numMatches );
 }
-#endif // REFLECTOR || ZDO_COORDINATOR
+#endif // REFLECTOR
 
 #if defined ( REFLECTOR )
 /*********************************************************************
@@ -683,22 +703,39 @@ static uint16 *ZDO_CreateAlignedUINT16List(uint8 num, uint8 *buf)
   uint16 *ptr;
 
   if ((ptr=osal_mem_alloc((short)(num*sizeof(uint16)))))  {
-    uint8 i, ubyte, inc;
-
-    inc = (ZB_PROT_V1_1 == NLME_GetProtocolVersion()) ? 2 : 1;
-
-    for (i=0; i<num; ++i)  {
-      // set upper byte to 0 if we're talking Version 1.0. otherwise
-      // the buffer contains 16 bit cluster IDs.
-      ubyte  = (2 == inc) ? buf[1] : 0;
-      ptr[i] = BUILD_UINT16(buf[0], ubyte);
-      buf    += inc;
-    }
+    ZDO_CopyUINT16List( ptr, num, buf,
+                        (ZB_PROT_V1_1 == NLME_GetProtocolVersion()) ? 2 : 1 );
   }
 
   return ptr;
 }
 
+/*********************************************************************
+ * @fn          ZDO_CopyUINT16List
+ *
+ * @brief       Copies a list of cluster IDs from a message into an
+ *              aligned list.
+ *
+ * @param       ptr  - aligned list of at least num entries
+ * @param       num  - number of entries in list
+ * @param       buf  - pointer to list in the message
+ * @param       inc  - bytes per cluster ID in the message
+ *
+ * @return      none
+ */
+static void ZDO_CopyUINT16List( uint16 *ptr, uint8 num, uint8 *buf, uint8 inc )
+{
+  uint8 i, ubyte;
+
+  for (i=0; i<num; ++i)  {
+    // set upper byte to 0 if we're talking Version 1.0. otherwise
+    // the buffer contains 16 bit cluster IDs.
+    ubyte  = (2 == inc) ? buf[1] : 0;
+    ptr[i] = BUILD_UINT16(buf[0], ubyte);
+    buf    += inc;
+  }
+}
+
 /*********************************************************************
  * @fn          ZDO_CompareByteLists
  *
@@ -929,49 +966,33 @@ void ZDO_ProcessActiveEPReq( byte seq, zAddrType_t *src, byte *msg, byte sty )
  */
 void ZDO_ProcessMatchDescReq( byte seq, zAddrType_t *src, byte *msg, byte sty )
 {
-  byte epCnt = 0;
+  byte epCnt;
   byte numInClusters;
-  uint16 *inClusters;
+  byte *inList;
   byte numOutClusters;
-  uint16 *outClusters;
-  epList_t *epDesc;
-  SimpleDescriptionFormat_t *sDesc = NULL;
-  uint8 allocated;
+  byte *outList;
+  byte cIdLen;
+  byte i;
 
-  // Parse the incoming message
+  // Parse the incoming message, the cluster lists are used in place.
   uint16 aoi = BUILD_UINT16( msg[0], msg[1] );
   uint16 profileID = BUILD_UINT16( msg[2], msg[3] );
+  cIdLen = (ZB_PROT_V1_1 == NLME_GetProtocolVersion()) ? 2 : 1;
   msg += 4;
   numInClusters = *msg++;
-  inClusters = NULL;
-  if (numInClusters)  {
-    if (!(inClusters=ZDO_CreateAlignedUINT16List(numInClusters, msg)))  {
-      // can't allocate memory. drop message
-      return;
-    }
-  }
-  msg += numInClusters*sizeof(uint16);
+  inList = msg;
+  msg += numInClusters*cIdLen;
 
   numOutClusters = *msg++;
-  outClusters = NULL;
-  if (numOutClusters)  {
-    if (!(outClusters=ZDO_CreateAlignedUINT16List(numOutClusters, msg)))  {
-      // can't allocate memory. drop message
-      if (inClusters) {
-        osal_mem_free(inClusters);
-      }
-      return;
-    }
-  }
-  msg += numOutClusters*sizeof(uint16);
+  outList = msg;
 
   if ( NWK_BROADCAST_SHORTADDR_DEVALL == aoi )
   {
 #if defined( ZDO_CACHE ) && ( CACHE_DEV_MAX > 0 )
     if ( CACHE_SERVER )
     {
-      ZDCacheProcessMatchDescReq( seq, src, numInClusters, inClusters,
-                            numOutClusters, outClusters, profileID, aoi, sty );
+      ZDO_CacheMatchDescReq( seq, src, aoi, profileID,
+                    numInClusters, inList, numOutClusters, outList, sty );
     }
 #endif
   }
@@ -979,12 +1000,6 @@ void ZDO_ProcessMatchDescReq( byte seq, zAddrType_t *src, byte *msg, byte sty )
   {
     ZDP_MatchDescRsp( seq, src, ZDP_INVALID_REQTYPE,
                                    ZDAppNwkAddr.addr.shortAddr, 0, NULL, sty );
-    if (inClusters)  {
-      osal_mem_free(inClusters);
-    }
-    if (outClusters)  {
-      osal_mem_free(outClusters);
-    }
     return;
   }
   else if ( (ADDR_NOT_BCAST == NLME_IsAddressBroadcast(aoi)) && (aoi != ZDAppNwkAddr.addr.shortAddr) )
@@ -992,108 +1007,109 @@ void ZDO_ProcessMatchDescReq( byte seq, zAddrType_t *src, byte *msg, byte sty )
 #if defined( ZDO_CACHE ) && ( CACHE_DEV_MAX > 0 )
     if ( CACHE_SERVER )
     {
-      ZDCacheProcessMatchDescReq( seq, src, numInClusters, inClusters,
-                            numOutClusters, outClusters, profileID, aoi, sty );
+      ZDO_CacheMatchDescReq( seq, src, aoi, profileID,
+                    numInClusters, inList, numOutClusters, outList, sty );
     }
 #else
     ZDP_MatchDescRsp( seq, src, ZDP_INVALID_REQTYPE,
                                    ZDAppNwkAddr.addr.shortAddr, 0, NULL, sty );
 #endif
-    if (inClusters)  {
-      osal_mem_free(inClusters);
-    }
-    if (outClusters)  {
-      osal_mem_free(outClusters);
-    }
     return;
   }
 
-  // First count the number of endpoints that match.
-  epDesc = epList;
-  while ( epDesc )
+  // Look up the matching endpoints in the AF cluster index.
+  epCnt = afMatchEndPoints( profileID, numInClusters, inList,
+                      numOutClusters, outList, cIdLen, (uint8 *)ZDOBuildBuf );
+
+  for ( i = 0; i < epCnt; i++ )
   {
-    // Don't search endpoint 0 and check if response is allowed
-    if ( epDesc->epDesc->endPoint != ZDO_EP && (epDesc->flags&eEP_AllowMatch) )
+    // Notify the endpoint of the match.
+    endPointDesc_t *epDesc = afFindEndPointDesc( ((uint8 *)ZDOBuildBuf)[i] );
+    uint8 bufLen = sizeof( ZDO_MatchDescRspSent_t ) + (numOutClusters + numInClusters) * sizeof(uint16);
+    ZDO_MatchDescRspSent_t *pRspSent = (ZDO_MatchDescRspSent_t *) osal_msg_allocate( bufLen );
+
+    if (pRspSent)
     {
-      if ( epDesc->pfnDescCB )
+      pRspSent->hdr.event = ZDO_MATCH_DESC_RSP_SENT;
+      pRspSent->nwkAddr = src->addr.shortAddr;
+      pRspSent->numInClusters = numInClusters;
+      pRspSent->numOutClusters = numOutClusters;
+
+      if (numInClusters)
       {
-        sDesc = (SimpleDescriptionFormat_t *)epDesc->pfnDescCB( AF_DESCRIPTOR_SIMPLE, epDesc->epDesc->endPoint );
-        allocated = TRUE;
+        pRspSent->pInClusters = (uint16*) (pRspSent + 1);
+        ZDO_CopyUINT16List( pRspSent->pInClusters, numInClusters, inList, cIdLen );
       }
       else
       {
-        sDesc = epDesc->epDesc->simpleDesc;
-        allocated = FALSE;
+        pRspSent->pInClusters = NULL;
       }
 
-      if ( sDesc && sDesc->AppProfId == profileID )
+      if (numOutClusters)
       {
-        uint8 *uint8Buf = (uint8 *)ZDOBuildBuf;
-
-        // If there are no search input/ouput clusters - respond
-        if ( ((numInClusters == 0) && (numOutClusters == 0))
-            // Are there matching input clusters?
-             || (ZDO_AnyClusterMatches( numInClusters, inClusters,
-                  sDesc->AppNumInClusters, sDesc->pAppInClusterList ))
-            // Are there matching output clusters?
-             || (ZDO_AnyClusterMatches( numOutClusters, outClusters,
-                  sDesc->AppNumOutClusters, sDesc->pAppOutClusterList ))     )
-        {
-          // Notify the endpoint of the match.
-          uint8 bufLen = sizeof( ZDO_MatchDescRspSent_t ) + (numOutClusters + numInClusters) * sizeof(uint16);
-          ZDO_MatchDescRspSent_t *pRspSent = (ZDO_MatchDescRspSent_t *) osal_msg_allocate( bufLen );
-
-          if (pRspSent)
-          {
-            pRspSent->hdr.event = ZDO_MATCH_DESC_RSP_SENT;
-            pRspSent->nwkAddr = src->addr.shortAddr;
-            pRspSent->numInClusters = numInClusters;
-            pRspSent->numOutClusters = numOutClusters;
-
-            if (numInClusters)
-            {
-              pRspSent->pInClusters = (uint16*) (pRspSent + 1);
-              osal_memcpy(pRspSent->pInClusters, inClusters, numInClusters * sizeof(uint16));
-            }
-            else
-            {
-              pRspSent->pInClusters = NULL;
-            }
-
-            if (numOutClusters)
-            {
-              pRspSent->pOutClusters = (uint16*)(pRspSent + 1) + numInClusters;
-              osal_memcpy(pRspSent->pOutClusters, outClusters, numOutClusters * sizeof(uint16));
-            }
-            else
-            {
-              pRspSent->pOutClusters = NULL;
-            }
-
-            osal_msg_send( *epDesc->epDesc->task_id, (uint8 *)pRspSent );
-          }
-
-          uint8Buf[epCnt++] = sDesc->EndPoint;
-        }
+        pRspSent->pOutClusters = (uint16*)(pRspSent + 1) + numInClusters;
+        ZDO_CopyUINT16List( pRspSent->pOutClusters, numOutClusters, outList, cIdLen );
+      }
+      else
+      {
+        pRspSent->pOutClusters = NULL;
       }
 
-      if ( allocated )
-        osal_mem_free( sDesc );
+      osal_msg_send( *epDesc->task_id, (uint8 *)pRspSent );
     }
-    epDesc = epDesc->nextDesc;
   }
 
   // Send the message only if at least one match found.
   if ( epCnt )
   {
-    if ( ZSuccess == ZDP_MatchDescRsp( seq, src, ZDP_SUCCESS,
-                       ZDAppNwkAddr.addr.shortAddr, epCnt, (uint8 *)ZDOBuildBuf, sty ) )
-    {
+    ZDP_MatchDescRsp( seq, src, ZDP_SUCCESS,
+                       ZDAppNwkAddr.addr.shortAddr, epCnt, (uint8 *)ZDOBuildBuf, sty );
+  }
+}
+
+#if defined( ZDO_CACHE ) && ( CACHE_DEV_MAX > 0 )
+/*********************************************************************
+ * @fn          ZDO_CacheMatchDescReq
+ *
+ * @brief       Answer a Match_Desc_req by proxy from the discovery cache,
+ *              which needs the cluster lists aligned.
+ *
+ * @param       src  - Source address
+ * @param       aoi  - NWK address of interest
+ * @param       profileID - profile ID searched for
+ * @param       numIn, inList - input cluster IDs as received
+ * @param       numOut, outList - output cluster IDs as received
+ * @param       sty - Security enable/disable
+ *
+ * @return      none
+ */
+static void ZDO_CacheMatchDescReq( byte seq, zAddrType_t *src, uint16 aoi,
+                      uint16 profileID, byte numIn, byte *inList,
+                      byte numOut, byte *outList, byte sty )
+{
+  uint16 *inClusters = NULL;
+  uint16 *outClusters = NULL;
+
+  if (numIn)  {
+    if (!(inClusters=ZDO_CreateAlignedUINT16List(numIn, inList)))  {
+      // can't allocate memory. drop message
+      return;
     }
   }
-  else
-  {
+
+  if (numOut)  {
+    if (!(outClusters=ZDO_CreateAlignedUINT16List(numOut, outList)))  {
+      // can't allocate memory. drop message
+      if (inClusters) {
+        osal_mem_free(inClusters);
+      }
+      return;
+    }
   }
+
+  ZDCacheProcessMatchDescReq( seq, src, numIn, inClusters,
+                              numOut, outClusters, profileID, aoi, sty );
+
   if (inClusters)  {
     osal_mem_free(inClusters);
   }
@@ -1101,6 +1117,7 @@ void ZDO_ProcessMatchDescReq( byte seq, zAddrType_t *src, byte *msg, byte sty )
     osal_mem_free(outClusters);
   }
 }
+#endif
 
 #if defined ( ZDO_COORDINATOR )
 /*********************************************************************
@@ -1281,6 +1298,7 @@ void ZDO_ProcessAddrRsp( zAddrType_t *src, uint16 cId, byte *msg, byte msgLen )
   uint16 *list = NULL;
   byte idx = 0;
   byte cnt = 0;
+  byte listCnt = 0;
 
   byte stat = *msg++;
   byte *ieee = msg;
@@ -1315,6 +1333,15 @@ void ZDO_ProcessAddrRsp( zAddrType_t *src, uint16 cId, byte *msg, byte msgLen )
           uint16 *pList = list;
           byte n = cnt - idx;
 
+          // Only the entries the message holds; a long list comes in pages.
+          // Status + IEEEAddr + NWKAddr + NumAssocDev + StartIndex = 13.
+          listCnt = ( msgLen > 13 ) ? (msgLen - 13) / sizeof( uint16 ) : 0;
+          if ( n > listCnt )
+          {
+            n = listCnt;
+          }
+          listCnt = n;
+
           while ( n != 0 )
           {
             *pList++ = BUILD_UINT16( msg[0], msg[1] );
@@ -1326,6 +1353,23 @@ void ZDO_ProcessAddrRsp( zAddrType_t *src, uint16 cId, byte *msg, byte msgLen )
     }
   }
 
+#if defined ( ZDO_RESOLVE )
+  // Feed the resolver whoever asked, so waiting lookups complete.
+  ZDResolveAddrRsp( cId, stat, aoi, ieee );
+#endif
+
+#if defined ( ZDO_FAST_RESUME )
+  ZDApp_ResumeAddrRsp( src->addr.shortAddr, stat );
+#endif
+
+#if defined ( ZDO_INVENTORY )
+  if ( cId == IEEE_addr_rsp )
+  {
+    ZDInventoryIEEEAddrRsp( src->addr.shortAddr, stat, ieee, aoi,
+                            cnt, idx, listCnt, list );
+  }
+#endif
+
 #if defined ( ZDO_NWKADDR_REQUEST )
   if ( cId == NWK_addr_rsp )
   {
@@ -1530,11 +1574,9 @@ void ZDO_ProcessBindUnbindRsp( zAddrType_t *SrcAddr, uint16 ClusterID, byte Stat
 #endif
 
 #if defined ( ZDO_COORDINATOR )
-  if ( matchED )
+  if ( (ClusterID == Bind_rsp) || (ClusterID == Unbind_rsp) )
   {
-    used = ZDMatchSendState(
-           (uint8)((ClusterID == Bind_rsp) ? ZDMATCH_REASON_BIND_RSP : ZDMATCH_REASON_UNBIND_RSP),
-           Status, TransSeq );
+    used = ZDMatchProcessRsp( SrcAddr->addr.shortAddr, ClusterID, Status, TransSeq );
   }
 
   if ( !used )
@@ -1857,6 +1899,7 @@ void ZDO_ProcessMgmtLqiRsp( zAddrType_t *SrcAddr, byte *msg, byte SecurityUse )
 
         msg += Z_EXTADDR_LEN;  // Throwing away IEEE.
         pList->nwkAddr = BUILD_UINT16( msg[0], msg[1] );
+        pList->devType = msg[2] & 0x03;
         if ( proVer == ZB_PROT_V1_0 )
           msg += 2 + 1 + 1;          // Skip DeviceType, RxOnIdle, Relationship, PermitJoinging and Depth
         else
@@ -2768,6 +2811,10 @@ void ZDO_ProcessEndDeviceAnnce( byte TransSeq, zAddrType_t *SrcAddr, byte *msg,
   AddrMgrExtAddrSet( addrEntry.extAddr, ieeeAddr );
   AddrMgrEntryUpdate( &addrEntry );
 
+#if defined ( ZDO_RESOLVE )
+  ZDResolveUpdate( nwkAddr, ieeeAddr );
+#endif
+
   // find device in device list
   dev = AssocGetWithExt( ieeeAddr );
   if ( dev != NULL )
@@ -2915,160 +2962,188 @@ uint8 ZDO_ParseSimpleDescBuf( byte *buf, SimpleDescriptionFormat_t *desc )
  *
  * @brief
  *
- *   Called to match end device binding requests
+ *   Called to match end device binding requests. The request is
+ *   paired with the longest waiting request of the same profile whose
+ *   cluster lists match it, otherwise it waits in the match table for
+ *   AIB_MaxBindingTime. Up to ZDMATCH_MAX requests or pairs are
+ *   handled at once.
  *
  * @param  bindReq  - binding request information
- * @param  SecurityUse - Security enable/disable
  *
  * @return  none
  */
 void ZDO_MatchEndDeviceBind( ZDEndDeviceBind_t *bindReq )
 {
+  ZDMatchEndDeviceBind_t *match = NULL;
+  ZDMatchEndDeviceBind_t *pEntry;
   zAddrType_t dstAddr;
-  uint8 sendRsp = FALSE;
+  uint32 now = osal_GetSystemClock();
   uint8 status;
+  uint8 x;
 
-  // Is this the first request?
-  if ( matchED == NULL )
+  // Find the longest waiting request this one matches
+  for ( x = 0; x < ZDMATCH_MAX; x++ )
   {
-    // Create match info structure
-    matchED = (ZDMatchEndDeviceBind_t *)osal_mem_alloc( sizeof ( ZDMatchEndDeviceBind_t ) );
-    if ( matchED )
+    pEntry = ZDMatchTable[x];
+
+    if ( (pEntry == NULL) || (pEntry->state != ZDMATCH_WAIT_REQ)
+        || (pEntry->ed1.srcAddr == bindReq->srcAddr) )
     {
-      // Clear the structure
-      osal_memset( (uint8 *)matchED, 0, sizeof ( ZDMatchEndDeviceBind_t ) );
+      continue;
+    }
 
-      // Copy the first request's information
-      if ( !ZDO_CopyMatchInfo( &(matchED->ed1), bindReq ) )
+    if ( (pEntry->ed1.profileID == bindReq->profileID)
+        && (ZDO_AnyClusterMatches( pEntry->ed1.numOutClusters, pEntry->ed1.outClusters,
+                                   bindReq->numInClusters, bindReq->inClusters )
+         || ZDO_AnyClusterMatches( bindReq->numOutClusters, bindReq->outClusters,
+                                   pEntry->ed1.numInClusters, pEntry->ed1.inClusters )) )
+    {
+      if ( (match == NULL) || ((int32)(pEntry->due - match->due) < 0) )
       {
-
-        status = ZDP_NO_ENTRY;
-        sendRsp = TRUE;
+        match = pEntry;
       }
     }
     else
     {
-      status = ZDP_NO_ENTRY;
-      sendRsp = TRUE;
+      // Reported if the request times out without a partner
+      pEntry->mismatch = TRUE;
     }
+  }
 
-    if ( !sendRsp )
-    {
-      // Set into the correct state
-      matchED->state = ZDMATCH_WAIT_REQ;
+  if ( match )
+  {
+    match->state = ZDMATCH_SENDING_BINDS;
 
-      // Setup the timeout
-      APS_SetEndDeviceBindTimeout( AIB_MaxBindingTime, ZDO_EndDeviceBindMatchTimeoutCB );
+    // Copy the 2nd request's information and list the bindings
+    if ( !ZDO_CopyMatchInfo( &(match->ed2), bindReq ) || !ZDMatchBinds( match ) )
+    {
+      ZDMatchEnd( match, ZDP_NO_ENTRY );
     }
+    else
+    {
+      // Do the first unbind/bind requests
+      ZDMatchSendState( match );
+    }
+    return;
   }
-  else
+
+  // First request of a pair, wait for the second
+  for ( x = 0; x < ZDMATCH_MAX; x++ )
   {
-      matchED->state = ZDMATCH_SENDING_BINDS;
+    if ( ZDMatchTable[x] == NULL )
+    {
+      match = (ZDMatchEndDeviceBind_t *)osal_mem_alloc( sizeof ( ZDMatchEndDeviceBind_t ) );
+      break;
+    }
+  }
 
-      // Copy the 2nd request's information
-      if ( !ZDO_CopyMatchInfo( &(matchED->ed2), bindReq ) )
-      {
-        status = ZDP_NO_ENTRY;
-        sendRsp = TRUE;
-      }
+  if ( match )
+  {
+    // Clear the structure
+    osal_memset( (uint8 *)match, 0, sizeof ( ZDMatchEndDeviceBind_t ) );
+    ZDMatchTable[x] = match;
 
-      // Make a source match for ed1
-      matchED->ed1numMatched = ZDO_CompareClusterLists(
-                  matchED->ed1.numOutClusters, matchED->ed1.outClusters,
-                  matchED->ed2.numInClusters, matchED->ed2.inClusters, ZDOBuildBuf );
-      if ( matchED->ed1numMatched )
-      {
-        // Save the match list
-        matchED->ed1Matched = osal_mem_alloc( (short)(matchED->ed1numMatched * sizeof ( uint16 )) );
-        if ( matchED->ed1Matched )
-        {
-          osal_memcpy( matchED->ed1Matched, ZDOBuildBuf, (matchED->ed1numMatched * sizeof ( uint16 )) );
-        }
-        else
-        {
-          // Allocation error, stop
-          status = ZDP_NO_ENTRY;
-          sendRsp = TRUE;
-        }
-      }
+    // Copy the first request's information
+    if ( !ZDO_CopyMatchInfo( &(match->ed1), bindReq ) )
+    {
+      ZDO_RemoveMatchMemory( match );
+      match = NULL;
+    }
+  }
 
-      // Make a source match for ed2
-      matchED->ed2numMatched = ZDO_CompareClusterLists(
-                  matchED->ed2.numOutClusters, matchED->ed2.outClusters,
-                  matchED->ed1.numInClusters, matchED->ed1.inClusters, ZDOBuildBuf );
-      if ( matchED->ed2numMatched )
-      {
-        // Save the match list
-        matchED->ed2Matched = osal_mem_alloc( (short)(matchED->ed2numMatched * sizeof ( uint16 )) );
-        if ( matchED->ed2Matched )
-        {
-          osal_memcpy( matchED->ed2Matched, ZDOBuildBuf, (matchED->ed2numMatched * sizeof ( uint16 )) );
-        }
-        else
-        {
-          // Allocation error, stop
-          status = ZDP_NO_ENTRY;
-          sendRsp = TRUE;
-        }
-      }
+  if ( match )
+  {
+    // Set into the correct state
+    match->state = ZDMATCH_WAIT_REQ;
+    match->status = ZDP_SUCCESS;
 
-      if ( (sendRsp == FALSE) && (matchED->ed1numMatched || matchED->ed2numMatched) )
-      {
-        // Do the first unbind/bind state
-        ZDMatchSendState( ZDMATCH_REASON_START, ZDP_SUCCESS, 0 );
-      }
-      else
-      {
-        status = ZDP_NO_MATCH;
-        sendRsp = TRUE;
-      }
+    // Setup the timeout
+    match->due = now + AIB_MaxBindingTime;
+    ZDApp_ServiceTimer( AIB_MaxBindingTime );
   }
-
-  if ( sendRsp )
+  else
   {
     // send response to this requester
+    status = ZDP_NO_ENTRY;
     dstAddr.addrMode = Addr16Bit;
     dstAddr.addr.shortAddr = bindReq->srcAddr;
     ZDP_EndDeviceBindRsp( bindReq->TransSeq, &dstAddr, status, bindReq->SecurityUse );
+  }
+}
 
-    if ( matchED->state == ZDMATCH_SENDING_BINDS )
+/*********************************************************************
+ * @fn      ZDO_MatchTimerEvent()
+ *
+ * @brief
+ *
+ *   Called on ZDO_SERVICE_TIMER to end the end device bind matches
+ *   that waited AIB_MaxBindingTime for a partner or a response.
+ *
+ * @param  none
+ *
+ * @return  none
+ */
+void ZDO_MatchTimerEvent( void )
+{
+  ZDMatchEndDeviceBind_t *match;
+  uint32 now = osal_GetSystemClock();
+  uint8 x;
+
+  for ( x = 0; x < ZDMATCH_MAX; x++ )
+  {
+    match = ZDMatchTable[x];
+
+    if ( match == NULL )
     {
-      // send response to first requester
-      dstAddr.addrMode = Addr16Bit;
-      dstAddr.addr.shortAddr = matchED->ed1.srcAddr;
-      ZDP_EndDeviceBindRsp( matchED->ed1.TransSeq, &dstAddr, status, matchED->ed1.SecurityUse );
+      continue;
     }
 
-    // Process ended - release memory used
-    ZDO_RemoveMatchMemory();
+    if ( (int32)(now - match->due) >= 0 )
+    {
+      if ( (match->state == ZDMATCH_WAIT_REQ) && match->mismatch )
+      {
+        ZDMatchEnd( match, ZDP_NO_MATCH );
+      }
+      else
+      {
+        ZDMatchEnd( match, ZDP_TIMEOUT );
+      }
+    }
+    else
+    {
+      ZDApp_ServiceTimer( (uint16)(match->due - now) );
+    }
   }
 }
 
-static void ZDO_RemoveMatchMemory( void )
+static void ZDO_RemoveMatchMemory( ZDMatchEndDeviceBind_t *match )
 {
-  if ( matchED )
+  uint8 x;
+
+  for ( x = 0; x < ZDMATCH_MAX; x++ )
   {
-    if ( matchED->ed2Matched )
-      osal_mem_free( matchED->ed2Matched );
-    if ( matchED->ed1Matched )
-      osal_mem_free( matchED->ed1Matched );
+    if ( ZDMatchTable[x] == match )
+    {
+      ZDMatchTable[x] = (ZDMatchEndDeviceBind_t *)NULL;
+    }
+  }
 
-    if ( matchED->ed1.inClusters )
-      osal_mem_free( matchED->ed1.inClusters );
+  if ( match->binds )
+    osal_mem_free( match->binds );
 
-    if ( matchED->ed1.outClusters )
-      osal_mem_free( matchED->ed1.outClusters );
+  if ( match->ed1.inClusters )
+    osal_mem_free( match->ed1.inClusters );
 
-    if ( matchED->ed2.inClusters )
-      osal_mem_free( matchED->ed2.inClusters );
+  if ( match->ed1.outClusters )
+    osal_mem_free( match->ed1.outClusters );
 
-    if ( matchED->ed2.outClusters )
-      osal_mem_free( matchED->ed2.outClusters );
+  if ( match->ed2.inClusters )
+    osal_mem_free( match->ed2.inClusters );
 
-    osal_mem_free( matchED );
+  if ( match->ed2.outClusters )
+    osal_mem_free( match->ed2.outClusters );
 
-    matchED = (ZDMatchEndDeviceBind_t *)NULL;
-  }
+  osal_mem_free( match );
 }
 
 static uint8 ZDO_CopyMatchInfo( ZDEndDeviceBind_t *destReq, ZDEndDeviceBind_t *srcReq )
@@ -3117,130 +3192,233 @@ static uint8 ZDO_CopyMatchInfo( ZDEndDeviceBind_t *destReq, ZDEndDeviceBind_t *s
   return ( allOK );
 }
 
-static uint8 ZDMatchSendState( uint8 reason, uint8 status, uint8 TransSeq )
+/*********************************************************************
+ * @fn      ZDMatchBinds()
+ *
+ * @brief
+ *
+ *   List the bindings of a matched pair, one per output cluster of
+ *   either device that the other device has as input cluster.
+ *
+ * @param  match - the pair
+ *
+ * @return  TRUE if listed, FALSE if out of memory
+ */
+static uint8 ZDMatchBinds( ZDMatchEndDeviceBind_t *match )
 {
-  uint8 *dstIEEEAddr;
-  uint8 dstEP;
-  zAddrType_t dstAddr;
-  zAddrType_t destinationAddr;
-  uint16 msgType;
-  uint16 clusterID;
-  ZDEndDeviceBind_t *ed = NULL;
-  uint8 rspStatus = ZDP_SUCCESS;
-
-  if ( matchED == NULL )
-    return ( FALSE );
-
-  // Check sequence number
-  if ( reason == ZDMATCH_REASON_BIND_RSP || reason == ZDMATCH_REASON_UNBIND_RSP )
-  {
-    if ( TransSeq != matchED->transSeq )
-      return( FALSE ); // ignore the message
-  }
+  ZDEndDeviceBind_t *src;
+  ZDEndDeviceBind_t *dst;
+  uint8 fromEd2;
+  uint8 x;
 
-  // turn off timer
-  APS_SetEndDeviceBindTimeout( 0, ZDO_EndDeviceBindMatchTimeoutCB );
+  match->binds = osal_mem_alloc( (short)((match->ed1.numOutClusters
+                 + match->ed2.numOutClusters) * sizeof ( ZDMatchBind_t )) );
 
-  if ( reason == ZDMATCH_REASON_TIMEOUT )
+  if ( match->binds == NULL )
   {
-    rspStatus = ZDP_TIMEOUT;    // The process will stop
+    return ( FALSE );
   }
 
-  if ( reason == ZDMATCH_REASON_START || reason == ZDMATCH_REASON_BIND_RSP )
+  for ( fromEd2 = FALSE; fromEd2 <= TRUE; fromEd2++ )
   {
-    matchED->sending = ZDMATCH_SENDING_UNBIND;
+    src = (fromEd2) ? &(match->ed2) : &(match->ed1);
+    dst = (fromEd2) ? &(match->ed1) : &(match->ed2);
 
-    if ( reason == ZDMATCH_REASON_BIND_RSP && status != ZDP_SUCCESS )
-    {
-      rspStatus = status;
-    }
-  }
-  else if ( reason == ZDMATCH_REASON_UNBIND_RSP )
-  {
-    if ( status == ZDP_SUCCESS )
-    {
-      matchED->sending = ZDMATCH_SENDING_UNBIND;
-    }
-    else
+    for ( x = 0; x < src->numOutClusters; x++ )
     {
-      matchED->sending = ZDMATCH_SENDING_BIND;
+      if ( ZDO_AnyClusterMatches( 1, &(src->outClusters[x]),
+                                  dst->numInClusters, dst->inClusters ) )
+      {
+        match->binds[match->numBinds].clusterID = src->outClusters[x];
+        match->binds[match->numBinds].fromEd2 = fromEd2;
+        match->binds[match->numBinds].sending = ZDMATCH_SENDING_NOT;
+        match->numBinds++;
+      }
     }
   }
 
-  if ( reason != ZDMATCH_REASON_START && matchED->sending == ZDMATCH_SENDING_UNBIND )
+  return ( TRUE );
+}
+
+/*********************************************************************
+ * @fn      ZDMatchSendReq()
+ *
+ * @brief
+ *
+ *   Send the Unbind_req or Bind_req of a binding to its source device.
+ *
+ * @param  match - the pair
+ * @param  pBind - the binding, sending says which request
+ *
+ * @return  none
+ */
+static void ZDMatchSendReq( ZDMatchEndDeviceBind_t *match, ZDMatchBind_t *pBind )
+{
+  ZDEndDeviceBind_t *ed = (pBind->fromEd2) ? &(match->ed2) : &(match->ed1);
+  ZDEndDeviceBind_t *dst = (pBind->fromEd2) ? &(match->ed1) : &(match->ed2);
+  zAddrType_t dstAddr;
+  zAddrType_t destinationAddr;
+  uint16 msgType;
+
+  // Send unbind/bind message to source
+  if ( pBind->sending == ZDMATCH_SENDING_UNBIND )
+    msgType = Unbind_req;
+  else
+    msgType = Bind_req;
+
+  dstAddr.addrMode = Addr16Bit;
+  dstAddr.addr.shortAddr = ed->srcAddr;
+
+  // Save off the transaction sequence number
+  pBind->transSeq = ZDP_TransID;
+
+  destinationAddr.addrMode = Addr64Bit;
+  osal_cpyExtAddr( destinationAddr.addr.extAddr, dst->ieeeAddr );
+
+  ZDP_BindUnbindReq( msgType, &dstAddr, ed->ieeeAddr, ed->endpoint, pBind->clusterID,
+      &destinationAddr, dst->endpoint, ed->SecurityUse );
+}
+
+/*********************************************************************
+ * @fn      ZDMatchSendState()
+ *
+ * @brief
+ *
+ *   Keep up to ZDMATCH_MAX_PENDING unbind/bind requests of a pair in
+ *   flight, and end the pair once they are all answered. No new
+ *   bindings are started after one failed.
+ *
+ * @param  match - the pair
+ *
+ * @return  none
+ */
+static void ZDMatchSendState( ZDMatchEndDeviceBind_t *match )
+{
+  ZDMatchBind_t *pBind;
+
+  while ( (match->status == ZDP_SUCCESS) && (match->nextBind < match->numBinds)
+         && (match->pending < ZDMATCH_MAX_PENDING) )
   {
-    // Move to the next cluster ID
-    if ( matchED->ed1numMatched )
-      matchED->ed1numMatched--;
-    else if ( matchED->ed2numMatched )
-      matchED->ed2numMatched--;
+    // Unbind first, the binding is toggled if it already exists
+    pBind = &(match->binds[match->nextBind++]);
+    pBind->sending = ZDMATCH_SENDING_UNBIND;
+    match->pending++;
+
+    ZDMatchSendReq( match, pBind );
   }
 
-  // What message do we send now
-  if ( matchED->ed1numMatched )
+  if ( match->pending == 0 )
   {
-    ed = &(matchED->ed1);
-    clusterID = matchED->ed1Matched[matchED->ed1numMatched-1];
-    dstIEEEAddr = matchED->ed2.ieeeAddr;
-    dstEP = matchED->ed2.endpoint;
+    ZDMatchEnd( match, match->status );
   }
-  else if ( matchED->ed2numMatched )
+  else
   {
-    ed = &(matchED->ed2);
-    clusterID = matchED->ed2Matched[matchED->ed2numMatched-1];
-    dstIEEEAddr = matchED->ed1.ieeeAddr;
-    dstEP = matchED->ed1.endpoint;
+    // Set timeout for response
+    match->due = osal_GetSystemClock() + AIB_MaxBindingTime;
+    ZDApp_ServiceTimer( AIB_MaxBindingTime );
   }
+}
 
-  dstAddr.addrMode = Addr16Bit;
+/*********************************************************************
+ * @fn      ZDMatchProcessRsp()
+ *
+ * @brief
+ *
+ *   Hand a Bind_rsp or Unbind_rsp to the pair that sent the request.
+ *
+ * @param  srcAddr - source of the response
+ * @param  ClusterID - Bind_rsp or Unbind_rsp
+ * @param  Status - response status
+ * @param  TransSeq - transaction sequence number of the response
+ *
+ * @return  TRUE if a pair sent the request
+ */
+static uint8 ZDMatchProcessRsp( uint16 srcAddr, uint16 ClusterID, uint8 Status, uint8 TransSeq )
+{
+  ZDMatchEndDeviceBind_t *match;
+  ZDMatchBind_t *pBind;
+  uint16 edAddr;
+  uint8 sending = (ClusterID == Bind_rsp) ? ZDMATCH_SENDING_BIND : ZDMATCH_SENDING_UNBIND;
+  uint8 x, y;
 
-  // Send the next message
-  if ( rspStatus == ZDP_SUCCESS && ed )
+  for ( x = 0; x < ZDMATCH_MAX; x++ )
   {
-    // Send unbind/bind message to source
-    if ( matchED->sending == ZDMATCH_SENDING_UNBIND )
-      msgType = Unbind_req;
-    else
-      msgType = Bind_req;
+    match = ZDMatchTable[x];
 
-    dstAddr.addr.shortAddr = ed->srcAddr;
+    if ( (match == NULL) || (match->state != ZDMATCH_SENDING_BINDS) )
+    {
+      continue;
+    }
 
-    // Save off the transaction sequence number
-    matchED->transSeq = ZDP_TransID;
+    for ( y = 0; y < match->nextBind; y++ )
+    {
+      pBind = &(match->binds[y]);
+      edAddr = (pBind->fromEd2) ? match->ed2.srcAddr : match->ed1.srcAddr;
 
-    destinationAddr.addrMode = Addr64Bit;
-    osal_cpyExtAddr( destinationAddr.addr.extAddr, dstIEEEAddr );
+      if ( (pBind->sending != sending) || (pBind->transSeq != TransSeq)
+          || (edAddr != srcAddr) )
+      {
+        continue;
+      }
 
-    ZDP_BindUnbindReq( msgType, &dstAddr, ed->ieeeAddr, ed->endpoint, clusterID,
-        &destinationAddr, dstEP, ed->SecurityUse );
+      if ( (sending == ZDMATCH_SENDING_UNBIND) && (Status != ZDP_SUCCESS)
+          && (match->status == ZDP_SUCCESS) )
+      {
+        // There was no binding to remove, create it
+        pBind->sending = ZDMATCH_SENDING_BIND;
+        ZDMatchSendReq( match, pBind );
+      }
+      else
+      {
+        if ( (sending == ZDMATCH_SENDING_BIND) && (Status != ZDP_SUCCESS) )
+        {
+          match->status = Status;    // The process will stop
+        }
 
-    // Set timeout for response
-    APS_SetEndDeviceBindTimeout( AIB_MaxBindingTime, ZDO_EndDeviceBindMatchTimeoutCB );
-  }
-  else
-  {
-    // Send the response messages to requesting devices
-    // send response to first requester
-    dstAddr.addr.shortAddr = matchED->ed1.srcAddr;
-    ZDP_EndDeviceBindRsp( matchED->ed1.TransSeq, &dstAddr, rspStatus, matchED->ed1.SecurityUse );
+        pBind->sending = ZDMATCH_SENDING_DONE;
+        match->pending--;
+      }
 
-    // send response to second requester
-    if ( matchED->state == ZDMATCH_SENDING_BINDS )
-    {
-      dstAddr.addr.shortAddr = matchED->ed2.srcAddr;
-      ZDP_EndDeviceBindRsp( matchED->ed2.TransSeq, &dstAddr, rspStatus, matchED->ed2.SecurityUse );
+      ZDMatchSendState( match );
+      return ( TRUE );
     }
-
-    // Process ended - release memory used
-    ZDO_RemoveMatchMemory();
   }
 
-  return ( TRUE );
+  return ( FALSE );
 }
 
-static void ZDO_EndDeviceBindMatchTimeoutCB( void )
+/*********************************************************************
+ * @fn      ZDMatchEnd()
+ *
+ * @brief
+ *
+ *   Send the End_Device_Bind_rsp to the requesting devices and
+ *   release the pair.
+ *
+ * @param  match - the pair
+ * @param  status - response status
+ *
+ * @return  none
+ */
+static void ZDMatchEnd( ZDMatchEndDeviceBind_t *match, uint8 status )
 {
-  ZDMatchSendState( ZDMATCH_REASON_TIMEOUT, ZDP_TIMEOUT, 0 );
+  zAddrType_t dstAddr;
+
+  dstAddr.addrMode = Addr16Bit;
+
+  // send response to first requester
+  dstAddr.addr.shortAddr = match->ed1.srcAddr;
+  ZDP_EndDeviceBindRsp( match->ed1.TransSeq, &dstAddr, status, match->ed1.SecurityUse );
+
+  // send response to second requester
+  if ( match->state == ZDMATCH_SENDING_BINDS )
+  {
+    dstAddr.addr.shortAddr = match->ed2.srcAddr;
+    ZDP_EndDeviceBindRsp( match->ed2.TransSeq, &dstAddr, status, match->ed2.SecurityUse );
+  }
+
+  // Process ended - release memory used
+  ZDO_RemoveMatchMemory( match );
 }
 
 #endif // ZDO_COORDINATOR
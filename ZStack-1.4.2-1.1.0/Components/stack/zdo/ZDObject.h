@@ -38,6 +38,18 @@ extern "C"
 #define ZDO_MAX_RTG_ITEMS       10
 #define ZDO_MAX_BIND_ITEMS      3
 
+#if defined ( ZDO_COORDINATOR )
+  // End_Device_Bind_req requests and matched pairs handled at once.
+  #if !defined( ZDMATCH_MAX )
+    #define ZDMATCH_MAX           4
+  #endif
+
+  // Unbind_req/Bind_req in flight at once for one matched pair.
+  #if !defined( ZDMATCH_MAX_PENDING )
+    #define ZDMATCH_MAX_PENDING   3
+  #endif
+#endif
+
 /*********************************************************************
  * TYPEDEFS
  */
@@ -88,6 +100,13 @@ extern void ZDO_DoEndDeviceBind( ZDEndDeviceBind_t *bindReq );
  */
 extern void ZDO_MatchEndDeviceBind( ZDEndDeviceBind_t *bindReq );
 
+#if defined ( ZDO_COORDINATOR )
+/*
+ * ZDO_MatchTimerEvent - Time out End Device Bind matches
+ */
+extern void ZDO_MatchTimerEvent( void );
+#endif
+
 /*********************************************************************
  * Call Back Functions from ZDProfile  - API
  */
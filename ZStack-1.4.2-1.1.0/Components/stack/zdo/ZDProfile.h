@@ -166,6 +166,7 @@ typedef struct
   uint8  extPANId[Z_EXTADDR_LEN]; // The neighbor device's Extended PanID
   byte   txQuality;       // Transmit quality
   byte   rxLqi;           // Receive LQI
+  byte   devType;         // ZDP_MGMT_DT_ value, parsed from Mgmt_Lqi_rsp only
 } neighborLqiItem_t;
 #define ZDP_NEIGHBORLQI_SIZE    12
 
@@ -0,0 +1,609 @@
+/*********************************************************************
+    Filename:       ZDResolve.c
+    Revised:        $Date: 2007-06-19 14:05:00 -0700 (Tue, 19 Jun 2007) $
+    Revision:       $Revision: 14640 $
+
+    Description: Implementation of the ZDO Address Resolution functionality.
+
+    Notes:
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+#if defined( ZDO_RESOLVE )
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "ZComDef.h"
+#include "OSAL.h"
+#include "AddrMgr.h"
+#include "ZDConfig.h"
+#include "ZDProfile.h"
+#include "ZDApp.h"
+#include "ZDResolve.h"
+
+/*********************************************************************
+ * MACROS
+ */
+
+// Seconds clock for the TTL, wraps after 18 hours. Stale entries are
+// swept every RES_SWEEP_MSECS at most so none outlives a wrap.
+#define RES_SECONDS()  ( (uint16)( osal_GetSystemClock() / 1000 ) )
+
+// Millisecond clock for response timeouts, wraps after 65 seconds.
+#define RES_MSECS()    ( (uint16)osal_GetSystemClock() )
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// resReq_t.type
+#define RES_FREE      0
+#define RES_FIND_NWK  1  // Looking for the NWK address of extAddr
+#define RES_FIND_EXT  2  // Looking for the IEEE address of nwkAddr
+
+// Longest wait between TTL sweeps, well inside the 16-bit seconds clock
+#define RES_SWEEP_MSECS  60000
+
+#if ( RES_TTL > 32767 ) || ( RES_RSP_TIMEOUT > 32767 )
+  #error "RES_TTL and RES_RSP_TIMEOUT must be less than 32768"
+#endif
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint16 ami;       // Address Manager index, INVALID_NODE_ADDR if free
+  uint16 expires;   // RES_SECONDS() the pair goes stale
+} resCache_t;
+
+typedef struct
+{
+  uint16 nwkAddr;
+  uint8  extAddr[Z_EXTADDR_LEN];
+  byte   type;
+  byte   tries;
+  uint16 due;       // RES_MSECS() the request is sent again
+  byte   taskCnt;
+  byte   tasks[RES_SUB_MAX];
+} resReq_t;
+
+/*********************************************************************
+ * GLOBAL VARIABLES
+ */
+
+/*********************************************************************
+ * EXTERNAL VARIABLES
+ */
+
+/*********************************************************************
+ * EXTERNAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static resCache_t resCache[RES_CACHE_MAX];
+static resReq_t resReqs[RES_REQ_MAX];
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+static resCache_t *resCacheFind( uint16 ami );
+static uint16 resCacheExpire( void );
+static byte resLookup( AddrMgrEntry_t *entry, byte byExt );
+static resReq_t *resReqFind( byte type, uint16 nwkAddr, byte *extAddr );
+static byte resReqAdd( byte type, uint16 nwkAddr, byte *extAddr, byte taskID );
+static void resSend( resReq_t *pReq );
+static void resComplete( resReq_t *pReq, byte status );
+
+/*********************************************************************
+ * @fn          resCacheFind
+ *
+ * @brief       Find the TTL entry of an Address Manager entry.
+ *
+ * @param       ami - Address Manager index.
+ *
+ * @return      Pointer to the entry, NULL if not found.
+ */
+static resCache_t *resCacheFind( uint16 ami )
+{
+  resCache_t *pCache = resCache;
+  byte cnt;
+
+  for ( cnt = RES_CACHE_MAX; cnt != 0; cnt--, pCache++ )
+  {
+    if ( pCache->ami == ami )
+    {
+      return pCache;  // EMBEDDED RETURN
+    }
+  }
+
+  return NULL;
+}
+
+/*********************************************************************
+ * @fn          resCacheExpire
+ *
+ * @brief       Drop the TTL entries that went stale, with their
+ *              Address Manager references. Run at least every
+ *              RES_SWEEP_MSECS while entries are held, so the 16-bit
+ *              seconds clock never wraps past an entry.
+ *
+ * @param       none
+ *
+ * @return      ms until the next sweep, 0 if no entries are held.
+ */
+static uint16 resCacheExpire( void )
+{
+  resCache_t *pCache = resCache;
+  AddrMgrEntry_t old;
+  uint16 now = RES_SECONDS();
+  uint16 next = 0;
+  int16 left;
+  byte cnt;
+
+  for ( cnt = RES_CACHE_MAX; cnt != 0; cnt--, pCache++ )
+  {
+    if ( pCache->ami == INVALID_NODE_ADDR )
+    {
+      continue;
+    }
+
+    left = (int16)(pCache->expires - now);
+    if ( left <= 0 )
+    {
+      old.user = ADDRMGR_USER_PRIVATE1;
+      old.index = pCache->ami;
+      (void)AddrMgrEntryRelease( &old );
+      pCache->ami = INVALID_NODE_ADDR;
+      continue;
+    }
+
+    if ( left > (RES_SWEEP_MSECS / 1000) )
+    {
+      left = (RES_SWEEP_MSECS / 1000);
+    }
+
+    if ( (next == 0) || ((uint16)left * 1000 < next) )
+    {
+      next = (uint16)left * 1000;
+    }
+  }
+
+  return ( next );
+}
+
+/*********************************************************************
+ * @fn          resLookup
+ *
+ * @brief       Look up a pair in the Address Manager and check that it
+ *              is still within its TTL.
+ *
+ * @param       entry - extAddr set if byExt, else nwkAddr set.
+ *              The other address is returned in it.
+ * @param       byExt - TRUE to look up by IEEE address.
+ *
+ * @return      TRUE if the pair is known and fresh.
+ */
+static byte resLookup( AddrMgrEntry_t *entry, byte byExt )
+{
+  resCache_t *pCache;
+
+  entry->user = ADDRMGR_USER_PRIVATE1;
+
+  if ( byExt )
+  {
+    if ( (AddrMgrEntryLookupExt( entry ) != TRUE) ||
+         (entry->nwkAddr == INVALID_NODE_ADDR) )
+    {
+      return FALSE;  // EMBEDDED RETURN
+    }
+  }
+  else
+  {
+    if ( (AddrMgrEntryLookupNwk( entry ) != TRUE) ||
+         (AddrMgrExtAddrValid( entry->extAddr ) != TRUE) )
+    {
+      return FALSE;  // EMBEDDED RETURN
+    }
+  }
+
+  pCache = resCacheFind( entry->index );
+
+  return ( pCache && ((int16)(pCache->expires - RES_SECONDS()) > 0) );
+}
+
+/*********************************************************************
+ * @fn          resReqFind
+ *
+ * @brief       Find a resolution in flight.
+ *
+ * @param       type - RES_FIND_NWK or RES_FIND_EXT.
+ * @param       nwkAddr - Address looked up, for RES_FIND_EXT.
+ * @param       extAddr - Address looked up, for RES_FIND_NWK.
+ *
+ * @return      Pointer to the request, NULL if not found.
+ */
+static resReq_t *resReqFind( byte type, uint16 nwkAddr, byte *extAddr )
+{
+  resReq_t *pReq = resReqs;
+  byte cnt;
+
+  for ( cnt = RES_REQ_MAX; cnt != 0; cnt--, pReq++ )
+  {
+    if ( pReq->type == type )
+    {
+      if ( (type == RES_FIND_NWK) ? AddrMgrExtAddrEqual( pReq->extAddr, extAddr )
+                                  : (pReq->nwkAddr == nwkAddr) )
+      {
+        return pReq;  // EMBEDDED RETURN
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/*********************************************************************
+ * @fn          resReqAdd
+ *
+ * @brief       Add a task to the resolution of an address, sending the
+ *              request if none is in flight for it.
+ *
+ * @param       type - RES_FIND_NWK or RES_FIND_EXT.
+ * @param       nwkAddr - Address looked up, for RES_FIND_EXT.
+ * @param       extAddr - Address looked up, for RES_FIND_NWK.
+ * @param       taskID - Task to send ZDO_ADDR_RESOLVE_RSP to.
+ *
+ * @return      ZDRES_PENDING or ZDRES_BUSY.
+ */
+static byte resReqAdd( byte type, uint16 nwkAddr, byte *extAddr, byte taskID )
+{
+  resReq_t *pReq = resReqFind( type, nwkAddr, extAddr );
+  byte idx;
+
+  if ( pReq == NULL )
+  {
+    if ( (pReq = resReqFind( RES_FREE, 0, NULL )) == NULL )
+    {
+      return ZDRES_BUSY;  // EMBEDDED RETURN
+    }
+
+    pReq->type = type;
+    pReq->nwkAddr = nwkAddr;
+    if ( type == RES_FIND_NWK )
+    {
+      AddrMgrExtAddrSet( pReq->extAddr, extAddr );
+    }
+    pReq->tries = 0;
+    pReq->taskCnt = 0;
+    resSend( pReq );
+  }
+
+  for ( idx = 0; idx < pReq->taskCnt; idx++ )
+  {
+    if ( pReq->tasks[idx] == taskID )
+    {
+      return ZDRES_PENDING;  // EMBEDDED RETURN
+    }
+  }
+
+  if ( pReq->taskCnt == RES_SUB_MAX )
+  {
+    return ZDRES_BUSY;  // EMBEDDED RETURN
+  }
+
+  pReq->tasks[pReq->taskCnt++] = taskID;
+
+  return ZDRES_PENDING;
+}
+
+/*********************************************************************
+ * @fn          resSend
+ *
+ * @brief       Send the address request of a resolution.
+ *
+ * @param       pReq - Resolution in flight.
+ *
+ * @return      none
+ */
+static void resSend( resReq_t *pReq )
+{
+  if ( pReq->type == RES_FIND_NWK )
+  {
+    (void)ZDP_NwkAddrReq( pReq->extAddr, ZDP_ADDR_REQTYPE_SINGLE, 0, 0 );
+  }
+  else
+  {
+    (void)ZDP_IEEEAddrReq( pReq->nwkAddr, ZDP_ADDR_REQTYPE_SINGLE, 0, 0 );
+  }
+
+  pReq->tries++;
+  pReq->due = RES_MSECS() + RES_RSP_TIMEOUT;
+  ZDApp_ServiceTimer( RES_RSP_TIMEOUT );
+}
+
+/*********************************************************************
+ * @fn          resComplete
+ *
+ * @brief       Send ZDO_ADDR_RESOLVE_RSP to every task waiting on a
+ *              resolution and free it.
+ *
+ * @param       pReq - Resolution, with both addresses set on success.
+ * @param       status - ZSuccess or ZNwkUnknownDevice.
+ *
+ * @return      none
+ */
+static void resComplete( resReq_t *pReq, byte status )
+{
+  ZDO_AddrResolveRsp_t *pRsp;
+  byte idx;
+
+  for ( idx = 0; idx < pReq->taskCnt; idx++ )
+  {
+    pRsp = (ZDO_AddrResolveRsp_t *)osal_msg_allocate( sizeof( ZDO_AddrResolveRsp_t ) );
+    if ( pRsp )
+    {
+      pRsp->hdr.event = ZDO_ADDR_RESOLVE_RSP;
+      pRsp->hdr.status = status;
+      pRsp->nwkAddr = pReq->nwkAddr;
+      osal_cpyExtAddr( pRsp->extAddr, pReq->extAddr );
+
+      osal_msg_send( pReq->tasks[idx], (uint8 *)pRsp );
+    }
+  }
+
+  pReq->type = RES_FREE;
+}
+
+/*********************************************************************
+ * @fn          ZDResolveInit
+ *
+ * @brief       Initialize the ZDO Address Resolution.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDResolveInit( void )
+{
+  byte idx;
+
+  for ( idx = 0; idx < RES_CACHE_MAX; idx++ )
+  {
+    resCache[idx].ami = INVALID_NODE_ADDR;
+  }
+
+  for ( idx = 0; idx < RES_REQ_MAX; idx++ )
+  {
+    resReqs[idx].type = RES_FREE;
+  }
+}
+
+/*********************************************************************
+ * @fn          ZDResolveNwkAddr
+ *
+ * @brief       Resolve the NWK address of a device.
+ *
+ * @param       extAddr - IEEE address of the device.
+ * @param       taskID - Task to send ZDO_ADDR_RESOLVE_RSP to if the
+ *                       address is not known.
+ * @param       pNwkAddr - Returns the NWK address if known.
+ *
+ * @return      ZDRES_RESOLVED, ZDRES_PENDING or ZDRES_BUSY.
+ */
+byte ZDResolveNwkAddr( byte *extAddr, byte taskID, uint16 *pNwkAddr )
+{
+  AddrMgrEntry_t entry;
+
+  AddrMgrExtAddrSet( entry.extAddr, extAddr );
+
+  if ( resLookup( &entry, TRUE ) )
+  {
+    *pNwkAddr = entry.nwkAddr;
+    return ZDRES_RESOLVED;  // EMBEDDED RETURN
+  }
+
+  return resReqAdd( RES_FIND_NWK, INVALID_NODE_ADDR, extAddr, taskID );
+}
+
+/*********************************************************************
+ * @fn          ZDResolveExtAddr
+ *
+ * @brief       Resolve the IEEE address of a device.
+ *
+ * @param       nwkAddr - NWK address of the device.
+ * @param       taskID - Task to send ZDO_ADDR_RESOLVE_RSP to if the
+ *                       address is not known.
+ * @param       extAddr - Returns the IEEE address if known.
+ *
+ * @return      ZDRES_RESOLVED, ZDRES_PENDING or ZDRES_BUSY.
+ */
+byte ZDResolveExtAddr( uint16 nwkAddr, byte taskID, byte *extAddr )
+{
+  AddrMgrEntry_t entry;
+
+  entry.nwkAddr = nwkAddr;
+
+  if ( resLookup( &entry, FALSE ) )
+  {
+    AddrMgrExtAddrSet( extAddr, entry.extAddr );
+    return ZDRES_RESOLVED;  // EMBEDDED RETURN
+  }
+
+  return resReqAdd( RES_FIND_EXT, nwkAddr, NULL, taskID );
+}
+
+/*********************************************************************
+ * @fn          ZDResolveUpdate
+ *
+ * @brief       Record a NWK/IEEE address pair heard from the network,
+ *              starting its TTL and completing the resolutions waiting
+ *              for it. When all TTL entries are in use, the one that
+ *              goes stale first is reused.
+ *
+ * @param       nwkAddr - NWK address of the device.
+ * @param       extAddr - IEEE address of the device.
+ *
+ * @return      none
+ */
+void ZDResolveUpdate( uint16 nwkAddr, byte *extAddr )
+{
+  AddrMgrEntry_t entry;
+  resCache_t *pCache;
+  resReq_t *pReq;
+  uint16 now = RES_SECONDS();
+  byte idx;
+
+  entry.user = ADDRMGR_USER_PRIVATE1;
+  entry.nwkAddr = nwkAddr;
+  AddrMgrExtAddrSet( entry.extAddr, extAddr );
+
+  if ( AddrMgrEntryUpdate( &entry ) == TRUE )
+  {
+    if ( (pCache = resCacheFind( entry.index )) == NULL )
+    {
+      if ( (pCache = resCacheFind( INVALID_NODE_ADDR )) == NULL )
+      {
+        pCache = resCache;
+        for ( idx = 1; idx < RES_CACHE_MAX; idx++ )
+        {
+          if ( (int16)(resCache[idx].expires - pCache->expires) < 0 )
+          {
+            pCache = &resCache[idx];
+          }
+        }
+      }
+
+      if ( pCache->ami != INVALID_NODE_ADDR )
+      {
+        // Drop the Address Manager reference of the entry reused.
+        AddrMgrEntry_t old;
+
+        old.user = ADDRMGR_USER_PRIVATE1;
+        old.index = pCache->ami;
+        (void)AddrMgrEntryRelease( &old );
+      }
+      pCache->ami = entry.index;
+    }
+    pCache->expires = now + RES_TTL;
+    ZDApp_ServiceTimer( resCacheExpire() );
+  }
+
+  if ( (pReq = resReqFind( RES_FIND_NWK, 0, extAddr )) )
+  {
+    pReq->nwkAddr = nwkAddr;
+    resComplete( pReq, ZSuccess );
+  }
+
+  if ( (pReq = resReqFind( RES_FIND_EXT, nwkAddr, NULL )) )
+  {
+    AddrMgrExtAddrSet( pReq->extAddr, extAddr );
+    resComplete( pReq, ZSuccess );
+  }
+}
+
+/*********************************************************************
+ * @fn          ZDResolveAddrRsp
+ *
+ * @brief       Record a NWK_addr_rsp or IEEE_addr_rsp, whoever asked.
+ *
+ * @param       cId - NWK_addr_rsp or IEEE_addr_rsp.
+ * @param       status - Response status.
+ * @param       nwkAddr - NWK address of interest.
+ * @param       extAddr - IEEE address of interest.
+ *
+ * @return      none
+ */
+void ZDResolveAddrRsp( uint16 cId, byte status, uint16 nwkAddr, byte *extAddr )
+{
+  resReq_t *pReq;
+
+  if ( status == ZDP_SUCCESS )
+  {
+    ZDResolveUpdate( nwkAddr, extAddr );
+  }
+  else
+  {
+    if ( cId == NWK_addr_rsp )
+    {
+      pReq = resReqFind( RES_FIND_NWK, 0, extAddr );
+    }
+    else
+    {
+      pReq = resReqFind( RES_FIND_EXT, nwkAddr, NULL );
+    }
+
+    if ( pReq )
+    {
+      resComplete( pReq, ZNwkUnknownDevice );
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn          ZDResolveTimerEvent
+ *
+ * @brief       Send again the requests that were not answered in
+ *              RES_RSP_TIMEOUT, fail those out of tries and drop the
+ *              stale TTL entries. Called on
+ *              ZDO_SERVICE_TIMER, which may fire early for other
+ *              services.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDResolveTimerEvent( void )
+{
+  resReq_t *pReq = resReqs;
+  uint16 now = RES_MSECS();
+  uint16 next = resCacheExpire();
+  int16 left;
+  byte cnt;
+
+  for ( cnt = RES_REQ_MAX; cnt != 0; cnt--, pReq++ )
+  {
+    if ( pReq->type == RES_FREE )
+    {
+      continue;
+    }
+
+    left = (int16)(pReq->due - now);
+    if ( left <= 0 )
+    {
+      if ( pReq->tries >= RES_MAX_TRIES )
+      {
+        resComplete( pReq, ZNwkUnknownDevice );
+        continue;
+      }
+
+      resSend( pReq );
+      left = RES_RSP_TIMEOUT;
+    }
+
+    if ( (next == 0) || ((uint16)left < next) )
+    {
+      next = (uint16)left;
+    }
+  }
+
+  if ( next )
+  {
+    ZDApp_ServiceTimer( next );
+  }
+}
+
+/*********************************************************************
+*********************************************************************/
+
+#endif  // ZDO_RESOLVE
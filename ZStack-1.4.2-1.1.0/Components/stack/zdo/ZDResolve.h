@@ -0,0 +1,122 @@
+#ifndef ZDRESOLVE_H
+#define ZDRESOLVE_H
+
+/*********************************************************************
+    Filename:       ZDResolve.h
+    Revised:        $Date: 2007-06-19 14:05:00 -0700 (Tue, 19 Jun 2007) $
+    Revision:       $Revision: 14640 $
+
+    Description: Declaration of the ZDO Address Resolution functionality.
+
+      Tasks resolve a NWK address from an IEEE address, or the reverse,
+      through ZDResolveNwkAddr() and ZDResolveExtAddr(). Pairs learned
+      from address responses and device announces are kept in the
+      Address Manager and used for RES_TTL seconds without asking the
+      network again. Lookups for the same device while a request is in
+      flight share that request, and each waiting task gets its own
+      ZDO_ADDR_RESOLVE_RSP message when it completes.
+
+    Notes:
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#if defined( ZDO_RESOLVE )
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "ZComDef.h"
+#include "OSAL.h"
+
+/*********************************************************************
+ * MACROS
+ */
+
+// Resolved pairs kept fresh at once.
+#if !defined( RES_CACHE_MAX )
+  #define RES_CACHE_MAX  8
+#endif
+
+// Resolutions in flight at once.
+#if !defined( RES_REQ_MAX )
+  #define RES_REQ_MAX  4
+#endif
+
+// Tasks that can wait on one resolution.
+#if !defined( RES_SUB_MAX )
+  #define RES_SUB_MAX  4
+#endif
+
+// Seconds a resolved pair is used without asking the network again.
+#if !defined( RES_TTL )
+  #define RES_TTL  300
+#endif
+
+// Milliseconds to wait for an address response before asking again.
+#if !defined( RES_RSP_TIMEOUT )
+  #define RES_RSP_TIMEOUT  2000
+#endif
+
+// Times a request is sent before the resolution fails.
+#if !defined( RES_MAX_TRIES )
+  #define RES_MAX_TRIES  2
+#endif
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// ZDResolveNwkAddr() and ZDResolveExtAddr() return values.
+#define ZDRES_RESOLVED  0x00  // Address returned now, no message follows
+#define ZDRES_PENDING   0x01  // A ZDO_ADDR_RESOLVE_RSP message follows
+#define ZDRES_BUSY      0x02  // No room for the request, try again later
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+// ZDO_ADDR_RESOLVE_RSP message, hdr.status is ZSuccess or ZNwkUnknownDevice.
+typedef struct
+{
+  osal_event_hdr_t hdr;
+  uint16 nwkAddr;
+  uint8  extAddr[Z_EXTADDR_LEN];
+} ZDO_AddrResolveRsp_t;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+extern void ZDResolveInit( void );
+
+extern byte ZDResolveNwkAddr( byte *extAddr, byte taskID, uint16 *pNwkAddr );
+
+extern byte ZDResolveExtAddr( uint16 nwkAddr, byte taskID, byte *extAddr );
+
+extern void ZDResolveUpdate( uint16 nwkAddr, byte *extAddr );
+
+extern void ZDResolveAddrRsp( uint16 cId, byte status, uint16 nwkAddr,
+                              byte *extAddr );
+
+extern void ZDResolveTimerEvent( void );
+
+/*********************************************************************
+*********************************************************************/
+
+#endif  // ZDO_RESOLVE
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZDRESOLVE_H */
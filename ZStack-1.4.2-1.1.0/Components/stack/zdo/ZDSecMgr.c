@@ -24,6 +24,7 @@ extern "C"
  */
 #include "ZComdef.h"
 #include "osal.h"
+#include "OSAL_Nv.h"
 #include "ZGlobals.h"
 #include "ssp.h"
 #include "nwk_globals.h"
@@ -37,23 +38,73 @@ extern "C"
 #include "ZDApp.h"
 #include "ZDSecMgr.h"
 
+#if defined ( ZDSECMGR_ADMIT ) && defined ( MT_ZDO_FUNC )
+  #include "MT_ZDO.h"
+#endif
+
 /******************************************************************************
  * CONSTANTS
  */
 // maximum number of devices managed by this Security Manager
-#define ZDSECMGR_DEVICE_MAX 3
+#if !defined ( ZDSECMGR_DEVICE_MAX )
+  #define ZDSECMGR_DEVICE_MAX 3
+#endif
 
-// total number of preconfigured devices (EXT address, MASTER key)
-#define ZDSECMGR_PRECONFIG_MAX ZDSECMGR_DEVICE_MAX
+// total number of preconfigured devices (EXT address, MASTER key) -- must
+// match the ZDSecMgrPreConfigData table
+#define ZDSECMGR_PRECONFIG_MAX 3
 
 // maximum number of MASTER keys this device may hold
-#define ZDSECMGR_MASTERKEY_MAX ZDSECMGR_DEVICE_MAX
+#if !defined ( ZDSECMGR_MASTERKEY_MAX )
+  #define ZDSECMGR_MASTERKEY_MAX ZDSECMGR_DEVICE_MAX
+#endif
 
 // maximum number of LINK keys this device may store
-#define ZDSECMGR_ENTRY_MAX ZDSECMGR_DEVICE_MAX
+#if !defined ( ZDSECMGR_ENTRY_MAX )
+  #define ZDSECMGR_ENTRY_MAX ZDSECMGR_DEVICE_MAX
+#endif
 
 // total number of devices under control - authentication, SKKE, etc.
-#define ZDSECMGR_CTRL_MAX ZDSECMGR_DEVICE_MAX
+#if !defined ( ZDSECMGR_CTRL_MAX )
+  #define ZDSECMGR_CTRL_MAX 3
+#endif
+
+#if ( ZDSECMGR_MASTERKEY_MAX < ZDSECMGR_PRECONFIG_MAX )
+  #error "ZDSECMGR_MASTERKEY_MAX must hold the preconfigured keys"
+#endif
+
+// buckets in the NWK and EXT address indexes of the entries -- power of 2,
+// raise it with ZDSECMGR_ENTRY_MAX to keep the bucket chains short
+#if !defined ( ZDSECMGR_HASH_MAX )
+  #define ZDSECMGR_HASH_MAX 16
+#endif
+
+#define ZDSECMGR_HASH_NWK( nwkAddr ) \
+  ( (uint8)( (nwkAddr) ^ ( (nwkAddr) >> 8 ) ) & ( ZDSECMGR_HASH_MAX - 1 ) )
+
+#define ZDSECMGR_HASH_EXT( extAddr ) \
+  ( (uint8)( (extAddr)[0] ^ (extAddr)[1] ) & ( ZDSECMGR_HASH_MAX - 1 ) )
+
+#if defined ( NV_RESTORE )
+// entries saved per NV item -- items start at ZCD_NV_SECMGR_ENTRIES
+#if !defined ( ZDSECMGR_NV_BLOCK )
+  #define ZDSECMGR_NV_BLOCK 8
+#endif
+
+#define ZDSECMGR_NV_BLOCKS \
+  ( ( ZDSECMGR_ENTRY_MAX + ZDSECMGR_NV_BLOCK - 1 ) / ZDSECMGR_NV_BLOCK )
+
+#if ( ZDSECMGR_NV_BLOCKS > \
+      ( ZCD_NV_SECMGR_ENTRIES_END - ZCD_NV_SECMGR_ENTRIES + 1 ) )
+  #error "ZDSECMGR_NV_BLOCK too small for ZDSECMGR_ENTRY_MAX"
+#endif
+
+// LINK key frames sent between saves of the frame counter -- the counter
+// is advanced by this much when restored
+#if !defined ( ZDSECMGR_TX_CNTR_WINDOW )
+  #define ZDSECMGR_TX_CNTR_WINDOW 256
+#endif
+#endif // defined ( NV_RESTORE )
 
 // total number of restricted devices
 #define ZDSECMGR_RESTRICTED_DEVICES 2
@@ -74,6 +125,13 @@ extern "C"
 // set SKKE slot maximum
 #define ZDSECMGR_SKKE_SLOT_MAX 1
 
+// admission queue entry flags
+#define ZDSECMGR_ADMIT_NONE   0x00
+#define ZDSECMGR_ADMIT_USED   0x01
+#define ZDSECMGR_ADMIT_KNOWN  0x02
+#define ZDSECMGR_ADMIT_SECURE 0x04
+#define ZDSECMGR_ADMIT_SKIP   0x08
+
 // APSME Stub Implementations
 #define ZDSecMgrMasterKeyGet   APSME_MasterKeyGet
 #define ZDSecMgrLinkKeySet     APSME_LinkKeySet
@@ -102,12 +160,45 @@ typedef struct
   APSME_LinkKeyData_t apsmelkd;
 } ZDSecMgrLinkKeyData_t;
 
+// entry and MASTER key slots, as held by the indexes
+#if ( ZDSECMGR_ENTRY_MAX < 0xFF ) && ( ZDSECMGR_MASTERKEY_MAX < 0xFF )
+typedef uint8 ZDSecMgrSlot_t;
+#define ZDSECMGR_SLOT_NONE 0xFF
+#else
+typedef uint16 ZDSecMgrSlot_t;
+#define ZDSECMGR_SLOT_NONE 0xFFFF
+#endif
+
 typedef struct
 {
   uint16                ami;
+  uint16                nwkAddr;  // NWK address indexed under
+  ZDSecMgrSlot_t        nwkNext;  // next entry in the NWK address bucket
+  ZDSecMgrSlot_t        extNext;  // next entry in the EXT address bucket
+                                  // or in the free list
+  uint8                 extHash;  // EXT address bucket
+  #if defined ( NV_RESTORE )
+  uint32                nvTxFrmCntr; // lkd.apsmelkd.txFrmCntr last saved
+  #endif
   ZDSecMgrLinkKeyData_t lkd;
 } ZDSecMgrEntry_t;
 
+// entry and MASTER key of an Address Manager index
+typedef struct
+{
+  ZDSecMgrSlot_t entry;
+  ZDSecMgrSlot_t key;
+} ZDSecMgrIndex_t;
+
+// entry as saved in NV
+typedef struct
+{
+  uint16 ami;
+  uint8  key[SEC_KEY_LEN];
+  uint32 txFrmCntr;
+  uint32 rxFrmCntr;
+} ZDSecMgrEntryNV_t;
+
 typedef struct
 {
   ZDSecMgrEntry_t* entry;
@@ -127,6 +218,22 @@ typedef struct
   ZDSecMgrCtrl_t* ctrl;
 } ZDSecMgrDevice_t;
 
+typedef struct
+{
+  uint16 nwkAddr;
+  uint16 parentAddr;
+  uint8  extAddr[Z_EXTADDR_LEN];
+  uint8  flags;
+  uint8  tries;
+  uint32 joined;
+} ZDSecMgrAdmit_t;
+
+typedef struct
+{
+  uint16 nwkAddr;
+  uint32 joined;
+} ZDSecMgrAdmitLate_t;
+
 /******************************************************************************
  * LOCAL VARIABLES
  */
@@ -183,6 +290,13 @@ const ZDSecMgrPreConfigData_t ZDSecMgrPreConfigData[ZDSECMGR_PRECONFIG_MAX] =
 ZDSecMgrMasterKeyData_t* ZDSecMgrMasterKeyData = NULL;
 ZDSecMgrEntry_t*         ZDSecMgrEntries       = NULL;
 ZDSecMgrCtrl_t*          ZDSecMgrCtrlData      = NULL;
+ZDSecMgrIndex_t*         ZDSecMgrIndex         = NULL;
+ZDSecMgrSlot_t           ZDSecMgrEntryFreeList;
+ZDSecMgrSlot_t           ZDSecMgrNwkHash[ZDSECMGR_HASH_MAX];
+ZDSecMgrSlot_t           ZDSecMgrExtHash[ZDSECMGR_HASH_MAX];
+#if defined ( NV_RESTORE )
+uint32                   ZDSecMgrEntryNVDirty;
+#endif
 void ZDSecMgrAddrMgrUpdate( uint16 ami, uint16 nwkAddr );
 void ZDSecMgrAddrMgrCB( uint8 update, AddrMgrEntry_t* newEntry, AddrMgrEntry_t* oldEntry );
 #endif // defined ( ZDSECMGR_COMMERCIAL )
@@ -192,10 +306,20 @@ uint8 ZDSecMgrPermitJoiningEnabled;
 uint8 ZDSecMgrPermitJoiningTimed;
 #endif // defined ( ZDSECMGR_SECURE ) && defined ( ZDO_COORDINATOR )
 
+#if defined ( ZDSECMGR_ADMIT )
+ZDSecMgrAdmit_t      ZDSecMgrAdmitData[ZDSECMGR_ADMIT_MAX];
+ZDSecMgrAdmitLate_t  ZDSecMgrAdmitLate[ZDSECMGR_ADMIT_MAX];
+ZDSecMgrAdmitStats_t ZDSecMgrAdmitStats;
+uint8                ZDSecMgrAdmitCnt;
+uint8                ZDSecMgrAdmitStorm;
+uint32               ZDSecMgrAdmitStart;
+#endif // defined ( ZDSECMGR_ADMIT )
+
 #if defined ( ZDSECMGR_SECURE )
 /******************************************************************************
  * PRIVATE FUNCTIONS
  *
+ *   ZDSecMgrIndexInit
  *   ZDSecMgrMasterKeyInit
  *   ZDSecMgrExtAddrLookup
  *   ZDSecMgrExtAddrStore
@@ -207,6 +331,10 @@ uint8 ZDSecMgrPermitJoiningTimed;
  *   ZDSecMgrEntryLookupExt
  *   ZDSecMgrEntryFree
  *   ZDSecMgrEntryNew
+ *   ZDSecMgrEntryIndexAdd
+ *   ZDSecMgrEntryIndexRemove
+ *   ZDSecMgrEntryNwkSet
+ *   ZDSecMgrEntryNVMark
  *   ZDSecMgrCtrlInit
  *   ZDSecMgrCtrlRelease
  *   ZDSecMgrCtrlLookup
@@ -235,7 +363,22 @@ uint8 ZDSecMgrPermitJoiningTimed;
  *   ZDSecMgrDeviceJoinFwd
  *   ZDSecMgrDeviceNew
  *   ZDSecMgrAssocDeviceAuth
+ *   ZDSecMgrAssocDeviceNew
+ *   ZDSecMgrAdmitKnown
+ *   ZDSecMgrAdmitNext
+ *   ZDSecMgrAdmitLateReset
+ *   ZDSecMgrAdmitLateSet
+ *   ZDSecMgrAdmitLateGet
+ *   ZDSecMgrAdmitCount
+ *   ZDSecMgrAdmitEvent
+ *   ZDSecMgrAdmitEnd
+ *   ZDSecMgrCtrlFree
  */
+//-----------------------------------------------------------------------------
+// Address Manager index data
+//-----------------------------------------------------------------------------
+void ZDSecMgrIndexInit( void );
+
 //-----------------------------------------------------------------------------
 // master key data
 //-----------------------------------------------------------------------------
@@ -261,7 +404,11 @@ ZStatus_t ZDSecMgrEntryLookup( uint16 nwkAddr, ZDSecMgrEntry_t** entry );
 ZStatus_t ZDSecMgrEntryLookupAMI( uint16 ami, ZDSecMgrEntry_t** entry );
 ZStatus_t ZDSecMgrEntryLookupExt( uint8* extAddr, ZDSecMgrEntry_t** entry );
 void ZDSecMgrEntryFree( ZDSecMgrEntry_t* entry );
-ZStatus_t ZDSecMgrEntryNew( ZDSecMgrEntry_t** entry );
+ZStatus_t ZDSecMgrEntryNew( uint16 ami, ZDSecMgrEntry_t** entry );
+void ZDSecMgrEntryIndexAdd( ZDSecMgrEntry_t* entry );
+void ZDSecMgrEntryIndexRemove( ZDSecMgrEntry_t* entry );
+void ZDSecMgrEntryNwkSet( ZDSecMgrEntry_t* entry, uint16 nwkAddr );
+void ZDSecMgrEntryNVMark( ZDSecMgrEntry_t* entry );
 
 //-----------------------------------------------------------------------------
 // control data
@@ -322,6 +469,54 @@ ZStatus_t ZDSecMgrDeviceNew( ZDSecMgrDevice_t* device );
 // association management
 //-----------------------------------------------------------------------------
 void ZDSecMgrAssocDeviceAuth( associated_devices_t* assoc );
+ZStatus_t ZDSecMgrAssocDeviceNew( associated_devices_t* assoc );
+
+//-----------------------------------------------------------------------------
+// join admission
+//-----------------------------------------------------------------------------
+uint8 ZDSecMgrAdmitKnown( uint8* extAddr );
+ZDSecMgrAdmit_t* ZDSecMgrAdmitNext( void );
+void ZDSecMgrAdmitLateReset( void );
+void ZDSecMgrAdmitLateSet( uint16 nwkAddr, uint32 joined );
+uint8 ZDSecMgrAdmitLateGet( uint16 nwkAddr, uint32* joined );
+void ZDSecMgrAdmitCount( uint32* joined, uint8 known );
+void ZDSecMgrAdmitEvent( void );
+void ZDSecMgrAdmitEnd( void );
+uint8 ZDSecMgrCtrlFree( void );
+
+#if defined ( ZDSECMGR_COMMERCIAL )
+/******************************************************************************
+ * @fn          ZDSecMgrIndexInit
+ *
+ * @brief       Initialize the entry and MASTER key index by Address Manager
+ *              index.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDSecMgrIndexInit( void )
+{
+  uint16 size;
+  uint16 index;
+
+
+  // allocate index data
+  size = (short)( sizeof(ZDSecMgrIndex_t) * NWK_MAX_ADDRESSES );
+
+  ZDSecMgrIndex = osal_mem_alloc( size );
+
+  // initialize data
+  if ( ZDSecMgrIndex != NULL )
+  {
+    for ( index = 0; index < NWK_MAX_ADDRESSES; index++ )
+    {
+      ZDSecMgrIndex[index].entry = ZDSECMGR_SLOT_NONE;
+      ZDSecMgrIndex[index].key   = ZDSECMGR_SLOT_NONE;
+    }
+  }
+}
+#endif // defined ( ZDSECMGR_COMMERCIAL )
 
 #if defined ( ZDSECMGR_COMMERCIAL )
 /******************************************************************************
@@ -381,6 +576,12 @@ void ZDSecMgrMasterKeyInit( void )
 
           osal_cpyExtAddr( ZDSecMgrMasterKeyData[index].key,
                            (void*)ZDSecMgrPreConfigData[index].key );
+
+          if ( ( ZDSecMgrIndex != NULL ) &&
+               ( entry.index < NWK_MAX_ADDRESSES ) )
+          {
+            ZDSecMgrIndex[entry.index].key = (ZDSecMgrSlot_t)index;
+          }
         }
       }
     }
@@ -490,19 +691,16 @@ ZStatus_t ZDSecMgrMasterKeyLookup( uint16 ami, uint8** key )
   status = ZNwkUnknownDevice;
 
   // verify data is available
-  if ( ZDSecMgrMasterKeyData != NULL )
+  if ( ( ZDSecMgrMasterKeyData != NULL ) && ( ZDSecMgrIndex != NULL ) &&
+       ( ami < NWK_MAX_ADDRESSES ) )
   {
-    for ( index = 0; index < ZDSECMGR_MASTERKEY_MAX ; index++ )
-    {
-      if ( ZDSecMgrMasterKeyData[index].ami == ami )
-      {
-        // return successful results
-        *key   = ZDSecMgrMasterKeyData[index].key;
-        status = ZSuccess;
+    index = ZDSecMgrIndex[ami].key;
 
-        // break from loop
-        index  = ZDSECMGR_MASTERKEY_MAX;
-      }
+    if ( index != ZDSECMGR_SLOT_NONE )
+    {
+      // return successful results
+      *key   = ZDSecMgrMasterKeyData[index].key;
+      status = ZSuccess;
     }
   }
 
@@ -532,7 +730,8 @@ ZStatus_t ZDSecMgrMasterKeyStore( uint16 ami, uint8* key )
   status = ZNwkUnknownDevice;
 
   // verify data is available
-  if ( ZDSecMgrMasterKeyData != NULL )
+  if ( ( ZDSecMgrMasterKeyData != NULL ) && ( ZDSecMgrIndex != NULL ) &&
+       ( ami < NWK_MAX_ADDRESSES ) )
   {
     for ( index = 0; index < ZDSECMGR_MASTERKEY_MAX ; index++ )
     {
@@ -540,6 +739,7 @@ ZStatus_t ZDSecMgrMasterKeyStore( uint16 ami, uint8* key )
       {
         // store EXT address index
         ZDSecMgrMasterKeyData[index].ami = ami;
+        ZDSecMgrIndex[ami].key = (ZDSecMgrSlot_t)index;
 
         entry = ZDSecMgrMasterKeyData[index].key;
 
@@ -587,11 +787,28 @@ void ZDSecMgrEntryInit( void )
   ZDSecMgrEntries = osal_mem_alloc( size );
 
   // initialize data
+  ZDSecMgrEntryFreeList = ZDSECMGR_SLOT_NONE;
+
+  for ( index = 0; index < ZDSECMGR_HASH_MAX; index++ )
+  {
+    ZDSecMgrNwkHash[index] = ZDSECMGR_SLOT_NONE;
+    ZDSecMgrExtHash[index] = ZDSECMGR_SLOT_NONE;
+  }
+
+  #if defined ( NV_RESTORE )
+  ZDSecMgrEntryNVDirty = 0;
+  #endif
+
   if ( ZDSecMgrEntries != NULL )
   {
-    for( index = 0; index < ZDSECMGR_ENTRY_MAX; index++ )
+    // chain all entries into the free list, lowest first
+    index = ZDSECMGR_ENTRY_MAX;
+
+    while ( index-- > 0 )
     {
-      ZDSecMgrEntries[index].ami = INVALID_NODE_ADDR;
+      ZDSecMgrEntries[index].ami     = INVALID_NODE_ADDR;
+      ZDSecMgrEntries[index].extNext = ZDSecMgrEntryFreeList;
+      ZDSecMgrEntryFreeList          = (ZDSecMgrSlot_t)index;
     }
   }
 }
@@ -622,21 +839,48 @@ ZStatus_t ZDSecMgrEntryLookup( uint16 nwkAddr, ZDSecMgrEntry_t** entry )
   // verify data is available
   if ( ZDSecMgrEntries != NULL )
   {
-    addrMgrEntry.user    = ADDRMGR_USER_SECURITY;
-    addrMgrEntry.nwkAddr = nwkAddr;
+    addrMgrEntry.user = ADDRMGR_USER_SECURITY;
+
+    // check the NWK address index
+    index = ZDSecMgrNwkHash[ZDSECMGR_HASH_NWK( nwkAddr )];
 
-    if ( AddrMgrEntryLookupNwk( &addrMgrEntry ) == TRUE )
+    while ( index != ZDSECMGR_SLOT_NONE )
     {
-      for ( index = 0; index < ZDSECMGR_ENTRY_MAX ; index++ )
+      if ( ZDSecMgrEntries[index].nwkAddr == nwkAddr )
       {
-        if ( addrMgrEntry.index == ZDSecMgrEntries[index].ami )
+        // make sure Address Manager still has the same NWK address
+        addrMgrEntry.index = ZDSecMgrEntries[index].ami;
+
+        if ( ( AddrMgrEntryGet( &addrMgrEntry ) == TRUE ) &&
+             ( addrMgrEntry.nwkAddr == nwkAddr )             )
         {
           // return successful results
           *entry = &ZDSecMgrEntries[index];
           status = ZSuccess;
+        }
 
-          // break from loop
-          index = ZDSECMGR_ENTRY_MAX;
+        // break from loop
+        index = ZDSECMGR_SLOT_NONE;
+      }
+      else
+      {
+        index = ZDSecMgrEntries[index].nwkNext;
+      }
+    }
+
+    if ( status != ZSuccess )
+    {
+      // NWK address may have been changed by another Address Manager user
+      addrMgrEntry.nwkAddr = nwkAddr;
+
+      if ( AddrMgrEntryLookupNwk( &addrMgrEntry ) == TRUE )
+      {
+        if ( ZDSecMgrEntryLookupAMI( addrMgrEntry.index, entry ) == ZSuccess )
+        {
+          // reindex under the current NWK address
+          ZDSecMgrEntryNwkSet( *entry, nwkAddr );
+
+          status = ZSuccess;
         }
       }
     }
@@ -668,19 +912,16 @@ ZStatus_t ZDSecMgrEntryLookupAMI( uint16 ami, ZDSecMgrEntry_t** entry )
   status = ZNwkUnknownDevice;
 
   // verify data is available
-  if ( ZDSecMgrEntries != NULL )
+  if ( ( ZDSecMgrEntries != NULL ) && ( ZDSecMgrIndex != NULL ) &&
+       ( ami < NWK_MAX_ADDRESSES ) )
   {
-    for ( index = 0; index < ZDSECMGR_ENTRY_MAX ; index++ )
-    {
-      if ( ZDSecMgrEntries[index].ami == ami )
-      {
-        // return successful results
-        *entry = &ZDSecMgrEntries[index];
-        status = ZSuccess;
+    index = ZDSecMgrIndex[ami].entry;
 
-        // break from loop
-        index = ZDSECMGR_ENTRY_MAX;
-      }
+    if ( index != ZDSECMGR_SLOT_NONE )
+    {
+      // return successful results
+      *entry = &ZDSecMgrEntries[index];
+      status = ZSuccess;
     }
   }
 
@@ -701,18 +942,42 @@ ZStatus_t ZDSecMgrEntryLookupAMI( uint16 ami, ZDSecMgrEntry_t** entry )
  */
 ZStatus_t ZDSecMgrEntryLookupExt( uint8* extAddr, ZDSecMgrEntry_t** entry )
 {
-  ZStatus_t status;
-  uint16    ami;
+  ZStatus_t      status;
+  uint16         index;
+  AddrMgrEntry_t addrMgrEntry;
 
 
   // initialize results
   *entry = NULL;
   status = ZNwkUnknownDevice;
 
-  // lookup address index
-  if ( ZDSecMgrExtAddrLookup( extAddr, &ami ) == ZSuccess )
+  // verify data is available
+  if ( ZDSecMgrEntries != NULL )
   {
-    status = ZDSecMgrEntryLookupAMI( ami, entry );
+    addrMgrEntry.user = ADDRMGR_USER_SECURITY;
+
+    // check the EXT address index
+    index = ZDSecMgrExtHash[ZDSECMGR_HASH_EXT( extAddr )];
+
+    while ( index != ZDSECMGR_SLOT_NONE )
+    {
+      addrMgrEntry.index = ZDSecMgrEntries[index].ami;
+
+      if ( ( AddrMgrEntryGet( &addrMgrEntry ) == TRUE ) &&
+           ( AddrMgrExtAddrEqual( addrMgrEntry.extAddr, extAddr ) == TRUE ) )
+      {
+        // return successful results
+        *entry = &ZDSecMgrEntries[index];
+        status = ZSuccess;
+
+        // break from loop
+        index = ZDSECMGR_SLOT_NONE;
+      }
+      else
+      {
+        index = ZDSecMgrEntries[index].extNext;
+      }
+    }
   }
 
   return status;
@@ -731,7 +996,16 @@ ZStatus_t ZDSecMgrEntryLookupExt( uint8* extAddr, ZDSecMgrEntry_t** entry )
  */
 void ZDSecMgrEntryFree( ZDSecMgrEntry_t* entry )
 {
+  // remove from the indexes
+  ZDSecMgrEntryIndexRemove( entry );
+
   entry->ami = INVALID_NODE_ADDR;
+
+  // return to the free list
+  entry->extNext        = ZDSecMgrEntryFreeList;
+  ZDSecMgrEntryFreeList = (ZDSecMgrSlot_t)( entry - ZDSecMgrEntries );
+
+  ZDSecMgrEntryNVMark( entry );
 }
 #endif // defined ( ZDSECMGR_COMMERCIAL )
 
@@ -739,16 +1013,16 @@ void ZDSecMgrEntryFree( ZDSecMgrEntry_t* entry )
 /******************************************************************************
  * @fn          ZDSecMgrEntryNew
  *
- * @brief       Get a new entry.
+ * @brief       Get a new entry for the specified address index.
  *
+ * @param       ami   - [in] Address Manager index
  * @param       entry - [out] valid entry
  *
  * @return      ZStatus_t
  */
-ZStatus_t ZDSecMgrEntryNew( ZDSecMgrEntry_t** entry )
+ZStatus_t ZDSecMgrEntryNew( uint16 ami, ZDSecMgrEntry_t** entry )
 {
   ZStatus_t status;
-  uint16    index;
 
 
   // initialize results
@@ -756,20 +1030,28 @@ ZStatus_t ZDSecMgrEntryNew( ZDSecMgrEntry_t** entry )
   status = ZNwkUnknownDevice;
 
   // verify data is available
-  if ( ZDSecMgrEntries != NULL )
+  if ( ( ZDSecMgrEntries != NULL ) && ( ZDSecMgrIndex != NULL ) &&
+       ( ami < NWK_MAX_ADDRESSES ) )
   {
-    // find available entry
-    for ( index = 0; index < ZDSECMGR_ENTRY_MAX ; index++ )
+    // take the first free entry
+    if ( ZDSecMgrEntryFreeList != ZDSECMGR_SLOT_NONE )
     {
-      if ( ZDSecMgrEntries[index].ami == INVALID_NODE_ADDR )
-      {
-        // return successful result
-        *entry = &ZDSecMgrEntries[index];
-        status = ZSuccess;
+      *entry = &ZDSecMgrEntries[ZDSecMgrEntryFreeList];
 
-        // break from loop
-        index = ZDSECMGR_ENTRY_MAX;
-      }
+      ZDSecMgrEntryFreeList = (*entry)->extNext;
+
+      // add to the indexes
+      (*entry)->ami = ami;
+      ZDSecMgrEntryIndexAdd( *entry );
+
+      #if defined ( NV_RESTORE )
+      (*entry)->nvTxFrmCntr = (*entry)->lkd.apsmelkd.txFrmCntr;
+      #endif
+
+      ZDSecMgrEntryNVMark( *entry );
+
+      // return successful result
+      status = ZSuccess;
     }
   }
 
@@ -779,125 +1061,314 @@ ZStatus_t ZDSecMgrEntryNew( ZDSecMgrEntry_t** entry )
 
 #if defined ( ZDSECMGR_COMMERCIAL )
 /******************************************************************************
- * @fn          ZDSecMgrCtrlInit
+ * @fn          ZDSecMgrEntryIndexAdd
  *
- * @brief       Initialize control sub module
+ * @brief       Add entry to the address index and the NWK and EXT address
+ *              indexes.
  *
- * @param       none
+ * @param       entry - [in] valid entry, ami set
  *
  * @return      none
  */
-void ZDSecMgrCtrlInit( void )
+void ZDSecMgrEntryIndexAdd( ZDSecMgrEntry_t* entry )
 {
-  //---------------------------------------------------------------------------
-  #if defined ( ZDO_COORDINATOR )
-  //---------------------------------------------------------------------------
-  uint16 size;
-  uint16 index;
+  ZDSecMgrSlot_t slot;
+  uint8          hash;
+  AddrMgrEntry_t addrMgrEntry;
 
 
-  // allocate entry data
-  size = (short)( sizeof(ZDSecMgrCtrl_t) * ZDSECMGR_CTRL_MAX );
+  slot = (ZDSecMgrSlot_t)( entry - ZDSecMgrEntries );
 
-  ZDSecMgrCtrlData = osal_mem_alloc( size );
+  ZDSecMgrIndex[entry->ami].entry = slot;
 
-  // initialize data
-  if ( ZDSecMgrCtrlData != NULL )
+  // get the address data
+  addrMgrEntry.user  = ADDRMGR_USER_SECURITY;
+  addrMgrEntry.index = entry->ami;
+
+  if ( AddrMgrEntryGet( &addrMgrEntry ) != TRUE )
   {
-    for( index = 0; index < ZDSECMGR_CTRL_MAX; index++ )
-    {
-      ZDSecMgrCtrlData[index].state = ZDSECMGR_CTRL_NONE;
-    }
+    addrMgrEntry.nwkAddr = INVALID_NODE_ADDR;
+    osal_memset( addrMgrEntry.extAddr, 0, Z_EXTADDR_LEN );
   }
-  //---------------------------------------------------------------------------
-  #endif // defined ( ZDO_COORDINATOR )
-  //---------------------------------------------------------------------------
+
+  // EXT address never changes for an address index
+  entry->extHash = ZDSECMGR_HASH_EXT( addrMgrEntry.extAddr );
+
+  entry->extNext                  = ZDSecMgrExtHash[entry->extHash];
+  ZDSecMgrExtHash[entry->extHash] = slot;
+
+  // NWK address is reindexed when it changes
+  entry->nwkAddr = addrMgrEntry.nwkAddr;
+  hash = ZDSECMGR_HASH_NWK( entry->nwkAddr );
+
+  entry->nwkNext        = ZDSecMgrNwkHash[hash];
+  ZDSecMgrNwkHash[hash] = slot;
 }
 #endif // defined ( ZDSECMGR_COMMERCIAL )
 
 #if defined ( ZDSECMGR_COMMERCIAL )
-#if defined ( ZDO_COORDINATOR )
 /******************************************************************************
- * @fn          ZDSecMgrCtrlRelease
+ * @fn          ZDSecMgrEntryIndexRemove
  *
- * @brief       Release control data.
+ * @brief       Remove entry from the address index and the NWK and EXT
+ *              address indexes.
  *
- * @param       ctrl - [in] valid control data
+ * @param       entry - [in] valid entry
  *
  * @return      none
  */
-void ZDSecMgrCtrlRelease( ZDSecMgrCtrl_t* ctrl )
+void ZDSecMgrEntryIndexRemove( ZDSecMgrEntry_t* entry )
 {
-  // should always be enough entry control data
-  ctrl->state = ZDSECMGR_CTRL_NONE;
+  ZDSecMgrSlot_t  slot;
+  ZDSecMgrSlot_t* link;
+
+
+  slot = (ZDSecMgrSlot_t)( entry - ZDSecMgrEntries );
+
+  if ( ( entry->ami < NWK_MAX_ADDRESSES ) &&
+       ( ZDSecMgrIndex[entry->ami].entry == slot ) )
+  {
+    ZDSecMgrIndex[entry->ami].entry = ZDSECMGR_SLOT_NONE;
+
+    // unlink from the NWK address bucket
+    link = &ZDSecMgrNwkHash[ZDSECMGR_HASH_NWK( entry->nwkAddr )];
+
+    while ( *link != ZDSECMGR_SLOT_NONE )
+    {
+      if ( *link == slot )
+      {
+        *link = entry->nwkNext;
+      }
+      else
+      {
+        link = &ZDSecMgrEntries[*link].nwkNext;
+      }
+    }
+
+    // unlink from the EXT address bucket
+    link = &ZDSecMgrExtHash[entry->extHash];
+
+    while ( *link != ZDSECMGR_SLOT_NONE )
+    {
+      if ( *link == slot )
+      {
+        *link = entry->extNext;
+      }
+      else
+      {
+        link = &ZDSecMgrEntries[*link].extNext;
+      }
+    }
+  }
 }
-#endif // defined ( ZDO_COORDINATOR )
 #endif // defined ( ZDSECMGR_COMMERCIAL )
 
 #if defined ( ZDSECMGR_COMMERCIAL )
-#if defined ( ZDO_COORDINATOR )
 /******************************************************************************
- * @fn          ZDSecMgrCtrlLookup
+ * @fn          ZDSecMgrEntryNwkSet
  *
- * @brief       Lookup control data.
+ * @brief       Reindex entry under a new NWK address.
  *
- * @param       entry - [in] valid entry data
- * @param       ctrl  - [out] control data - NULL if not found
+ * @param       entry   - [in] valid entry
+ * @param       nwkAddr - [in] NWK address
  *
  * @return      none
  */
-void ZDSecMgrCtrlLookup( ZDSecMgrEntry_t* entry, ZDSecMgrCtrl_t** ctrl )
+void ZDSecMgrEntryNwkSet( ZDSecMgrEntry_t* entry, uint16 nwkAddr )
 {
-  uint16 index;
+  ZDSecMgrSlot_t  slot;
+  ZDSecMgrSlot_t* link;
+  uint8           hash;
 
 
-  // initialize search results
-  *ctrl = NULL;
-
-  // verify data is available
-  if ( ZDSecMgrCtrlData != NULL )
+  if ( entry->nwkAddr != nwkAddr )
   {
-    for ( index = 0; index < ZDSECMGR_CTRL_MAX; index++ )
+    slot = (ZDSecMgrSlot_t)( entry - ZDSecMgrEntries );
+
+    // unlink from the old NWK address bucket
+    link = &ZDSecMgrNwkHash[ZDSECMGR_HASH_NWK( entry->nwkAddr )];
+
+    while ( *link != ZDSECMGR_SLOT_NONE )
     {
-      // make sure control data is in use
-      if ( ZDSecMgrCtrlData[index].state != ZDSECMGR_CTRL_NONE )
+      if ( *link == slot )
       {
-        // check for entry match
-        if ( ZDSecMgrCtrlData[index].entry == entry )
-        {
-          // return this control data
-          *ctrl = &ZDSecMgrCtrlData[index];
-
-          // break from loop
-          index = ZDSECMGR_CTRL_MAX;
-        }
+        *link = entry->nwkNext;
+      }
+      else
+      {
+        link = &ZDSecMgrEntries[*link].nwkNext;
       }
     }
+
+    // link into the new NWK address bucket
+    entry->nwkAddr = nwkAddr;
+    hash = ZDSECMGR_HASH_NWK( nwkAddr );
+
+    entry->nwkNext        = ZDSecMgrNwkHash[hash];
+    ZDSecMgrNwkHash[hash] = slot;
   }
 }
-#endif // defined ( ZDO_COORDINATOR )
 #endif // defined ( ZDSECMGR_COMMERCIAL )
 
-
 #if defined ( ZDSECMGR_COMMERCIAL )
-#if defined ( ZDO_COORDINATOR )
 /******************************************************************************
- * @fn          ZDSecMgrCtrlSet
+ * @fn          ZDSecMgrEntryNVMark
  *
- * @brief       Set control data.
+ * @brief       Mark the NV block of the entry for the next NV update.
  *
- * @param       device - [in] valid device data
- * @param       entry  - [in] valid entry data
- * @param       ctrl   - [in] valid control data
+ * @param       entry - [in] valid entry
  *
  * @return      none
  */
-void ZDSecMgrCtrlSet( ZDSecMgrDevice_t* device,
-                      ZDSecMgrEntry_t*  entry,
-                      ZDSecMgrCtrl_t*   ctrl )
+void ZDSecMgrEntryNVMark( ZDSecMgrEntry_t* entry )
 {
-  // set control date
-  ctrl->parentAddr = device->parentAddr;
+  //---------------------------------------------------------------------------
+  #if defined ( NV_RESTORE )
+  //---------------------------------------------------------------------------
+  uint32 block;
+
+
+  block = (uint32)1 << ( (uint16)( entry - ZDSecMgrEntries ) /
+                         ZDSECMGR_NV_BLOCK );
+
+  if ( ( ZDSecMgrEntryNVDirty & block ) == 0 )
+  {
+    ZDSecMgrEntryNVDirty |= block;
+
+    // request an NV update -- written by ZDSecMgrWriteNV
+    AddrMgrWriteNVRequest();
+  }
+  //---------------------------------------------------------------------------
+  #else // !defined ( NV_RESTORE )
+  //---------------------------------------------------------------------------
+  (void)entry;
+  //---------------------------------------------------------------------------
+  #endif // defined ( NV_RESTORE )
+  //---------------------------------------------------------------------------
+}
+#endif // defined ( ZDSECMGR_COMMERCIAL )
+
+#if defined ( ZDSECMGR_COMMERCIAL )
+/******************************************************************************
+ * @fn          ZDSecMgrCtrlInit
+ *
+ * @brief       Initialize control sub module
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDSecMgrCtrlInit( void )
+{
+  //---------------------------------------------------------------------------
+  #if defined ( ZDO_COORDINATOR )
+  //---------------------------------------------------------------------------
+  uint16 size;
+  uint16 index;
+
+
+  // allocate entry data
+  size = (short)( sizeof(ZDSecMgrCtrl_t) * ZDSECMGR_CTRL_MAX );
+
+  ZDSecMgrCtrlData = osal_mem_alloc( size );
+
+  // initialize data
+  if ( ZDSecMgrCtrlData != NULL )
+  {
+    for( index = 0; index < ZDSECMGR_CTRL_MAX; index++ )
+    {
+      ZDSecMgrCtrlData[index].state = ZDSECMGR_CTRL_NONE;
+    }
+  }
+  //---------------------------------------------------------------------------
+  #endif // defined ( ZDO_COORDINATOR )
+  //---------------------------------------------------------------------------
+}
+#endif // defined ( ZDSECMGR_COMMERCIAL )
+
+#if defined ( ZDSECMGR_COMMERCIAL )
+#if defined ( ZDO_COORDINATOR )
+/******************************************************************************
+ * @fn          ZDSecMgrCtrlRelease
+ *
+ * @brief       Release control data.
+ *
+ * @param       ctrl - [in] valid control data
+ *
+ * @return      none
+ */
+void ZDSecMgrCtrlRelease( ZDSecMgrCtrl_t* ctrl )
+{
+  // should always be enough entry control data
+  ctrl->state = ZDSECMGR_CTRL_NONE;
+}
+#endif // defined ( ZDO_COORDINATOR )
+#endif // defined ( ZDSECMGR_COMMERCIAL )
+
+#if defined ( ZDSECMGR_COMMERCIAL )
+#if defined ( ZDO_COORDINATOR )
+/******************************************************************************
+ * @fn          ZDSecMgrCtrlLookup
+ *
+ * @brief       Lookup control data.
+ *
+ * @param       entry - [in] valid entry data
+ * @param       ctrl  - [out] control data - NULL if not found
+ *
+ * @return      none
+ */
+void ZDSecMgrCtrlLookup( ZDSecMgrEntry_t* entry, ZDSecMgrCtrl_t** ctrl )
+{
+  uint16 index;
+
+
+  // initialize search results
+  *ctrl = NULL;
+
+  // verify data is available
+  if ( ZDSecMgrCtrlData != NULL )
+  {
+    for ( index = 0; index < ZDSECMGR_CTRL_MAX; index++ )
+    {
+      // make sure control data is in use
+      if ( ZDSecMgrCtrlData[index].state != ZDSECMGR_CTRL_NONE )
+      {
+        // check for entry match
+        if ( ZDSecMgrCtrlData[index].entry == entry )
+        {
+          // return this control data
+          *ctrl = &ZDSecMgrCtrlData[index];
+
+          // break from loop
+          index = ZDSECMGR_CTRL_MAX;
+        }
+      }
+    }
+  }
+}
+#endif // defined ( ZDO_COORDINATOR )
+#endif // defined ( ZDSECMGR_COMMERCIAL )
+
+
+#if defined ( ZDSECMGR_COMMERCIAL )
+#if defined ( ZDO_COORDINATOR )
+/******************************************************************************
+ * @fn          ZDSecMgrCtrlSet
+ *
+ * @brief       Set control data.
+ *
+ * @param       device - [in] valid device data
+ * @param       entry  - [in] valid entry data
+ * @param       ctrl   - [in] valid control data
+ *
+ * @return      none
+ */
+void ZDSecMgrCtrlSet( ZDSecMgrDevice_t* device,
+                      ZDSecMgrEntry_t*  entry,
+                      ZDSecMgrCtrl_t*   ctrl )
+{
+  // set control date
+  ctrl->parentAddr = device->parentAddr;
   ctrl->secure     = device->secure;
   ctrl->entry      = entry;
   ctrl->state      = ZDSECMGR_CTRL_INIT;
@@ -1354,7 +1825,8 @@ void ZDSecMgrDeviceEntryRemove( ZDSecMgrEntry_t* entry )
  */
 void ZDSecMgrAddrMgrUpdate( uint16 ami, uint16 nwkAddr )
 {
-  AddrMgrEntry_t entry;
+  AddrMgrEntry_t   entry;
+  ZDSecMgrEntry_t* secEntry;
 
   // get the ami data
   entry.user  = ADDRMGR_USER_SECURITY;
@@ -1370,6 +1842,12 @@ void ZDSecMgrAddrMgrUpdate( uint16 ami, uint16 nwkAddr )
 
     AddrMgrEntryUpdate( &entry );
   }
+
+  // keep the NWK address index in step
+  if ( ZDSecMgrEntryLookupAMI( ami, &secEntry ) == ZSuccess )
+  {
+    ZDSecMgrEntryNwkSet( secEntry, nwkAddr );
+  }
 }
 
 ZStatus_t ZDSecMgrDeviceEntryAdd( ZDSecMgrDevice_t* device, uint16 ami )
@@ -1409,13 +1887,10 @@ ZStatus_t ZDSecMgrDeviceEntryAdd( ZDSecMgrDevice_t* device, uint16 ami )
   if ( entry == NULL )
   {
     // get new entry
-    if ( ZDSecMgrEntryNew( &entry ) == ZSuccess )
+    if ( ZDSecMgrEntryNew( ami, &entry ) == ZSuccess )
     {
       // reset entry lkd
 
-      // finish setting up entry
-      entry->ami = ami;
-
       // update NWK address
       ZDSecMgrAddrMgrUpdate( ami, device->nwkAddr );
 
@@ -1972,64 +2447,536 @@ ZStatus_t ZDSecMgrDeviceJoinFwd( ZDSecMgrDevice_t* device )
  *
  * @brief       Process a new device.
  *
- * @param       device - [in] ZDSecMgrDevice_t, device info
+ * @param       device - [in] ZDSecMgrDevice_t, device info
+ *
+ * @return      ZStatus_t
+ */
+ZStatus_t ZDSecMgrDeviceNew( ZDSecMgrDevice_t* joiner )
+{
+  ZStatus_t status;
+
+  //---------------------------------------------------------------------------
+  #if defined ( ZDO_COORDINATOR ) && !defined ( SOFT_START )
+  //---------------------------------------------------------------------------
+  // try to join this device
+  status = ZDSecMgrDeviceJoinDirect( joiner );
+  //---------------------------------------------------------------------------
+  #elif defined ( ZDO_COORDINATOR ) && defined ( SOFT_START )
+  //---------------------------------------------------------------------------
+  // which mode -- COORD or ROUTER
+  if ( ZDO_Config_Node_Descriptor.LogicalType == NODETYPE_COORDINATOR )
+  {
+    // try to join this device
+    status = ZDSecMgrDeviceJoinDirect( joiner );
+  }
+  else
+  {
+    // forward join to Trust Center
+    status = ZDSecMgrDeviceJoinFwd( joiner );
+  }
+  //---------------------------------------------------------------------------
+  #else // !ZDO_COORDINATOR
+  //---------------------------------------------------------------------------
+  // forward join to Trust Center
+  status = ZDSecMgrDeviceJoinFwd( joiner );
+  //---------------------------------------------------------------------------
+  #endif // !ZDO_COORDINATOR
+  //---------------------------------------------------------------------------
+
+  return status;
+}
+#endif // defined ( RTR_NWK )
+
+#if defined ( RTR_NWK )
+/******************************************************************************
+ * @fn          ZDSecMgrAssocDeviceAuth
+ *
+ * @brief       Set associated device status to authenticated
+ *
+ * @param       assoc - [in, out] associated_devices_t
+ *
+ * @return      none
+ */
+void ZDSecMgrAssocDeviceAuth( associated_devices_t* assoc )
+{
+  if ( assoc != NULL )
+  {
+    assoc->devStatus |= DEV_SEC_AUTH_STATUS;
+  }
+}
+#endif // defined ( RTR_NWK )
+
+#if defined ( RTR_NWK )
+/******************************************************************************
+ * @fn          ZDSecMgrAssocDeviceNew
+ *
+ * @brief       Process a new device from the associated device list.
+ *
+ * @param       assoc - [in, out] associated_devices_t, in security init state
+ *
+ * @return      ZStatus_t
+ */
+ZStatus_t ZDSecMgrAssocDeviceNew( associated_devices_t* assoc )
+{
+  ZDSecMgrDevice_t      device;
+  AddrMgrEntry_t        addrEntry;
+  ZStatus_t             status;
+
+  // check for preconfigured security
+  if ( zgPreConfigKeys == TRUE )
+  {
+    // set association status to authenticated
+    ZDSecMgrAssocDeviceAuth( assoc );
+  }
+
+  // set up device info
+  addrEntry.user  = ADDRMGR_USER_DEFAULT;
+  addrEntry.index = assoc->addrIdx;
+  AddrMgrEntryGet( &addrEntry );
+
+  device.nwkAddr    = assoc->shortAddr;
+  device.extAddr    = addrEntry.extAddr;
+  device.parentAddr = NLME_GetShortAddr();
+  device.secure     = FALSE;
+
+  // process new device
+  status = ZDSecMgrDeviceNew( &device );
+
+  if ( status == ZSuccess )
+  {
+    assoc->devStatus &= ~DEV_SEC_INIT_STATUS;
+  }
+  else if ( status == ZNwkUnknownDevice )
+  {
+    AssocRemove( addrEntry.extAddr );
+  }
+
+  return status;
+}
+#endif // defined ( RTR_NWK )
+
+#if defined ( ZDSECMGR_ADMIT )
+/******************************************************************************
+ * @fn          ZDSecMgrAdmitKnown
+ *
+ * @brief       Check whether a joiner is a known device, one with bindings
+ *              or security data kept in the Address Manager.
+ *
+ * @param       extAddr - [in] EXT address
+ *
+ * @return      uint8 - known(TRUE:FALSE)
+ */
+uint8 ZDSecMgrAdmitKnown( uint8* extAddr )
+{
+  AddrMgrEntry_t entry;
+  uint8          known;
+
+
+  AddrMgrExtAddrSet( entry.extAddr, extAddr );
+
+  // look for bindings to the device
+  entry.user = ADDRMGR_USER_BINDING;
+  known      = AddrMgrEntryLookupExt( &entry );
+
+  if ( known != TRUE )
+  {
+    // look for security data of the device
+    entry.user = ADDRMGR_USER_SECURITY;
+    known      = AddrMgrEntryLookupExt( &entry );
+  }
+
+  return known;
+}
+#endif // defined ( ZDSECMGR_ADMIT )
+
+#if defined ( ZDSECMGR_ADMIT )
+/******************************************************************************
+ * @fn          ZDSecMgrAdmitNext
+ *
+ * @brief       Find the next joiner to admit -- known devices first, then in
+ *              join order, skipping joiners still associating and those
+ *              that already failed this tick.
+ *
+ * @param       none
+ *
+ * @return      ZDSecMgrAdmit_t* - NULL if none is due
+ */
+ZDSecMgrAdmit_t* ZDSecMgrAdmitNext( void )
+{
+  ZDSecMgrAdmit_t* admit;
+  ZDSecMgrAdmit_t* next;
+  uint32           now;
+  uint8            index;
+
+
+  now  = osal_GetSystemClock();
+  next = NULL;
+
+  for ( index = 0; index < ZDSECMGR_ADMIT_MAX; index++ )
+  {
+    admit = &ZDSecMgrAdmitData[index];
+
+    if ( ( ( admit->flags & ( ZDSECMGR_ADMIT_USED | ZDSECMGR_ADMIT_SKIP ) ) ==
+           ZDSECMGR_ADMIT_USED                                         ) &&
+         ( ( now - admit->joined ) >= ZDSECMGR_ADMIT_DELAY              )    )
+    {
+      if ( ( next == NULL ) ||
+           ( ( admit->flags & ZDSECMGR_ADMIT_KNOWN ) >
+             ( next->flags  & ZDSECMGR_ADMIT_KNOWN )    ) ||
+           ( ( ( admit->flags & ZDSECMGR_ADMIT_KNOWN ) ==
+               ( next->flags  & ZDSECMGR_ADMIT_KNOWN )    ) &&
+             ( (int32)( admit->joined - next->joined ) < 0 )   ) )
+      {
+        next = admit;
+      }
+    }
+  }
+
+  return next;
+}
+#endif // defined ( ZDSECMGR_ADMIT )
+
+#if defined ( ZDSECMGR_ADMIT )
+/******************************************************************************
+ * @fn          ZDSecMgrAdmitLateReset
+ *
+ * @brief       Drop the join times kept for joiners left to the associated
+ *              device list.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDSecMgrAdmitLateReset( void )
+{
+  uint8 index;
+
+
+  for ( index = 0; index < ZDSECMGR_ADMIT_MAX; index++ )
+  {
+    ZDSecMgrAdmitLate[index].nwkAddr = INVALID_NODE_ADDR;
+  }
+}
+#endif // defined ( ZDSECMGR_ADMIT )
+
+#if defined ( ZDSECMGR_ADMIT )
+/******************************************************************************
+ * @fn          ZDSecMgrAdmitLateSet
+ *
+ * @brief       Keep the join time of a joiner left to the associated device
+ *              list. The time is lost when all records are in use.
+ *
+ * @param       nwkAddr - [in] NWK address of the joiner
+ * @param       joined  - [in] system clock(ms) at the join
+ *
+ * @return      none
+ */
+void ZDSecMgrAdmitLateSet( uint16 nwkAddr, uint32 joined )
+{
+  ZDSecMgrAdmitLate_t* late;
+  uint8                index;
+
+
+  late = NULL;
+
+  for ( index = 0; index < ZDSECMGR_ADMIT_MAX; index++ )
+  {
+    if ( ZDSecMgrAdmitLate[index].nwkAddr == nwkAddr )
+    {
+      // keep the first join time
+      return;  // EMBEDDED RETURN
+    }
+
+    if ( ( late == NULL                                          ) &&
+         ( ZDSecMgrAdmitLate[index].nwkAddr == INVALID_NODE_ADDR )    )
+    {
+      late = &ZDSecMgrAdmitLate[index];
+    }
+  }
+
+  if ( late != NULL )
+  {
+    late->nwkAddr = nwkAddr;
+    late->joined  = joined;
+  }
+}
+#endif // defined ( ZDSECMGR_ADMIT )
+
+#if defined ( ZDSECMGR_ADMIT )
+/******************************************************************************
+ * @fn          ZDSecMgrAdmitLateGet
+ *
+ * @brief       Take the join time kept for a joiner left to the associated
+ *              device list.
+ *
+ * @param       nwkAddr - [in] NWK address of the joiner
+ * @param       joined  - [out] system clock(ms) at the join
+ *
+ * @return      uint8 - join time found(TRUE:FALSE)
+ */
+uint8 ZDSecMgrAdmitLateGet( uint16 nwkAddr, uint32* joined )
+{
+  uint8 index;
+
+
+  for ( index = 0; index < ZDSECMGR_ADMIT_MAX; index++ )
+  {
+    if ( ( nwkAddr != INVALID_NODE_ADDR                 ) &&
+         ( ZDSecMgrAdmitLate[index].nwkAddr == nwkAddr )    )
+    {
+      *joined = ZDSecMgrAdmitLate[index].joined;
+      ZDSecMgrAdmitLate[index].nwkAddr = INVALID_NODE_ADDR;
+
+      return TRUE;  // EMBEDDED RETURN
+    }
+  }
+
+  return FALSE;
+}
+#endif // defined ( ZDSECMGR_ADMIT )
+
+#if defined ( ZDSECMGR_ADMIT )
+/******************************************************************************
+ * @fn          ZDSecMgrAdmitCount
+ *
+ * @brief       Add an admitted joiner to the join storm metrics.
+ *
+ * @param       joined - [in] system clock(ms) at the join, NULL if the join
+ *                       time was lost
+ * @param       known  - [in] known device(TRUE:FALSE)
+ *
+ * @return      none
+ */
+void ZDSecMgrAdmitCount( uint32* joined, uint8 known )
+{
+  uint32 now;
+  uint32 wait;
+
+
+  now = osal_GetSystemClock();
+
+  ZDSecMgrAdmitStats.admitted++;
+
+  if ( known == TRUE )
+  {
+    ZDSecMgrAdmitStats.known++;
+  }
+
+  if ( joined != NULL )
+  {
+    wait = now - *joined;
+
+    ZDSecMgrAdmitStats.timed++;
+    ZDSecMgrAdmitStats.waitSum += wait;
+
+    if ( wait > ZDSecMgrAdmitStats.waitMax )
+    {
+      ZDSecMgrAdmitStats.waitMax = wait;
+    }
+  }
+
+  ZDSecMgrAdmitStats.span = now - ZDSecMgrAdmitStart;
+}
+#endif // defined ( ZDSECMGR_ADMIT )
+
+#if defined ( ZDSECMGR_ADMIT )
+/******************************************************************************
+ * @fn          ZDSecMgrAdmitEvent
+ *
+ * @brief       Admit up to ZDSECMGR_ADMIT_BURST queued joiners.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDSecMgrAdmitEvent( void )
+{
+  ZDSecMgrAdmit_t*      admit;
+  associated_devices_t* assoc;
+  ZStatus_t             status;
+  uint8                 burst;
+  uint8                 index;
+
+
+  // joiners that failed on the last tick are due again
+  for ( index = 0; index < ZDSECMGR_ADMIT_MAX; index++ )
+  {
+    ZDSecMgrAdmitData[index].flags &= ~ZDSECMGR_ADMIT_SKIP;
+  }
+
+  for ( burst = 0; burst < ZDSECMGR_ADMIT_BURST; burst++ )
+  {
+    admit = ZDSecMgrAdmitNext();
+
+    if ( admit == NULL )
+    {
+      break;
+    }
+
+    //-------------------------------------------------------------------------
+    #if defined ( ZDSECMGR_COMMERCIAL ) && defined ( ZDO_COORDINATOR )
+    //-------------------------------------------------------------------------
+    // wait for a control slot instead of turning the joiner away
+    if ( ZDSecMgrCtrlFree() == FALSE )
+    {
+      break;
+    }
+    //-------------------------------------------------------------------------
+    #endif // defined ( ZDSECMGR_COMMERCIAL ) && defined ( ZDO_COORDINATOR )
+    //-------------------------------------------------------------------------
+
+    if ( admit->parentAddr == NLME_GetShortAddr() )
+    {
+      assoc = AssocGetWithExt( admit->extAddr );
+
+      if ( ( assoc != NULL                                ) &&
+           ( ( assoc->devStatus & DEV_SEC_INIT_STATUS ) != 0 )    )
+      {
+        status = ZDSecMgrAssocDeviceNew( assoc );
+      }
+      else
+      {
+        // left or already processed
+        status = ZNwkUnknownDevice;
+      }
+    }
+    //-------------------------------------------------------------------------
+    #if defined ( ZDO_COORDINATOR )
+    //-------------------------------------------------------------------------
+    else
+    {
+      ZDSecMgrDevice_t device;
+
+      device.nwkAddr    = admit->nwkAddr;
+      device.extAddr    = admit->extAddr;
+      device.parentAddr = admit->parentAddr;
+
+      if ( admit->flags & ZDSECMGR_ADMIT_SECURE )
+      {
+        device.secure = TRUE;
+      }
+      else
+      {
+        device.secure = FALSE;
+      }
+
+      // try to join this device
+      status = ZDSecMgrDeviceJoin( &device );
+    }
+    //-------------------------------------------------------------------------
+    #else // !defined ( ZDO_COORDINATOR )
+    //-------------------------------------------------------------------------
+    else
+    {
+      status = ZNwkUnknownDevice;
+    }
+    //-------------------------------------------------------------------------
+    #endif // !defined ( ZDO_COORDINATOR )
+    //-------------------------------------------------------------------------
+
+    if ( status == ZSuccess )
+    {
+      if ( admit->flags & ZDSECMGR_ADMIT_KNOWN )
+      {
+        ZDSecMgrAdmitCount( &admit->joined, TRUE );
+      }
+      else
+      {
+        ZDSecMgrAdmitCount( &admit->joined, FALSE );
+      }
+    }
+    else if ( status != ZNwkUnknownDevice )
+    {
+      if ( ++admit->tries < ZDSECMGR_ADMIT_TRIES )
+      {
+        // try again on the next tick, letting the joiners behind it go first
+        admit->flags |= ZDSECMGR_ADMIT_SKIP;
+        continue;
+      }
+
+      if ( admit->parentAddr == NLME_GetShortAddr() )
+      {
+        // left to the associated device list
+        ZDSecMgrAdmitLateSet( admit->nwkAddr, admit->joined );
+      }
+    }
+
+    // release the queue entry
+    admit->flags = ZDSECMGR_ADMIT_NONE;
+    ZDSecMgrAdmitCnt--;
+  }
+}
+#endif // defined ( ZDSECMGR_ADMIT )
+
+#if defined ( ZDSECMGR_ADMIT )
+/******************************************************************************
+ * @fn          ZDSecMgrAdmitEnd
+ *
+ * @brief       End of the join storm -- report the metrics.
+ *
+ * @param       none
  *
- * @return      ZStatus_t
+ * @return      none
  */
-ZStatus_t ZDSecMgrDeviceNew( ZDSecMgrDevice_t* joiner )
+void ZDSecMgrAdmitEnd( void )
 {
-  ZStatus_t status;
-
-  //---------------------------------------------------------------------------
-  #if defined ( ZDO_COORDINATOR ) && !defined ( SOFT_START )
-  //---------------------------------------------------------------------------
-  // try to join this device
-  status = ZDSecMgrDeviceJoinDirect( joiner );
-  //---------------------------------------------------------------------------
-  #elif defined ( ZDO_COORDINATOR ) && defined ( SOFT_START )
-  //---------------------------------------------------------------------------
-  // which mode -- COORD or ROUTER
-  if ( ZDO_Config_Node_Descriptor.LogicalType == NODETYPE_COORDINATOR )
-  {
-    // try to join this device
-    status = ZDSecMgrDeviceJoinDirect( joiner );
-  }
-  else
+  if ( ZDSecMgrAdmitStorm == TRUE )
   {
-    // forward join to Trust Center
-    status = ZDSecMgrDeviceJoinFwd( joiner );
-  }
-  //---------------------------------------------------------------------------
-  #else // !ZDO_COORDINATOR
-  //---------------------------------------------------------------------------
-  // forward join to Trust Center
-  status = ZDSecMgrDeviceJoinFwd( joiner );
-  //---------------------------------------------------------------------------
-  #endif // !ZDO_COORDINATOR
-  //---------------------------------------------------------------------------
+    ZDSecMgrAdmitStorm = FALSE;
 
-  return status;
+    // joiners that left before they were admitted
+    ZDSecMgrAdmitLateReset();
+
+    #if defined ( MT_ZDO_FUNC )
+    if ( _zdoCallbackSub & CB_ID_ZDO_ADMIT_STATS_RSP )
+    {
+      zdo_MTCB_AdmitStatsCB( &ZDSecMgrAdmitStats );
+    }
+    #endif // defined ( MT_ZDO_FUNC )
+  }
 }
-#endif // defined ( RTR_NWK )
+#endif // defined ( ZDSECMGR_ADMIT )
 
-#if defined ( RTR_NWK )
+#if defined ( ZDSECMGR_COMMERCIAL ) && defined ( ZDSECMGR_ADMIT )
+#if defined ( ZDO_COORDINATOR )
 /******************************************************************************
- * @fn          ZDSecMgrAssocDeviceAuth
+ * @fn          ZDSecMgrCtrlFree
  *
- * @brief       Set associated device status to authenticated
+ * @brief       Check for a free control slot.
  *
- * @param       assoc - [in, out] associated_devices_t
+ * @param       none
  *
- * @return      none
+ * @return      uint8 - free slot(TRUE:FALSE)
  */
-void ZDSecMgrAssocDeviceAuth( associated_devices_t* assoc )
+uint8 ZDSecMgrCtrlFree( void )
 {
-  if ( assoc != NULL )
+  uint8  found;
+  uint16 index;
+
+
+  // initialize results
+  found = FALSE;
+
+  // verify data is available
+  if ( ZDSecMgrCtrlData != NULL )
   {
-    assoc->devStatus |= DEV_SEC_AUTH_STATUS;
+    // look for an empty slot
+    for ( index = 0; index < ZDSECMGR_CTRL_MAX; index++ )
+    {
+      if ( ZDSecMgrCtrlData[index].state == ZDSECMGR_CTRL_NONE )
+      {
+        found = TRUE;
+
+        // break from loop
+        index = ZDSECMGR_CTRL_MAX;
+      }
+    }
   }
+
+  return found;
 }
-#endif // defined ( RTR_NWK )
+#endif // defined ( ZDO_COORDINATOR )
+#endif // defined ( ZDSECMGR_COMMERCIAL ) && defined ( ZDSECMGR_ADMIT )
 #endif // defined ( ZDSECMGR_SECURE )
 
 /******************************************************************************
@@ -2063,6 +3010,7 @@ void ZDSecMgrInit( void )
   #if defined ( ZDSECMGR_COMMERCIAL )
   //---------------------------------------------------------------------------
   // initialize sub modules
+  ZDSecMgrIndexInit();
   ZDSecMgrMasterKeyInit();
   ZDSecMgrEntryInit();
   ZDSecMgrCtrlInit();
@@ -2088,6 +3036,19 @@ void ZDSecMgrInit( void )
   #endif // defined ( ZDSECMGR_SECURE ) && defined ( ZDO_COORDINATOR )
   //---------------------------------------------------------------------------
 
+  //---------------------------------------------------------------------------
+  #if defined ( ZDSECMGR_ADMIT )
+  //---------------------------------------------------------------------------
+  // empty admission queue
+  osal_memset( ZDSecMgrAdmitData, 0, sizeof( ZDSecMgrAdmitData ) );
+  ZDSecMgrAdmitLateReset();
+  ZDSecMgrAdmitCnt   = 0;
+  ZDSecMgrAdmitStorm = FALSE;
+  ZDSecMgrAdmitStatsReset();
+  //---------------------------------------------------------------------------
+  #endif // defined ( ZDSECMGR_ADMIT )
+  //---------------------------------------------------------------------------
+
   // configure security based on security mode and type of device
   ZDSecMgrConfig();
 }
@@ -2287,50 +3248,61 @@ void ZDSecMgrPermitJoiningTimeout( void )
 uint8 ZDSecMgrNewDeviceEvent( void )
 {
   uint8                 found;
-  ZDSecMgrDevice_t      device;
-  AddrMgrEntry_t        addrEntry;
   associated_devices_t* assoc;
-  ZStatus_t             status;
-
-  // initialize return results
-  found = FALSE;
-
-  // look for device in the security init state
-  assoc = AssocMatchDeviceStatus( DEV_SEC_INIT_STATUS );
 
-  if ( assoc != NULL )
+  //---------------------------------------------------------------------------
+  #if defined ( ZDSECMGR_ADMIT )
+  //---------------------------------------------------------------------------
+  if ( ZDSecMgrAdmitCnt != 0 )
   {
-    // device found
-    found = TRUE;
+    // admit queued joiners first
+    ZDSecMgrAdmitEvent();
 
-    // check for preconfigured security
-    if ( zgPreConfigKeys == TRUE )
-    {
-      // set association status to authenticated
-      ZDSecMgrAssocDeviceAuth( assoc );
-    }
+    found = TRUE;
+  }
+  else
+  //---------------------------------------------------------------------------
+  #endif // defined ( ZDSECMGR_ADMIT )
+  //---------------------------------------------------------------------------
+  {
+    // initialize return results
+    found = FALSE;
 
-    // set up device info
-    addrEntry.user  = ADDRMGR_USER_DEFAULT;
-    addrEntry.index = assoc->addrIdx;
-    AddrMgrEntryGet( &addrEntry );
+    // look for device in the security init state
+    assoc = AssocMatchDeviceStatus( DEV_SEC_INIT_STATUS );
 
-    device.nwkAddr    = assoc->shortAddr;
-    device.extAddr    = addrEntry.extAddr;
-    device.parentAddr = NLME_GetShortAddr();
-    device.secure     = FALSE;
+    if ( assoc != NULL )
+    {
+      // device found
+      found = TRUE;
 
-    // process new device
-    status = ZDSecMgrDeviceNew( &device );
+      // process new device
+      #if defined ( ZDSECMGR_ADMIT )
+      if ( ( ZDSecMgrAssocDeviceNew( assoc ) == ZSuccess ) &&
+           ( ZDSecMgrAdmitStorm == TRUE                  )    )
+      {
+        uint32 joined;
 
-    if ( status == ZSuccess )
-    {
-      assoc->devStatus &= ~DEV_SEC_INIT_STATUS;
+        // joined while the queue was full or ran out of tries
+        if ( ZDSecMgrAdmitLateGet( assoc->shortAddr, &joined ) == TRUE )
+        {
+          ZDSecMgrAdmitCount( &joined, FALSE );
+        }
+        else
+        {
+          ZDSecMgrAdmitCount( NULL, FALSE );
+        }
+      }
+      #else
+      ZDSecMgrAssocDeviceNew( assoc );
+      #endif
     }
-    else if ( status == ZNwkUnknownDevice )
+    #if defined ( ZDSECMGR_ADMIT )
+    else
     {
-      AssocRemove( addrEntry.extAddr );
+      ZDSecMgrAdmitEnd();
     }
+    #endif
   }
 
   return found;
@@ -2367,7 +3339,7 @@ void ZDSecMgrEvent( void )
     restart = FALSE;
 
     // update all the counters
-    for ( index = 0; index < ZDSECMGR_ENTRY_MAX; index++ )
+    for ( index = 0; index < ZDSECMGR_CTRL_MAX; index++ )
     {
       if ( ZDSecMgrCtrlData[index].state !=  ZDSECMGR_CTRL_NONE )
       {
@@ -2607,8 +3579,16 @@ void ZDSecMgrUpdateDeviceInd( ZDO_UpdateDeviceInd_t* ind )
       device.secure = FALSE;
     }
 
+    #if defined ( ZDSECMGR_ADMIT )
+    // queue this device for admission
+    ZDSecMgrAdmitJoin( device.nwkAddr,
+                       device.extAddr,
+                       device.parentAddr,
+                       device.secure );
+    #else
     // try to join this device
     ZDSecMgrDeviceJoin( &device );
+    #endif
   }
 }
 #endif // defined ( ZDO_COORDINATOR )
@@ -2764,6 +3744,322 @@ ZStatus_t ZDSecMgrSwitchNwkKey( uint8 keySeqNum )
 #endif // defined ( ZDO_COORDINATOR )
 #endif // defined ( ZDSECMGR_SECURE )
 
+#if defined ( ZDSECMGR_COMMERCIAL ) && defined ( NV_RESTORE )
+/******************************************************************************
+ * @fn          ZDSecMgrInitNV
+ *
+ * @brief       Initialize the NV items of the LINK key entries and restore
+ *              the entries when the network state is restored. Entries keep
+ *              their slots, so each NV item maps to a fixed block of slots.
+ *
+ * @param       restore - [in] network state restored from NV(TRUE:FALSE)
+ *
+ * @return      none
+ */
+void ZDSecMgrInitNV( uint8 restore )
+{
+  uint16            block;
+  uint16            index;
+  uint16            slot;
+  ZDSecMgrEntry_t*  entry;
+  ZDSecMgrEntryNV_t nv;
+
+
+  // verify data is available
+  if ( ( ZDSecMgrEntries != NULL ) && ( ZDSecMgrIndex != NULL ) )
+  {
+    for ( block = 0; block < ZDSECMGR_NV_BLOCKS; block++ )
+    {
+      if ( ( osal_nv_item_init( ZCD_NV_SECMGR_ENTRIES + block,
+                                sizeof(ZDSecMgrEntryNV_t) * ZDSECMGR_NV_BLOCK,
+                                NULL ) == ZSUCCESS ) &&
+           ( restore == TRUE ) )
+      {
+        for ( index = 0; index < ZDSECMGR_NV_BLOCK; index++ )
+        {
+          slot  = ( block * ZDSECMGR_NV_BLOCK ) + index;
+          entry = &ZDSecMgrEntries[slot];
+
+          if ( ( slot < ZDSECMGR_ENTRY_MAX                            ) &&
+               ( entry->ami == INVALID_NODE_ADDR                      ) &&
+               ( osal_nv_read( ZCD_NV_SECMGR_ENTRIES + block,
+                               index * sizeof(ZDSecMgrEntryNV_t),
+                               sizeof(ZDSecMgrEntryNV_t),
+                               &nv ) == ZSUCCESS                      ) &&
+               ( nv.ami < NWK_MAX_ADDRESSES                           ) &&
+               ( ZDSecMgrIndex[nv.ami].entry == ZDSECMGR_SLOT_NONE    )    )
+          {
+            entry->ami = nv.ami;
+
+            osal_memcpy( entry->lkd.key, nv.key, SEC_KEY_LEN );
+
+            // skip past any frame counter used since the last save
+            entry->lkd.apsmelkd.txFrmCntr = nv.txFrmCntr +
+                                            ZDSECMGR_TX_CNTR_WINDOW;
+            entry->lkd.apsmelkd.rxFrmCntr = nv.rxFrmCntr;
+            entry->nvTxFrmCntr            = entry->lkd.apsmelkd.txFrmCntr;
+
+            ZDSecMgrEntryIndexAdd( entry );
+          }
+        }
+      }
+
+      // rewrite every block at the next NV update -- saves the advanced
+      // frame counters or clears entries of a previous network
+      ZDSecMgrEntryNVDirty |= (uint32)1 << block;
+    }
+
+    // rebuild the free list around the restored entries
+    ZDSecMgrEntryFreeList = ZDSECMGR_SLOT_NONE;
+
+    slot = ZDSECMGR_ENTRY_MAX;
+
+    while ( slot-- > 0 )
+    {
+      if ( ZDSecMgrEntries[slot].ami == INVALID_NODE_ADDR )
+      {
+        ZDSecMgrEntries[slot].extNext = ZDSecMgrEntryFreeList;
+        ZDSecMgrEntryFreeList         = (ZDSecMgrSlot_t)slot;
+      }
+    }
+
+    if ( restore == TRUE )
+    {
+      // save the advanced frame counters now -- a second reset before the
+      // next NV update would restore the same counters again
+      AddrMgrWriteNVRequest();
+    }
+  }
+}
+#endif // defined ( ZDSECMGR_COMMERCIAL ) && defined ( NV_RESTORE )
+
+#if defined ( ZDSECMGR_COMMERCIAL ) && defined ( NV_RESTORE )
+/******************************************************************************
+ * @fn          ZDSecMgrWriteNV
+ *
+ * @brief       Save the LINK key entries changed since the last NV update.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDSecMgrWriteNV( void )
+{
+  uint16             block;
+  uint16             index;
+  uint16             slot;
+  ZDSecMgrEntry_t*   entry;
+  ZDSecMgrEntryNV_t* nv;
+
+
+  // verify data is available
+  if ( ( ZDSecMgrEntries != NULL ) && ( ZDSecMgrEntryNVDirty != 0 ) )
+  {
+    nv = osal_mem_alloc( sizeof(ZDSecMgrEntryNV_t) * ZDSECMGR_NV_BLOCK );
+
+    if ( nv != NULL )
+    {
+      for ( block = 0; block < ZDSECMGR_NV_BLOCKS; block++ )
+      {
+        if ( ZDSecMgrEntryNVDirty & ( (uint32)1 << block ) )
+        {
+          osal_memset( nv, 0, sizeof(ZDSecMgrEntryNV_t) * ZDSECMGR_NV_BLOCK );
+
+          for ( index = 0; index < ZDSECMGR_NV_BLOCK; index++ )
+          {
+            slot  = ( block * ZDSECMGR_NV_BLOCK ) + index;
+            entry = &ZDSecMgrEntries[slot];
+
+            nv[index].ami = INVALID_NODE_ADDR;
+
+            if ( ( slot < ZDSECMGR_ENTRY_MAX           ) &&
+                 ( entry->ami != INVALID_NODE_ADDR )    )
+            {
+              nv[index].ami       = entry->ami;
+              nv[index].txFrmCntr = entry->lkd.apsmelkd.txFrmCntr;
+              nv[index].rxFrmCntr = entry->lkd.apsmelkd.rxFrmCntr;
+
+              osal_memcpy( nv[index].key, entry->lkd.key, SEC_KEY_LEN );
+
+              entry->nvTxFrmCntr = nv[index].txFrmCntr;
+            }
+          }
+
+          if ( osal_nv_write( ZCD_NV_SECMGR_ENTRIES + block, 0,
+                              sizeof(ZDSecMgrEntryNV_t) * ZDSECMGR_NV_BLOCK,
+                              nv ) == ZSUCCESS )
+          {
+            ZDSecMgrEntryNVDirty &= ~( (uint32)1 << block );
+          }
+        }
+      }
+
+      osal_mem_free( nv );
+    }
+  }
+}
+#endif // defined ( ZDSECMGR_COMMERCIAL ) && defined ( NV_RESTORE )
+
+#if defined ( ZDSECMGR_ADMIT )
+/******************************************************************************
+ * @fn          ZDSecMgrAdmitJoin
+ *
+ * @brief       Queue a joiner for admission. Known devices are admitted
+ *              first, then joiners in the order they joined.
+ *
+ * @param       nwkAddr    - [in] NWK address of the joiner
+ * @param       extAddr    - [in] EXT address of the joiner
+ * @param       parentAddr - [in] NWK address of the joiner's parent
+ * @param       secure     - [in] joined with a preconfigured key(TRUE:FALSE)
+ *
+ * @return      none
+ */
+void ZDSecMgrAdmitJoin( uint16 nwkAddr,
+                        uint8* extAddr,
+                        uint16 parentAddr,
+                        uint8  secure )
+{
+  ZDSecMgrAdmit_t* admit;
+  ZDSecMgrAdmit_t* free;
+  uint8            index;
+
+
+  admit = NULL;
+  free  = NULL;
+
+  // a joiner already queued keeps its place
+  for ( index = 0; index < ZDSECMGR_ADMIT_MAX; index++ )
+  {
+    if ( ZDSecMgrAdmitData[index].flags & ZDSECMGR_ADMIT_USED )
+    {
+      if ( AddrMgrExtAddrEqual( ZDSecMgrAdmitData[index].extAddr, extAddr ) )
+      {
+        admit = &ZDSecMgrAdmitData[index];
+      }
+    }
+    else if ( free == NULL )
+    {
+      free = &ZDSecMgrAdmitData[index];
+    }
+  }
+
+  // first joiner of a storm
+  if ( ZDSecMgrAdmitStorm == FALSE )
+  {
+    ZDSecMgrAdmitStorm = TRUE;
+    ZDSecMgrAdmitStart = osal_GetSystemClock();
+  }
+
+  if ( ( admit == NULL ) && ( free != NULL ) )
+  {
+    admit = free;
+
+    AddrMgrExtAddrSet( admit->extAddr, extAddr );
+    admit->flags  = ZDSECMGR_ADMIT_USED;
+    admit->tries  = 0;
+    admit->joined = osal_GetSystemClock();
+
+    if ( ZDSecMgrAdmitKnown( extAddr ) == TRUE )
+    {
+      admit->flags |= ZDSECMGR_ADMIT_KNOWN;
+    }
+
+    ZDSecMgrAdmitStats.joins++;
+
+    if ( ++ZDSecMgrAdmitCnt > ZDSecMgrAdmitStats.peak )
+    {
+      ZDSecMgrAdmitStats.peak = ZDSecMgrAdmitCnt;
+    }
+  }
+
+  if ( admit != NULL )
+  {
+    admit->nwkAddr    = nwkAddr;
+    admit->parentAddr = parentAddr;
+
+    if ( secure == TRUE )
+    {
+      admit->flags |= ZDSECMGR_ADMIT_SECURE;
+    }
+    else
+    {
+      admit->flags &= ~ZDSECMGR_ADMIT_SECURE;
+    }
+  }
+  else
+  {
+    ZDSecMgrAdmitStats.overflow++;
+
+    if ( parentAddr == NLME_GetShortAddr() )
+    {
+      ZDSecMgrAdmitLateSet( nwkAddr, osal_GetSystemClock() );
+    }
+
+    //-------------------------------------------------------------------------
+    #if defined ( ZDO_COORDINATOR )
+    //-------------------------------------------------------------------------
+    // a direct joiner is picked up from the associated device list later, a
+    // forwarded joiner is handled at once
+    if ( parentAddr != NLME_GetShortAddr() )
+    {
+      ZDSecMgrDevice_t device;
+
+      device.nwkAddr    = nwkAddr;
+      device.extAddr    = extAddr;
+      device.parentAddr = parentAddr;
+      device.secure     = secure;
+
+      // try to join this device
+      ZDSecMgrDeviceJoin( &device );
+    }
+    //-------------------------------------------------------------------------
+    #endif // defined ( ZDO_COORDINATOR )
+    //-------------------------------------------------------------------------
+  }
+
+  // start the admission ticks, without pushing back a tick already due
+  if ( osal_get_timeoutEx( ZDAppTaskID, ZDO_NEW_DEVICE ) == 0 )
+  {
+    osal_start_timerEx( ZDAppTaskID, ZDO_NEW_DEVICE, ZDSECMGR_ADMIT_INTERVAL );
+  }
+}
+#endif // defined ( ZDSECMGR_ADMIT )
+
+#if defined ( ZDSECMGR_ADMIT )
+/******************************************************************************
+ * @fn          ZDSecMgrAdmitStatsGet
+ *
+ * @brief       Get the join storm metrics.
+ *
+ * @param       none
+ *
+ * @return      ZDSecMgrAdmitStats_t* - metrics since the last reset
+ */
+ZDSecMgrAdmitStats_t* ZDSecMgrAdmitStatsGet( void )
+{
+  return &ZDSecMgrAdmitStats;
+}
+#endif // defined ( ZDSECMGR_ADMIT )
+
+#if defined ( ZDSECMGR_ADMIT )
+/******************************************************************************
+ * @fn          ZDSecMgrAdmitStatsReset
+ *
+ * @brief       Reset the join storm metrics.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDSecMgrAdmitStatsReset( void )
+{
+  osal_memset( &ZDSecMgrAdmitStats, 0, sizeof( ZDSecMgrAdmitStats_t ) );
+
+  // a storm in progress is measured from now on
+  ZDSecMgrAdmitStart = osal_GetSystemClock();
+}
+#endif // defined ( ZDSECMGR_ADMIT )
+
 /******************************************************************************
  * ZigBee Device Security Manager - Stub Implementations
  */
@@ -2842,6 +4138,12 @@ ZStatus_t ZDSecMgrLinkKeySet( uint8* extAddr, uint8* key )
 
       entry->lkd.apsmelkd.rxFrmCntr = 0;
       entry->lkd.apsmelkd.txFrmCntr = 0;
+
+      #if defined ( NV_RESTORE )
+      entry->nvTxFrmCntr = 0;
+      #endif
+
+      ZDSecMgrEntryNVMark( entry );
     }
 
     return status;
@@ -2885,6 +4187,15 @@ ZStatus_t ZDSecMgrLinkKeyDataGet(uint16 nwkAddr, APSME_LinkKeyData_t** data)
       // setup the link key data reference
       (*data) = &entry->lkd.apsmelkd;
       (*data)->key = entry->lkd.key;
+
+      #if defined ( NV_RESTORE )
+      // save the frame counter well before it passes the restore window
+      if ( ( entry->lkd.apsmelkd.txFrmCntr - entry->nvTxFrmCntr ) >=
+           ( ZDSECMGR_TX_CNTR_WINDOW / 2 ) )
+      {
+        ZDSecMgrEntryNVMark( entry );
+      }
+      #endif
     }
     else
     {
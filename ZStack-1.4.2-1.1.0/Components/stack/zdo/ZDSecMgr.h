@@ -42,6 +42,60 @@ extern "C"
   #endif
 #endif // ( SECURE != 0 ) && defined ( SECURITY_MODE )
 
+// Join admission queue -- only used by secure routers and coordinators
+#if defined ( ZDSECMGR_ADMIT )
+  #if !defined ( ZDSECMGR_SECURE ) || !defined ( RTR_NWK )
+    #undef ZDSECMGR_ADMIT
+  #endif
+#endif // defined ( ZDSECMGR_ADMIT )
+
+#if defined ( ZDSECMGR_ADMIT )
+// joiners held in the admission queue -- further joiners are picked up from
+// the associated device list once the queue empties
+#if !defined ( ZDSECMGR_ADMIT_MAX )
+  #define ZDSECMGR_ADMIT_MAX 8
+#endif
+
+// joiners admitted per admission tick
+#if !defined ( ZDSECMGR_ADMIT_BURST )
+  #define ZDSECMGR_ADMIT_BURST 2
+#endif
+
+// admission tick(ms)
+#if !defined ( ZDSECMGR_ADMIT_INTERVAL )
+  #define ZDSECMGR_ADMIT_INTERVAL 250
+#endif
+
+// time(ms) a joiner is given to finish associating before it is admitted
+#if !defined ( ZDSECMGR_ADMIT_DELAY )
+  #define ZDSECMGR_ADMIT_DELAY 600
+#endif
+
+// admission attempts before a joiner is left to the associated device list
+#if !defined ( ZDSECMGR_ADMIT_TRIES )
+  #define ZDSECMGR_ADMIT_TRIES 4
+#endif
+#endif // defined ( ZDSECMGR_ADMIT )
+
+/******************************************************************************
+ * TYPEDEFS
+ */
+#if defined ( ZDSECMGR_ADMIT )
+// join storm metrics -- times in ms
+typedef struct
+{
+  uint16 joins;     // joiners queued
+  uint16 admitted;  // joiners admitted
+  uint16 timed;     // admitted joiners whose join time was kept
+  uint16 known;     // admitted joiners that were known devices
+  uint16 overflow;  // joiners that found the queue full
+  uint8  peak;      // most joiners queued at once
+  uint32 waitSum;   // join to admission, summed over the timed joiners
+  uint32 waitMax;   // longest join to admission
+  uint32 span;      // first join to last admission of the storm
+} ZDSecMgrAdmitStats_t;
+#endif // defined ( ZDSECMGR_ADMIT )
+
 /******************************************************************************
  * PUBLIC FUNCTIONS
  */
@@ -214,6 +268,73 @@ extern ZStatus_t ZDSecMgrUpdateNwkKey( uint8* key, uint8 keySeqNum );
  */
 extern ZStatus_t ZDSecMgrSwitchNwkKey( uint8 keySeqNum );
 
+#if defined ( ZDSECMGR_COMMERCIAL ) && defined ( NV_RESTORE )
+/******************************************************************************
+ * @fn          ZDSecMgrInitNV
+ *
+ * @brief       Initialize the NV items of the LINK key entries and restore
+ *              the entries when the network state is restored.
+ *
+ * @param       restore - [in] network state restored from NV(TRUE:FALSE)
+ *
+ * @return      none
+ */
+extern void ZDSecMgrInitNV( uint8 restore );
+
+/******************************************************************************
+ * @fn          ZDSecMgrWriteNV
+ *
+ * @brief       Save the LINK key entries changed since the last NV update.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+extern void ZDSecMgrWriteNV( void );
+#endif // defined ( ZDSECMGR_COMMERCIAL ) && defined ( NV_RESTORE )
+
+#if defined ( ZDSECMGR_ADMIT )
+/******************************************************************************
+ * @fn          ZDSecMgrAdmitJoin
+ *
+ * @brief       Queue a joiner for admission. Known devices are admitted
+ *              first, then joiners in the order they joined.
+ *
+ * @param       nwkAddr    - [in] NWK address of the joiner
+ * @param       extAddr    - [in] EXT address of the joiner
+ * @param       parentAddr - [in] NWK address of the joiner's parent
+ * @param       secure     - [in] joined with a preconfigured key(TRUE:FALSE)
+ *
+ * @return      none
+ */
+extern void ZDSecMgrAdmitJoin( uint16 nwkAddr,
+                               uint8* extAddr,
+                               uint16 parentAddr,
+                               uint8  secure );
+
+/******************************************************************************
+ * @fn          ZDSecMgrAdmitStatsGet
+ *
+ * @brief       Get the join storm metrics.
+ *
+ * @param       none
+ *
+ * @return      ZDSecMgrAdmitStats_t* - metrics since the last reset
+ */
+extern ZDSecMgrAdmitStats_t* ZDSecMgrAdmitStatsGet( void );
+
+/******************************************************************************
+ * @fn          ZDSecMgrAdmitStatsReset
+ *
+ * @brief       Reset the join storm metrics.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+extern void ZDSecMgrAdmitStatsReset( void );
+#endif // defined ( ZDSECMGR_ADMIT )
+
 /******************************************************************************
 ******************************************************************************/
 
@@ -0,0 +1,725 @@
+/*********************************************************************
+    Filename:       ZDTopology.c
+    Revised:        $Date: 2007-06-14 09:45:00 -0700 (Thu, 14 Jun 2007) $
+    Revision:       $Revision: 14612 $
+
+    Description: Implementation of the ZDO Topology Crawler functionality.
+
+    Notes:
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+#if defined( ZDO_TOPOLOGY )
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "ZComDef.h"
+#include "OSAL.h"
+#include "NLMEDE.h"
+#include "AssocList.h"
+#include "rtg.h"
+#include "ZDConfig.h"
+#include "ZDProfile.h"
+#include "ZDApp.h"
+#include "ZDTopology.h"
+
+#if defined( MT_ZDO_FUNC )
+  #include "MT_ZDO.h"
+#endif
+
+/*********************************************************************
+ * MACROS
+ */
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Timer ticks a request waits for its response.
+#define TOPO_RSP_TICKS      ( TOPO_RSP_TIMEOUT / TOPO_TX_INTERVAL )
+
+// Timer ticks between probes of a crawled router.
+#define TOPO_REFRESH_TICKS  ( TOPO_REFRESH / TOPO_TX_INTERVAL )
+
+#if ( TOPO_RSP_TICKS == 0 ) || ( TOPO_RSP_TICKS > 255 )
+  #error "TOPO_RSP_TIMEOUT must be 1 to 255 times TOPO_TX_INTERVAL"
+#endif
+
+#if ( TOPO_REFRESH_TICKS == 0 ) || ( TOPO_REFRESH_TICKS > 65535 )
+  #error "TOPO_REFRESH must be 1 to 65535 times TOPO_TX_INTERVAL"
+#endif
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+/*********************************************************************
+ * GLOBAL VARIABLES
+ */
+
+/*********************************************************************
+ * EXTERNAL VARIABLES
+ */
+
+/*********************************************************************
+ * EXTERNAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static topoNode_t topoNodes[TOPO_NODE_MAX];
+static topoLink_t topoLinks[TOPO_LINK_MAX];
+static byte topoNodeCnt;  // Entries used in topoNodes
+static byte topoPending;  // Requests in flight
+static byte topoCursor;   // topoNodes index the next request search starts at
+static byte topoActive;
+static uint16 topoTickDue;  // Clock (ms) of the next tick, the timer is shared
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+static topoNode_t *topoFindNode( uint16 nwkAddr );
+static void topoAddNode( uint16 nwkAddr );
+static topoLink_t *topoFindLink( uint16 srcAddr, uint16 dstAddr, byte add );
+static void topoSend( topoNode_t *pNode );
+static void topoSetState( topoNode_t *pNode, byte state );
+static void topoCrawl( topoNode_t *pNode, byte state );
+static void topoFinish( topoNode_t *pNode, byte state );
+static void topoChanged( topoNode_t *pNode, byte change, topoLink_t *pLink );
+
+/*********************************************************************
+ * @fn          topoFindNode
+ *
+ * @brief       Find the crawler entry of a router.
+ *
+ * @param       nwkAddr - Network address of the router.
+ *
+ * @return      Pointer to the entry, NULL if not found.
+ */
+static topoNode_t *topoFindNode( uint16 nwkAddr )
+{
+  topoNode_t *pNode = topoNodes;
+  byte cnt;
+
+  for ( cnt = topoNodeCnt; cnt != 0; cnt--, pNode++ )
+  {
+    if ( pNode->nwkAddr == nwkAddr )
+    {
+      return pNode;  // EMBEDDED RETURN
+    }
+  }
+
+  return NULL;
+}
+
+/*********************************************************************
+ * @fn          topoAddNode
+ *
+ * @brief       Add a router to be crawled, if it is new and there is
+ *              room. New routers are taken after those already known,
+ *              which makes the crawl breadth-first.
+ *
+ * @param       nwkAddr - Network address of the router.
+ *
+ * @return      none
+ */
+static void topoAddNode( uint16 nwkAddr )
+{
+  topoNode_t *pNode;
+
+  if ( (nwkAddr == NLME_GetShortAddr()) || (topoNodeCnt == TOPO_NODE_MAX) ||
+       topoFindNode( nwkAddr ) )
+  {
+    return;  // EMBEDDED RETURN
+  }
+
+  pNode = &topoNodes[topoNodeCnt++];
+  osal_memset( pNode, 0, sizeof( topoNode_t ) );
+  pNode->nwkAddr = nwkAddr;
+  pNode->state = TOPO_STATE_LQI;
+}
+
+/*********************************************************************
+ * @fn          topoFindLink
+ *
+ * @brief       Find a link in the graph, optionally adding it.
+ *
+ * @param       srcAddr - Router reporting the link.
+ * @param       dstAddr - Neighbor.
+ * @param       add - TRUE to add the link if not found.
+ *
+ * @return      Pointer to the link, NULL if not found or no room.
+ */
+static topoLink_t *topoFindLink( uint16 srcAddr, uint16 dstAddr, byte add )
+{
+  topoLink_t *pLink = topoLinks;
+  topoLink_t *pFree = NULL;
+  byte cnt;
+
+  for ( cnt = TOPO_LINK_MAX; cnt != 0; cnt--, pLink++ )
+  {
+    if ( pLink->srcAddr == srcAddr )
+    {
+      if ( pLink->dstAddr == dstAddr )
+      {
+        return pLink;  // EMBEDDED RETURN
+      }
+    }
+    else if ( (pLink->srcAddr == INVALID_NODE_ADDR) && (pFree == NULL) )
+    {
+      pFree = pLink;
+    }
+  }
+
+  if ( add && pFree )
+  {
+    pFree->srcAddr = srcAddr;
+    pFree->dstAddr = dstAddr;
+    pFree->lqi = 0;
+    pFree->flags = 0;
+  }
+  else
+  {
+    pFree = NULL;
+  }
+
+  return pFree;
+}
+
+/*********************************************************************
+ * @fn          topoSend
+ *
+ * @brief       Send the table request for the current state of a
+ *              router. A request that cannot be sent is retried on
+ *              timeout like one that is lost over the air.
+ *
+ * @param       pNode - Crawler entry.
+ *
+ * @return      none
+ */
+static void topoSend( topoNode_t *pNode )
+{
+  zAddrType_t dstAddr;
+
+  dstAddr.addrMode = Addr16Bit;
+  dstAddr.addr.shortAddr = pNode->nwkAddr;
+
+  if ( pNode->state == TOPO_STATE_RTG )
+  {
+    (void)ZDP_MgmtRtgReq( &dstAddr, pNode->startIdx, 0 );
+  }
+  else
+  {
+    (void)ZDP_MgmtLqiReq( &dstAddr, pNode->startIdx, 0 );
+  }
+
+  pNode->state |= TOPO_STATE_PENDING;
+  pNode->ticks = TOPO_RSP_TICKS;
+  pNode->tries++;
+  topoPending++;
+}
+
+/*********************************************************************
+ * @fn          topoSetState
+ *
+ * @brief       Move a router to its next state after a response or a
+ *              final timeout.
+ *
+ * @param       pNode - Crawler entry.
+ * @param       state - New TOPO_STATE_ value.
+ *
+ * @return      none
+ */
+static void topoSetState( topoNode_t *pNode, byte state )
+{
+  if ( pNode->state & TOPO_STATE_PENDING )
+  {
+    topoPending--;
+  }
+
+  pNode->state = state;
+  pNode->tries = 0;
+}
+
+/*********************************************************************
+ * @fn          topoCrawl
+ *
+ * @brief       Start a probe or a full crawl of a router. Its links are
+ *              marked unseen so that the crawl can find those removed.
+ *
+ * @param       pNode - Crawler entry.
+ * @param       state - TOPO_STATE_PROBE or TOPO_STATE_LQI.
+ *
+ * @return      none
+ */
+static void topoCrawl( topoNode_t *pNode, byte state )
+{
+  topoLink_t *pLink = topoLinks;
+  byte cnt;
+
+  for ( cnt = TOPO_LINK_MAX; cnt != 0; cnt--, pLink++ )
+  {
+    if ( pLink->srcAddr == pNode->nwkAddr )
+    {
+      pLink->flags &= ~(TOPO_LINK_SEEN | TOPO_LINK_ROUTE_SEEN);
+    }
+  }
+
+  topoSetState( pNode, state );
+  pNode->startIdx = 0;
+  pNode->changed = FALSE;
+}
+
+/*********************************************************************
+ * @fn          topoFinish
+ *
+ * @brief       End the crawl of a router: remove the links it no longer
+ *              reports and update the route flags of the rest.
+ *
+ * @param       pNode - Crawler entry.
+ * @param       state - TOPO_STATE_IDLE or TOPO_STATE_FAILED.
+ *
+ * @return      none
+ */
+static void topoFinish( topoNode_t *pNode, byte state )
+{
+  topoLink_t *pLink = topoLinks;
+  byte cnt;
+  byte route;
+
+  for ( cnt = TOPO_LINK_MAX; cnt != 0; cnt--, pLink++ )
+  {
+    if ( pLink->srcAddr != pNode->nwkAddr )
+    {
+      continue;
+    }
+
+    if ( !(pLink->flags & TOPO_LINK_SEEN) )
+    {
+      topoChanged( pNode, TOPO_LINK_REMOVED, pLink );
+      pLink->srcAddr = INVALID_NODE_ADDR;
+    }
+    else
+    {
+      route = (pLink->flags & TOPO_LINK_ROUTE_SEEN) ? TOPO_LINK_ROUTE : 0;
+
+      if ( route != (pLink->flags & TOPO_LINK_ROUTE) )
+      {
+        pLink->flags ^= TOPO_LINK_ROUTE;
+        topoChanged( pNode, TOPO_LINK_CHANGED, pLink );
+      }
+    }
+  }
+
+  topoSetState( pNode, state );
+  pNode->refresh = TOPO_REFRESH_TICKS;
+}
+
+/*********************************************************************
+ * @fn          topoChanged
+ *
+ * @brief       Stream a link change to the host. The router at the far
+ *              end of the link is probed at once, since its own table
+ *              has likely changed as well.
+ *
+ * @param       pNode - Crawler entry of the reporting router.
+ * @param       change - TOPO_LINK_ADDED, _REMOVED or _CHANGED.
+ * @param       pLink - The link.
+ *
+ * @return      none
+ */
+static void topoChanged( topoNode_t *pNode, byte change, topoLink_t *pLink )
+{
+  topoNode_t *pFar = topoFindNode( pLink->dstAddr );
+
+  pNode->changed = TRUE;
+
+  if ( pFar && (pFar->state >= TOPO_STATE_IDLE) )
+  {
+    pFar->refresh = 1;
+  }
+
+#if defined( MT_ZDO_FUNC )
+  if ( _zdoCallbackSub & CB_ID_ZDO_TOPOLOGY_RSP )
+  {
+    zdo_MTCB_TopologyRspCB( change, pLink );
+  }
+#else
+  (void)change;
+#endif
+}
+
+/*********************************************************************
+ * @fn          ZDTopologyInit
+ *
+ * @brief       Initialize the ZDO Topology Crawler.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDTopologyInit( void )
+{
+  byte idx;
+
+  for ( idx = 0; idx < TOPO_LINK_MAX; idx++ )
+  {
+    topoLinks[idx].srcAddr = INVALID_NODE_ADDR;
+  }
+
+  topoNodeCnt = 0;
+  topoPending = 0;
+  topoCursor = 0;
+  topoActive = FALSE;
+}
+
+/*********************************************************************
+ * @fn          ZDTopologyStart
+ *
+ * @brief       Start crawling from the local device's router children.
+ *              The graph is cleared; every link found is streamed to
+ *              the host as added.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDTopologyStart( void )
+{
+  ZDTopologyInit();
+  topoActive = TRUE;
+
+#if defined( RTR_NWK )
+  {
+    byte cnt;
+    uint16 *pList = AssocMakeList( &cnt );
+
+    if ( pList )
+    {
+      associated_devices_t *pAssoc;
+      byte idx;
+
+      for ( idx = 0; idx < cnt; idx++ )
+      {
+        pAssoc = AssocGetWithShort( pList[idx] );
+
+        if ( pAssoc && ((pAssoc->nodeRelation == CHILD_FFD) ||
+                        (pAssoc->nodeRelation == CHILD_FFD_RX_IDLE)) )
+        {
+          topoAddNode( pList[idx] );
+        }
+      }
+      osal_mem_free( pList );
+    }
+  }
+#endif
+
+  topoTickDue = (uint16)osal_GetSystemClock();
+  osal_set_event( ZDAppTaskID, ZDO_SERVICE_TIMER );
+}
+
+/*********************************************************************
+ * @fn          ZDTopologyStop
+ *
+ * @brief       Stop crawling. The graph is kept for ZDTopologyGetLink.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDTopologyStop( void )
+{
+  topoActive = FALSE;
+}
+
+/*********************************************************************
+ * @fn          ZDTopologyTimerEvent
+ *
+ * @brief       Crawler tick, every TOPO_TX_INTERVAL while crawling.
+ *              ZDO_SERVICE_TIMER is shared, so early calls only re-arm
+ *              the timer for the rest of the interval.
+ *              Times out requests in flight, starts the probes that are
+ *              due and sends at most one new request, taking routers in
+ *              turn so that a slow router does not hold up the others.
+ *
+ * @param       none
+ *
+ * @return      none
+ */
+void ZDTopologyTimerEvent( void )
+{
+  topoNode_t *pNode;
+  uint16 now;
+  int16 left;
+  byte idx;
+
+  if ( !topoActive )
+  {
+    return;  // EMBEDDED RETURN
+  }
+
+  now = (uint16)osal_GetSystemClock();
+  left = (int16)(topoTickDue - now);
+  if ( left > 0 )
+  {
+    ZDApp_ServiceTimer( (uint16)left );
+    return;  // EMBEDDED RETURN
+  }
+  topoTickDue = now + TOPO_TX_INTERVAL;
+
+  for ( pNode = topoNodes, idx = topoNodeCnt; idx != 0; idx--, pNode++ )
+  {
+    if ( pNode->state & TOPO_STATE_PENDING )
+    {
+      if ( --pNode->ticks == 0 )
+      {
+        pNode->state &= TOPO_STATE_MASK;
+        topoPending--;
+
+        if ( pNode->tries >= TOPO_MAX_TRIES )
+        {
+          // All of its links are unseen, so they are removed.
+          topoFinish( pNode, TOPO_STATE_FAILED );
+        }
+      }
+    }
+    else if ( (pNode->state >= TOPO_STATE_IDLE) && (--pNode->refresh == 0) )
+    {
+      // A failed router is crawled in full when it is back.
+      topoCrawl( pNode, (pNode->state == TOPO_STATE_IDLE) ? TOPO_STATE_PROBE
+                                                           : TOPO_STATE_LQI );
+    }
+  }
+
+  if ( topoPending < TOPO_MAX_PENDING )
+  {
+    for ( idx = 0; idx < topoNodeCnt; idx++ )
+    {
+      if ( topoCursor >= topoNodeCnt )
+      {
+        topoCursor = 0;
+      }
+      pNode = &topoNodes[topoCursor++];
+
+      if ( pNode->state < TOPO_STATE_IDLE )
+      {
+        topoSend( pNode );
+        break;
+      }
+    }
+  }
+
+  ZDApp_ServiceTimer( TOPO_TX_INTERVAL );
+}
+
+/*********************************************************************
+ * @fn          ZDTopologyGetLink
+ *
+ * @brief       Read the graph, one link table slot at a time.
+ *
+ * @param       idx - Slot, 0 to TOPO_LINK_MAX - 1.
+ *
+ * @return      Pointer to the link, NULL if the slot is free or past
+ *              the end of the table.
+ */
+topoLink_t *ZDTopologyGetLink( byte idx )
+{
+  if ( (idx >= TOPO_LINK_MAX) || (topoLinks[idx].srcAddr == INVALID_NODE_ADDR) )
+  {
+    return NULL;  // EMBEDDED RETURN
+  }
+
+  return &topoLinks[idx];
+}
+
+/*********************************************************************
+ * @fn          ZDTopologyLqiRsp
+ *
+ * @brief       Record a Mgmt_Lqi_rsp page. Routers and the coordinator
+ *              in it are added to the crawl.
+ *
+ * @param       srcAddr - Router that sent the page.
+ * @param       status - Response status.
+ * @param       total - Neighbor table entries on the router.
+ * @param       startIdx - Table index of the first item.
+ * @param       cnt - Number of items in pList.
+ * @param       pList - Neighbor items.
+ *
+ * @return      none
+ */
+void ZDTopologyLqiRsp( uint16 srcAddr, byte status, byte total,
+                       byte startIdx, byte cnt, neighborLqiItem_t *pList )
+{
+  topoNode_t *pNode;
+  topoLink_t *pLink;
+  byte state;
+  byte delta;
+
+  if ( !topoActive || ((pNode = topoFindNode( srcAddr )) == NULL) )
+  {
+    return;  // EMBEDDED RETURN
+  }
+
+  state = pNode->state & TOPO_STATE_MASK;
+  if ( ((state != TOPO_STATE_PROBE) && (state != TOPO_STATE_LQI)) ||
+       ((status == ZSuccess) && (startIdx != pNode->startIdx)) )
+  {
+    return;  // EMBEDDED RETURN - late response to an earlier request
+  }
+
+  if ( status != ZSuccess )
+  {
+    topoFinish( pNode, TOPO_STATE_FAILED );
+    return;  // EMBEDDED RETURN
+  }
+
+  if ( total != pNode->lqiTotal )
+  {
+    pNode->lqiTotal = total;
+    pNode->changed = TRUE;
+  }
+
+  for ( ; (pList != NULL) && (cnt != 0); cnt--, pList++ )
+  {
+    pNode->startIdx++;
+
+    if ( pList->devType != ZDP_MGMT_DT_ENDDEV )
+    {
+      topoAddNode( pList->nwkAddr );
+    }
+
+    if ( (pLink = topoFindLink( srcAddr, pList->nwkAddr, FALSE )) )
+    {
+      delta = ( pList->rxLqi > pLink->lqi ) ? pList->rxLqi - pLink->lqi
+                                            : pLink->lqi - pList->rxLqi;
+      if ( delta >= TOPO_LQI_DELTA )
+      {
+        pLink->lqi = pList->rxLqi;
+        topoChanged( pNode, TOPO_LINK_CHANGED, pLink );
+      }
+    }
+    else if ( (pLink = topoFindLink( srcAddr, pList->nwkAddr, TRUE )) )
+    {
+      pLink->lqi = pList->rxLqi;
+      topoChanged( pNode, TOPO_LINK_ADDED, pLink );
+    }
+
+    // With no room in the graph the link is dropped.
+    if ( pLink )
+    {
+      pLink->flags |= TOPO_LINK_SEEN;
+    }
+  }
+
+  if ( (state == TOPO_STATE_PROBE) && !pNode->changed )
+  {
+    // The first page matches the graph: keep the rest of the router's
+    // links as they are and skip the remaining pages.
+    pLink = topoLinks;
+    for ( cnt = TOPO_LINK_MAX; cnt != 0; cnt--, pLink++ )
+    {
+      if ( pLink->srcAddr == srcAddr )
+      {
+        pLink->flags |= TOPO_LINK_SEEN;
+        if ( pLink->flags & TOPO_LINK_ROUTE )
+        {
+          pLink->flags |= TOPO_LINK_ROUTE_SEEN;
+        }
+      }
+    }
+    topoFinish( pNode, TOPO_STATE_IDLE );
+  }
+  else if ( (pNode->startIdx < total) && (startIdx != pNode->startIdx) )
+  {
+    topoSetState( pNode, TOPO_STATE_LQI );
+  }
+  else
+  {
+    topoSetState( pNode, TOPO_STATE_RTG );
+    pNode->startIdx = 0;
+  }
+}
+
+/*********************************************************************
+ * @fn          ZDTopologyRtgRsp
+ *
+ * @brief       Record a Mgmt_Rtg_rsp page. The next hop of each active
+ *              route is flagged in the graph.
+ *
+ * @param       srcAddr - Router that sent the page.
+ * @param       status - Response status.
+ * @param       total - Routing table entries on the router.
+ * @param       startIdx - Table index of the first item.
+ * @param       cnt - Number of items in pList.
+ * @param       pList - Routing items.
+ *
+ * @return      none
+ */
+void ZDTopologyRtgRsp( uint16 srcAddr, byte status, byte total,
+                       byte startIdx, byte cnt, rtgItem_t *pList )
+{
+  topoNode_t *pNode;
+  topoLink_t *pLink;
+
+  if ( !topoActive || ((pNode = topoFindNode( srcAddr )) == NULL) ||
+       ((pNode->state & TOPO_STATE_MASK) != TOPO_STATE_RTG) ||
+       ((status == ZSuccess) && (startIdx != pNode->startIdx)) )
+  {
+    return;  // EMBEDDED RETURN
+  }
+
+  if ( status != ZSuccess )
+  {
+    // The neighbor table was read; a router without a routing table
+    // to report is not a failure.
+    topoFinish( pNode, TOPO_STATE_IDLE );
+    return;  // EMBEDDED RETURN
+  }
+
+  for ( ; (pList != NULL) && (cnt != 0); cnt--, pList++ )
+  {
+    pNode->startIdx++;
+
+    if ( pList->status == RT_ACTIVE )
+    {
+      pLink = topoFindLink( srcAddr, pList->nextHopAddress, FALSE );
+
+      if ( pLink == NULL )
+      {
+        // A next hop missing from the neighbor table, LQI unknown.
+        if ( (pLink = topoFindLink( srcAddr, pList->nextHopAddress, TRUE )) )
+        {
+          pLink->flags = TOPO_LINK_SEEN | TOPO_LINK_ROUTE | TOPO_LINK_ROUTE_SEEN;
+          topoChanged( pNode, TOPO_LINK_ADDED, pLink );
+        }
+      }
+      else
+      {
+        // Seen again, also when the link is known only from routes
+        pLink->flags |= TOPO_LINK_SEEN | TOPO_LINK_ROUTE_SEEN;
+      }
+    }
+  }
+
+  if ( (pNode->startIdx < total) && (startIdx != pNode->startIdx) )
+  {
+    topoSetState( pNode, TOPO_STATE_RTG );
+  }
+  else
+  {
+    topoFinish( pNode, TOPO_STATE_IDLE );
+  }
+}
+
+/*********************************************************************
+*********************************************************************/
+
+#endif  // ZDO_TOPOLOGY
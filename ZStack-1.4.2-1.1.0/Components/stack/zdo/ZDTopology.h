@@ -0,0 +1,166 @@
+#ifndef ZDTOPOLOGY_H
+#define ZDTOPOLOGY_H
+
+/*********************************************************************
+    Filename:       ZDTopology.h
+    Revised:        $Date: 2007-06-14 09:45:00 -0700 (Thu, 14 Jun 2007) $
+    Revision:       $Revision: 14612 $
+
+    Description: Declaration of the ZDO Topology Crawler functionality.
+
+      The crawler walks the routers of the network breadth-first from
+      the local device's router children, reading every page of each
+      router's neighbor table (Mgmt_Lqi_req) and routing table
+      (Mgmt_Rtg_req) into a link table. Requests to different routers
+      are pipelined, bounded by TOPO_MAX_PENDING.
+
+      Once crawled, a router is probed every TOPO_REFRESH with a single
+      neighbor table page and only crawled again if that page or the
+      table size changed; the routers on the far side of a changed link
+      are probed at once. Link additions, removals and changes are
+      streamed to MT as they are found.
+
+    Notes:
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#if defined( ZDO_TOPOLOGY )
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "ZComDef.h"
+#include "ZDProfile.h"
+
+/*********************************************************************
+ * MACROS
+ */
+
+// Routers tracked by the crawler.
+#if !defined( TOPO_NODE_MAX )
+  #define TOPO_NODE_MAX  16
+#endif
+
+// Links held in the graph, for all routers together.
+#if !defined( TOPO_LINK_MAX )
+  #define TOPO_LINK_MAX  64
+#endif
+
+// Requests allowed in flight at once, each to a different router.
+#if !defined( TOPO_MAX_PENDING )
+  #define TOPO_MAX_PENDING  4
+#endif
+
+// Times a request is sent before the router is marked failed.
+#if !defined( TOPO_MAX_TRIES )
+  #define TOPO_MAX_TRIES  3
+#endif
+
+// Crawler timer tick in milliseconds. At most one request is sent
+// per tick, which sets the rate limit.
+#if !defined( TOPO_TX_INTERVAL )
+  #define TOPO_TX_INTERVAL  100
+#endif
+
+// Milliseconds to wait for a response before the request is retried.
+#if !defined( TOPO_RSP_TIMEOUT )
+  #define TOPO_RSP_TIMEOUT  5000
+#endif
+
+// Milliseconds between probes of a crawled router.
+#if !defined( TOPO_REFRESH )
+  #define TOPO_REFRESH  60000
+#endif
+
+// LQI change reported as a changed link.
+#if !defined( TOPO_LQI_DELTA )
+  #define TOPO_LQI_DELTA  16
+#endif
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Router states, topoNode_t.state.
+#define TOPO_STATE_PROBE      0x00  // Reading the first neighbor page only
+#define TOPO_STATE_LQI        0x01  // Reading neighbor pages from startIdx
+#define TOPO_STATE_RTG        0x02  // Reading routing pages from startIdx
+#define TOPO_STATE_IDLE       0x03  // Crawled, waiting for the next probe
+#define TOPO_STATE_FAILED     0x04  // No response, retried at the next probe
+#define TOPO_STATE_MASK       0x7F
+#define TOPO_STATE_PENDING    0x80  // Request for the state is in flight
+
+// topoLink_t.flags
+#define TOPO_LINK_ROUTE       0x01  // Next hop of an active route
+#define TOPO_LINK_SEEN        0x02  // Reported in the current crawl
+#define TOPO_LINK_ROUTE_SEEN  0x04  // Reported as next hop in the current crawl
+
+// Link changes streamed to MT.
+#define TOPO_LINK_ADDED       0x01
+#define TOPO_LINK_REMOVED     0x02
+#define TOPO_LINK_CHANGED     0x03
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint16 nwkAddr;
+  byte   state;
+  byte   startIdx;      // Start index of the next table page
+  byte   lqiTotal;      // Neighbor table entries last reported
+  byte   ticks;         // Ticks left before the pending request times out
+  byte   tries;
+  byte   changed;       // A link changed in the current crawl
+  uint16 refresh;       // Ticks until the next probe
+} topoNode_t;
+
+typedef struct
+{
+  uint16 srcAddr;       // Router reporting the link, INVALID_NODE_ADDR if free
+  uint16 dstAddr;       // Neighbor
+  byte   lqi;
+  byte   flags;
+} topoLink_t;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+extern void ZDTopologyInit( void );
+
+extern void ZDTopologyStart( void );
+
+extern void ZDTopologyStop( void );
+
+extern void ZDTopologyTimerEvent( void );
+
+extern topoLink_t *ZDTopologyGetLink( byte idx );
+
+extern void ZDTopologyLqiRsp( uint16 srcAddr, byte status, byte total,
+                   byte startIdx, byte cnt, neighborLqiItem_t *pList );
+
+extern void ZDTopologyRtgRsp( uint16 srcAddr, byte status, byte total,
+                   byte startIdx, byte cnt, rtgItem_t *pList );
+
+/*********************************************************************
+*********************************************************************/
+
+#endif  // ZDO_TOPOLOGY
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZDTOPOLOGY_H */
@@ -271,7 +271,7 @@ void SampleApp_Init( uint8 task_id )
   // By default, all devices start out in Group 1
   SampleApp_Group.ID = 0x0001;
   osal_memcpy( SampleApp_Group.name, "Group 1", 7  );
-  aps_AddGroup( SAMPLEAPP_ENDPOINT, &SampleApp_Group );
+  afAddGroup( SAMPLEAPP_ENDPOINT, &SampleApp_Group );
 
   //ʼ
   initUARTtest();
@@ -0,0 +1,824 @@
+/*********************************************************************
+    Filename:       ZclHarness.c
+    Revised:        $Date: 2007-06-20 10:30:00 -0700 (Wed, 20 Jun 2007) $
+    Revision:       $Revision: 14650 $
+
+    Description: Host harness for the ZCL libraries (zcl*.c). Frames go
+                 in through zcl_event_loop() as AF_INCOMING_MSG_CMD
+                 messages, the way AF delivers them on the target, with
+                 OSAL and AF stubbed out (ZclHarnessStubs.c) and the
+                 real OSAL heap underneath.
+
+                 Modes:
+                   -r <file>  replay the frames of a capture file
+                   -g         generate frames for every foundation and
+                              cluster command of every cluster, both
+                              directions, with truncated and extended
+                              payloads
+                   -f <n>     fuzz for n inputs, seeded with the frames
+                              from -r and -g (ZclHarnessFuzz.c)
+                   -u         register the cluster conversion table
+                              without its index, so frames are
+                              dispatched the way they were before it
+                   -b <n>     time n attribute lookups per case, linear
+                              against indexed, and stop
+                              (ZclHarnessBench.c)
+
+                 Each frame is run on its own and timed. The report
+                 gives, per cluster and command, frames per second,
+                 mean and worst-case latency, OSAL heap allocations per
+                 frame, heap blocks still held afterwards and the
+                 heap peak, and counts frames ZCL answered with more
+                 than AF takes (exit status 1 if there were any).
+
+    Notes:       Host build only, never linked into a device image.
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ZComDef.h"
+#include "OSAL.h"
+
+#include "zcl.h"
+
+#include "ZclHarness.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Report rows, one per cluster/direction/type/command seen
+#define ZCLH_STATS_MAX        16384
+
+// Cluster specific command IDs the generator tries
+#define ZCLH_GEN_CMD_MAX      0x10
+
+// Virtual time between frames, so ZCL's timers run as they would
+#define ZCLH_FRAME_GAP        100
+
+// Frame control bits
+#define ZCLH_FC_MANU          ZCL_FRAME_CONTROL_MANU_SPECIFIC
+#define ZCLH_FC_DIR           ZCL_FRAME_CONTROL_DIRECTION
+#define ZCLH_FC_NO_RSP        0x10
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+// One report row
+typedef struct
+{
+  uint32 key;                       // cluster, frame control, command + 1
+  uint32 frames;
+  uint64_t ns;                      // total processing time
+  uint64_t nsMax;                   // worst case
+  uint32 allocs;
+  uint32 allocMax;
+  uint32 allocFails;
+  int32  held;                      // heap blocks left allocated
+  uint16 heapPeak;
+  uint32 sent;
+  uint32 oversize;
+} zclhStats_t;
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static zclhStats_t zclhStats[ZCLH_STATS_MAX];
+static zclhStats_t zclhTotal;
+static zclhStats_t zclhTimerStats;
+static uint32 zclhSeed = 1;
+static uint32 zclhRepeat = 1;
+static uint32 zclhGap = ZCLH_FRAME_GAP;
+
+static zclhFrame_t *zclhFrames;
+static uint32 zclhFrameCnt;
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      zclhStatsKey
+ *
+ * @brief   Report row key of a frame: the cluster, the type, direction
+ *          and manufacturer bits of the frame control and the command.
+ *          Frames too short to carry a command share a row.
+ *
+ * @param   pFrame - frame
+ *
+ * @return  key
+ */
+static uint32 zclhStatsKey( zclhFrame_t *pFrame )
+{
+  uint8 fc;
+  uint8 cmdIdx;
+  uint32 cmd;
+
+  if ( pFrame->len == 0 )
+    return ( ((uint32)pFrame->clusterID << 16) | 0xFFFF );
+
+  fc = pFrame->data[0] & (ZCL_FRAME_CONTROL_TYPE | ZCLH_FC_MANU | ZCLH_FC_DIR);
+  cmdIdx = (fc & ZCLH_FC_MANU) ? 4 : 2;
+  cmd = (pFrame->len > cmdIdx) ? (uint32)pFrame->data[cmdIdx] + 1 : 0;
+
+  return ( ((uint32)pFrame->clusterID << 16) | ((uint32)fc << 9) | cmd );
+}
+
+static zclhStats_t *zclhStatsFind( uint32 key )
+{
+  uint32 i = (key * 2654435761u) % ZCLH_STATS_MAX;
+  uint32 n;
+
+  for ( n = 0; n < ZCLH_STATS_MAX; n++ )
+  {
+    if ( zclhStats[i].frames == 0 )
+    {
+      zclhStats[i].key = key;
+      return ( &zclhStats[i] );
+    }
+    if ( zclhStats[i].key == key )
+      return ( &zclhStats[i] );
+    i = (i + 1) % ZCLH_STATS_MAX;
+  }
+
+  return ( NULL );
+}
+
+static void zclhStatsAdd( zclhStats_t *pStats, uint64_t ns, int32 held )
+{
+  pStats->frames++;
+  pStats->ns += ns;
+  if ( ns > pStats->nsMax )
+    pStats->nsMax = ns;
+  pStats->allocs += zclhCounts.allocs;
+  if ( zclhCounts.allocs > pStats->allocMax )
+    pStats->allocMax = zclhCounts.allocs;
+  pStats->allocFails += zclhCounts.allocFails;
+  pStats->held += held;
+  if ( zclhCounts.heapPeak > pStats->heapPeak )
+    pStats->heapPeak = zclhCounts.heapPeak;
+  pStats->sent += zclhCounts.sent;
+  pStats->oversize += zclhCounts.oversize;
+}
+
+static void zclhStatsPrint( const char *name, zclhStats_t *pStats )
+{
+  double secs = pStats->ns / 1e9;
+
+  printf( "%-22s %8u %10.0f %8.2f %8.2f %6.2f %4u %5u %6d %6u %6u %4u\n",
+          name, pStats->frames,
+          secs > 0 ? pStats->frames / secs : 0.0,
+          pStats->frames ? pStats->ns / 1e3 / pStats->frames : 0.0,
+          pStats->nsMax / 1e3,
+          pStats->frames ? (double)pStats->allocs / pStats->frames : 0.0,
+          pStats->allocMax, pStats->allocFails, pStats->held, pStats->heapPeak,
+          pStats->sent, pStats->oversize );
+}
+
+static int zclhStatsCmp( const void *a, const void *b )
+{
+  uint32 ka = ((const zclhStats_t *)a)->key;
+  uint32 kb = ((const zclhStats_t *)b)->key;
+
+  return ( ka < kb ? -1 : ka > kb );
+}
+
+/*********************************************************************
+ * @fn      zclhReport
+ *
+ * @brief   Print the report, a row per cluster/direction/command and
+ *          the totals.
+ *
+ * @param   verbose - TRUE for the per command rows
+ *
+ * @return  none
+ */
+static void zclhReport( uint8 verbose )
+{
+  char name[32];
+  zclhStats_t *pStats;
+  uint32 key;
+  uint8 fc;
+  uint32 i;
+
+  printf( "%-22s %8s %10s %8s %8s %6s %4s %5s %6s %6s %6s %4s\n",
+          "cluster dir cmd", "frames", "fps", "mean us", "max us",
+          "allocs", "max", "nomem", "held", "peakB", "sent", "long" );
+
+  qsort( zclhStats, ZCLH_STATS_MAX, sizeof( zclhStats_t ), zclhStatsCmp );
+  for ( i = 0; verbose && i < ZCLH_STATS_MAX; i++ )
+  {
+    pStats = &zclhStats[i];
+    if ( pStats->frames == 0 )
+      continue;
+
+    key = pStats->key;
+    fc = (uint8)((key >> 9) & 0x7F);
+    if ( (key & 0xFFFF) == 0xFFFF )
+      sprintf( name, "%04X empty", (unsigned)(key >> 16) );
+    else if ( (key & 0x1FF) == 0 )
+      sprintf( name, "%04X %s %s short", (unsigned)(key >> 16),
+               (fc & ZCLH_FC_DIR) ? "s>c" : "c>s",
+               zcl_ProfileCmd( fc & ZCL_FRAME_CONTROL_TYPE ) ? "prof" : "clus" );
+    else
+      sprintf( name, "%04X %s %s%s %02X", (unsigned)(key >> 16),
+               (fc & ZCLH_FC_DIR) ? "s>c" : "c>s",
+               zcl_ProfileCmd( fc & ZCL_FRAME_CONTROL_TYPE ) ? "prof" : "clus",
+               (fc & ZCLH_FC_MANU) ? "/m" : "",
+               (unsigned)((key & 0x1FF) - 1) );
+    zclhStatsPrint( name, pStats );
+  }
+
+  if ( zclhTimerStats.frames )
+    zclhStatsPrint( "timers", &zclhTimerStats );
+  zclhStatsPrint( "total", &zclhTotal );
+
+  printf( "heap: %u blocks, %u bytes in use at the end\n",
+          zclhStubsHeapBlocks(), zclhStubsHeapBytes() );
+}
+
+/*********************************************************************
+ * @fn      zclhFrameAdd
+ *
+ * @brief   Add a frame to the list the driver runs.
+ *
+ * @param   cluster - real cluster ID
+ * @param   flags - ZCLH_FRAME_BCAST, ZCLH_FRAME_GROUP
+ * @param   buf - frame
+ * @param   len - frame length
+ *
+ * @return  none
+ */
+static void zclhFrameAdd( uint16 cluster, uint8 flags, uint8 *buf, uint16 len )
+{
+  zclhFrame_t *pFrame;
+
+  if ( (zclhFrameCnt % 1024) == 0 )
+  {
+    zclhFrames = realloc( zclhFrames, (zclhFrameCnt + 1024) * sizeof( zclhFrame_t ) );
+    if ( zclhFrames == NULL )
+    {
+      fprintf( stderr, "out of memory\n" );
+      exit( 2 );
+    }
+  }
+
+  if ( len > ZCLH_FRAME_MAX )
+    len = ZCLH_FRAME_MAX;
+
+  pFrame = &zclhFrames[zclhFrameCnt++];
+  pFrame->clusterID = cluster;
+  pFrame->flags = flags;
+  pFrame->len = (uint8)len;
+  memcpy( pFrame->data, buf, len );
+}
+
+/*********************************************************************
+ * @fn      zclhLoadCapture
+ *
+ * @brief   Read a capture file. Each line is a frame: the cluster ID
+ *          in hex, an optional 'b' (broadcast) or 'g' (group) and the
+ *          ZCL frame in hex, header first. Bytes may be separated by
+ *          spaces. A '#' starts a comment.
+ *
+ * @param   path - capture file
+ *
+ * @return  frames read, -1 if the file can't be read
+ */
+static int32 zclhLoadCapture( const char *path )
+{
+  FILE *fp;
+  char line[1024];
+  uint8 buf[ZCLH_FRAME_MAX];
+  uint32 lineNo = 0;
+  int32 cnt = 0;
+  unsigned int cluster;
+  uint8 flags;
+  uint16 len;
+  char *p;
+  int n;
+
+  fp = fopen( path, "r" );
+  if ( fp == NULL )
+    return ( -1 );
+
+  while ( fgets( line, sizeof( line ), fp ) )
+  {
+    lineNo++;
+    if ( (p = strchr( line, '#' )) != NULL )
+      *p = '\0';
+
+    p = line;
+    while ( isspace( (unsigned char)*p ) )
+      p++;
+    if ( *p == '\0' )
+      continue;
+
+    if ( sscanf( p, "%x%n", &cluster, &n ) != 1 || cluster > 0xFFFF )
+    {
+      fprintf( stderr, "%s:%u: bad cluster ID\n", path, lineNo );
+      continue;
+    }
+    p += n;
+
+    flags = 0;
+    while ( isspace( (unsigned char)*p ) )
+      p++;
+    if ( (*p == 'b' || *p == 'g') && isspace( (unsigned char)p[1] ) )
+    {
+      flags = (*p == 'b') ? ZCLH_FRAME_BCAST : ZCLH_FRAME_GROUP;
+      p++;
+    }
+
+    len = 0;
+    while ( *p )
+    {
+      unsigned int byte;
+
+      if ( isspace( (unsigned char)*p ) )
+      {
+        p++;
+        continue;
+      }
+      if ( !isxdigit( (unsigned char)p[0] ) || !isxdigit( (unsigned char)p[1] ) ||
+           sscanf( p, "%2x", &byte ) != 1 )
+      {
+        fprintf( stderr, "%s:%u: bad frame byte\n", path, lineNo );
+        break;
+      }
+      if ( len < ZCLH_FRAME_MAX )
+        buf[len++] = (uint8)byte;
+      p += 2;
+    }
+
+    zclhFrameAdd( (uint16)cluster, flags, buf, len );
+    cnt++;
+  }
+
+  fclose( fp );
+
+  return ( cnt );
+}
+
+/*********************************************************************
+ * @fn      zclhBuildPayload
+ *
+ * @brief   Fill a foundation command payload with well formed records
+ *          for the harness attributes, as many as fit. The caller
+ *          cuts it short or pads it to test the length checks.
+ *
+ * @param   cmd - foundation command ID
+ * @param   buf - where to build
+ * @param   len - room
+ *
+ * @return  none
+ */
+static void zclhBuildPayload( uint8 cmd, uint8 *buf, uint16 len )
+{
+  // Types of attributes 0x0000-0x0005 on a cluster (see ZclHarnessApp.c)
+  static const uint8 types[] =
+  {
+    ZCL_DATATYPE_UINT8, ZCL_DATATYPE_UINT16, ZCL_DATATYPE_UINT16,
+    ZCL_DATATYPE_INT16, ZCL_DATATYPE_UINT32, ZCL_DATATYPE_CHAR_STR
+  };
+  static const uint8 sizes[] = { 1, 2, 2, 2, 4, 0 };
+  uint8 rec[24];
+  uint8 recLen;
+  uint8 attr = 0;
+  uint16 pos = 0;
+  uint8 i;
+
+  while ( pos < len )
+  {
+    uint8 type = types[attr];
+    uint8 size = sizes[attr];
+    uint8 value[8];
+
+    recLen = 0;
+    for ( i = 0; i < sizeof( value ); i++ )
+      value[i] = (uint8)zclhRand();
+    if ( type == ZCL_DATATYPE_CHAR_STR )
+    {
+      value[0] = 3;                 // three character string
+      size = 4;
+    }
+
+    switch ( cmd )
+    {
+      case ZCL_CMD_READ:
+      case ZCL_CMD_READ_REPORT_CFG:
+        if ( cmd == ZCL_CMD_READ_REPORT_CFG )
+          rec[recLen++] = 0x00;     // direction
+        rec[recLen++] = attr;
+        rec[recLen++] = 0x00;
+        break;
+
+      case ZCL_CMD_WRITE:
+      case ZCL_CMD_WRITE_UNDIVIDED:
+      case ZCL_CMD_WRITE_NO_RSP:
+      case ZCL_CMD_REPORT:
+      case ZCL_CMD_READ_RSP:
+        rec[recLen++] = attr;
+        rec[recLen++] = 0x00;
+        if ( cmd == ZCL_CMD_READ_RSP )
+          rec[recLen++] = ZCL_STATUS_SUCCESS;
+        rec[recLen++] = type;
+        memcpy( &rec[recLen], value, size );
+        recLen += size;
+        break;
+
+      case ZCL_CMD_WRITE_RSP:
+      case ZCL_CMD_CONFIG_REPORT_RSP:
+        rec[recLen++] = ZCL_STATUS_UNSUPPORTED_ATTRIBUTE;
+        if ( cmd == ZCL_CMD_CONFIG_REPORT_RSP )
+          rec[recLen++] = 0x00;     // direction
+        rec[recLen++] = attr;
+        rec[recLen++] = 0x00;
+        break;
+
+      case ZCL_CMD_CONFIG_REPORT:
+      case ZCL_CMD_READ_REPORT_CFG_RSP:
+        if ( cmd == ZCL_CMD_READ_REPORT_CFG_RSP )
+          rec[recLen++] = ZCL_STATUS_SUCCESS;
+        rec[recLen++] = 0x00;       // direction
+        rec[recLen++] = attr;
+        rec[recLen++] = 0x00;
+        rec[recLen++] = type;
+        rec[recLen++] = 0x01;       // minimum interval
+        rec[recLen++] = 0x00;
+        rec[recLen++] = 0x0A;       // maximum interval
+        rec[recLen++] = 0x00;
+        if ( type != ZCL_DATATYPE_CHAR_STR )
+        {
+          memcpy( &rec[recLen], value, size );  // reportable change
+          recLen += size;
+        }
+        break;
+
+      case ZCL_CMD_DISCOVER:
+        rec[recLen++] = attr;
+        rec[recLen++] = 0x00;
+        rec[recLen++] = 0x08;       // max attribute IDs
+        break;
+
+      case ZCL_CMD_DISCOVER_RSP:
+        if ( pos == 0 )
+          rec[recLen++] = (uint8)(zclhRand() & 1);  // discovery complete
+        rec[recLen++] = attr;
+        rec[recLen++] = 0x00;
+        rec[recLen++] = type;
+        break;
+
+      case ZCL_CMD_ERROR:
+      default:
+        rec[recLen++] = (uint8)zclhRand();
+        break;
+    }
+
+    if ( recLen > len - pos )
+      recLen = (uint8)(len - pos);
+    memcpy( &buf[pos], rec, recLen );
+    pos += recLen;
+
+    attr = (attr + 1) % sizeof( types );
+  }
+}
+
+/*********************************************************************
+ * @fn      zclhGenerate
+ *
+ * @brief   Make frames for every command of every cluster on the
+ *          harness endpoint: the foundation commands (and the first
+ *          ID past them), cluster command IDs 0x00-0x0F, both
+ *          directions. Each gets a range of payload lengths from
+ *          empty to past the MTU, well formed records cut short for
+ *          the foundation commands and random bytes for the rest,
+ *          and some go out broadcast or manufacturer specific.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void zclhGenerate( void )
+{
+  static const uint8 lens[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 11, 16, 24, 40,
+                                ZCLH_AF_MTU - 3, ZCLH_FRAME_MAX - 3 };
+  uint8 buf[ZCLH_FRAME_MAX];
+  uint8 cluster;
+  uint8 dir;
+  uint8 type;
+  uint16 cmd;
+  uint8 l;
+  uint8 len;
+  uint8 hdr;
+  uint8 seq = 0;
+  uint8 flags;
+
+  for ( cluster = 0; cluster < zclhAppClusterCnt(); cluster++ )
+  {
+    for ( dir = 0; dir < 2; dir++ )
+    {
+      for ( type = 0; type < 2; type++ )
+      {
+        uint16 cmdMax = (type == 0) ? ZCL_CMD_MAX + 1 : ZCLH_GEN_CMD_MAX - 1;
+
+        for ( cmd = 0; cmd <= cmdMax; cmd++ )
+        {
+          for ( l = 0; l < sizeof( lens ); l++ )
+          {
+            hdr = 0;
+            buf[hdr++] = (type == 0 ? ZCL_FRAME_TYPE_PROFILE_CMD : ZCL_FRAME_TYPE_SPECIFIC_CMD)
+                       | (dir ? ZCLH_FC_DIR : 0);
+            if ( (l % 5) == 4 )
+            {
+              buf[0] |= ZCLH_FC_MANU;
+              buf[hdr++] = 0x34;    // manufacturer code
+              buf[hdr++] = 0x12;
+            }
+            buf[hdr++] = seq++;
+            buf[hdr++] = (uint8)cmd;
+
+            // The longest payloads fill whatever the header leaves
+            len = lens[l];
+            if ( len > sizeof( buf ) - hdr )
+              len = sizeof( buf ) - hdr;
+
+            if ( type == 0 )
+              zclhBuildPayload( (uint8)cmd, &buf[hdr], len );
+            else
+            {
+              uint8 i;
+
+              for ( i = 0; i < len; i++ )
+                buf[hdr + i] = (uint8)zclhRand();
+            }
+
+            flags = ((l % 7) == 6) ? ZCLH_FRAME_BCAST : 0;
+            zclhFrameAdd( zclhAppCluster( cluster ), flags, buf, hdr + len );
+          }
+
+          // Header only, and the header cut short
+          zclhFrameAdd( zclhAppCluster( cluster ), 0, buf, hdr );
+          zclhFrameAdd( zclhAppCluster( cluster ), 0, buf, hdr - 1 );
+        }
+      }
+    }
+  }
+}
+
+static void zclhUsage( const char *prog )
+{
+  fprintf( stderr,
+    "usage: %s [-r capture] [-g] [-f inputs] [-n repeat] [-s seed]\n"
+    "          [-t gap-ms] [-w capture] [-q] [-u] [-b lookups]\n"
+    "  -r file  replay the frames of a capture file\n"
+    "  -g       generate frames for every command of every cluster\n"
+    "           (the default when no -r is given)\n"
+    "  -f n     fuzz for n inputs, seeded with the frames above\n"
+    "  -n n     run each frame n times (default 1)\n"
+    "  -s n     random seed (default 1)\n"
+    "  -t ms    virtual time between frames (default %u)\n"
+    "  -w file  write the frames in capture format and stop\n"
+    "  -q       totals only\n"
+    "  -u       don't index the cluster conversion table\n"
+    "  -b n     benchmark n attribute lookups per case and stop\n", prog, ZCLH_FRAME_GAP );
+  exit( 2 );
+}
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      zclhRand
+ *
+ * @brief   xorshift32 pseudo random number.
+ *
+ * @param   none
+ *
+ * @return  number
+ */
+uint32 zclhRand( void )
+{
+  zclhSeed ^= zclhSeed << 13;
+  zclhSeed ^= zclhSeed >> 17;
+  zclhSeed ^= zclhSeed << 5;
+
+  return ( zclhSeed );
+}
+
+/*********************************************************************
+ * @fn      zclhNow
+ *
+ * @brief   Monotonic clock.
+ *
+ * @param   none
+ *
+ * @return  ns
+ */
+uint64_t zclhNow( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+
+  return ( (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec );
+}
+
+/*********************************************************************
+ * @fn      zclhPrintFrame
+ *
+ * @brief   Write a frame in capture format.
+ *
+ * @param   fp - where to write
+ * @param   pFrame - frame
+ *
+ * @return  none
+ */
+void zclhPrintFrame( FILE *fp, zclhFrame_t *pFrame )
+{
+  uint8 i;
+
+  fprintf( fp, "%04X", pFrame->clusterID );
+  if ( pFrame->flags & ZCLH_FRAME_BCAST )
+    fprintf( fp, " b" );
+  else if ( pFrame->flags & ZCLH_FRAME_GROUP )
+    fprintf( fp, " g" );
+  for ( i = 0; i < pFrame->len; i++ )
+    fprintf( fp, " %02X", pFrame->data[i] );
+  fprintf( fp, "\n" );
+}
+
+/*********************************************************************
+ * @fn      zclhRunFrame
+ *
+ * @brief   Deliver one frame, run ZCL until it is done with it and add
+ *          the cost to the report. Then move the virtual clock on, so
+ *          reports and transitions run; that time is reported apart.
+ *
+ * @param   pFrame - frame
+ *
+ * @return  none
+ */
+void zclhRunFrame( zclhFrame_t *pFrame )
+{
+  zclhStats_t *pStats;
+  uint16 blocks;
+  uint64_t t0;
+  uint64_t ns;
+
+  memset( &zclhCounts, 0, sizeof( zclhCounts ) );
+  blocks = zclhStubsHeapBlocks();
+
+  t0 = zclhNow();
+  if ( zclhStubsDeliver( pFrame ) )
+    zclhStubsRun();
+  ns = zclhNow() - t0;
+
+  pStats = zclhStatsFind( zclhStatsKey( pFrame ) );
+  if ( pStats )
+    zclhStatsAdd( pStats, ns, (int32)zclhStubsHeapBlocks() - blocks );
+  zclhStatsAdd( &zclhTotal, ns, (int32)zclhStubsHeapBlocks() - blocks );
+
+  if ( zclhGap )
+  {
+    memset( &zclhCounts, 0, sizeof( zclhCounts ) );
+    blocks = zclhStubsHeapBlocks();
+
+    t0 = zclhNow();
+    zclhStubsAdvance( zclhGap );
+    ns = zclhNow() - t0;
+
+    if ( zclhCounts.allocs || zclhCounts.sent )
+      zclhStatsAdd( &zclhTimerStats, ns, (int32)zclhStubsHeapBlocks() - blocks );
+  }
+}
+
+#if !defined( ZCLH_LIBFUZZER )
+/*********************************************************************
+ * @fn      main
+ *
+ * @brief   See the description at the top of the file.
+ *
+ * @param   argc, argv - command line
+ *
+ * @return  0, 1 if ZCL tried to send a frame longer than AF takes,
+ *          2 on a usage error
+ */
+int main( int argc, char **argv )
+{
+  const char *capture = NULL;
+  const char *writeTo = NULL;
+  uint8 generate = FALSE;
+  uint8 verbose = TRUE;
+  uint32 fuzz = 0;
+  uint32 bench = 0;
+  uint32 i;
+  uint32 n;
+  int32 cnt;
+  int opt;
+
+  while ( (opt = getopt( argc, argv, "r:gf:n:s:t:w:qub:" )) != -1 )
+  {
+    switch ( opt )
+    {
+      case 'r': capture = optarg; break;
+      case 'g': generate = TRUE; break;
+      case 'f': fuzz = strtoul( optarg, NULL, 0 ); break;
+      case 'n': zclhRepeat = strtoul( optarg, NULL, 0 ); break;
+      case 's': zclhSeed = strtoul( optarg, NULL, 0 ); break;
+      case 't': zclhGap = strtoul( optarg, NULL, 0 ); break;
+      case 'w': writeTo = optarg; break;
+      case 'q': verbose = FALSE; break;
+      case 'u': zclhAppConvertIndex( FALSE ); break;
+      case 'b': bench = strtoul( optarg, NULL, 0 ); break;
+      default:  zclhUsage( argv[0] );
+    }
+  }
+  if ( optind != argc || zclhRepeat == 0 )
+    zclhUsage( argv[0] );
+  if ( zclhSeed == 0 )
+    zclhSeed = 1;
+  if ( capture == NULL )
+    generate = TRUE;
+
+  zclhStubsInit();
+
+  if ( bench )
+  {
+    zclhBenchAttrs( bench );
+    return ( 0 );
+  }
+
+  zclhAppInit();
+
+  if ( capture )
+  {
+    cnt = zclhLoadCapture( capture );
+    if ( cnt < 0 )
+    {
+      perror( capture );
+      return ( 2 );
+    }
+    printf( "%s: %d frames\n", capture, (int)cnt );
+  }
+  if ( generate )
+  {
+    n = zclhFrameCnt;
+    zclhGenerate();
+    printf( "generated %u frames\n", zclhFrameCnt - n );
+  }
+
+  if ( writeTo )
+  {
+    FILE *fp = fopen( writeTo, "w" );
+
+    if ( fp == NULL )
+    {
+      perror( writeTo );
+      return ( 2 );
+    }
+    for ( i = 0; i < zclhFrameCnt; i++ )
+      zclhPrintFrame( fp, &zclhFrames[i] );
+    fclose( fp );
+    return ( 0 );
+  }
+
+  if ( fuzz )
+  {
+    // The fuzzer replays the frames itself, as seeds, to see their edges
+    printf( "fuzz: %u inputs kept\n", zclhFuzz( zclhFrames, zclhFrameCnt, fuzz ) );
+  }
+  else
+  {
+    for ( n = 0; n < zclhRepeat; n++ )
+    {
+      for ( i = 0; i < zclhFrameCnt; i++ )
+        zclhRunFrame( &zclhFrames[i] );
+    }
+  }
+
+  zclhReport( verbose );
+
+  return ( (zclhTotal.oversize || zclhTimerStats.oversize) ? 1 : 0 );
+}
+#endif // !ZCLH_LIBFUZZER
+
+/*********************************************************************
+*********************************************************************/
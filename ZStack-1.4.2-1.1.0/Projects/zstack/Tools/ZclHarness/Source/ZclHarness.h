@@ -0,0 +1,184 @@
+#ifndef ZCLHARNESS_H
+#define ZCLHARNESS_H
+/*********************************************************************
+    Filename:       ZclHarness.h
+    Revised:        $Date: 2007-06-20 10:30:00 -0700 (Wed, 20 Jun 2007) $
+    Revision:       $Revision: 14650 $
+
+    Description: Host harness for the ZCL libraries. Feeds ZCL frames
+                 through zcl_event_loop() the way AF delivers them and
+                 measures what it costs. See ZclHarness.c.
+
+    Notes:       Host build only, never linked into a device image.
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ZComDef.h"
+#include "AF.h"
+#include "zcl.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Task ID given to ZCL
+#define ZCLH_TASK_ID          1
+
+// Endpoint registered for the harness application
+#define ZCLH_ENDPOINT         8
+
+// Address the harness frames come from
+#define ZCLH_SRC_ADDR         0x1234
+#define ZCLH_SRC_ENDPOINT     1
+
+// Longest frame the harness sends in
+#define ZCLH_FRAME_MAX        127
+
+// Largest APS payload AF_DataRequest() takes (AF would take off the
+// headers of the frame the application asks for)
+#if !defined( ZCLH_AF_MTU )
+  #define ZCLH_AF_MTU         80
+#endif
+
+// Home Automation devices (ZclHarnessHa.c)
+#define ZCLH_HA_DEV_LIGHT       0   // dimmable light
+#define ZCLH_HA_DEV_THERMOSTAT  1
+#define ZCLH_HA_DEVICES         2
+
+// Frame flags
+#define ZCLH_FRAME_BCAST      0x01  // delivered as a broadcast
+#define ZCLH_FRAME_GROUP      0x02  // delivered to a group
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+// A frame as delivered by AF
+typedef struct
+{
+  uint16 clusterID;                 // real cluster ID
+  uint8  flags;                     // ZCLH_FRAME_BCAST, ZCLH_FRAME_GROUP
+  uint8  len;                       // length of the ZCL frame
+  uint8  data[ZCLH_FRAME_MAX];      // ZCL frame, header first
+} zclhFrame_t;
+
+// What the stubs counted while a frame was processed
+typedef struct
+{
+  uint32 allocs;                    // osal_mem_alloc() calls
+  uint32 allocFails;                // osal_mem_alloc() returned NULL
+  uint32 frees;                     // osal_mem_free() calls
+  uint32 sent;                      // AF_DataRequest() calls
+  uint32 oversize;                  // AF_DataRequest() longer than the MTU
+  uint32 callbacks;                 // application callbacks made
+  uint16 heapPeak;                  // most OSAL heap bytes in use
+} zclhCounts_t;
+
+/*********************************************************************
+ * GLOBAL VARIABLES
+ */
+
+// Counters kept by the stubs, cleared by the driver
+extern zclhCounts_t zclhCounts;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*
+ * Stubs (ZclHarnessStubs.c)
+ */
+  // Reset the OSAL heap, timers, NV, groups and endpoints
+  extern void zclhStubsInit( void );
+
+  // Deliver a frame to ZCL as an AF_INCOMING_MSG_CMD, TRUE if queued
+  extern uint8 zclhStubsDeliver( zclhFrame_t *pFrame );
+
+  // Run the ZCL task until no event is pending
+  extern void zclhStubsRun( void );
+
+  // Move the virtual clock on, firing the timers that expire
+  extern void zclhStubsAdvance( uint32 ms );
+
+  // OSAL heap in use, in blocks and bytes
+  extern uint16 zclhStubsHeapBlocks( void );
+  extern uint16 zclhStubsHeapBytes( void );
+
+  // Fail the nth osal_mem_alloc() from now (1 is the next), 0 cancels
+  extern void zclhStubsAllocFail( uint8 nth );
+
+/*
+ * Application (ZclHarnessApp.c)
+ */
+  // Register the harness endpoint, attributes and library callbacks
+  extern void zclhAppInit( void );
+
+  // Register the cluster conversion table without its index, FALSE,
+  // or with it, TRUE (the default); takes effect at zclhAppInit()
+  extern void zclhAppConvertIndex( uint8 indexed );
+
+  // Number of real cluster IDs the endpoint serves and the i'th one
+  extern uint8 zclhAppClusterCnt( void );
+  extern uint16 zclhAppCluster( uint8 i );
+
+/*
+ * Driver (ZclHarness.c)
+ */
+  // Deliver one frame, run it to completion and add it to the report
+  extern void zclhRunFrame( zclhFrame_t *pFrame );
+
+  // Write a frame in capture format
+  extern void zclhPrintFrame( FILE *fp, zclhFrame_t *pFrame );
+
+  // Pseudo random number, from the seed given with -s
+  extern uint32 zclhRand( void );
+
+  // Monotonic clock, in ns
+  extern uint64_t zclhNow( void );
+
+/*
+ * Fuzzer (ZclHarnessFuzz.c)
+ */
+  // Run the coverage guided fuzzer on a seed corpus for a number of
+  // inputs, returns the number of inputs kept in the corpus
+  extern uint32 zclhFuzz( zclhFrame_t *pSeeds, uint32 seedCnt, uint32 iterations );
+
+/*
+ * Benchmarks (ZclHarnessBench.c)
+ */
+  // Time attribute lookups, linear against indexed, for 50 to 300
+  // attributes on an endpoint and for the HA devices; lookups is the
+  // number timed per case
+  extern void zclhBenchAttrs( uint32 lookups );
+
+/*
+ * HA devices (ZclHarnessHa.c)
+ */
+  // CONST attribute list and name of a ZCLH_HA_DEV_ device, returns
+  // the number of records
+  extern uint8 zclhHaAttrs( uint8 device, const char **ppName, const zclAttrRec_t **ppAttrs );
+
+/*********************************************************************
+*********************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ZCLHARNESS_H */
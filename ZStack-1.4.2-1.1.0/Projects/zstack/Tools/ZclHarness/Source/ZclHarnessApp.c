@@ -0,0 +1,573 @@
+/*********************************************************************
+    Filename:       ZclHarnessApp.c
+    Revised:        $Date: 2007-06-20 10:30:00 -0700 (Wed, 20 Jun 2007) $
+    Revision:       $Revision: 14650 $
+
+    Description: Application side of the ZCL harness. Registers one
+                 Home Automation endpoint that serves every cluster the
+                 ZCL libraries know, with a few attributes of each data
+                 type on each cluster, and callbacks for every library
+                 command. The callbacks read all the data they are
+                 given, so a short buffer shows up under ASan.
+
+    Notes:       Host build only, never linked into a device image.
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "ZComDef.h"
+#include "OSAL.h"
+#include "AF.h"
+
+#include "zcl.h"
+#include "zcl_ha.h"
+#include "zcl_general.h"
+#include "zcl_closures.h"
+#include "zcl_hvac.h"
+#include "zcl_lighting.h"
+#include "zcl_ms.h"
+#include "zcl_pi.h"
+#include "zcl_ss.h"
+
+#include "ZclHarness.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Attributes on each cluster
+#define ZCLH_ATTR_PER_CLUSTER   7
+
+// Room for any string a frame can carry
+#define ZCLH_STR_LEN            256
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+// Storage behind the attributes of one cluster
+typedef struct
+{
+  uint8  u8;
+  uint16 u16;
+  uint16 u16b;
+  int16  s16;
+  uint32 u32;
+  uint8  str[ZCLH_STR_LEN];
+  uint8  flag;
+} zclhAttrData_t;
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+// Home Automation cluster IDs and the logical IDs the libraries use
+static zclConvertClusterRec_t zclhClusters[] =
+{
+  { 0x0000, ZCL_GEN_LOGICAL_CLUSTER_ID_BASIC },
+  { 0x0001, ZCL_GEN_LOGICAL_CLUSTER_ID_POWER_CFG },
+  { 0x0002, ZCL_GEN_LOGICAL_CLUSTER_ID_DEV_TEMP_CFG },
+  { 0x0003, ZCL_GEN_LOGICAL_CLUSTER_ID_IDENTIFY },
+  { 0x0004, ZCL_GEN_LOGICAL_CLUSTER_ID_GROUPS },
+  { 0x0005, ZCL_GEN_LOGICAL_CLUSTER_ID_SCENES },
+  { 0x0006, ZCL_GEN_LOGICAL_CLUSTER_ID_ON_OFF },
+  { 0x0007, ZCL_GEN_LOGICAL_CLUSTER_ID_ON_OFF_SWITCH_CFG },
+  { 0x0008, ZCL_GEN_LOGICAL_CLUSTER_ID_LEVEL_CTRL },
+  { 0x0009, ZCL_GEN_LOGICAL_CLUSTER_ID_ALARMS },
+  { 0x000A, ZCL_GEN_LOGICAL_CLUSTER_ID_TIME },
+  { 0x000B, ZCL_GEN_LOGICAL_CLUSTER_ID_LOCATION },
+  { 0x0100, ZCL_CLOSURES_LOGICAL_CLUSTER_ID_SHADE_CONFIG },
+  { 0x0200, ZCL_HVAC_LOGICAL_CLUSTER_ID_PUMP_CONFIG_CONTROL },
+  { 0x0201, ZCL_HVAC_LOGICAL_CLUSTER_ID_THERMOSTAT },
+  { 0x0202, ZCL_HVAC_LOGICAL_CLUSTER_ID_FAN_CONTROL },
+  { 0x0203, ZCL_HVAC_LOGICAL_CLUSTER_ID_DIHUMIDIFICATION_CONTROL },
+  { 0x0204, ZCL_HVAC_LOGICAL_CLUSTER_ID_USER_INTERFACE_CONFIG },
+  { 0x0300, ZCL_LIGHTING_LOGICAL_CLUSTER_ID_COLOR_CONTROL },
+  { 0x0301, ZCL_LIGHTING_LOGICAL_CLUSTER_ID_BALLAST_CONFIG },
+  { 0x0400, ZCL_MS_LOGICAL_CLUSTER_ID_ILLUMINANCE_MEASUREMENT },
+  { 0x0401, ZCL_MS_LOGICAL_CLUSTER_ID_ILLUMINANCE_LEVEL_SENSING_CFG },
+  { 0x0402, ZCL_MS_LOGICAL_CLUSTER_ID_TEMPERATURE_MEASUREMENT },
+  { 0x0403, ZCL_MS_LOGICAL_CLUSTER_ID_PRESSURE_MEASUREMENT },
+  { 0x0404, ZCL_MS_LOGICAL_CLUSTER_ID_FLOW_MEASUREMENT },
+  { 0x0405, ZCL_MS_LOGICAL_CLUSTER_ID_RELATIVE_HUMIDITY },
+  { 0x0406, ZCL_MS_LOGICAL_CLUSTER_ID_OCCUPANCY_SENSING },
+  { 0x0500, ZCL_SS_LOGICAL_CLUSTER_ID_IAS_ZONE },
+  { 0x0501, ZCL_SS_LOGICAL_CLUSTER_ID_IAS_ACE },
+  { 0x0502, ZCL_SS_LOGICAL_CLUSTER_ID_IAS_WD },
+  { 0x0601, ZCL_PI_LOGICAL_CLUSTER_ID_BACNET_INTERFACE },
+};
+
+#define ZCLH_CLUSTER_CNT  ( sizeof( zclhClusters ) / sizeof( zclhClusters[0] ) )
+
+static zclhAttrData_t zclhAttrData[ZCLH_CLUSTER_CNT];
+static zclAttrRec_t zclhAttrs[ZCLH_CLUSTER_CNT * ZCLH_ATTR_PER_CLUSTER];
+static uint8 zclhDeviceEnabled = TRUE;
+static uint8 zclhConvertIndexed = TRUE;
+
+static cId_t zclhClusterList[ZCLH_CLUSTER_CNT];
+
+static SimpleDescriptionFormat_t zclhSimpleDesc =
+{
+  ZCLH_ENDPOINT,                    // Endpoint
+  ZCL_HA_PROFILE_ID,                // Profile ID
+  0x0000,                           // Device ID
+  0,                                // Device version
+  0,                                // Reserved
+  ZCLH_CLUSTER_CNT,                 // Number of input clusters
+  zclhClusterList,                  // Input cluster list
+  ZCLH_CLUSTER_CNT,                 // Number of output clusters
+  zclhClusterList                   // Output cluster list
+};
+
+static uint8 zclhTaskID = ZCLH_TASK_ID;
+
+static endPointDesc_t zclhEpDesc =
+{
+  ZCLH_ENDPOINT,
+  &zclhTaskID,
+  &zclhSimpleDesc,
+  noLatencyReqs
+};
+
+// Sink for the data the callbacks read
+static volatile uint8 zclhSink;
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+static void zclhRead( const void *buf, uint16 len )
+{
+  const uint8 *p = buf;
+
+  zclhCounts.callbacks++;
+
+  if ( p == NULL )
+    return;
+
+  while ( len-- )
+    zclhSink += *p++;
+}
+
+static void zclhReadAddr( afAddrType_t *addr )
+{
+  zclhRead( addr, sizeof( afAddrType_t ) );
+}
+
+static void zclhReadScene( zclGeneral_Scene_t *scene )
+{
+  zclhRead( scene, sizeof( zclGeneral_Scene_t ) );
+}
+
+/*********************************************************************
+ * CALLBACKS - GENERAL
+ */
+
+static void zclhBasicReset( void )
+{
+  zclhRead( NULL, 0 );
+}
+
+static void zclhIdentifyRsp( afAddrType_t *dstAddr, uint16 timeout )
+{
+  zclhReadAddr( dstAddr );
+  zclhSink += (uint8)timeout;
+}
+
+static void zclhOnOff( uint8 cmd )
+{
+  zclhRead( &cmd, 1 );
+}
+
+static void zclhLevelMoveToLevel( uint8 level, uint16 transitionTime )
+{
+  zclhRead( &level, 1 );
+  zclhSink += (uint8)transitionTime;
+}
+
+static void zclhLevelMove( uint8 moveMode, uint8 rate )
+{
+  zclhRead( &moveMode, 1 );
+  zclhSink += rate;
+}
+
+static void zclhLevelStep( uint8 stepMode, uint8 amount, uint16 transitionTime )
+{
+  zclhRead( &stepMode, 1 );
+  zclhSink += amount + (uint8)transitionTime;
+}
+
+static void zclhGroupRsp( afAddrType_t *srcAddr, uint8 cmdID, uint8 status,
+                          uint8 grpCnt, uint16 *grpList, uint8 capacity, uint8 *grpName )
+{
+  zclhReadAddr( srcAddr );
+  zclhSink += cmdID + status + capacity;
+  zclhRead( grpList, (uint16)(grpCnt * sizeof( uint16 )) );
+  if ( grpName )
+    zclhRead( grpName, grpName[0] + 1 );
+}
+
+static uint8 zclhSceneStoreReq( afAddrType_t *srcAddr, zclGeneral_Scene_t *scene )
+{
+  zclhReadAddr( srcAddr );
+  zclhReadScene( scene );
+
+  return ( TRUE );
+}
+
+static void zclhSceneRecallReq( afAddrType_t *srcAddr, zclGeneral_Scene_t *scene )
+{
+  zclhReadAddr( srcAddr );
+  zclhReadScene( scene );
+}
+
+static void zclhSceneRsp( afAddrType_t *srcAddr, uint8 cmdID, uint8 status, uint8 sceneCnt,
+                          uint8 *sceneList, uint8 capacity, zclGeneral_Scene_t *scene )
+{
+  zclhReadAddr( srcAddr );
+  zclhSink += cmdID + status + capacity;
+  zclhRead( sceneList, sceneCnt );
+  if ( scene )
+    zclhReadScene( scene );
+}
+
+static void zclhAlarm( afAddrType_t *srcAddr, uint8 cmdID, uint8 status,
+                       uint8 alarmCode, uint16 clusterID, uint32 timeStamp )
+{
+  zclhReadAddr( srcAddr );
+  zclhSink += cmdID + status + alarmCode + (uint8)clusterID + (uint8)timeStamp;
+}
+
+static void zclhLocation( afAddrType_t *srcAddr, uint8 cmdID, zclLocationAbsolute_t *absLoc,
+                          zclLocationGetData_t *loc, zclLocationDevCfg_t *devCfg,
+                          uint8 *ieeeAddr, uint8 seqNum )
+{
+  zclhReadAddr( srcAddr );
+  zclhSink += cmdID + seqNum;
+  if ( absLoc )
+    zclhRead( absLoc, sizeof( zclLocationAbsolute_t ) );
+  if ( loc )
+    zclhRead( loc, sizeof( zclLocationGetData_t ) );
+  if ( devCfg )
+    zclhRead( devCfg, sizeof( zclLocationDevCfg_t ) );
+  if ( ieeeAddr )
+    zclhRead( ieeeAddr, Z_EXTADDR_LEN );
+}
+
+static void zclhLocationRsp( afAddrType_t *srcAddr, uint8 cmdID, zclLocationDataRsp_t *locRsp,
+                             zclLocationDevCfgRsp_t *devCfgRsp, uint8 locationType )
+{
+  zclhReadAddr( srcAddr );
+  zclhSink += cmdID + locationType;
+  if ( locRsp )
+    zclhRead( locRsp, sizeof( zclLocationDataRsp_t ) );
+  if ( devCfgRsp )
+    zclhRead( devCfgRsp, sizeof( zclLocationDevCfgRsp_t ) );
+}
+
+static zclGeneral_AppCallbacks_t zclhGeneralCBs =
+{
+  zclhBasicReset,
+  zclhIdentifyRsp,
+  zclhOnOff,
+  zclhLevelMoveToLevel,
+  zclhLevelMove,
+  zclhLevelStep,
+  zclhGroupRsp,
+  zclhSceneStoreReq,
+  zclhSceneRecallReq,
+  zclhSceneRsp,
+  zclhAlarm,
+  zclhLocation,
+  zclhLocationRsp
+};
+
+/*********************************************************************
+ * CALLBACKS - OTHER LIBRARIES
+ */
+
+static void zclhPlaceHolder( void )
+{
+  zclhRead( NULL, 0 );
+}
+
+static void zclhSetpointRaiseLower( uint8 mode, uint8 amount )
+{
+  zclhRead( &mode, 1 );
+  zclhSink += amount;
+}
+
+static void zclhMoveToHue( uint8 hue, uint8 direction, uint16 transitionTime )
+{
+  zclhRead( &hue, 1 );
+  zclhSink += direction + (uint8)transitionTime;
+}
+
+static void zclhMoveHue( uint8 moveMode, uint8 rate )
+{
+  zclhRead( &moveMode, 1 );
+  zclhSink += rate;
+}
+
+static void zclhStepHue( uint8 stepMode, uint8 amount, uint16 transitionTime )
+{
+  zclhRead( &stepMode, 1 );
+  zclhSink += amount + (uint8)transitionTime;
+}
+
+static void zclhMoveToSaturation( uint8 saturation, uint16 transitionTime )
+{
+  zclhRead( &saturation, 1 );
+  zclhSink += (uint8)transitionTime;
+}
+
+static void zclhMoveToHueAndSaturation( uint8 hue, uint8 saturation, uint16 transitionTime )
+{
+  zclhRead( &hue, 1 );
+  zclhSink += saturation + (uint8)transitionTime;
+}
+
+static void zclhBACnet( uint8 len, uint8 *BACnet )
+{
+  zclhRead( BACnet, len );
+}
+
+static void zclhChangeNotification( uint8 zoneStatus, uint8 extendedStatus )
+{
+  zclhRead( &zoneStatus, 1 );
+  zclhSink += extendedStatus;
+}
+
+static void zclhEnrollRequest( afAddrType_t *srcAddr, uint8 zoneID, uint16 zoneType,
+                               uint16 manufacturerCode )
+{
+  zclhReadAddr( srcAddr );
+  zclhSink += zoneID + (uint8)zoneType + (uint8)manufacturerCode;
+}
+
+static void zclhEnrollResponse( uint8 responseCode, uint8 zoneID )
+{
+  zclhRead( &responseCode, 1 );
+  zclhSink += zoneID;
+}
+
+static uint8 zclhArm( uint8 armMode )
+{
+  zclhRead( &armMode, 1 );
+
+  return ( armMode );
+}
+
+static void zclhBypass( uint8 numberOfZones, uint8 *bypassBuf )
+{
+  zclhRead( bypassBuf, numberOfZones );
+}
+
+static void zclhArmResponse( uint8 armNotification )
+{
+  zclhRead( &armNotification, 1 );
+}
+
+static void zclhGetZoneIDMapResponse( uint16 *zoneIDMap )
+{
+  zclhRead( zoneIDMap, 16 * sizeof( uint16 ) );
+}
+
+static void zclhGetZoneInformationResponse( uint8 zoneID, uint16 zoneType, uint8 *ieeeAddr )
+{
+  zclhRead( ieeeAddr, Z_EXTADDR_LEN );
+  zclhSink += zoneID + (uint8)zoneType;
+}
+
+static void zclhStartWarning( warning_t warnings, uint16 duration )
+{
+  zclhRead( &warnings, sizeof( warning_t ) );
+  zclhSink += (uint8)duration;
+}
+
+static void zclhSquawk( zclCmdSSWDSquawkPayload_t squawks )
+{
+  zclhRead( &squawks, sizeof( zclCmdSSWDSquawkPayload_t ) );
+}
+
+static zclClosures_AppCallbacks_t zclhClosuresCBs =
+{
+  zclhPlaceHolder
+};
+
+static zclHVAC_AppCallbacks_t zclhHVACCBs =
+{
+  zclhSetpointRaiseLower
+};
+
+static zclLighting_AppCallbacks_t zclhLightingCBs =
+{
+  zclhMoveToHue,
+  zclhMoveHue,
+  zclhStepHue,
+  zclhMoveToSaturation,
+  zclhMoveHue,                      // MoveSaturation has the same form
+  zclhStepHue,                      // StepSaturation has the same form
+  zclhMoveToHueAndSaturation
+};
+
+static zclMS_AppCallbacks_t zclhMSCBs =
+{
+  zclhPlaceHolder
+};
+
+static zclPI_AppCallbacks_t zclhPICBs =
+{
+  zclhBACnet
+};
+
+static zclSS_AppCallbacks_t zclhSSCBs =
+{
+  zclhChangeNotification,
+  zclhEnrollRequest,
+  zclhEnrollResponse,
+  zclhArm,
+  zclhBypass,
+  zclhPlaceHolder,                  // Emergency
+  zclhPlaceHolder,                  // Fire
+  zclhPlaceHolder,                  // Panic
+  zclhArmResponse,
+  zclhGetZoneIDMapResponse,
+  zclhGetZoneInformationResponse,
+  zclhStartWarning,
+  zclhSquawk
+};
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      zclhAppInit
+ *
+ * @brief   Start ZCL and register the harness endpoint with it. Each
+ *          cluster gets attributes 0x0000-0x0005 of types uint8,
+ *          uint16, uint16, int16, uint32 and character string, plus
+ *          a read-only boolean. Identify Time (uint16) and the
+ *          read-only Basic Device Enabled take their own types, so
+ *          writes can't take the device out of service.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void zclhAppInit( void )
+{
+  zclAttrRec_t *pAttr = zclhAttrs;
+  zclhAttrData_t *pData;
+  uint8 i;
+
+  zcl_Init( ZCLH_TASK_ID );
+
+  for ( i = 0; i < ZCLH_CLUSTER_CNT; i++ )
+  {
+    zclhClusterList[i] = zclhClusters[i].actualCluster;
+    pData = &zclhAttrData[i];
+    osal_memset( pData, 0, sizeof( zclhAttrData_t ) );
+
+#define ZCLH_ATTR( id, type, access, ptr ) \
+    st( pAttr->clusterID = zclhClusters[i].actualCluster; \
+        pAttr->pfnWrtHdlr = NULL; \
+        pAttr->attr.attrId = (id); \
+        pAttr->attr.dataType = (type); \
+        pAttr->attr.accessControl = (access); \
+        pAttr->attr.dataPtr = (ptr); \
+        pAttr++; )
+
+    if ( zclhClusters[i].actualCluster == ZCL_HA_CLUSTER_ID_GEN_IDENTIFY )
+      ZCLH_ATTR( ATTRID_IDENTIFY_TIME, ZCL_DATATYPE_UINT16,
+                 ACCESS_CONTROL_READ | ACCESS_CONTROL_WRITE, &pData->u16b );
+    else
+      ZCLH_ATTR( 0x0000, ZCL_DATATYPE_UINT8,
+                 ACCESS_CONTROL_READ | ACCESS_CONTROL_WRITE, &pData->u8 );
+    ZCLH_ATTR( 0x0001, ZCL_DATATYPE_UINT16, ACCESS_CONTROL_READ | ACCESS_CONTROL_WRITE, &pData->u16 );
+    ZCLH_ATTR( 0x0002, ZCL_DATATYPE_UINT16, ACCESS_CONTROL_READ | ACCESS_CONTROL_WRITE, &pData->u16b );
+    ZCLH_ATTR( 0x0003, ZCL_DATATYPE_INT16, ACCESS_CONTROL_READ | ACCESS_CONTROL_WRITE, &pData->s16 );
+    ZCLH_ATTR( 0x0004, ZCL_DATATYPE_UINT32, ACCESS_CONTROL_READ | ACCESS_CONTROL_WRITE, &pData->u32 );
+    ZCLH_ATTR( 0x0005, ZCL_DATATYPE_CHAR_STR, ACCESS_CONTROL_READ | ACCESS_CONTROL_WRITE, pData->str );
+    if ( zclhClusters[i].actualCluster == ZCL_HA_CLUSTER_ID_GEN_BASIC )
+      ZCLH_ATTR( ATTRID_BASIC_DEVICE_ENABLED, ZCL_DATATYPE_BOOLEAN,
+                 ACCESS_CONTROL_READ, &zclhDeviceEnabled );
+    else
+      ZCLH_ATTR( 0x0010, ZCL_DATATYPE_BOOLEAN, ACCESS_CONTROL_READ, &pData->flag );
+
+#undef ZCLH_ATTR
+  }
+
+  afRegister( &zclhEpDesc );
+
+  // Without its index (the second allocation) ZCL searches the table
+  // entry by entry, as it did before the index
+  if ( zclhConvertIndexed == FALSE )
+    zclhStubsAllocFail( 2 );
+  zcl_registerClusterConvertTable( ZCL_HA_PROFILE_ID, ZCLH_CLUSTER_CNT, zclhClusters );
+  zclhStubsAllocFail( 0 );
+
+  zcl_registerAttrList( ZCLH_ENDPOINT, (uint8)(pAttr - zclhAttrs), zclhAttrs );
+
+  zclGeneral_RegisterCmdCallbacks( ZCLH_ENDPOINT, &zclhGeneralCBs );
+  zclClosures_RegisterCmdCallbacks( ZCLH_ENDPOINT, &zclhClosuresCBs );
+  zclHVAC_RegisterCmdCallbacks( ZCLH_ENDPOINT, &zclhHVACCBs );
+  zclLighting_RegisterCmdCallbacks( ZCLH_ENDPOINT, &zclhLightingCBs );
+  zclMS_RegisterCmdCallbacks( ZCLH_ENDPOINT, &zclhMSCBs );
+  zclPI_RegisterCmdCallbacks( ZCLH_ENDPOINT, &zclhPICBs );
+  zclSS_RegisterCmdCallbacks( ZCLH_ENDPOINT, &zclhSSCBs );
+}
+
+/*********************************************************************
+ * @fn      zclhAppConvertIndex
+ *
+ * @brief   Choose whether zclhAppInit() lets ZCL index the cluster
+ *          conversion table.
+ *
+ * @param   indexed - TRUE (the default) or FALSE
+ *
+ * @return  none
+ */
+void zclhAppConvertIndex( uint8 indexed )
+{
+  zclhConvertIndexed = indexed;
+}
+
+/*********************************************************************
+ * @fn      zclhAppClusterCnt
+ *
+ * @brief   Number of clusters on the harness endpoint.
+ *
+ * @param   none
+ *
+ * @return  count
+ */
+uint8 zclhAppClusterCnt( void )
+{
+  return ( ZCLH_CLUSTER_CNT );
+}
+
+/*********************************************************************
+ * @fn      zclhAppCluster
+ *
+ * @brief   Real ID of a cluster on the harness endpoint.
+ *
+ * @param   i - index, below zclhAppClusterCnt()
+ *
+ * @return  cluster ID
+ */
+uint16 zclhAppCluster( uint8 i )
+{
+  return ( zclhClusters[i].actualCluster );
+}
+
+/*********************************************************************
+*********************************************************************/
@@ -0,0 +1,305 @@
+/*********************************************************************
+    Filename:       ZclHarnessBench.c
+    Revised:        $Date: 2007-06-20 10:30:00 -0700 (Wed, 20 Jun 2007) $
+    Revision:       $Revision: 14650 $
+
+    Description: Micro-benchmarks for the ZCL harness.
+
+                 Attribute lookup: zclFindAttrRec() on one endpoint
+                 with 50 to 300 attributes, 16 to a cluster, registered
+                 three ways:
+                   linear    out of order, with the index allocation
+                             failed, so the records are scanned one by
+                             one (the search ZCL had before the index)
+                   indexed   out of order, sorted through the index
+                             built at registration
+                   in place  in cluster and attribute ID order, binary
+                             searched without an index
+                 Hits look up a random attribute of the endpoint,
+                 misses an attribute ID its clusters don't have. The
+                 same cases are then run on the attribute lists of the
+                 HA light and thermostat (ZclHarnessHa.c).
+
+    Notes:       Host build only, never linked into a device image.
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ZComDef.h"
+
+#include "zcl.h"
+
+#include "ZclHarness.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Endpoint the benchmark lists are registered on
+#define ZCLH_BENCH_ENDPOINT     20
+
+// Attributes on each cluster of the benchmark lists
+#define ZCLH_BENCH_PER_CLUSTER  16
+
+// Most records in one list, numAttributes is a uint8
+#define ZCLH_BENCH_LIST_MAX     150
+
+// Most attributes on the endpoint
+#define ZCLH_BENCH_ATTR_MAX     300
+
+// Attribute ID no cluster has
+#define ZCLH_BENCH_MISS_ID      0x7FFF
+
+// Keys looked up in turn, a power of two
+#define ZCLH_BENCH_KEYS         4096
+
+// How the lists of a case are registered
+#define ZCLH_BENCH_LINEAR       0
+#define ZCLH_BENCH_INDEXED      1
+#define ZCLH_BENCH_IN_PLACE     2
+#define ZCLH_BENCH_CASES        3
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint16 clusterID;
+  uint16 attrId;
+} zclhBenchKey_t;
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static const uint16 zclhBenchSizes[] = { 50, 100, 150, 200, 250, 300 };
+
+static const char *zclhBenchNames[ZCLH_BENCH_CASES] =
+{
+  "linear", "indexed", "in place"
+};
+
+static zclAttrRec_t zclhBenchOrdered[ZCLH_BENCH_ATTR_MAX];
+static zclAttrRec_t zclhBenchShuffled[ZCLH_BENCH_ATTR_MAX];
+static zclhBenchKey_t zclhBenchHits[ZCLH_BENCH_KEYS];
+static zclhBenchKey_t zclhBenchMisses[ZCLH_BENCH_KEYS];
+static uint8 zclhBenchValue;
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      zclhBenchBuild
+ *
+ * @brief   Fill in the records of an endpoint, in order and shuffled,
+ *          and the keys to look up.
+ *
+ * @param   pSrc - records in order, NULL for made up ones
+ * @param   n - number of attributes
+ *
+ * @return  none
+ */
+static void zclhBenchBuild( const zclAttrRec_t *pSrc, uint16 n )
+{
+  zclAttrRec_t tmp;
+  uint16 i;
+  uint16 j;
+
+  for ( i = 0; i < n; i++ )
+  {
+    if ( pSrc )
+    {
+      zclhBenchOrdered[i] = pSrc[i];
+      continue;
+    }
+    memset( &zclhBenchOrdered[i], 0, sizeof( zclAttrRec_t ) );
+    zclhBenchOrdered[i].clusterID = i / ZCLH_BENCH_PER_CLUSTER;
+    zclhBenchOrdered[i].attr.attrId = i % ZCLH_BENCH_PER_CLUSTER;
+    zclhBenchOrdered[i].attr.dataType = ZCL_DATATYPE_UINT8;
+    zclhBenchOrdered[i].attr.accessControl = ACCESS_CONTROL_READ;
+    zclhBenchOrdered[i].attr.dataPtr = &zclhBenchValue;
+  }
+
+  memcpy( zclhBenchShuffled, zclhBenchOrdered, n * sizeof( zclAttrRec_t ) );
+  for ( i = n - 1; i > 0; i-- )
+  {
+    j = zclhRand() % (i + 1);
+    tmp = zclhBenchShuffled[i];
+    zclhBenchShuffled[i] = zclhBenchShuffled[j];
+    zclhBenchShuffled[j] = tmp;
+  }
+
+  for ( i = 0; i < ZCLH_BENCH_KEYS; i++ )
+  {
+    j = zclhRand() % n;
+    zclhBenchHits[i].clusterID = zclhBenchOrdered[j].clusterID;
+    zclhBenchHits[i].attrId = zclhBenchOrdered[j].attr.attrId;
+    zclhBenchMisses[i].clusterID = zclhBenchOrdered[j].clusterID;
+    zclhBenchMisses[i].attrId = ZCLH_BENCH_MISS_ID;
+  }
+}
+
+/*********************************************************************
+ * @fn      zclhBenchRegister
+ *
+ * @brief   Start ZCL from scratch and register the endpoint's records
+ *          for a case, in lists of up to ZCLH_BENCH_LIST_MAX.
+ *
+ * @param   n - number of attributes
+ * @param   benchCase - ZCLH_BENCH_LINEAR, _INDEXED or _IN_PLACE
+ *
+ * @return  none
+ */
+static void zclhBenchRegister( uint16 n, uint8 benchCase )
+{
+  zclAttrRec_t *pRecs;
+  uint16 i;
+  uint16 cnt;
+
+  pRecs = (benchCase == ZCLH_BENCH_IN_PLACE) ? zclhBenchOrdered : zclhBenchShuffled;
+
+  zcl_Init( ZCLH_TASK_ID );
+
+  for ( i = 0; i < n; i += cnt )
+  {
+    cnt = n - i;
+    if ( cnt > ZCLH_BENCH_LIST_MAX )
+      cnt = ZCLH_BENCH_LIST_MAX;
+
+    // The list record is the first allocation, the index the second
+    if ( benchCase == ZCLH_BENCH_LINEAR )
+      zclhStubsAllocFail( 2 );
+
+    if ( zcl_registerAttrList( ZCLH_BENCH_ENDPOINT, (uint8)cnt, &pRecs[i] ) != ZSuccess )
+    {
+      fprintf( stderr, "bench: attribute list not registered\n" );
+      exit( 1 );
+    }
+  }
+  zclhStubsAllocFail( 0 );
+}
+
+/*********************************************************************
+ * @fn      zclhBenchTime
+ *
+ * @brief   Look up keys in turn.
+ *
+ * @param   pKeys - ZCLH_BENCH_KEYS keys
+ * @param   lookups - number of lookups
+ * @param   pFound - incremented for each key found
+ *
+ * @return  mean ns per lookup
+ */
+static double zclhBenchTime( zclhBenchKey_t *pKeys, uint32 lookups, uint32 *pFound )
+{
+  zclhBenchKey_t *pKey;
+  uint64_t t0;
+  uint32 i;
+
+  t0 = zclhNow();
+  for ( i = 0; i < lookups; i++ )
+  {
+    pKey = &pKeys[i & (ZCLH_BENCH_KEYS - 1)];
+    if ( zclFindAttrRec( ZCLH_BENCH_ENDPOINT, pKey->clusterID, pKey->attrId ) )
+      (*pFound)++;
+  }
+
+  return ( (double)(zclhNow() - t0) / lookups );
+}
+
+/*********************************************************************
+ * @fn      zclhBenchCases
+ *
+ * @brief   Register the records zclhBenchBuild() made each way and
+ *          time the lookups.
+ *
+ * @param   pName - what the records are
+ * @param   n - number of attributes
+ * @param   lookups - number of hits, and of misses, timed per case
+ *
+ * @return  none
+ */
+static void zclhBenchCases( const char *pName, uint16 n, uint32 lookups )
+{
+  double hit;
+  double miss;
+  uint32 hits;
+  uint32 misses;
+  uint8 c;
+
+  for ( c = 0; c < ZCLH_BENCH_CASES; c++ )
+  {
+    zclhBenchRegister( n, c );
+
+    hits = 0;
+    misses = 0;
+    hit = zclhBenchTime( zclhBenchHits, lookups, &hits );
+    miss = zclhBenchTime( zclhBenchMisses, lookups, &misses );
+    if ( hits != lookups || misses != 0 )
+    {
+      fprintf( stderr, "bench: %s, %s: wrong lookup result\n", pName, zclhBenchNames[c] );
+      exit( 1 );
+    }
+
+    printf( "  %-18s %-8s  %8.1f  %8.1f\n", pName, zclhBenchNames[c], hit, miss );
+  }
+}
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      zclhBenchAttrs
+ *
+ * @brief   Time attribute lookups on endpoints of 50 to 300 attributes
+ *          and on the HA devices, for each way of registering them,
+ *          see the top of the file. ZCL is started again for each
+ *          case, so the harness application is gone afterwards.
+ *
+ * @param   lookups - number of hits, and of misses, timed per case
+ *
+ * @return  none
+ */
+void zclhBenchAttrs( uint32 lookups )
+{
+  const zclAttrRec_t *pAttrs;
+  const char *pName;
+  char name[32];
+  uint8 n;
+  uint8 s;
+
+  printf( "attribute lookup, %u per case\n", lookups );
+  printf( "  %-27s  %8s  %8s\n", "", "ns/hit", "ns/miss" );
+
+  for ( s = 0; s < sizeof( zclhBenchSizes ) / sizeof( zclhBenchSizes[0] ); s++ )
+  {
+    zclhBenchBuild( NULL, zclhBenchSizes[s] );
+    sprintf( name, "%u attributes", zclhBenchSizes[s] );
+    zclhBenchCases( name, zclhBenchSizes[s], lookups );
+  }
+
+  for ( s = 0; s < ZCLH_HA_DEVICES; s++ )
+  {
+    n = zclhHaAttrs( s, &pName, &pAttrs );
+    zclhBenchBuild( pAttrs, n );
+    sprintf( name, "%s (%u)", pName, n );
+    zclhBenchCases( name, n, lookups );
+  }
+}
+
+/*********************************************************************
+*********************************************************************/
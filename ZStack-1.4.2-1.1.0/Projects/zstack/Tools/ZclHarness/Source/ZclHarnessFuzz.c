@@ -0,0 +1,418 @@
+/*********************************************************************
+    Filename:       ZclHarnessFuzz.c
+    Revised:        $Date: 2007-06-20 10:30:00 -0700 (Wed, 20 Jun 2007) $
+    Revision:       $Revision: 14650 $
+
+    Description: Coverage guided fuzzer for the ZCL harness.
+
+                 The ZCL sources are built with gcc's
+                 -fsanitize-coverage=trace-pc (ZCLH_COVERAGE), which
+                 calls __sanitizer_cov_trace_pc() on every basic block.
+                 That hashes pairs of blocks into an edge map. An input
+                 that reaches an edge not seen before is kept in the
+                 corpus, and new inputs are mutations of kept ones:
+                 bit flips, boundary bytes, inserted and deleted bytes,
+                 truncated and extended frames, other clusters and
+                 command IDs, and splices of two inputs. Without
+                 ZCLH_COVERAGE the fuzzer still runs, blind.
+
+                 Built with AddressSanitizer, a read or write past a
+                 frame, a ZCL buffer or an application buffer stops the
+                 run; the input is written to stderr in capture format
+                 first, so "-r" replays it.
+
+                 With ZCLH_LIBFUZZER the file instead provides
+                 LLVMFuzzerTestOneInput() for clang's libFuzzer: the
+                 first byte picks the cluster, the second the flags and
+                 the rest is the ZCL frame.
+
+    Notes:       Host build only, never linked into a device image.
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "ZComDef.h"
+
+#include "zcl.h"
+
+#include "ZclHarness.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Edge map size, a power of two
+#define ZCLH_COV_SIZE         65536
+
+// Most mutations stacked on one input
+#define ZCLH_MUTATE_MAX       4
+
+// Progress line interval, in inputs
+#define ZCLH_FUZZ_STATUS      100000
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+#if defined( ZCLH_COVERAGE )
+static uint8 zclhCovMap[ZCLH_COV_SIZE];
+#endif
+static uint32 zclhCovPrev;
+static uint32 zclhCovEdges;
+static uint32 zclhCovNew;
+
+static zclhFrame_t *zclhCurrent;
+
+static zclhFrame_t *zclhCorpus;
+static uint32 zclhCorpusCnt;
+static uint32 zclhCorpusMax;
+
+/*********************************************************************
+ * COVERAGE
+ */
+
+#if defined( ZCLH_COVERAGE )
+/*********************************************************************
+ * @fn      __sanitizer_cov_trace_pc
+ *
+ * @brief   Called by gcc on every basic block of the ZCL sources.
+ *          The edge is the pair (previous block, this block), hashed
+ *          the way AFL does it.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void __sanitizer_cov_trace_pc( void )
+{
+  uintptr_t pc = (uintptr_t)__builtin_return_address( 0 );
+  uint32 cur = (uint32)((pc >> 4) ^ (pc << 8)) & (ZCLH_COV_SIZE - 1);
+  uint32 idx = cur ^ zclhCovPrev;
+
+  zclhCovPrev = cur >> 1;
+
+  if ( zclhCovMap[idx] == 0 )
+  {
+    zclhCovMap[idx] = 1;
+    zclhCovNew++;
+  }
+}
+#endif // ZCLH_COVERAGE
+
+/*********************************************************************
+ * CRASH REPORTING
+ */
+
+static void zclhDumpCurrent( void )
+{
+  if ( zclhCurrent )
+  {
+    fprintf( stderr, "\nzclharness: failing input (replay with -r):\n" );
+    zclhPrintFrame( stderr, zclhCurrent );
+    zclhCurrent = NULL;
+  }
+}
+
+static void zclhSignal( int sig )
+{
+  zclhDumpCurrent();
+  signal( sig, SIG_DFL );
+  raise( sig );
+}
+
+// Provided by the sanitizer runtime, when there is one
+extern void __sanitizer_set_death_callback( void (*callback)( void ) ) __attribute__(( weak ));
+
+static void zclhCrashInit( void )
+{
+  if ( __sanitizer_set_death_callback )
+    __sanitizer_set_death_callback( zclhDumpCurrent );
+
+  signal( SIGSEGV, zclhSignal );
+  signal( SIGBUS, zclhSignal );
+  signal( SIGABRT, zclhSignal );
+  signal( SIGFPE, zclhSignal );
+}
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      zclhFuzzRun
+ *
+ * @brief   Run one input.
+ *
+ * @param   pFrame - input
+ *
+ * @return  number of new edges it reached
+ */
+static uint32 zclhFuzzRun( zclhFrame_t *pFrame )
+{
+  zclhCovPrev = 0;
+  zclhCovNew = 0;
+
+  zclhCurrent = pFrame;
+  zclhRunFrame( pFrame );
+  zclhCurrent = NULL;
+
+  zclhCovEdges += zclhCovNew;
+
+  return ( zclhCovNew );
+}
+
+static void zclhCorpusAdd( zclhFrame_t *pFrame )
+{
+  if ( zclhCorpusCnt == zclhCorpusMax )
+  {
+    zclhCorpusMax = zclhCorpusMax ? zclhCorpusMax * 2 : 1024;
+    zclhCorpus = realloc( zclhCorpus, zclhCorpusMax * sizeof( zclhFrame_t ) );
+    if ( zclhCorpus == NULL )
+    {
+      fprintf( stderr, "out of memory\n" );
+      exit( 2 );
+    }
+  }
+
+  zclhCorpus[zclhCorpusCnt++] = *pFrame;
+}
+
+/*********************************************************************
+ * @fn      zclhMutate
+ *
+ * @brief   Apply one to ZCLH_MUTATE_MAX random mutations to an input.
+ *
+ * @param   pFrame - input, changed in place
+ *
+ * @return  none
+ */
+static void zclhMutate( zclhFrame_t *pFrame )
+{
+  static const uint8 boundary[] = { 0x00, 0x01, 0x02, 0x7F, 0x80, 0xFE, 0xFF };
+  uint8 n = 1 + zclhRand() % ZCLH_MUTATE_MAX;
+  uint8 cmdIdx;
+  uint8 pos;
+  uint8 cnt;
+
+  while ( n-- )
+  {
+    pos = pFrame->len ? (uint8)(zclhRand() % pFrame->len) : 0;
+
+    switch ( zclhRand() % 11 )
+    {
+      case 0:   // flip a bit
+        if ( pFrame->len )
+          pFrame->data[pos] ^= (uint8)(1 << (zclhRand() % 8));
+        break;
+
+      case 1:   // random byte
+        if ( pFrame->len )
+          pFrame->data[pos] = (uint8)zclhRand();
+        break;
+
+      case 2:   // boundary value, or the length of what follows
+        if ( pFrame->len )
+        {
+          if ( zclhRand() & 1 )
+            pFrame->data[pos] = boundary[zclhRand() % sizeof( boundary )];
+          else
+            pFrame->data[pos] = (uint8)(pFrame->len - pos - 1 + (int)(zclhRand() % 3) - 1);
+        }
+        break;
+
+      case 3:   // insert bytes
+        cnt = 1 + zclhRand() % 4;
+        if ( pFrame->len + cnt <= ZCLH_FRAME_MAX )
+        {
+          memmove( &pFrame->data[pos + cnt], &pFrame->data[pos], pFrame->len - pos );
+          while ( cnt-- )
+          {
+            pFrame->data[pos + cnt] = (uint8)zclhRand();
+            pFrame->len++;
+          }
+        }
+        break;
+
+      case 4:   // delete bytes
+        cnt = 1 + zclhRand() % 4;
+        if ( pos + cnt <= pFrame->len )
+        {
+          memmove( &pFrame->data[pos], &pFrame->data[pos + cnt], pFrame->len - pos - cnt );
+          pFrame->len -= cnt;
+        }
+        break;
+
+      case 5:   // cut short
+        pFrame->len = pos;
+        break;
+
+      case 6:   // extend
+        cnt = 1 + zclhRand() % 16;
+        while ( cnt-- && pFrame->len < ZCLH_FRAME_MAX )
+          pFrame->data[pFrame->len++] = (uint8)zclhRand();
+        break;
+
+      case 7:   // another cluster
+        if ( zclhRand() % 8 )
+          pFrame->clusterID = zclhAppCluster( (uint8)(zclhRand() % zclhAppClusterCnt()) );
+        else
+          pFrame->clusterID = (uint16)zclhRand();
+        break;
+
+      case 8:   // another command
+        cmdIdx = (pFrame->len && (pFrame->data[0] & ZCL_FRAME_CONTROL_MANU_SPECIFIC)) ? 4 : 2;
+        if ( cmdIdx < pFrame->len )
+          pFrame->data[cmdIdx] = (uint8)(zclhRand() % 0x20);
+        break;
+
+      case 9:   // another frame control or delivery
+        if ( pFrame->len && (zclhRand() & 1) )
+          pFrame->data[0] ^= (uint8)(1 << (zclhRand() % 5));
+        else
+          pFrame->flags = (uint8)(zclhRand() % 3);
+        break;
+
+      case 10:  // splice: the tail of another input
+        if ( zclhCorpusCnt )
+        {
+          zclhFrame_t *pOther = &zclhCorpus[zclhRand() % zclhCorpusCnt];
+          uint8 from = pOther->len ? (uint8)(zclhRand() % pOther->len) : 0;
+
+          cnt = pOther->len - from;
+          if ( pos + cnt > ZCLH_FRAME_MAX )
+            cnt = ZCLH_FRAME_MAX - pos;
+          memcpy( &pFrame->data[pos], &pOther->data[from], cnt );
+          pFrame->len = pos + cnt;
+        }
+        break;
+    }
+  }
+}
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+#if !defined( ZCLH_LIBFUZZER )
+/*********************************************************************
+ * @fn      zclhFuzz
+ *
+ * @brief   Fuzz ZCL. The seeds are run first; those that reach new
+ *          edges start the corpus (all of them if there is no
+ *          coverage). Then each input is a mutation of a corpus entry.
+ *
+ * @param   pSeeds - seed frames
+ * @param   seedCnt - number of seeds
+ * @param   iterations - inputs to run
+ *
+ * @return  corpus size at the end
+ */
+uint32 zclhFuzz( zclhFrame_t *pSeeds, uint32 seedCnt, uint32 iterations )
+{
+  zclhFrame_t input;
+  time_t start = time( NULL );
+  uint32 i;
+
+  zclhCrashInit();
+
+  for ( i = 0; i < seedCnt; i++ )
+  {
+    if ( zclhFuzzRun( &pSeeds[i] ) || zclhCovEdges == 0 )
+      zclhCorpusAdd( &pSeeds[i] );
+  }
+  if ( zclhCorpusCnt == 0 )
+  {
+    // Nothing to start from, begin with a bare header
+    memset( &input, 0, sizeof( input ) );
+    input.len = 3;
+    zclhCorpusAdd( &input );
+  }
+  printf( "fuzz: %u seeds, %u kept, %u edges\n", seedCnt, zclhCorpusCnt, zclhCovEdges );
+
+  for ( i = 1; i <= iterations; i++ )
+  {
+    input = zclhCorpus[zclhRand() % zclhCorpusCnt];
+    zclhMutate( &input );
+
+    if ( zclhFuzzRun( &input ) )
+      zclhCorpusAdd( &input );
+
+    if ( (i % ZCLH_FUZZ_STATUS) == 0 || i == iterations )
+    {
+      time_t secs = time( NULL ) - start;
+
+      printf( "fuzz: %u inputs, %u/s, %u edges, corpus %u, heap %u blocks\n",
+              i, (uint32)(secs ? i / secs : i), zclhCovEdges, zclhCorpusCnt,
+              zclhStubsHeapBlocks() );
+      fflush( stdout );
+    }
+  }
+
+  return ( zclhCorpusCnt );
+}
+
+#else // ZCLH_LIBFUZZER
+
+/*********************************************************************
+ * @fn      LLVMFuzzerTestOneInput
+ *
+ * @brief   libFuzzer entry point.
+ *
+ * @param   data - input
+ * @param   size - input length
+ *
+ * @return  0
+ */
+int LLVMFuzzerTestOneInput( const uint8_t *data, size_t size )
+{
+  static uint8 ready = FALSE;
+  zclhFrame_t frame;
+
+  if ( ready == FALSE )
+  {
+    zclhStubsInit();
+    zclhAppInit();
+    zclhCrashInit();
+    ready = TRUE;
+  }
+
+  if ( size < 2 )
+    return ( 0 );
+
+  frame.clusterID = zclhAppCluster( (uint8)(data[0] % zclhAppClusterCnt()) );
+  frame.flags = data[1] % 3;
+  size -= 2;
+  frame.len = (uint8)(size > ZCLH_FRAME_MAX ? ZCLH_FRAME_MAX : size);
+  memcpy( frame.data, data + 2, frame.len );
+
+  zclhFuzzRun( &frame );
+
+  return ( 0 );
+}
+
+uint32 zclhFuzz( zclhFrame_t *pSeeds, uint32 seedCnt, uint32 iterations )
+{
+  (void)pSeeds;
+  (void)seedCnt;
+  (void)iterations;
+
+  return ( 0 );
+}
+#endif // ZCLH_LIBFUZZER
+
+/*********************************************************************
+*********************************************************************/
@@ -0,0 +1,214 @@
+/*********************************************************************
+    Filename:       ZclHarnessHa.c
+    Revised:        $Date: 2007-06-20 10:30:00 -0700 (Wed, 20 Jun 2007) $
+    Revision:       $Revision: 14650 $
+
+    Description: Attribute lists of two full Home Automation devices,
+                 a dimmable light and a thermostat, the way an
+                 application declares them: CONST records in cluster
+                 and attribute ID order, only the values in RAM.
+
+                 Built with ZCLH_HA_RAM the records go in RAM instead,
+                 as they had to before ZCL took CONST lists; "make map"
+                 links the harness both ways, so the linker maps give
+                 what CONST saves.
+
+    Notes:       Host build only, never linked into a device image.
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "ZComDef.h"
+
+#include "zcl.h"
+#include "zcl_general.h"
+#include "zcl_hvac.h"
+
+#include "ZclHarness.h"
+
+/*********************************************************************
+ * MACROS
+ */
+
+#if defined( ZCLH_HA_RAM )
+  #define ZCLH_HA_CONST
+#else
+  #define ZCLH_HA_CONST       const
+#endif
+
+#define ZCLH_HA_RD            ACCESS_CONTROL_READ
+#define ZCLH_HA_RW            (ACCESS_CONTROL_READ | ACCESS_CONTROL_WRITE)
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Home Automation cluster IDs
+#define ZCLH_HA_BASIC         0x0000
+#define ZCLH_HA_IDENTIFY      0x0003
+#define ZCLH_HA_GROUPS        0x0004
+#define ZCLH_HA_SCENES        0x0005
+#define ZCLH_HA_ON_OFF        0x0006
+#define ZCLH_HA_LEVEL_CTRL    0x0008
+#define ZCLH_HA_THERMOSTAT    0x0201
+#define ZCLH_HA_FAN_CTRL      0x0202
+#define ZCLH_HA_UI_CONFIG     0x0204
+
+// Longest Basic cluster string, with its length byte
+#define ZCLH_HA_STR_LEN       17
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+// Basic cluster values, kept by every device
+typedef struct
+{
+  uint8 zclVersion;
+  uint8 appVersion;
+  uint8 stackVersion;
+  uint8 hwVersion;
+  uint8 manufacturer[ZCLH_HA_STR_LEN];
+  uint8 model[ZCLH_HA_STR_LEN];
+  uint8 dateCode[ZCLH_HA_STR_LEN];
+  uint8 powerSource;
+  uint8 location[ZCLH_HA_STR_LEN];
+  uint8 physicalEnv;
+  uint8 deviceEnabled;
+  uint16 identifyTime;
+} zclhHaBasic_t;
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+// Attribute values, in RAM either way
+static zclhHaBasic_t zclhHaLightBasic;
+static uint8 zclhHaGroupsNameSupport;
+static uint8 zclhHaSceneCount;
+static uint8 zclhHaSceneCurrent;
+static uint16 zclhHaSceneGroup;
+static uint8 zclhHaSceneValid;
+static uint8 zclhHaOnOff;
+static uint8 zclhHaLevel;
+static uint16 zclhHaLevelRemaining;
+static uint16 zclhHaLevelOnOffTime;
+static uint8 zclhHaLevelOn;
+
+static zclhHaBasic_t zclhHaThermostatBasic;
+static int16 zclhHaLocalTemp;
+static int16 zclhHaAbsMinHeat;
+static int16 zclhHaAbsMaxHeat;
+static int16 zclhHaAbsMinCool;
+static int16 zclhHaAbsMaxCool;
+static int16 zclhHaOccupiedCool;
+static int16 zclhHaOccupiedHeat;
+static int16 zclhHaMinHeat;
+static int16 zclhHaMaxHeat;
+static int16 zclhHaMinCool;
+static int16 zclhHaMaxCool;
+static int8 zclhHaDeadBand;
+static uint8 zclhHaCtrlSeq;
+static uint8 zclhHaSystemMode;
+static uint8 zclhHaFanMode;
+static uint8 zclhHaFanSequence;
+static uint8 zclhHaDisplayMode;
+static uint8 zclhHaKeypadLockout;
+
+#define ZCLH_HA_BASIC_ATTRS( b ) \
+  { ZCLH_HA_BASIC, NULL, { ATTRID_BASIC_ZCL_VERSION, ZCL_DATATYPE_UINT8, ZCLH_HA_RD, &(b).zclVersion } }, \
+  { ZCLH_HA_BASIC, NULL, { ATTRID_BASIC_APPL_VERSION, ZCL_DATATYPE_UINT8, ZCLH_HA_RD, &(b).appVersion } }, \
+  { ZCLH_HA_BASIC, NULL, { ATTRID_BASIC_STACK_VERSION, ZCL_DATATYPE_UINT8, ZCLH_HA_RD, &(b).stackVersion } }, \
+  { ZCLH_HA_BASIC, NULL, { ATTRID_BASIC_HW_VERSION, ZCL_DATATYPE_UINT8, ZCLH_HA_RD, &(b).hwVersion } }, \
+  { ZCLH_HA_BASIC, NULL, { ATTRID_BASIC_MANUFACTURER_NAME, ZCL_DATATYPE_CHAR_STR, ZCLH_HA_RD, (b).manufacturer } }, \
+  { ZCLH_HA_BASIC, NULL, { ATTRID_BASIC_MODEL_ID, ZCL_DATATYPE_CHAR_STR, ZCLH_HA_RD, (b).model } }, \
+  { ZCLH_HA_BASIC, NULL, { ATTRID_BASIC_DATE_CODE, ZCL_DATATYPE_CHAR_STR, ZCLH_HA_RD, (b).dateCode } }, \
+  { ZCLH_HA_BASIC, NULL, { ATTRID_BASIC_POWER_SOURCE, ZCL_DATATYPE_ENUM8, ZCLH_HA_RD, &(b).powerSource } }, \
+  { ZCLH_HA_BASIC, NULL, { ATTRID_BASIC_LOCATION_DESC, ZCL_DATATYPE_CHAR_STR, ZCLH_HA_RW, (b).location } }, \
+  { ZCLH_HA_BASIC, NULL, { ATTRID_BASIC_PHYSICAL_ENV, ZCL_DATATYPE_ENUM8, ZCLH_HA_RW, &(b).physicalEnv } }, \
+  { ZCLH_HA_BASIC, NULL, { ATTRID_BASIC_DEVICE_ENABLED, ZCL_DATATYPE_BOOLEAN, ZCLH_HA_RW, &(b).deviceEnabled } }, \
+  { ZCLH_HA_IDENTIFY, NULL, { ATTRID_IDENTIFY_TIME, ZCL_DATATYPE_UINT16, ZCLH_HA_RW, &(b).identifyTime } }
+
+// Dimmable light
+static ZCLH_HA_CONST zclAttrRec_t zclhHaLightAttrs[] =
+{
+  ZCLH_HA_BASIC_ATTRS( zclhHaLightBasic ),
+  { ZCLH_HA_GROUPS, NULL, { 0x0000, ZCL_DATATYPE_BITMAP8, ZCLH_HA_RD, &zclhHaGroupsNameSupport } },
+  { ZCLH_HA_SCENES, NULL, { ATTRID_SCENES_COUNT, ZCL_DATATYPE_UINT8, ZCLH_HA_RD, &zclhHaSceneCount } },
+  { ZCLH_HA_SCENES, NULL, { ATTRID_SCENES_CURRENT_SCENE, ZCL_DATATYPE_UINT8, ZCLH_HA_RD, &zclhHaSceneCurrent } },
+  { ZCLH_HA_SCENES, NULL, { ATTRID_SCENES_CURRENT_GROUP, ZCL_DATATYPE_UINT16, ZCLH_HA_RD, &zclhHaSceneGroup } },
+  { ZCLH_HA_SCENES, NULL, { ATTRID_SCENES_SCENE_VALID, ZCL_DATATYPE_BOOLEAN, ZCLH_HA_RD, &zclhHaSceneValid } },
+  { ZCLH_HA_ON_OFF, NULL, { ATTRID_ON_OFF, ZCL_DATATYPE_BOOLEAN, ZCLH_HA_RD, &zclhHaOnOff } },
+  { ZCLH_HA_LEVEL_CTRL, NULL, { ATTRID_LEVEL_CURRENT_LEVEL, ZCL_DATATYPE_UINT8, ZCLH_HA_RD, &zclhHaLevel } },
+  { ZCLH_HA_LEVEL_CTRL, NULL, { ATTRID_LEVEL_REMAINING_TIME, ZCL_DATATYPE_UINT16, ZCLH_HA_RD, &zclhHaLevelRemaining } },
+  { ZCLH_HA_LEVEL_CTRL, NULL, { ATTRID_LEVEL_ON_OFF_TRANSITION_TIME, ZCL_DATATYPE_UINT16, ZCLH_HA_RW, &zclhHaLevelOnOffTime } },
+  { ZCLH_HA_LEVEL_CTRL, NULL, { ATTRID_LEVEL_ON_LEVEL, ZCL_DATATYPE_UINT8, ZCLH_HA_RW, &zclhHaLevelOn } },
+};
+
+// Thermostat
+static ZCLH_HA_CONST zclAttrRec_t zclhHaThermostatAttrs[] =
+{
+  ZCLH_HA_BASIC_ATTRS( zclhHaThermostatBasic ),
+  { ZCLH_HA_THERMOSTAT, NULL, { ATTRID_HVAC_THERMOSTAT_LOCAL_TEMPERATURE, ZCL_DATATYPE_INT16, ZCLH_HA_RD, &zclhHaLocalTemp } },
+  { ZCLH_HA_THERMOSTAT, NULL, { ATTRID_HVAC_THERMOSTAT_ABS_MIN_HEAT_SETPOINT_LIMIT, ZCL_DATATYPE_INT16, ZCLH_HA_RD, &zclhHaAbsMinHeat } },
+  { ZCLH_HA_THERMOSTAT, NULL, { ATTRID_HVAC_THERMOSTAT_ABS_MAX_HEAT_SETPOINT_LIMIT, ZCL_DATATYPE_INT16, ZCLH_HA_RD, &zclhHaAbsMaxHeat } },
+  { ZCLH_HA_THERMOSTAT, NULL, { ATTRID_HVAC_THERMOSTAT_ABS_MIN_COOL_SETPOINT_LIMIT, ZCL_DATATYPE_INT16, ZCLH_HA_RD, &zclhHaAbsMinCool } },
+  { ZCLH_HA_THERMOSTAT, NULL, { ATTRID_HVAC_THERMOSTAT_ABS_MAX_COOL_SETPOINT_LIMIT, ZCL_DATATYPE_INT16, ZCLH_HA_RD, &zclhHaAbsMaxCool } },
+  { ZCLH_HA_THERMOSTAT, NULL, { ATTRID_HVAC_THERMOSTAT_OCCUPIED_COOLING_SETPOINT, ZCL_DATATYPE_INT16, ZCLH_HA_RW, &zclhHaOccupiedCool } },
+  { ZCLH_HA_THERMOSTAT, NULL, { ATTRID_HVAC_THERMOSTAT_OCCUPIED_HEATING_SETPOINT, ZCL_DATATYPE_INT16, ZCLH_HA_RW, &zclhHaOccupiedHeat } },
+  { ZCLH_HA_THERMOSTAT, NULL, { ATTRID_HVAC_THERMOSTAT_MIN_HEAT_SETPOINT_LIMIT, ZCL_DATATYPE_INT16, ZCLH_HA_RW, &zclhHaMinHeat } },
+  { ZCLH_HA_THERMOSTAT, NULL, { ATTRID_HVAC_THERMOSTAT_MAX_HEAT_SETPOINT_LIMIT, ZCL_DATATYPE_INT16, ZCLH_HA_RW, &zclhHaMaxHeat } },
+  { ZCLH_HA_THERMOSTAT, NULL, { ATTRID_HVAC_THERMOSTAT_MIN_COOL_SETPOINT_LIMIT, ZCL_DATATYPE_INT16, ZCLH_HA_RW, &zclhHaMinCool } },
+  { ZCLH_HA_THERMOSTAT, NULL, { ATTRID_HVAC_THERMOSTAT_MAX_COOL_SETPOINT_LIMIT, ZCL_DATATYPE_INT16, ZCLH_HA_RW, &zclhHaMaxCool } },
+  { ZCLH_HA_THERMOSTAT, NULL, { ATTRID_HVAC_THERMOSTAT_MIN_SETPOINT_DEAD_BAND, ZCL_DATATYPE_INT8, ZCLH_HA_RW, &zclhHaDeadBand } },
+  { ZCLH_HA_THERMOSTAT, NULL, { ATTRID_HVAC_THERMOSTAT_CTRL_SEQ_OF_OPER, ZCL_DATATYPE_ENUM8, ZCLH_HA_RW, &zclhHaCtrlSeq } },
+  { ZCLH_HA_THERMOSTAT, NULL, { ATTRID_HVAC_THERMOSTAT_SYSTEM_MODE, ZCL_DATATYPE_ENUM8, ZCLH_HA_RW, &zclhHaSystemMode } },
+  { ZCLH_HA_FAN_CTRL, NULL, { ATTRID_HVAC_FAN_CTRL_FAN_MODE, ZCL_DATATYPE_ENUM8, ZCLH_HA_RW, &zclhHaFanMode } },
+  { ZCLH_HA_FAN_CTRL, NULL, { ATTRID_HVAC_FAN_CTRL_FAN_SEQUENCE, ZCL_DATATYPE_ENUM8, ZCLH_HA_RW, &zclhHaFanSequence } },
+  { ZCLH_HA_UI_CONFIG, NULL, { ATTRID_HVAC_THERMOSTAT_UI_CONFIG_TEMP_DISPLAY_MODE, ZCL_DATATYPE_ENUM8, ZCLH_HA_RW, &zclhHaDisplayMode } },
+  { ZCLH_HA_UI_CONFIG, NULL, { ATTRID_HVAC_THERMOSTAT_UI_CONFIG_KEYPAD_LOCKOUT, ZCL_DATATYPE_ENUM8, ZCLH_HA_RW, &zclhHaKeypadLockout } },
+};
+
+static const char *zclhHaNames[ZCLH_HA_DEVICES] =
+{
+  "HA light", "HA thermostat"
+};
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      zclhHaAttrs
+ *
+ * @brief   Attribute list of a Home Automation device.
+ *
+ * @param   device - ZCLH_HA_DEV_LIGHT or ZCLH_HA_DEV_THERMOSTAT
+ * @param   ppName - set to the name of the device
+ * @param   ppAttrs - set to the attribute records
+ *
+ * @return  number of records
+ */
+uint8 zclhHaAttrs( uint8 device, const char **ppName, const zclAttrRec_t **ppAttrs )
+{
+  *ppName = zclhHaNames[device];
+
+  if ( device == ZCLH_HA_DEV_LIGHT )
+  {
+    *ppAttrs = zclhHaLightAttrs;
+    return ( sizeof( zclhHaLightAttrs ) / sizeof( zclAttrRec_t ) ); // EMBEDDED RETURN
+  }
+
+  *ppAttrs = zclhHaThermostatAttrs;
+  return ( sizeof( zclhHaThermostatAttrs ) / sizeof( zclAttrRec_t ) );
+}
+
+/*********************************************************************
+*********************************************************************/
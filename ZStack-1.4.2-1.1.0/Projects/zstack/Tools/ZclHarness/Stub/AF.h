@@ -0,0 +1,173 @@
+#ifndef AF_H
+#define AF_H
+/*********************************************************************
+    Filename:       AF.h
+    Revised:        $Date: 2007-06-20 10:30:00 -0700 (Wed, 20 Jun 2007) $
+    Revision:       $Revision: 14650 $
+
+    Description: Host build of the Application Framework for the ZCL
+                 harness. Only what ZCL uses is declared, with the same
+                 layouts as Components/stack/af/AF.h. The functions are
+                 implemented by the harness (ZclHarnessStubs.c).
+
+    Notes:
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "ZComDef.h"
+#include "OSAL.h"
+#include "aps_groups.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+#define AF_ACK_REQUEST                     0x10
+#define AF_DISCV_ROUTE                     0x20
+#define AF_EN_SECURITY                     0x40
+
+#define AF_MSG_ACK_REQUEST                 AF_ACK_REQUEST
+#define AF_DEFAULT_RADIUS                  10
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef uint16  cId_t;
+
+// Simple Description Format Structure
+typedef struct
+{
+  byte          EndPoint;
+  uint16        AppProfId;
+  uint16        AppDeviceId;
+  byte          AppDevVer:4;
+  byte          Reserved:4;
+  byte          AppNumInClusters;
+  cId_t         *pAppInClusterList;
+  byte          AppNumOutClusters;
+  cId_t         *pAppOutClusterList;
+} SimpleDescriptionFormat_t;
+
+// Generalized MSG Command Format
+typedef struct
+{
+  byte   TransSeqNumber;
+  uint16 DataLength;               // Number of bytes in TransData
+  byte  *Data;
+} afMSGCommandFormat_t;
+
+typedef enum
+{
+  noLatencyReqs,
+  fastBeacons,
+  slowBeacons
+} afNetworkLatencyReq_t;
+
+typedef enum
+{
+  afAddrNotPresent = AddrNotPresent,
+  afAddr16Bit      = Addr16Bit,
+  afAddrGroup      = AddrGroup,
+  afAddrBroadcast  = AddrBroadcast
+} afAddrMode_t;
+
+typedef struct
+{
+  union
+  {
+    uint16  shortAddr;
+  } addr;
+  afAddrMode_t addrMode;
+  byte endPoint;
+} afAddrType_t;
+
+typedef struct
+{
+  osal_event_hdr_t hdr;
+  uint16 groupId;
+  uint16 clusterId;
+  afAddrType_t srcAddr;
+  byte endPoint;
+  byte wasBroadcast;
+  byte LinkQuality;
+  byte SecurityUse;
+  uint32 timestamp;
+  afMSGCommandFormat_t cmd;
+} afIncomingMSGPacket_t;
+
+typedef struct
+{
+  osal_event_hdr_t hdr;
+  byte endpoint;
+  byte transID;
+} afDataConfirm_t;
+
+typedef struct
+{
+  byte endPoint;
+  byte *task_id;  // Pointer to location of the Application task ID.
+  SimpleDescriptionFormat_t *simpleDesc;
+  afNetworkLatencyReq_t latencyReq;
+} endPointDesc_t;
+
+typedef enum
+{
+  afStatus_SUCCESS,
+  afStatus_FAILED = 0x80,
+  afStatus_MEM_FAIL,
+  afStatus_INVALID_PARAMETER
+} afStatus_t;
+
+typedef struct
+{
+  uint8 secure;
+} APSDE_DataReqMTU_t;
+
+typedef struct
+{
+  uint8              kvp;
+  APSDE_DataReqMTU_t aps;
+} afDataReqMTU_t;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+  extern afStatus_t afRegister( endPointDesc_t *epDesc );
+
+  extern endPointDesc_t *afFindEndPointDesc( byte endPoint );
+
+  extern ZStatus_t afAddGroup( uint8 endpoint, aps_Group_t *group );
+
+  extern uint8 afRemoveGroup( uint8 endpoint, uint16 groupID );
+
+  extern void afRemoveAllGroups( uint8 endpoint );
+
+  extern uint8 afDataReqMTU( afDataReqMTU_t* fields );
+
+  extern afStatus_t AF_DataRequest( afAddrType_t *dstAddr, endPointDesc_t *srcEP,
+                                    uint16 cID, uint16 len, uint8 *buf, uint8 *transID,
+                                    uint8 options, uint8 radius );
+
+/*********************************************************************
+*********************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
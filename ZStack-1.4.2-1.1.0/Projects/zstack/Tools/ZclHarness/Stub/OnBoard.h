@@ -0,0 +1,33 @@
+#ifndef ONBOARD_H
+#define ONBOARD_H
+/*********************************************************************
+    Filename:       OnBoard.h
+    Revised:        $Date: 2007-06-20 10:30:00 -0700 (Wed, 20 Jun 2007) $
+    Revision:       $Revision: 14650 $
+
+    Description: Host build of the board definitions used by the OSAL
+                 heap, for the ZCL harness.
+
+    Notes:       Host pointers are wider than on the CC2430, so ZCL
+                 structures are too. The heap is sized for that.
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+
+#include "hal_defs.h"
+#include "hal_types.h"
+
+#if !defined( MAXMEMHEAP )
+  #define MAXMEMHEAP  16384
+#endif
+
+// No interrupts on the host
+typedef unsigned char halIntState_t;
+#define HAL_ENTER_CRITICAL_SECTION( x )   st( x = 0; )
+#define HAL_EXIT_CRITICAL_SECTION( x )    st( (void)x; )
+
+#endif /* ONBOARD_H */
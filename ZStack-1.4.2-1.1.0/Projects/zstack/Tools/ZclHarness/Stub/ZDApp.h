@@ -0,0 +1,22 @@
+#ifndef ZDAPP_H
+#define ZDAPP_H
+/*********************************************************************
+    Filename:       ZDApp.h
+    Revised:        $Date: 2007-06-20 10:30:00 -0700 (Wed, 20 Jun 2007) $
+    Revision:       $Revision: 14650 $
+
+    Description: Host build of the ZDO Application for the ZCL harness.
+                 ZCL only includes it, nothing from it is used.
+
+    Notes:
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+
+#include "ZComDef.h"
+
+#endif /* ZDAPP_H */
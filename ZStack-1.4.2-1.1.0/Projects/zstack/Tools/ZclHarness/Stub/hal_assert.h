@@ -0,0 +1,23 @@
+#ifndef HAL_ASSERT_H
+#define HAL_ASSERT_H
+/*********************************************************************
+    Filename:       hal_assert.h
+    Revised:        $Date: 2007-06-20 10:30:00 -0700 (Wed, 20 Jun 2007) $
+    Revision:       $Revision: 14650 $
+
+    Description: Host build of the HAL assert, for the ZCL harness.
+
+    Notes:
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+
+#include <assert.h>
+
+#define HAL_ASSERT( expr )  assert( expr )
+
+#endif /* HAL_ASSERT_H */
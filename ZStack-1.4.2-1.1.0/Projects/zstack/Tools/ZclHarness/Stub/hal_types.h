@@ -0,0 +1,65 @@
+/**************************************************************************************************
+    Filename:       hal_types.h
+    Revised:        $Date: 2007-06-20 10:30:00 -0700 (Wed, 20 Jun 2007) $
+    Revision:       $Revision: 14650 $
+
+    Description:
+
+    Host build of the HAL types for the ZCL harness. The widths match
+    the CC2430 target, whatever the host's long is.
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+**************************************************************************************************/
+
+#ifndef HAL_TYPES_H
+#define HAL_TYPES_H
+
+#include <stdint.h>
+
+/* ------------------------------------------------------------------------------------------------
+ *                                               Types
+ * ------------------------------------------------------------------------------------------------
+ */
+typedef int8_t          int8;
+typedef uint8_t         uint8;
+
+typedef int16_t         int16;
+typedef uint16_t        uint16;
+
+typedef int32_t         int32;
+typedef uint32_t        uint32;
+
+typedef unsigned char   bool;
+
+typedef uint8           halDataAlign_t;
+
+/* ------------------------------------------------------------------------------------------------
+ *                                        Compiler Macros
+ * ------------------------------------------------------------------------------------------------
+ */
+#define  CODE
+#define  XDATA
+
+/* ------------------------------------------------------------------------------------------------
+ *                                        Standard Defines
+ * ------------------------------------------------------------------------------------------------
+ */
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+/**************************************************************************************************
+ */
+#endif
@@ -0,0 +1,29 @@
+#ifndef ZCL_HA_H
+#define ZCL_HA_H
+/*********************************************************************
+    Filename:       zcl_ha.h
+    Revised:        $Date: 2007-06-20 10:30:00 -0700 (Wed, 20 Jun 2007) $
+    Revision:       $Revision: 14650 $
+
+    Description: Host build of the Home Automation profile definitions
+                 used by ZCL, for the ZCL harness.
+
+    Notes:
+
+    Copyright (c) 2006 by Texas Instruments, Inc.
+    All Rights Reserved.  Permission to use, reproduce, copy, prepare
+    derivative works, modify, distribute, perform, display or sell this
+    software and/or its documentation for any purpose is prohibited
+    without the express written consent of Texas Instruments, Inc.
+*********************************************************************/
+
+#include "ZComDef.h"
+
+// Zigbee Home Automation Profile Identification
+#define ZCL_HA_PROFILE_ID                       0x0104
+
+// Generic Clusters
+#define ZCL_HA_CLUSTER_ID_GEN_BASIC             0x0000
+#define ZCL_HA_CLUSTER_ID_GEN_IDENTIFY          0x0003
+
+#endif /* ZCL_HA_H */
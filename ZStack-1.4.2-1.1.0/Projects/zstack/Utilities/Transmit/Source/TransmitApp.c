@@ -444,7 +444,7 @@ void TransmitApp_HandleKeys( byte shift, byte keys )
       // Assign yourself to group 1
       group.ID = 0x0001;
       group.name[0] = 0;
-      aps_AddGroup( TRANSMITAPP_ENDPOINT, &group );
+      afAddGroup( TRANSMITAPP_ENDPOINT, &group );
     }
     if ( keys & HAL_KEY_SW_2 )
     {